@@ -0,0 +1,557 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+/**
+ * Micro-benchmarks for the hot primitives used by LSRP.
+ *
+ * Usage: ./bench_primitives [demo_map_path] [min_ms_per_case]
+ *
+ * Every case reports the mean wall time per operation (ns/op) and the number of
+ * heap allocations per operation (allocs/op). Allocations are counted by replacing
+ * the global operator new of this executable, which also intercepts the calls made
+ * inside libPROJ_LSRP.
+ */
+
+#include "mapfaa_lsrp.hpp"
+#include "binary_map.hpp"
+#include "search_jps.hpp"
+#include "graph_io.hpp"
+#include "plan_file.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <new>
+#include <sstream>
+
+// ------------------------------------------------------------------------------
+// allocation counter
+
+static std::size_t g_n_alloc = 0;
+
+void* operator new(std::size_t n) {
+  ++g_n_alloc;
+  void* p = std::malloc(n == 0 ? 1 : n);
+  if (!p) { throw std::bad_alloc(); }
+  return p;
+}
+void* operator new[](std::size_t n) {
+  ++g_n_alloc;
+  void* p = std::malloc(n == 0 ? 1 : n);
+  if (!p) { throw std::bad_alloc(); }
+  return p;
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// ------------------------------------------------------------------------------
+// harness
+
+static double g_min_sec = 0.05;
+static volatile double g_sink = 0; // keep results observable.
+
+template<typename Op>
+void RunCase(const std::string& primitive, const std::string& instance, Op op) {
+  op(); // warm up
+  size_t iters = 1;
+  while (true) {
+    size_t n_alloc0 = g_n_alloc;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iters; i++) {
+      op();
+    }
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    size_t n_alloc = g_n_alloc - n_alloc0;
+    if (sec >= g_min_sec || iters >= (size_t(1) << 26)) {
+      std::printf("%-28s %-26s %14.1f %12.2f %10zu\n", primitive.c_str(), instance.c_str(),
+                  sec * 1e9 / iters, double(n_alloc) / iters, iters);
+      return;
+    }
+    iters *= 2;
+  }
+}
+
+// ------------------------------------------------------------------------------
+// instances
+
+/**
+ * @brief Exposes the protected building blocks of Lsrp to the benchmark.
+ */
+class LsrpProbe : public raplab::Lsrp {
+public:
+  using raplab::Lsrp::generate_single_dis_table;
+  using raplab::Lsrp::insert_policy;
+  using raplab::Lsrp::merge_policy;
+  std::vector<raplab::Agent*>& Agents() {return _agents;}
+  std::vector<std::vector<raplab::State*>>& History() {return _S_T;}
+  void ClearPaths() {_paths.clear();}
+};
+
+struct Instance {
+  std::string name;
+  std::vector<std::vector<double>> grid;
+  std::vector<long> free_cells; // free cells in the component that contains the first free cell.
+  std::vector<long> starts;
+  std::vector<long> goals;
+  std::vector<double> durations;
+};
+
+void CollectComponent(Instance* ins) {
+  long rows = ins->grid.size();
+  long cols = ins->grid[0].size();
+  std::vector<char> seen(rows * cols, 0);
+  long seed = -1;
+  for (long k = 0; k < rows * cols && seed < 0; k++) {
+    if (ins->grid[k / cols][k % cols] <= 0) {seed = k;}
+  }
+  if (seed < 0) {return;}
+  std::deque<long> q;
+  q.push_back(seed);
+  seen[seed] = 1;
+  const long dr[4] = {0, 0, -1, 1};
+  const long dc[4] = {-1, 1, 0, 0};
+  while (!q.empty()) {
+    long k = q.front();
+    q.pop_front();
+    ins->free_cells.push_back(k);
+    for (int i = 0; i < 4; i++) {
+      long r = k / cols + dr[i];
+      long c = k % cols + dc[i];
+      if (r < 0 || r >= rows || c < 0 || c >= cols) {continue;}
+      long nk = r * cols + c;
+      if (seen[nk] || ins->grid[r][c] > 0) {continue;}
+      seen[nk] = 1;
+      q.push_back(nk);
+    }
+  }
+}
+
+void PickAgents(Instance* ins, size_t n_agents, std::mt19937* rng) {
+  std::vector<long> cells = ins->free_cells;
+  std::shuffle(cells.begin(), cells.end(), *rng);
+  n_agents = std::min(n_agents, cells.size() / 2);
+  ins->starts.assign(cells.begin(), cells.begin() + n_agents);
+  ins->goals.assign(cells.begin() + n_agents, cells.begin() + 2 * n_agents);
+  std::uniform_int_distribution<int> dis(1, 6);
+  for (size_t i = 0; i < n_agents; i++) {
+    ins->durations.push_back(0.1 * dis(*rng));
+  }
+}
+
+Instance MakeSynthetic(long rows, long cols, double obstacle_ratio, size_t n_agents, std::mt19937* rng) {
+  Instance ins;
+  ins.name = "rand-" + std::to_string(rows) + "x" + std::to_string(cols) + "-a" + std::to_string(n_agents);
+  ins.grid.resize(rows, std::vector<double>(cols, 0));
+  std::uniform_real_distribution<double> dis(0.0, 1.0);
+  for (long r = 0; r < rows; r++) {
+    for (long c = 0; c < cols; c++) {
+      if (dis(*rng) < obstacle_ratio) {ins.grid[r][c] = 1;}
+    }
+  }
+  CollectComponent(&ins);
+  PickAgents(&ins, n_agents, rng);
+  return ins;
+}
+
+bool MakeFromMap(const std::string& map_path, size_t n_agents, std::mt19937* rng, Instance* ins) {
+  if (raplab::LoadMap_MovingAI(map_path, &(ins->grid)) != 1 || ins->grid.empty()) {
+    return false;
+  }
+  std::string base = map_path.substr(map_path.find_last_of("/\\") + 1);
+  ins->name = base.substr(0, base.find_last_of('.')) + "-a" + std::to_string(n_agents);
+  CollectComponent(ins);
+  PickAgents(ins, n_agents, rng);
+  return true;
+}
+
+// ------------------------------------------------------------------------------
+// cases
+
+/**
+ * @brief One complete solve per op, with a fresh planner of type P.
+ */
+template <typename P>
+void RunSolveCase(const std::string& primitive, Instance& ins, raplab::Grid2d& g) {
+  RunCase(primitive, ins.name, [&]() {
+    P p;
+    p.SetGraphPtr(&g);
+    p.Setduration(ins.durations);
+    p.Solve(ins.starts, ins.goals, 30, 1.0);
+    g_sink += p.re_soc();
+  });
+}
+
+void BenchInstance(Instance& ins) {
+  raplab::Grid2d g;
+  g.SetOccuGridPtr(&ins.grid);
+  const std::vector<long>& cells = ins.free_cells;
+  size_t n_cells = cells.size();
+  size_t n_agents = ins.starts.size();
+
+  // graph access
+  size_t k = 0;
+  RunCase("Grid2d::GetSuccs", ins.name, [&]() {
+    g_sink += g.GetSuccs(cells[k++ % n_cells]).size();
+  });
+  k = 0;
+  RunCase("Grid2d::SuccBegin", ins.name, [&]() {
+    long v = cells[k++ % n_cells];
+    for (const raplab::vid_t* u = g.SuccBegin(v); u != g.SuccEnd(v); u++) {g_sink += *u;}
+  });
+  k = 0;
+  RunCase("Grid2d::GetSuccCosts", ins.name, [&]() {
+    g_sink += g.GetSuccCosts(cells[k++ % n_cells]).size();
+  });
+
+  // point to point queries between agent starts and goals, the search object is reused across queries.
+  raplab::Dijkstra dijkstra;
+  dijkstra.SetGraphPtr(&g);
+  k = 0;
+  RunCase("Dijkstra::PathFinding", ins.name, [&]() {
+    size_t i = k++ % n_agents;
+    g_sink += dijkstra.PathFinding(ins.starts[i], ins.goals[i]).size();
+  });
+  raplab::AstarGrid2d astar;
+  astar.SetGraphPtr(&g);
+  k = 0;
+  RunCase("AstarGrid2d::PathFinding", ins.name, [&]() {
+    size_t i = k++ % n_agents;
+    g_sink += astar.PathFinding(ins.starts[i], ins.goals[i]).size();
+  });
+  raplab::JpsGrid2d jps;
+  jps.SetGraphPtr(&g);
+  k = 0;
+  RunCase("JpsGrid2d::PathFinding", ins.name, [&]() {
+    size_t i = k++ % n_agents;
+    g_sink += jps.PathFinding(ins.starts[i], ins.goals[i]).size();
+  });
+  raplab::JpsPlusGrid2d jps_plus;
+  jps_plus.SetGraphPtr(&g);
+  jps_plus.Preprocess();
+  k = 0;
+  RunCase("JpsPlusGrid2d::PathFinding", ins.name, [&]() {
+    size_t i = k++ % n_agents;
+    g_sink += jps_plus.PathFinding(ins.starts[i], ins.goals[i]).size();
+  });
+
+  // planner state comes from a complete solve on the same instance.
+  LsrpProbe planner;
+  planner.SetGraphPtr(&g);
+  planner.Setduration(ins.durations);
+  planner.Solve(ins.starts, ins.goals, 30, 1.0);
+  std::vector<raplab::Agent*>& agents = planner.Agents();
+  const std::vector<raplab::State*>& Sfrom = planner.History().back();
+  std::vector<raplab::State*> Sto_empty(n_agents, nullptr);
+  std::vector<long> constrain_list;
+
+  // heuristics
+  k = 0;
+  RunCase("generate_single_dis_table", ins.name, [&]() {
+    g_sink += planner.generate_single_dis_table(int(k++ % n_agents)).size();
+  });
+
+  // conflict checks, worst case: the probed vertex is free so every agent is visited.
+  long v_free = cells[0];
+  for (size_t i = 0; i < n_cells; i++) {
+    bool used = false;
+    for (auto s : Sfrom) {
+      if (s->get_v() == cells[i] || s->get_p() == cells[i]) {used = true; break;}
+    }
+    if (!used) {v_free = cells[i]; break;}
+  }
+  k = 0;
+  RunCase("check_Occupied", ins.name, [&]() {
+    g_sink += planner.check_Occupied(*agents[k++ % n_agents], v_free, Sfrom, constrain_list, true);
+  });
+  k = 0;
+  RunCase("push_required", ins.name, [&]() {
+    g_sink += (planner.push_required(agents, *agents[k++ % n_agents], v_free, Sfrom, Sto_empty) != nullptr);
+  });
+
+  // swap probes between each agent and a neighbouring cell.
+  std::vector<std::pair<long, long>> probes;
+  for (size_t i = 0; i < n_agents; i++) {
+    long v = Sfrom[i]->get_v();
+    auto nghs = g.GetSuccs(v);
+    if (!nghs.empty()) {probes.push_back(std::make_pair(v, nghs[0]));}
+  }
+  if (!probes.empty()) {
+    k = 0;
+    RunCase("swap_required", ins.name, [&]() {
+      size_t i = k++ % probes.size();
+      g_sink += planner.swap_required(*agents[i % n_agents], *agents[(i + 1) % n_agents], Sfrom, Sto_empty,
+                                      probes[i].first, probes[i].second);
+    });
+    k = 0;
+    RunCase("swap_possible", ins.name, [&]() {
+      size_t i = k++ % probes.size();
+      g_sink += planner.swap_possible(Sfrom, Sto_empty, probes[i].first, probes[i].second);
+    });
+  }
+
+  // policy bookkeeping
+  std::vector<raplab::State> states;
+  for (size_t i = 0; i < n_agents; i++) {
+    long v = Sfrom[i]->get_v();
+    states.push_back(raplab::State(v, v, 1.0, 2.0));
+  }
+  std::vector<std::tuple<raplab::Agent, raplab::State*>> agent_state_list;
+  for (size_t i = 0; i < n_agents; i++) {
+    agent_state_list.push_back(std::make_tuple(*agents[i], &states[i]));
+  }
+  std::unordered_map<double, std::vector<raplab::State*>> new_policy;
+  planner.insert_policy(agent_state_list, new_policy);
+  RunCase("merge_policy", ins.name, [&]() {
+    planner.merge_policy(new_policy, 0.0);
+  });
+  RunCase("extract_policy", ins.name, [&]() {
+    planner.ClearPaths();
+    planner.extract_policy();
+    g_sink += planner.get_all_paths()->size();
+  });
+
+  // dynamic wrapper against the grid specialization, on the smaller instances only.
+  if (n_cells <= 20000) {
+    RunSolveCase<raplab::LsrpT<raplab::Grid2d>>("LsrpT<Grid2d>::Solve", ins, g);
+    RunSolveCase<raplab::Lsrp>("Lsrp::Solve", ins, g);
+  }
+}
+
+/**
+ * @brief The same access patterns under each vertex order of Grid2d.
+ */
+void BenchVertexOrder(Instance& ins) {
+  const char* names[3] = {"row", "hilbert", "bfs"};
+  const raplab::GridOrder orders[3] = {raplab::GridOrder::ROW_MAJOR, raplab::GridOrder::HILBERT, raplab::GridOrder::BFS};
+  for (int o = 0; o < 3; o++) {
+    raplab::Grid2d g;
+    g.SetVertexOrder(orders[o]);
+    g.SetOccuGridPtr(&ins.grid);
+    std::vector<uint32_t> hops(g.NumVertex());
+    size_t k = 0;
+    RunCase(std::string("ComputeHopTable/") + names[o], ins.name, [&]() {
+      g_sink += raplab::ComputeHopTable(g.GetTableView(), g.ToInternal(ins.goals[k++ % ins.goals.size()]), hops.data());
+    });
+    // the agents walk towards the goal of the table, reading the heuristic of every successor like the planner.
+    long goal = g.ToInternal(ins.goals[(k - 1) % ins.goals.size()]);
+    std::vector<long> pos;
+    for (long v : ins.free_cells) {pos.push_back(g.ToInternal(v));}
+    std::mt19937 rng(1);
+    std::shuffle(pos.begin(), pos.end(), rng);
+    pos.resize(std::min(pos.size(), size_t(4096)));
+    std::vector<long> walkers(pos);
+    k = 0;
+    RunCase(std::string("heuristic walk/") + names[o], ins.name, [&]() {
+      size_t i = k++ % walkers.size();
+      long v = walkers[i];
+      long best = v;
+      uint32_t best_h = hops[v];
+      for (const raplab::vid_t* u = g.SuccBegin(v); u != g.SuccEnd(v); u++) {
+        if (hops[*u] < best_h) {best_h = hops[*u]; best = long(*u);}
+      }
+      walkers[i] = (best == goal) ? pos[i] : best;
+      g_sink += best_h;
+    });
+  }
+}
+
+/**
+ * @brief 64 hop tables, one call per goal against one batch.
+ */
+void BenchHopBatch(Instance& ins) {
+  raplab::Grid2d g;
+  g.SetOccuGridPtr(&ins.grid);
+  std::vector<long> goals;
+  for (size_t i = 0; i < 64; i++) {goals.push_back(ins.free_cells[(i * 7919) % ins.free_cells.size()]);}
+  std::vector< std::vector<uint32_t> > tables(64, std::vector<uint32_t>(g.NumVertex()));
+  std::vector<uint32_t*> outs;
+  for (auto& t : tables) {outs.push_back(t.data());}
+  std::vector<uint32_t> max_hops(64);
+  RunCase("ComputeHopTable x64", ins.name, [&]() {
+    for (size_t i = 0; i < 64; i++) {g_sink += raplab::ComputeHopTable(g.GetTableView(), goals[i], outs[i]);}
+  });
+  RunCase("ComputeHopTables/64", ins.name, [&]() {
+    raplab::ComputeHopTables(g.GetTableView(), goals.data(), goals.size(), outs.data(), max_hops.data());
+    g_sink += max_hops[0];
+  });
+}
+
+/**
+ * @brief The mapped parsers against the getline/istringstream reading they replaced, on a 10k agent scenario.
+ */
+void BenchParsers(Instance& ins, const std::string& map_path) {
+  long cols = ins.grid[0].size();
+  long rows = ins.grid.size();
+  std::string scen_path = "bench_parsers.scen";
+  {
+    std::ofstream f(scen_path);
+    f << "version 1\n";
+    for (size_t i = 0; i < 10000; i++) {
+      long s = ins.free_cells[(i * 7919) % ins.free_cells.size()];
+      long t = ins.free_cells[(i * 104729 + 1) % ins.free_cells.size()];
+      f << i / 10 << "\tbench.map\t" << cols << "\t" << rows << "\t" << s % cols << "\t" << s / cols << "\t"
+        << t % cols << "\t" << t / cols << "\t" << 100.0 << "\n";
+    }
+  }
+  std::string name = ins.name + "-s10k";
+  RunCase("getline scen 10k", name, [&]() {
+    std::ifstream in(scen_path);
+    std::string line;
+    std::getline(in, line);
+    std::vector<long> starts, goals;
+    while (std::getline(in, line)) {
+      std::istringstream iss(line);
+      int bucket, w, h, sx, sy, gx, gy;
+      std::string map;
+      double opt;
+      iss >> bucket >> map >> w >> h >> sx >> sy >> gx >> gy >> opt;
+      starts.push_back(long(sy) * w + sx);
+      goals.push_back(long(gy) * w + gx);
+    }
+    g_sink += goals.size();
+  });
+  RunCase("ParseScenarios_MovingAI 10k", name, [&]() {
+    std::vector<long> starts, goals;
+    std::tuple<int, int> wh;
+    raplab::ParseScenarios_MovingAI(scen_path, raplab::ScenarioSelection(), &starts, &goals, &wh);
+    g_sink += goals.size();
+  });
+  std::remove(scen_path.c_str());
+  std::string base = map_path.substr(map_path.find_last_of("/\\") + 1);
+  RunCase("LoadMap_MovingAI", base, [&]() {
+    std::vector<std::vector<double>> grid;
+    if (raplab::LoadMap_MovingAI(map_path, &grid) == 1) {g_sink += grid.size();}
+  });
+  RunCase("ParseMap_MovingAI", base, [&]() {
+    raplab::OccupancyBitmap bits;
+    if (raplab::ParseMap_MovingAI(map_path, &bits) == 1) {g_sink += bits.rows;}
+  });
+}
+
+/**
+ * @brief Output of 10k agent paths, the binary plan against one formatted text line per section.
+ */
+void BenchPlanOutput() {
+  std::vector< std::vector< std::tuple<long, long, double, double> > > paths(10000);
+  std::vector<double> durations(paths.size(), 0.3);
+  for (size_t i = 0; i < paths.size(); i++) {
+    long v = long(i) * 7;
+    double t = 0;
+    for (int j = 0; j < 100; j++) {
+      long u = v + ((j % 3 == 0) ? 0 : ((j & 1) ? 1 : 512));
+      paths[i].push_back(std::make_tuple(v, u, t, t + 0.3));
+      v = u;
+      t += 0.3;
+    }
+  }
+  std::string path = "bench_plan.out";
+  raplab::PlanFileHeader h;
+  h.rows = 512;
+  h.cols = 512;
+  RunCase("text sections 10k x 100", "synthetic", [&]() {
+    std::ofstream f(path);
+    for (size_t i = 0; i < paths.size(); i++) {
+      for (size_t j = 0; j < paths[i].size(); j++) {
+        const auto& s = paths[i][j];
+        f << "<section number=\"" << j << "\" start=\"" << std::get<0>(s) << "\" goal=\"" << std::get<1>(s)
+          << "\" duration=\"" << std::get<3>(s) - std::get<2>(s) << "\"/>" << std::endl;
+      }
+    }
+  });
+  RunCase("WritePlan 10k x 100", "synthetic", [&]() {
+    g_sink += raplab::WritePlan(path, h, durations, paths);
+  });
+  std::remove(path.c_str());
+}
+
+/**
+ * @brief DIMACS graph with 200k arcs and two cost files, line by line AddArc against the chunked loader.
+ */
+void BenchDimacs() {
+  std::vector<std::string> paths = {"bench_dimacs_0.gr", "bench_dimacs_1.gr"};
+  {
+    std::mt19937 rng(1);
+    long n = 50000;
+    size_t m = 200000;
+    std::ofstream f0(paths[0]);
+    std::ofstream f1(paths[1]);
+    f0 << "p sp " << n << " " << m << "\n";
+    f1 << "p sp " << n << " " << m << "\n";
+    for (size_t i = 0; i < m; i++) {
+      long u = long(rng() % n) + 1;
+      long v = long(rng() % n) + 1;
+      f0 << "a " << u << " " << v << " " << rng() % 10000 << "\n";
+      f1 << "a " << u << " " << v << " " << rng() % 100 << "\n";
+    }
+  }
+  // the loaders report on std::cout, silenced here.
+  std::streambuf* cout_buf = std::cout.rdbuf();
+  std::ofstream null_out;
+  std::cout.rdbuf(null_out.rdbuf());
+  RunCase("getline + AddArc 200k x 2", "synthetic", [&]() {
+    std::ifstream f0(paths[0]);
+    std::ifstream f1(paths[1]);
+    std::string l0, l1;
+    raplab::SparseGraph g;
+    while (std::getline(f0, l0) && std::getline(f1, l1)) {
+      if (l0[0] != 'a') {continue;}
+      std::istringstream s0(l0), s1(l1);
+      char a;
+      long u, v;
+      double c0, c1;
+      s0 >> a >> u >> v >> c0;
+      s1 >> a >> u >> v >> c1;
+      g.AddArc(u, v, std::vector<double>{c0, c1});
+    }
+    g_sink += g.NumArc();
+  });
+  RunCase("LoadSparseGraphDIMAC 200k x 2", "synthetic", [&]() {
+    raplab::SparseGraph g;
+    if (raplab::LoadSparseGraphDIMAC(paths, &g) == 1) {g_sink += g.NumArc();}
+  });
+  std::cout.rdbuf(cout_buf);
+  for (const auto& p : paths) {
+    std::remove(p.c_str());
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::string demo_map = "../demo/warehouse-10-20-10-2-1.map";
+  if (argc > 1) {demo_map = argv[1];}
+  if (argc > 2) {g_min_sec = std::stod(argv[2]) / 1000.0;}
+
+  std::mt19937 rng(0);
+  std::vector<Instance> instances;
+  instances.push_back(MakeSynthetic(32, 32, 0.1, 32, &rng));
+  instances.push_back(MakeSynthetic(128, 128, 0.1, 128, &rng));
+  instances.push_back(MakeSynthetic(512, 512, 0.1, 128, &rng));
+  Instance demo_small, demo_large;
+  if (MakeFromMap(demo_map, 10, &rng, &demo_small)) {
+    instances.push_back(demo_small);
+  } else {
+    std::cout << "[INFO] bench_primitives, skip demo map " << demo_map << std::endl;
+  }
+  if (MakeFromMap(demo_map, 100, &rng, &demo_large)) {
+    instances.push_back(demo_large);
+  }
+
+  std::printf("%-28s %-26s %14s %12s %10s\n", "primitive", "instance", "ns/op", "allocs/op", "iters");
+  for (auto& ins : instances) {
+    BenchInstance(ins);
+  }
+  Instance large = MakeSynthetic(2048, 2048, 0.1, 64, &rng);
+  BenchVertexOrder(instances[2]);
+  BenchVertexOrder(large);
+  BenchHopBatch(instances[2]);
+  if (instances.size() > 3) {BenchHopBatch(instances[3]);}
+  if (instances.size() > 3) {BenchParsers(instances[2], demo_map);}
+  BenchPlanOutput();
+  BenchDimacs();
+  return 0;
+}
@@ -0,0 +1,176 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_BINARY_MAP_H_
+#define RAPLAB_BASIC_BINARY_MAP_H_
+
+#include "graph.hpp"
+#include "mapped_file.hpp"
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief Fixed size file header of a precompiled map. All sections start at a multiple of 64 bytes
+ * from the beginning of the file, the section offsets below are in bytes.
+ *
+ * sections:
+ *   bits       uint64[(rows*cols+63)/64], obstacle bitmap, see Grid2d::IsObstacle.
+ *   offsets    int64[rows*cols+1], CSR offsets of the neighbor table.
+ *   targets    vid_t[n_arcs], id_bytes per id.
+ *   costs      double[n_arcs].
+ *   capacities int32[rows*cols], vertex max capacities.
+ *   order      vid_t[rows*cols] to_internal then vid_t[rows*cols] to_external, only if order is not ROW_MAJOR.
+ *   hop_index  HopTableEntry[n_hop_tables], sorted by goal.
+ *   hop_sums   uint64[n_hop_tables], DigestBytes of each hop table.
+ *   hops       uint32[n_hop_tables][rows*cols], see HopTable.
+ */
+struct BinaryMapHeader
+{
+  char magic[8] = {'L','S','R','P','B','M','A','P'};
+  uint32_t version = 3;
+  uint32_t endian = 0x01020304; // read back in another byte order if the file comes from another machine.
+  int32_t kngh = 4;
+  uint32_t id_bytes = sizeof(vid_t); // a map must be loaded by a build with the same RAPLAB_VID_BITS.
+  int32_t order = 0; // GridOrder
+  uint32_t reserved = 0;
+  int64_t rows = 0;
+  int64_t cols = 0;
+  int64_t n_arcs = 0;
+  double cost_scale = 1.0;
+  uint64_t content_hash = 0; // GridContentHash
+  uint64_t off_bits = 0;
+  uint64_t off_offsets = 0;
+  uint64_t off_targets = 0;
+  uint64_t off_costs = 0;
+  uint64_t off_capacities = 0;
+  uint64_t off_order = 0;
+  uint64_t off_hop_index = 0;
+  uint64_t off_hop_sums = 0;
+  uint64_t off_hops = 0;
+  uint64_t n_hop_tables = 0;
+  uint64_t file_size = 0;
+};
+
+/**
+ * @brief Unit distances (number of moves) from every vertex to a goal, kUnreachableHop if there is no path.
+ * Multiplied by the duration of an agent this is the heuristic of Lsrp, see LsrpT::set_hop_table_source.
+ */
+const uint32_t kUnreachableHop = 0xffffffffu;
+
+struct HopTable
+{
+  const uint32_t* hops = nullptr; // one entry per vertex, nullptr if there is no table.
+  uint32_t max_hop = 0; // largest reachable entry.
+};
+
+struct HopTableEntry
+{
+  int64_t goal = 0;
+  uint32_t max_hop = 0;
+  uint32_t reserved = 0;
+};
+
+/**
+ * @brief The entries of a table of n vertices are at most max_hop or kUnreachableHop, max_hop is below n
+ * and the goal entry is 0. Checks the tables read from a file before the planner indexes by them.
+ */
+bool IsValidHopTable(const uint32_t* hops, size_t n, long goal, uint32_t max_hop) ;
+
+/**
+ * @brief Hash of the grid dimensions, connectivity, vertex order and obstacle bitmap, i.e. everything
+ * hop tables depend on.
+ */
+uint64_t GridContentHash(const GridTableView& view) ;
+/**
+ * @brief Breadth first search from goal over the neighbor table, out must hold rows*cols entries.
+ * Return the largest reachable entry.
+ */
+uint32_t ComputeHopTable(const GridTableView& view, long goal, uint32_t* out) ;
+/**
+ * @brief Same tables as ComputeHopTable for n_goals goals, outs[i] and max_hops[i] receive the result of goals[i].
+ * The goals are shared by n_threads workers (0 means one per hardware thread), each with its own queue.
+ */
+void ComputeHopTables(const GridTableView& view, const long* goals, size_t n_goals,
+  uint32_t* const* outs, uint32_t* max_hops, int n_threads = 0) ;
+
+/**
+ * @brief Write grid g (which must have a neighbor table), the vertex capacities and the hop tables of
+ * the given goals. Vertices not in capacities have capacity 1. capacities and hop_goals are keyed by
+ * vertex id, see Grid2d::ToInternal. Return 1 if succeed, -1 otherwise.
+ */
+int WriteBinaryMap(const std::string& fname, const Grid2d& g,
+  const std::unordered_map<long, int>& capacities, const std::vector<long>& hop_goals) ;
+
+/**
+ * @brief A precompiled map opened with mmap, the sections are used in place without copying.
+ */
+class BinaryMap
+{
+public:
+  /**
+   * @brief
+   */
+  BinaryMap() ;
+  /**
+   * @brief
+   */
+  virtual ~BinaryMap() ;
+  /**
+   * @brief Map the file and check the header, the section bounds, the neighbor table (monotonic offsets,
+   * targets and vertex order inside the grid), the hop index (sorted goals inside the grid, max_hop below
+   * the vertex count) and the content hash. Return 1 if succeed, -1 otherwise.
+   */
+  virtual int Open(const std::string& fname) ;
+  /**
+   * @brief True if the file starts with the magic of a precompiled map.
+   */
+  static bool IsBinaryMap(const std::string& fname) ;
+
+  bool IsOpen() const {return _file.IsOpen();};
+  const BinaryMapHeader& Header() const {return _h;};
+  long NumVertex() const {return long(_h.rows * _h.cols);};
+  /**
+   * @brief The neighbor table, valid while the map is open. See Grid2d::AttachTableView.
+   */
+  GridTableView TableView() const ;
+  const int32_t* Capacities() const {return _section<int32_t>(_h.off_capacities);};
+  /**
+   * @brief The hop table of goal, an empty HopTable if it was not precomputed or is corrupted. A table is
+   * checked the first time it is returned: its checksum, and every entry is at most max_hop or
+   * kUnreachableHop. Thread safe.
+   */
+  HopTable GetHopTable(long goal) const ;
+  size_t NumHopTables() const {return size_t(_h.n_hop_tables);};
+
+protected:
+  template <typename T>
+  const T* _section(uint64_t off) const {return reinterpret_cast<const T*>(_file.Data() + off);};
+  /**
+   * @brief O(V+E) check of the indices of the neighbor table and of the vertex order.
+   */
+  bool _check_tables() const ;
+
+  MappedFile _file;
+  BinaryMapHeader _h;
+  std::string _fname;
+  // per hop table: 0 not checked yet, 1 valid, 2 corrupted.
+  mutable std::vector< std::atomic<uint8_t> > _hop_checked;
+};
+
+/**
+ * @brief Let g use the arrays of an open map (no copy) and set the vertex capacities that differ from 1.
+ * map must stay open while g is used. Return 1 if succeed, -1 otherwise.
+ */
+int AttachBinaryMap(const BinaryMap& map, Grid2d* g) ;
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_BINARY_MAP_H_
@@ -0,0 +1,153 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_DECISION_LOG_H_
+#define RAPLAB_BASIC_DECISION_LOG_H_
+
+#include "varint.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief Fixed size file header of a decision log.
+ */
+struct DecisionLogHeader
+{
+  char magic[8] = {'L','S','R','P','D','L','O','G'};
+  uint32_t version = 1;
+  uint32_t n_agents = 0;
+  uint32_t seed = 0;
+  uint32_t flags = 0; // bit 0: swap.
+  uint64_t input_digest = 0; // hash of starts, goals and durations.
+};
+
+/**
+ * @brief Record tags. Every record is: tag, then varint/double fields, see Lsrp for the field layout.
+ */
+enum DecisionLogTag : uint8_t {
+  DLOG_EVENT = 1,    // t, n, agent ids in priority order
+  DLOG_SHUFFLE = 2,  // agent, n, candidate vertices after std::shuffle
+  DLOG_PUSH = 3,     // agent, pushed agent, success
+  DLOG_SWAP = 4,     // agent, swap partner, applied
+  DLOG_DECISION = 5, // agent, chosen vertex, outcome, end time
+  DLOG_END = 6       // n_events, soc, makespan
+};
+
+/**
+ * @brief Compact binary log of the planner decisions.
+ *
+ * In RECORD mode, records are appended to an in-memory buffer; full buffers are handed to a
+ * background thread which writes them to the file, so the planner thread does not wait for IO. At most
+ * kMaxQueuedBuffers buffers wait for the writer, beyond that the planner thread blocks until one is
+ * written: the log is never truncated silently. A failed write is kept and reported by Close and Report.
+ * In VERIFY mode, the log is loaded and every new record is compared with the recorded one,
+ * the first mismatch is kept as the divergence point.
+ */
+class DecisionLog
+{
+public:
+  enum Mode {OFF = 0, RECORD = 1, VERIFY = 2};
+  /**
+   * @brief
+   */
+  DecisionLog() ;
+  /**
+   * @brief flushes and closes.
+   */
+  virtual ~DecisionLog() ;
+  /**
+   * @brief Return 1 if succeed, -1 otherwise.
+   */
+  virtual int OpenRecord(const std::string& fname, const DecisionLogHeader& header) ;
+  /**
+   * @brief Load the log and its header. Return 1 if succeed, -1 otherwise.
+   */
+  virtual int OpenVerify(const std::string& fname, DecisionLogHeader* header) ;
+  /**
+   * @brief RECORD: flush and wait for the writer thread. VERIFY: a log with unconsumed records is a divergence.
+   * Return -1 if a record could not be written to the file, 1 otherwise.
+   */
+  virtual int Close() ;
+
+  bool Active() const {return _mode != OFF;};
+  Mode GetMode() const {return _mode;};
+
+  /**
+   * @brief Build one record, Begin -> Put* -> End.
+   */
+  void Begin(DecisionLogTag tag) {
+    _rec.clear();
+    _rec.push_back(char(tag));
+  };
+  void PutU(uint64_t v) {PutVarint(&_rec, v);};
+  void PutS(int64_t v) {PutSignedVarint(&_rec, v);};
+  void PutF(double v) {PutDouble(&_rec, v);};
+  void End() ;
+
+  /**
+   * @brief VERIFY mode only.
+   */
+  bool Diverged() const {return _diverged;};
+  /**
+   * @brief index of the first record that does not match the log, or -1.
+   */
+  long DivergedRecord() const {return _diverged ? long(_n_records_at_divergence) : -1;};
+  size_t NumRecords() const {return _n_records;};
+  /**
+   * @brief RECORD mode only, some records could not be written to the file.
+   */
+  bool WriteFailed() const {return _write_failed;};
+  /**
+   * @brief Number of times the planner thread waited for the writer thread.
+   */
+  size_t NumWriterWaits() const {return _n_writer_waits;};
+  std::string Report() const ;
+
+  static const size_t kMaxQueuedBuffers = 16;
+
+protected:
+  void _handoff() ;
+  void _writer_loop() ;
+
+  Mode _mode = OFF;
+  std::string _rec; // record being built
+  size_t _n_records = 0;
+
+  // RECORD
+  std::string _buf;
+  std::vector<std::string> _queue;
+  std::mutex _mtx;
+  std::condition_variable _cv;
+  std::condition_variable _cv_space; // signaled when the writer takes the queued buffers
+  std::thread _writer;
+  bool _closing = false;
+  std::FILE* _file = nullptr;
+  std::atomic<bool> _write_failed{false};
+  size_t _n_writer_waits = 0;
+
+  // VERIFY
+  std::string _expected;
+  size_t _offset = 0;
+  bool _diverged = false;
+  size_t _n_records_at_divergence = 0;
+  std::string _reason;
+};
+
+/**
+ * @brief FNV-1a, used to tie a log to its input.
+ */
+uint64_t DigestBytes(const void* data, size_t n, uint64_t h = 1469598103934665603ull) ;
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_DECISION_LOG_H_
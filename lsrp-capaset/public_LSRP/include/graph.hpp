@@ -8,6 +8,9 @@
 #ifndef ZHONGQIANGREN_BASIC_GRAPH_H_
 #define ZHONGQIANGREN_BASIC_GRAPH_H_
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <iostream>
@@ -20,6 +23,25 @@ namespace raplab{
 
 // #define GraphCostType CostVector // always vector-cost, more general
 
+/**
+ * @brief Read-only view of the arcs leaving (or entering) a vertex, pointing into the storage of the graph.
+ * ids[i] is the i-th neighbor and Cost(i,d) its d-th cost. The costs are either stored per arc
+ * (arc_stride = cdim, dim_stride = 1) or per cost dimension (arc_stride = 1, dim_stride = length of a column).
+ * Iterating an ArcSpan yields the neighbor ids. A span is invalidated when the graph is modified.
+ */
+struct ArcSpan
+{
+  const vid_t* ids = nullptr;
+  const double* costs = nullptr;
+  size_t size = 0;
+  size_t cdim = 0;
+  size_t arc_stride = 0;
+  size_t dim_stride = 1;
+  const vid_t* begin() const {return ids;};
+  const vid_t* end() const {return ids + size;};
+  double Cost(size_t i, size_t d = 0) const {return costs[i * arc_stride + d * dim_stride];};
+};
+
 /**
  * @brief This class is an interface (for planners) to access all directed graphs G=(V,E,C), where
  * V is a vertex set with a long integer ID.
@@ -97,6 +119,72 @@ public:
    * @brief 
    */  
   virtual std::vector<long> AllVertex() = 0;
+  /**
+   * @brief approximated number of bytes held by the graph, including capacity bookkeeping.
+   */
+  virtual size_t MemoryBytes() {return 0;};
+  /**
+   * @brief Zero-copy successors of v and their costs. Prefer this to GetSuccs and GetSuccCosts in planners.
+   * The default implementation copies all arcs (GetSuccs/GetSuccCosts) into a flat index at the first
+   * query, under a lock, and rebuilds it at the first query after ArcVersion changed. Concurrent queries
+   * are safe, modifying the graph while it is queried is not.
+   */
+  virtual ArcSpan GetSuccArcs(long v) ;
+  /**
+   * @brief Zero-copy predecessors of v and their costs, see GetSuccArcs.
+   */
+  virtual ArcSpan GetPredArcs(long v) ;
+  /**
+   * @brief number of successors of v.
+   */
+  virtual size_t OutDegree(long v) {return GetSuccArcs(v).size;};
+  /**
+   * @brief Incremented whenever the vertices, arcs or costs of the graph change. Copies of the arcs
+   * (see GetSuccArcs) are rebuilt when it differs from the version they were built from.
+   */
+  uint64_t ArcVersion() const {return _arc_version;};
+
+protected:
+  /**
+   * @brief Derived graphs call this whenever their vertices, arcs or costs change.
+   */
+  void _arcs_changed() {_arc_version++;};
+
+  // flat copy of the arcs in CSR form, costs per arc.
+  struct _FlatArcs {
+    std::vector<long> offsets;
+    std::vector<vid_t> ids;
+    std::vector<double> costs;
+  };
+  // the arc index, built from the graph with stamp _arc_stamp(). A copied graph rebuilds its own.
+  struct _ArcIndex {
+    _FlatArcs succ;
+    _FlatArcs pred;
+    std::mutex mtx;
+    std::atomic<uint64_t> stamp;
+    _ArcIndex() : stamp(0) {};
+    _ArcIndex(const _ArcIndex&) : stamp(0) {};
+    _ArcIndex& operator=(const _ArcIndex&) {stamp = 0; return *this;};
+  };
+  /**
+   * @brief The arc index, (re)built under its lock if its stamp is not _arc_stamp().
+   */
+  const _ArcIndex& _get_arc_index() ;
+  /**
+   * @brief Identifies the arcs the index is built from, never 0. Grows with every change.
+   */
+  virtual uint64_t _arc_stamp() const {return _arc_version;};
+  /**
+   * @brief Fill the index, the default reads GetSuccs/GetSuccCosts and GetPreds/GetPredCosts of AllVertex.
+   */
+  virtual void _build_arc_index(_FlatArcs* succ, _FlatArcs* pred) ;
+  /**
+   * @brief span of the arcs of v in f, empty if v is not in f.
+   */
+  ArcSpan _flat_span(const _FlatArcs& f, long v) ;
+
+  uint64_t _arc_version = 1;
+  _ArcIndex _arc_index;
 };
 
 /**
@@ -172,6 +260,22 @@ public:
    * @brief 
    */  
   virtual std::vector<long> AllVertex() override ;
+  /**
+   * @brief
+   */
+  virtual size_t MemoryBytes() override ;
+  /**
+   * @brief 
+   */
+  virtual ArcSpan GetSuccArcs(long v) override ;
+  /**
+   * @brief 
+   */
+  virtual ArcSpan GetPredArcs(long v) override ;
+  /**
+   * @brief 
+   */
+  virtual size_t OutDegree(long v) override ;
 
   //--------------------------------------
   //--------------------------------------
@@ -213,11 +317,86 @@ public:
    *
    */
   virtual std::string ToStr() const ;
+  /**
+   * @brief Compact the graph into CSR form: per-vertex offsets, targets sorted within each vertex and one
+   * contiguous array per cost dimension. Queries then need no per-vertex allocation, HasArc and GetCost
+   * use binary search. SetArcCost works in place; any other modification converts the graph back first.
+   */
+  virtual void Freeze() ;
+  /**
+   * @brief Build a frozen graph directly from arcs, without the intermediate per-vertex vectors.
+   * costs holds cdim values per arc, arc after arc. Duplicated arcs are kept, unless merge_duplicates is
+   * true: then only the last of them is kept, as with AddArc. The vertices are 0 ... the largest id of
+   * an arc, so an empty arc list gives an empty graph. Ids must not be negative.
+   */
+  virtual void CreateFrozenFromArcs(const std::vector<long>& sources, const std::vector<long>& targets,
+    const std::vector<double>& costs, size_t cdim, bool merge_duplicates = false) ;
+  /**
+   * @brief Same as CreateFrozenFromArcs with the ids given as vid_t, the width of the CSR arrays, so that a
+   * loader of a large graph does not hold them in 8 bytes each.
+   */
+  virtual void CreateFrozenFromIds(const std::vector<vid_t>& sources, const std::vector<vid_t>& targets,
+    const std::vector<double>& costs, size_t cdim, bool merge_duplicates = false) ;
+  /**
+   *
+   */
+  bool IsFrozen() const {return _frozen;};
+  /**
+   * @brief Frozen graph only. Index of arc (u,v), i.e. its position in the successor array, or -1.
+   */
+  long FindArc(long u, long v) const ;
+  /**
+   * @brief Frozen graph only. The d-th cost of the arc with index a (see FindArc), O(1).
+   */
+  double ArcCost(long a, size_t d = 0) const {return _csr_to.costs[d * _csr_to.ids.size() + a];};
+
 protected:
-  std::vector< std::vector<long> > _to;
-  std::vector< std::vector< std::vector<double> > > _to_cost;
-  std::vector< std::vector<long> > _from;
-  std::vector< std::vector< std::vector<double> > > _from_cost;
+  /**
+   * @brief set _cdim from a batch of arc costs, which must all have the same length.
+   */
+  void _set_cdim_from(const std::vector< std::vector<double> >& costs) ;
+
+  // CSR form of one direction, see Freeze.
+  struct _Csr {
+    std::vector<long> offsets; // the arcs of v are [offsets[v], offsets[v+1]).
+    std::vector<vid_t> ids; // sorted within each vertex.
+    std::vector<double> costs; // cost d of arc a is costs[d * ids.size() + a].
+  };
+  /**
+   * @brief see CreateFrozenFromArcs.
+   */
+  template <typename Id>
+  void _create_frozen(const std::vector<Id>& sources, const std::vector<Id>& targets,
+    const std::vector<double>& costs, size_t cdim, bool merge_duplicates) ;
+  /**
+   * @brief counting sort of m arcs (src[a], tgt[a]) with cdim costs per arc into out.
+   * If merge_duplicates, only the last arc of every (src, tgt) pair is kept. order is scratch space of
+   * m entries, shared by the calls for the two directions.
+   */
+  template <typename Id>
+  static void _build_csr(size_t n_vertex, size_t m, const Id* src, const Id* tgt,
+    const double* costs, size_t cdim, _Csr* out, bool merge_duplicates, std::vector<long>* order) ;
+  /**
+   * @brief span of the arcs of v in c.
+   */
+  ArcSpan _csr_span(const _Csr& c, long v) const ;
+  /**
+   * @brief arc index of (u,v) in c or -1.
+   */
+  long _csr_find(const _Csr& c, long u, long v) const ;
+  /**
+   * @brief convert a frozen graph back to per-vertex vectors.
+   */
+  void _thaw() ;
+
+  _Csr _csr_to;
+  _Csr _csr_from;
+  bool _frozen = false;
+
+  std::vector< std::vector<vid_t> > _to;
+  std::vector< std::vector<double> > _to_cost; // the costs of the arcs in _to[v], _cdim values per arc.
+  std::vector< std::vector<vid_t> > _from;
+  std::vector< std::vector<double> > _from_cost;
   size_t _n_arc = 0;
   size_t _cdim = 0;
 
@@ -245,7 +424,51 @@ std::ostream& operator<<(std::ostream& os, const SparseGraph& c) ;
 
 
 /**
- * @brief By default this is a 4-connected grid which is defined by calling SetOccuGridPtr or SetOccuGridObject.
+ * @brief How Grid2d numbers its cells, see Grid2d::SetVertexOrder.
+ * HILBERT follows a Hilbert curve, BFS numbers each connected free area breadth first from its
+ * first cell in row-major order and puts the obstacles last.
+ */
+enum class GridOrder : int {ROW_MAJOR = 0, HILBERT = 1, BFS = 2};
+
+/**
+ * @brief The raw arrays of a Grid2d neighbor table, see Grid2d::GetTableView and Grid2d::AttachTableView.
+ * All arrays are indexed by vertex id, i.e. in the order of the grid.
+ */
+struct GridTableView
+{
+  long rows = 0;
+  long cols = 0;
+  int kngh = 4;
+  GridOrder order = GridOrder::ROW_MAJOR;
+  const uint64_t* obst_bits = nullptr; // (rows*cols+63)/64 words, bit k is 1 if vertex k is an obstacle.
+  const long* offsets = nullptr; // rows*cols+1 entries.
+  const vid_t* targets = nullptr; // offsets[rows*cols] entries.
+  const double* costs = nullptr; // same layout as targets.
+  const vid_t* to_internal = nullptr; // row-major cell -> vertex id, nullptr for ROW_MAJOR.
+  const vid_t* to_external = nullptr; // vertex id -> row-major cell, nullptr for ROW_MAJOR.
+};
+
+/**
+ * @brief Row-major obstacle bitmap of a grid, see ParseMap_MovingAI and Grid2d::SetOccuBitmapPtr.
+ */
+struct OccupancyBitmap
+{
+  long rows = 0;
+  long cols = 0;
+  std::vector<uint64_t> bits; // (rows*cols+63)/64 words, bit r*cols+c is 1 if cell (r,c) is an obstacle.
+
+  void Resize(long r, long c) {
+    rows = r;
+    cols = c;
+    bits.assign(size_t(r * c + 63) / 64, 0);
+  };
+  bool IsBlocked(long k) const {return (bits[k >> 6] >> (k & 63)) & 1;};
+  void SetBlocked(long k) {bits[k >> 6] |= (uint64_t(1) << (k & 63));};
+};
+
+/**
+ * @brief By default this is a 4-connected grid which is defined by calling SetOccuGridPtr, SetOccuGridObject,
+ * SetOccuBitmapPtr or SetOccuCellsPtr.
  */
 class Grid2d : public PlannerGraph
 {
@@ -318,6 +541,22 @@ public:
    * @brief 
    */  
   virtual std::vector<long> AllVertex() override ;
+  /**
+   * @brief
+   */
+  virtual size_t MemoryBytes() override ;
+  /**
+   * @brief Served from the neighbor table.
+   */
+  virtual ArcSpan GetSuccArcs(long v) override ;
+  /**
+   * @brief Same as GetSuccArcs, the grid is undirected.
+   */
+  virtual ArcSpan GetPredArcs(long v) override ;
+  /**
+   * @brief 
+   */
+  virtual size_t OutDegree(long v) override ;
 
   //#### Non-Inherited Methods Below ####
 
@@ -334,6 +573,17 @@ public:
    * @brief For pybind11.
    */
   virtual void SetOccuGridObject(std::vector< std::vector<double> >&) ;
+  /**
+   * @brief Same as SetOccuGridPtr for a bitmap, which takes 1 bit per cell instead of a double.
+   * The bitmap must outlive the grid, or the next call to SetOccuBitmapPtr or SetOccuGridPtr.
+   */
+  virtual void SetOccuBitmapPtr(const OccupancyBitmap*) ;
+  /**
+   * @brief Same as SetOccuGridPtr for a row-major byte array (e.g. a NumPy uint8 array), a cell is an obstacle
+   * if its byte is not 0. Cell (r,c) is cells[r*row_stride+c], row_stride 0 means cols. The array is not copied,
+   * it must outlive the grid, or the next call to one of the SetOccu methods.
+   */
+  virtual void SetOccuCellsPtr(const uint8_t* cells, long rows, long cols, long row_stride = 0) ;
   /**
    * @brief Return if a given vertex (row, col) is inside the rectangular grid.
    */
@@ -346,6 +596,51 @@ public:
    * @brief
    */
   virtual void SetCostScaleFactor(const double) ;
+  double GetCostScaleFactor() const {return _cost_scale;};
+  /**
+   * @brief Allocation-free successor access, valid until the grid or the neighborhood changes.
+   * Successors of v are [SuccBegin(v), SuccEnd(v)), with costs starting at SuccCostBegin(v).
+   * v must be inside the grid.
+   */
+  const vid_t* SuccBegin(long v) const {return _tbl.targets + _tbl.offsets[v];};
+  const vid_t* SuccEnd(long v) const {return _tbl.targets + _tbl.offsets[v+1];};
+  const double* SuccCostBegin(long v) const {return _tbl.costs + _tbl.offsets[v];};
+  size_t NumSuccs(long v) const {return size_t(_tbl.offsets[v+1] - _tbl.offsets[v]);};
+  /**
+   * @brief Read the obstacle bitmap, v must be inside the grid.
+   */
+  bool IsObstacle(long v) const {return (_tbl.obst_bits[v >> 6] >> (v & 63)) & 1;};
+  /**
+   * @brief The arrays currently used by the grid.
+   */
+  const GridTableView& GetTableView() const {return _tbl;};
+  /**
+   * @brief Use externally owned arrays (e.g. a memory-mapped file) as the grid, without copying them.
+   * The arrays must outlive the grid. The occupancy grid pointer is cleared, so SetKNeighbor and
+   * SetCostScaleFactor do not rebuild the table until SetOccuGridPtr is called again.
+   */
+  virtual void AttachTableView(const GridTableView& view) ;
+  /**
+   * @brief Rebuild the obstacle bitmap and the neighbor table.
+   * Must be called if the cells of the occupancy grid are modified after SetOccuGridPtr.
+   */
+  virtual void RebuildNeighborTable() ;
+  /**
+   * @brief Number the vertices in the given order, so that cells which are close on the map are close
+   * in memory (neighbor table, capacities and the per-vertex arrays of the planners). Vertex ids are
+   * then no longer row*cols+col: translate ids read from or written to files with ToInternal/ToExternal.
+   * Rebuilds the table if an occupancy grid is set. Default ROW_MAJOR.
+   */
+  virtual void SetVertexOrder(GridOrder order) ;
+  GridOrder GetVertexOrder() const {return _tbl.order;};
+  /**
+   * @brief row-major cell index (row*cols+col) -> vertex id.
+   */
+  long ToInternal(long k) const {return _tbl.to_internal ? long(_tbl.to_internal[k]) : k;};
+  /**
+   * @brief vertex id -> row-major cell index.
+   */
+  long ToExternal(long v) const {return _tbl.to_external ? long(_tbl.to_external[v]) : v;};
   /**
    * @brief 
    */
@@ -360,14 +655,40 @@ public:
   virtual long _k2c(const long k) const ;
 
 protected:
+  /**
+   * @brief fill _to_int/_to_ext for _order, blocked is the row-major obstacle flag of every cell.
+   */
+  void _compute_order(const std::vector<bool>& blocked) ;
+  /**
+   * @brief One of the occupancy sources is set, the table is rebuilt from it.
+   */
+  bool _has_occupancy() const {return _occu_grid_ptr || _occu_bits_ptr || _occu_cells_ptr;};
+
   std::vector< std::vector< double > > _mat_from_py;
   std::vector< std::vector< double > >* _occu_grid_ptr;
     // row (y) first, column (x) next, the value in a cell indicates if that cell is an obstacle.
+  const OccupancyBitmap* _occu_bits_ptr = nullptr; // used instead of _occu_grid_ptr if set.
+  const uint8_t* _occu_cells_ptr = nullptr; // used instead of _occu_grid_ptr if set, see SetOccuCellsPtr.
+  long _cells_rows = 0;
+  long _cells_cols = 0;
+  long _cells_stride = 0;
   int _kngh;
   std::vector<long> _act_r;
   std::vector<long> _act_c;
   double _cost_scale = 1.0;
 
+  // flat copies of the occupancy grid, built by RebuildNeighborTable.
+  long _n_rows = 0;
+  long _n_cols = 0;
+  std::vector<uint64_t> _obst_bits; // one bit per vertex, 1 means obstacle.
+  std::vector<long> _nbr_offsets; // CSR, successors of v are _nbr_targets[_nbr_offsets[v], _nbr_offsets[v+1]).
+  std::vector<vid_t> _nbr_targets;
+  std::vector<double> _nbr_costs; // same layout as _nbr_targets.
+  std::vector<vid_t> _to_int; // see GridTableView
+  std::vector<vid_t> _to_ext;
+  GridOrder _order = GridOrder::ROW_MAJOR; // order of the next rebuild
+  GridTableView _tbl; // points either to the vectors above or to attached arrays.
+
   // New member to store vertex maximum capacities
   std::vector<long> _vertex_max_capacities;
 
@@ -450,6 +771,27 @@ public:
    * @brief 
    */  
   virtual std::vector<long> AllVertex() override ;
+  /**
+   * @brief includes the sub-graphs.
+   */
+  virtual size_t MemoryBytes() override ;
+  /**
+   * @brief Served from a flat copy of all arcs in global ids, built at the first call after the graph or
+   * one of its sub-graphs changed (see ArcVersion), under a lock so that concurrent queries are safe.
+   */
+  virtual ArcSpan GetSuccArcs(long v) override ;
+  /**
+   * @brief see GetSuccArcs.
+   */
+  virtual ArcSpan GetPredArcs(long v) override ;
+  /**
+   * @brief 
+   */
+  virtual size_t OutDegree(long v) override ;
+  /**
+   * @brief Build the flat copy of arcs used by GetSuccArcs and GetPredArcs now instead of at the next query.
+   */
+  virtual void RebuildArcIndex() ;
   /**
    *
    */
@@ -472,6 +814,14 @@ protected:
    *
    */
   virtual long _g2l_nid(long v);
+  /**
+   * @brief includes the versions of the sub-graphs.
+   */
+  virtual uint64_t _arc_stamp() const override ;
+  /**
+   * @brief arcs of the sub-graphs shifted to global ids, then the inter-graph arcs of each vertex.
+   */
+  virtual void _build_arc_index(_FlatArcs* succ, _FlatArcs* pred) override ;
 
   std::vector< Grid2d* > _grids;
   std::vector< SparseGraph* > _roadmaps;
@@ -481,6 +831,8 @@ protected:
   std::vector< long > _ig_arc_srcs; // ig = inter-graph
   std::vector< long > _ig_arc_tgts;
   std::vector< CostVec > _ig_costs;
+  std::unordered_map< long, std::vector<size_t> > _ig_by_src; // vertex -> indices of the inter-graph arcs leaving it
+  std::unordered_map< long, std::vector<size_t> > _ig_by_tgt; // vertex -> indices of the inter-graph arcs entering it
 
   // New member to store vertex maximum capacities
   std::vector<long> _vertex_max_capacities;
@@ -489,6 +841,13 @@ protected:
   std::vector<long> _vertex_occupied_capacities;
 };
 
+/**
+ * @brief Label the connected components of g, ignoring arc directions: label[v] is a representative vertex of
+ * the component of v, or -1 if v is not a vertex (e.g. an obstacle of a Grid2d). O(V+E) with an array union-find.
+ * Vertices with different labels are not connected. On a directed graph, the same label does not guarantee a path.
+ */
+void ComputeComponents(PlannerGraph* g, std::vector<long>* label) ;
+
 // /**
 //  *
 //  */
@@ -4,7 +4,9 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <limits>
 #include <string>
+#include <tuple>
 #include <vector>
 #include <iostream>
 
@@ -14,18 +16,69 @@ namespace raplab{
 
 
 
-int LoadSparseGraphDIMAC(std::vector<std::string> edge_cost_fnames, SparseGraph* out) ;
+/**
+ * @brief Read a DIMACS graph with one cost file per cost dimension. The files must list the same arcs
+ * ("a <u> <v> <cost>" lines) in the same order, the arcs are read from the first one. Each file is
+ * memory-mapped and parsed in chunks by n_threads workers (0 for one per hardware thread), directly into
+ * flat vid_t arrays that out is built from (see SparseGraph::CreateFrozenFromIds), so out is frozen.
+ * The last of parallel arcs is kept. An arc line with a vertex id that is negative or does not fit in vid_t
+ * is a bad line. Return 1 if succeed, -1 otherwise.
+ */
+int LoadSparseGraphDIMAC(const std::vector<std::string>& edge_cost_fnames, SparseGraph* out, int n_threads = 0) ;
 
 int LoadStartGoal(std::string benchmark_table_fname, std::vector<int>* sources, std::vector<int>* goals);
 
 int LoadCoordDIMAC(std::string coord_file, std::vector< std::vector<double> >* output) ;
 
+/**
+ * @brief Same as ParseMap_MovingAI, the grid is returned as output[row][col], 1 for an obstacle and 0 otherwise.
+ */
 int LoadMap_MovingAI(std::string map_file_path, std::vector<std::vector<double> >* output) ;
 
+/**
+ * @brief Read the first n entries of a MovingAI .scen file, see ParseScenarios_MovingAI.
+ * width_height receives the map size of the first entry.
+ */
 int LoadScenarios(std::string filePath, int n, std::vector<long>* starts,
                                                               std::vector<long>* goals,std::tuple<int,int>* width_height);
 
+/**
+ * @brief Read a MovingAI .map file (header "type", "height", "width", then "map" and the rows) into a bitmap,
+ * '.' and 'G' are free and any other cell is an obstacle. The file is memory-mapped and read in place,
+ * lines may end with LF or CRLF. The header must give the size, and there must be height rows of
+ * width cells. Return 1 if succeed, -1 otherwise.
+ */
+int ParseMap_MovingAI(const std::string& fname, OccupancyBitmap* out) ;
+
+/**
+ * @brief Which entries of a .scen file are read by ParseScenarios_MovingAI.
+ */
+struct ScenarioSelection
+{
+  int bucket_min = 0; // only the entries with a bucket in [bucket_min, bucket_max],
+  int bucket_max = std::numeric_limits<int>::max();
+  long skip = 0; // then skip that many of them,
+  long count = -1; // and take the next count, -1 for all.
+  long width = 0; // if > 0, every entry must refer to a map of width x height cells.
+  long height = 0;
+};
+
+/**
+ * @brief Read the selected entries of a MovingAI .scen file, start and goal cells are written as
+ * row-major ids y*width+x. The file is memory-mapped and the output is reserved once.
+ * Every entry must have the map size of the first one (or of sel.width/height) and cells inside the map.
+ * width_height receives the map size. Return 1 if succeed, -1 otherwise.
+ */
+int ParseScenarios_MovingAI(const std::string& fname, const ScenarioSelection& sel,
+                            std::vector<long>* starts, std::vector<long>* goals, std::tuple<int,int>* width_height) ;
+
 int LoadNodeCapacities(std::string capacity_file, std::unordered_map<long, int>* node_capacities);  
+
+/**
+ * @brief Read the durations of the agents, one "<name> <duration>" line per agent (e.g. "agent1: 0.5"),
+ * lines that do not end with a number are skipped. Return 1 if succeed, -1 otherwise.
+ */
+int ParseAgentDurations(const std::string& fname, std::vector<double>* durations) ;
 } // end namespace raplab
 
 
@@ -0,0 +1,184 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_HEURISTIC_STORE_H_
+#define RAPLAB_BASIC_HEURISTIC_STORE_H_
+
+#include "binary_map.hpp"
+#include "mapped_file.hpp"
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief Fixed size file header of a heuristic store, followed by a HopTableEntry index sorted by goal,
+ * one checksum (DigestBytes) per table and the hop tables, in the same layout as the hop sections of a
+ * binary map. meta_sum is the digest of the header (with meta_sum 0), the index and the checksums.
+ */
+struct HeuristicStoreHeader
+{
+  char magic[8] = {'L','S','R','P','H','S','T','O'};
+  uint32_t version = 2;
+  uint32_t endian = 0x01020304;
+  int64_t n_vertex = 0;
+  uint64_t content_hash = 0; // GridContentHash of the grid the tables belong to.
+  uint64_t n_tables = 0;
+  uint64_t off_index = 0;
+  uint64_t off_sums = 0;
+  uint64_t off_hops = 0;
+  uint64_t file_size = 0;
+  uint64_t meta_sum = 0;
+};
+
+/**
+ * @brief Persistent cache of hop tables (see HopTable) of a grid, one file per grid.
+ *
+ * Tables in the file are read through mmap, so only the pages of the goals that are used are loaded.
+ * The header and the index are checked when the file is mapped, a table against its checksum the first
+ * time it is used; a corrupted table is computed again. A missing goal is computed by BFS and kept in
+ * memory, up to the memory limit (see SetMemoryLimit). A file that belongs to another grid (content hash mismatch) or is corrupted is ignored and
+ * replaced by the next Flush.
+ *
+ * Flush holds an exclusive flock on "<file>.lock", merges the tables of the file as it is on disk then
+ * (other processes may have flushed since it was mapped) with the new ones, writes a uniquely named
+ * temporary file and renames it over the store. So concurrent processes neither lose each other's
+ * tables nor read a partially written store.
+ *
+ * Not thread safe. A caller that shares a store between threads under a lock can compute the missing
+ * tables outside of it: Missing or Find under the lock, ComputeHopTable(s) unlocked, then Insert under the
+ * lock. Tables returned by Get stay valid until the next Flush or Close, or as long as the pin
+ * given by Get is held: Flush and Close then release the file or the tables only once the last pin is gone.
+ */
+class HeuristicStore
+{
+public:
+  /**
+   * @brief Keeps the memory of a table returned by Get alive.
+   */
+  typedef std::shared_ptr<const void> HopTablePin;
+
+  /**
+   * @brief
+   */
+  HeuristicStore() ;
+  /**
+   * @brief flushes.
+   */
+  virtual ~HeuristicStore() ;
+  /**
+   * @brief Use fname as the store of grid view, the arrays of view must outlive the store.
+   * Return 1 if succeed (also when the file does not exist yet), -1 otherwise.
+   */
+  virtual int Open(const std::string& fname, const GridTableView& view) ;
+  /**
+   * @brief The hop table of goal, computed on a miss. If pin is given, it keeps the table valid.
+   */
+  virtual HopTable Get(long goal, HopTablePin* pin = nullptr) ;
+  /**
+   * @brief The hop table of goal if it is stored, a table with null hops otherwise. Never computes.
+   */
+  virtual HopTable Find(long goal, HopTablePin* pin = nullptr) ;
+  /**
+   * @brief The goals of the grid that are not stored yet, without duplicates.
+   */
+  virtual std::vector<long> Missing(const std::vector<long>& goals) ;
+  /**
+   * @brief Store the table of goal computed by the caller (rows*cols entries, see ComputeHopTable) and
+   * return it. If the goal is already stored, the stored table is returned and table is dropped.
+   * prefetched: the first Get or Find of the goal is not counted as a hit.
+   */
+  virtual HopTable Insert(long goal, std::vector<uint32_t>&& table, uint32_t max_hop, bool prefetched = false,
+                          HopTablePin* pin = nullptr) ;
+  /**
+   * @brief Compute the tables of the goals that are not in the store yet in one batch
+   * (see ComputeHopTables), so that the following Get calls are hits.
+   */
+  virtual void Prefetch(const std::vector<long>& goals) ;
+  /**
+   * @brief Write the computed tables to the file. Return 1 if succeed (or nothing to write), -1 otherwise.
+   */
+  virtual int Flush() ;
+  /**
+   * @brief Flush and release the file.
+   */
+  virtual void Close() ;
+
+  /**
+   * @brief Bound the memory of the tables kept since the last Flush to about bytes, 0 (default) for no bound.
+   * Over it, they are flushed to the file if there is one, otherwise the least recently used tables are
+   * dropped and computed again when needed. At least one table is kept. With a limit, a table returned by
+   * Get, Find or Insert stays valid only as long as its pin.
+   */
+  void SetMemoryLimit(size_t bytes) {_memory_limit = bytes;};
+
+  size_t NumHits() const {return _n_hits;};
+  size_t NumMisses() const {return _n_misses;};
+
+protected:
+  /**
+   * @brief Map the file if it is a valid store of the current grid.
+   */
+  bool _map_file() ;
+  /**
+   * @brief Map fname into file and check its header and index against the current grid.
+   */
+  bool _open_store_file(const std::string& fname, MappedFile* file, HeuristicStoreHeader* h) const ;
+  /**
+   * @brief Write the tables of the mapped file and the new ones, ordered by goal, to fname. Called by Flush
+   * with the lock held. Return 1 if succeed, -1 otherwise.
+   */
+  int _write_merged(const std::string& fname) ;
+  /**
+   * @brief Index of goal in the mapped file, -1 if it is not there or its table is corrupted.
+   */
+  long _find_mapped(long goal) ;
+  const HopTableEntry* _index() const {
+    return reinterpret_cast<const HopTableEntry*>(_file->Data() + _h.off_index);};
+  const uint64_t* _sums() const {
+    return reinterpret_cast<const uint64_t*>(_file->Data() + _h.off_sums);};
+  const uint32_t* _hops(size_t i) const {
+    return reinterpret_cast<const uint32_t*>(_file->Data() + _h.off_hops) + i * size_t(_h.n_vertex);};
+  /**
+   * @brief Release the mapped file, it is unmapped once no pin refers to it.
+   */
+  void _release_file() ;
+  /**
+   * @brief The stored table of goal, without hit accounting, refreshes its LRU position.
+   */
+  HopTable _lookup(long goal, HopTablePin* pin) ;
+  /**
+   * @brief Forget the tables computed since the last Flush.
+   */
+  void _clear_new() ;
+  /**
+   * @brief Enforce the memory limit.
+   */
+  void _trim() ;
+
+  std::string _fname;
+  GridTableView _view;
+  uint64_t _hash = 0;
+  std::shared_ptr<MappedFile> _file; // never null, shared with the pins of its tables.
+  HeuristicStoreHeader _h; // header of the mapped file, n_tables is 0 if nothing is mapped.
+  std::vector<uint8_t> _checked; // per table of the mapped file: 0 not checked yet, 1 valid, 2 corrupted.
+  std::unordered_map<long, HopTableEntry> _new_entries;
+  std::unordered_map<long, std::shared_ptr< std::vector<uint32_t> > > _new_tables; // computed since the last Flush
+  std::unordered_set<long> _prefetched; // computed by Prefetch and not requested yet
+  std::list<long> _lru; // goals of _new_tables, most recently used first.
+  std::unordered_map<long, std::list<long>::iterator> _lru_pos;
+  size_t _memory_limit = 0;
+  size_t _n_hits = 0;
+  size_t _n_misses = 0;
+};
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_HEURISTIC_STORE_H_
@@ -0,0 +1,104 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_INDEXED_HEAP_H_
+#define RAPLAB_BASIC_INDEXED_HEAP_H_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief Binary min-heap of (key, vertex) with decrease-key, every vertex is in the heap at most once.
+ * Entries are ordered by key, then by vertex id, i.e. in the same order as std::set< std::pair<double,long> >.
+ * The position array is kept between uses, so clearing costs O(size) and not O(number of vertices).
+ */
+class IndexedMinHeap
+{
+public:
+  typedef std::pair<double, long> Entry;
+  /**
+   * @brief Make room for vertices [0, n).
+   */
+  void Reserve(size_t n) {
+    if (_pos.size() < n) {_pos.resize(n, -1);}
+  };
+  bool Empty() const {return _heap.empty();};
+  size_t Size() const {return _heap.size();};
+  bool Contains(long v) const {return _pos[v] >= 0;};
+  const Entry& Top() const {return _heap[0];};
+  /**
+   * @brief Insert v, or lower its key if v is already in the heap with a larger key.
+   */
+  void Push(long v, double key) {
+    long i = _pos[v];
+    if (i < 0) {
+      i = long(_heap.size());
+      _heap.push_back(Entry(key, v));
+      _pos[v] = i;
+    } else if (Entry(key, v) < _heap[i]) {
+      _heap[i].first = key;
+    } else {
+      return;
+    }
+    _sift_up(size_t(i));
+  };
+  Entry Pop() {
+    Entry top = _heap[0];
+    _pos[top.second] = -1;
+    if (_heap.size() > 1) {
+      _heap[0] = _heap.back();
+      _pos[_heap[0].second] = 0;
+      _heap.pop_back();
+      _sift_down(0);
+    } else {
+      _heap.pop_back();
+    }
+    return top;
+  };
+  void Clear() {
+    for (const Entry& e : _heap) {_pos[e.second] = -1;}
+    _heap.clear();
+  };
+
+protected:
+  void _sift_up(size_t i) {
+    Entry e = _heap[i];
+    while (i > 0) {
+      size_t p = (i - 1) / 2;
+      if (!(e < _heap[p])) {break;}
+      _heap[i] = _heap[p];
+      _pos[_heap[i].second] = long(i);
+      i = p;
+    }
+    _heap[i] = e;
+    _pos[e.second] = long(i);
+  };
+  void _sift_down(size_t i) {
+    Entry e = _heap[i];
+    size_t n = _heap.size();
+    while (true) {
+      size_t c = 2 * i + 1;
+      if (c >= n) {break;}
+      if (c + 1 < n && _heap[c + 1] < _heap[c]) {c++;}
+      if (!(_heap[c] < e)) {break;}
+      _heap[i] = _heap[c];
+      _pos[_heap[i].second] = long(i);
+      i = c;
+    }
+    _heap[i] = e;
+    _pos[e.second] = long(i);
+  };
+
+  std::vector<Entry> _heap;
+  std::vector<long> _pos; // index of each vertex in _heap, -1 if absent.
+};
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_INDEXED_HEAP_H_
@@ -0,0 +1,118 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_INSTANCE_FILE_H_
+#define RAPLAB_BASIC_INSTANCE_FILE_H_
+
+#include "graph.hpp"
+#include "graph_io.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief A whole planning instance as flat arrays: the map, the agents and the vertex capacities.
+ * Vertices are row-major cell ids (row*cols+col). Agent i goes from starts[i] to goals[i] and takes
+ * durations[i] per move. Vertex cap_vertices[j] has capacity cap_values[j], the others capacity 1.
+ *
+ * The map is either embedded (map.rows > 0), or referenced by map_path, a MovingAI .map file or a
+ * precompiled map. rows and cols are the size of the map, 0 if it is referenced and was not known
+ * when the instance was written.
+ */
+struct Instance
+{
+  long rows = 0;
+  long cols = 0;
+  std::string map_path;
+  OccupancyBitmap map;
+  std::vector<long> starts;
+  std::vector<long> goals;
+  std::vector<double> durations;
+  std::vector<long> cap_vertices;
+  std::vector<int32_t> cap_values;
+
+  size_t NumAgents() const {return starts.size();};
+  bool HasEmbeddedMap() const {return map.rows > 0;};
+};
+
+/**
+ * @brief Fixed size file header of a binary instance. All sections start at a multiple of 8 bytes
+ * from the beginning of the file, the section offsets below are in bytes.
+ *
+ * sections:
+ *   starts      int64[n_agents].
+ *   goals       int64[n_agents].
+ *   durations   double[n_agents].
+ *   cap_vertices int64[n_capacities].
+ *   cap_values  int32[n_capacities].
+ *   map_bits    uint64[(rows*cols+63)/64], the embedded map, see OccupancyBitmap. Only if flags has kInstanceEmbeddedMap.
+ *   map_path    char[map_path_len], no terminator. Only without kInstanceEmbeddedMap.
+ */
+struct InstanceFileHeader
+{
+  char magic[8] = {'L','S','R','P','I','N','S','T'};
+  uint32_t version = 1;
+  uint32_t endian = 0x01020304;
+  uint32_t flags = 0;
+  uint32_t reserved = 0;
+  int64_t rows = 0;
+  int64_t cols = 0;
+  uint64_t n_agents = 0;
+  uint64_t n_capacities = 0;
+  uint64_t map_path_len = 0;
+  uint64_t off_starts = 0;
+  uint64_t off_goals = 0;
+  uint64_t off_durations = 0;
+  uint64_t off_cap_vertices = 0;
+  uint64_t off_cap_values = 0;
+  uint64_t off_map = 0; // map_bits or map_path.
+  uint64_t file_size = 0;
+};
+
+const uint32_t kInstanceEmbeddedMap = 1;
+
+/**
+ * @brief True if the file starts with the magic of a binary instance or the first line of a text instance.
+ */
+bool IsInstanceFile(const std::string& fname) ;
+
+/**
+ * @brief Read an instance in either form, detected from the first bytes. The file is memory-mapped and
+ * parsed in one pass, each array is allocated once. A relative map_path is resolved against the
+ * directory of the instance file. Vertices, durations and capacities are checked.
+ * Return 1 if succeed, -1 otherwise.
+ *
+ * The text form is line based, '#' starts a comment line:
+ *   lsrp-instance 1
+ *   map <map_path>                 (or: grid <height> <width>, then height rows of '.' free and '@' obstacle cells)
+ *   size <height> <width>          (optional with map, the size of the referenced map)
+ *   agents <n>
+ *   <start> <goal> <duration>      (n lines)
+ *   capacities <m>                 (optional)
+ *   <vertex> <capacity>            (m lines)
+ */
+int LoadInstance(const std::string& fname, Instance* out) ;
+
+/**
+ * @brief Write inst in the binary form, or in the text form if text is true. map_path is written as is.
+ * Return 1 if succeed, -1 otherwise.
+ */
+int WriteInstance(const std::string& fname, const Instance& inst, bool text = false) ;
+
+/**
+ * @brief Build an instance from the separate files of a run: a map (referenced, or embedded if embed_map
+ * and it is a MovingAI .map file), the selected entries of a .scen file (sel.count defaults to the number
+ * of durations), the "agentN: value" duration file and an optional capacity file (empty path for none).
+ * Return 1 if succeed, -1 otherwise.
+ */
+int AssembleInstance(const std::string& map_path, const std::string& scen_path, const std::string& duration_path,
+                     const std::string& capacity_path, const ScenarioSelection& sel, bool embed_map, Instance* out) ;
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_INSTANCE_FILE_H_
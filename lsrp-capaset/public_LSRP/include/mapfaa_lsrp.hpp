@@ -7,6 +7,9 @@
 #define CPPRAPLAB_MAPFAA_LSRP_HPP
 
 #include "mapfaa_util.hpp"
+#include "decision_log.hpp"
+#include "binary_map.hpp"
+#include <functional>
 #include <vector>
 #include <tuple>
 #include <queue>
@@ -24,6 +27,10 @@
 #include <vector>
 #include <vector>
 
+// counters of Lsrp::GetStats, compile with -DLSRP_STATS=0 to strip them from the hot loop.
+#ifndef LSRP_STATS
+#define LSRP_STATS 1
+#endif
 
 namespace raplab {
     
@@ -106,107 +113,263 @@ namespace raplab {
 
     };
 
-    class Lsrp : public MAPFAAPlanner {
+    /**
+     * @brief Phase timers (seconds) and search counters of one Lsrp::Solve call.
+     */
+    struct LsrpStats {
+        double t_heuristic = 0;
+        double t_search = 0;
+        double t_extract = 0;
+        long n_events = 0;
+        long n_agents_planned = 0;
+        long max_agents_per_event = 0;
+        long n_push_calls = 0;
+        long max_push_depth = 0;
+        long n_push_success = 0;
+        long n_push_fail = 0;
+        long n_swap_triggered = 0;
+        long n_swap_applied = 0;
+        long n_occupied_reject = 0;
+        long n_states = 0;
+        long n_infeasible = 0;
+    };
+
+    /**
+     * @brief What Solve does with agents whose goal is not connected to their start (or whose start or goal
+     * is not a free vertex). REJECT returns 0 before any heuristic work. QUARANTINE keeps such agents at their
+     * start (their goal becomes their start) and plans the other agents.
+     */
+    enum class InfeasiblePolicy { REJECT = 0, QUARANTINE = 1 };
+
+    /**
+     * @brief Where the distance tables of the agents come from: a hash map per agent filled by a search
+     * (the default), or the hop tables of a precompiled map or a heuristic store (set_hop_table_source).
+     */
+    enum class HeuristicSource { HASH_MAP = 0, HOP_TABLE = 1 };
+
+    /**
+     * @brief Bytes per planner subsystem, either measured (Lsrp::GetStats) or predicted (Lsrp::EstimateMemory).
+     */
+    struct LsrpMemory {
+        size_t heuristics = 0; // distance tables
+        size_t history = 0;    // _S_T, one joint state per event
+        size_t cache = 0;      // _cache, future commitments
+        size_t states = 0;     // all State objects, they live until the planner is destroyed
+        size_t graph = 0;
+        size_t total() const {return heuristics + history + cache + states + graph;}
+    };
+
+    /**
+     * @brief Graph access of the planner loop. The generic version goes through the virtual PlannerGraph
+     * interface, the Grid2d specialization reads the neighbor table directly so that it inlines. It does not
+     * check HasVertex: v must be a cell of the grid, which is asserted in debug builds.
+     */
+    template <typename G>
+    struct LsrpGraphOps {
+        static ArcSpan Succs(G* g, long v) {return g->GetSuccArcs(v);}
+        static size_t OutDegree(G* g, long v) {return g->OutDegree(v);}
+    };
+
+    template <>
+    struct LsrpGraphOps<Grid2d> {
+        static ArcSpan Succs(Grid2d* g, long v) {
+            assert(InGrid(g, v));
+            ArcSpan out;
+            out.ids = g->SuccBegin(v);
+            out.costs = g->SuccCostBegin(v);
+            out.size = g->NumSuccs(v);
+            out.cdim = 1;
+            out.arc_stride = 1;
+            return out;
+        }
+        static size_t OutDegree(Grid2d* g, long v) {
+            assert(InGrid(g, v));
+            return g->NumSuccs(v);
+        }
+        static bool InGrid(Grid2d* g, long v) {
+            const GridTableView& t = g->GetTableView();
+            return v >= 0 && v < t.rows * t.cols;
+        }
+    };
+
+    /**
+     * @brief LSRP planner over a graph type G, which must be PlannerGraph or derive from it.
+     * The methods of the search are not virtual and the graph is accessed through LsrpGraphOps<G>,
+     * so that LsrpT<Grid2d> runs without virtual dispatch in the push loop.
+     * Instantiated for PlannerGraph (see Lsrp) and Grid2d in mapfaa_lsrp.cpp.
+     */
+    template <typename G>
+    class LsrpT : public MAPFAAPlanner {
     public:
 
-        Lsrp();
+        LsrpT();
 
         /**
         *
         */
-        virtual ~Lsrp();
+        virtual ~LsrpT();
+
+        /**
+         * @brief g must be a G.
+         */
+        virtual void SetGraphPtr(PlannerGraph* g) override;
 
 
-        virtual bool reach_Goal() const;
+        bool reach_Goal() const;
 
-        virtual double get_tmin2() const;
+        double get_tmin2() const;
 
-        virtual std::vector<Agent *> extract_Agents(double t);
+        std::vector<Agent *> extract_Agents(double t);
 
-        virtual std::vector<State*> get_rawSnext(std::vector<State*> S_from,
+        std::vector<State*> get_rawSnext(std::vector<State*> S_from,
                                                              const std::vector<Agent *> &curr_agents, double t) const;
 
-        virtual void update_Priority();
+        void update_Priority();
 
-        virtual double get_duration(const Agent &agent, long v1 = 0, long v2 = 0) const;
+        double get_duration(const Agent &agent, long v1 = 0, long v2 = 0) const;
 
-        virtual bool
+        bool
         check_Occupied(const Agent &agent, const long &v, const std::vector<State*> &Sto,
                        const std::vector<long> &constrain_list, bool in_pibt) const;
 
-        virtual bool check_potential_deadlock(const long &v, const Agent &ag,
+        bool check_potential_deadlock(const long &v, const Agent &ag,
                                               const std::vector<State*> &Sfrom,
                                               const std::vector<State*> &Sto) const;
 
-        virtual double get_makespan();
+        double get_makespan();
 
-        virtual double get_Soc();
+        double get_Soc();
 
 
         void extract_policy();
 
         int _lsrp();
 
-        virtual double re_soc() ;
+        double re_soc() ;
 
-        virtual double re_makespan() ;
+        double re_makespan() ;
 
         virtual CostVec GetPlanCost(long nid=-1) override ;
 
-        virtual void Setduration(std::vector<double> duration) {_duration = duration;}
+        void Setduration(std::vector<double> duration) {_duration = duration;}
 
-        virtual void Set_minduration();
+        void Set_minduration();
 
         virtual TimePathSet GetPlan(long nid=-1) override ;
 
-        virtual double GetRuntime(long nid = -1) {return _runtime;}
+        double GetRuntime(long nid = -1) {return _runtime;}
 
         virtual int Solve(std::vector<long>& starts, std::vector<long>& goals, double time_limit, double eps) override ;
 
         virtual std::unordered_map<std::string, double> GetStats() override ;
 
-        virtual Agent*
+        Agent*
         push_required(const std::vector<Agent *> &curr_agents, const Agent &agent, const long &v,
                       const std::vector<State*> &Sfrom, const std::vector<State*> &Sto) const;
 
-        virtual double _asy_push(Agent &agent, std::vector<State*> &Sto,
+        double _asy_push(Agent &agent, std::vector<State*> &Sto,
                              const std::vector<State*> &Sfrom, const std::vector<Agent *> &curr_agents,
                              double tmin2, double curr_t,std::vector<long> &constrain_list, bool bp);
 
 
-        virtual Agent* swap_required_possible(const std::vector<Agent *> &curr_agents,const Agent &agent,
+        Agent* swap_required_possible(const std::vector<Agent *> &curr_agents,const Agent &agent,
                                               const std::vector<State*> &Sfrom,std::vector<State*> &Sto,
                                               std::vector<long> &C);
 
-        virtual bool swap_required(const Agent &pusher,const Agent &puller,const std::vector<State*> &Sfrom,
+        bool swap_required(const Agent &pusher,const Agent &puller,const std::vector<State*> &Sfrom,
                                    std::vector<State*> &Sto,long v_pusher_init,long v_puller_init);
 
-        virtual bool swap_possible(const std::vector<State*> &Sfrom,std::vector<State*> &Sto,
+        bool swap_possible(const std::vector<State*> &Sfrom,std::vector<State*> &Sto,
                                    long v_pusher_init,long v_puller_init);
 
-        virtual Agent* Check_occupied_forSwap(const std::vector<Agent*>& curr_agents,
+        Agent* Check_occupied_forSwap(const std::vector<Agent*>& curr_agents,
                                               const long& u,
                                               const std::vector<State*>& Sfrom,
                                               const std::vector<State*>& Sto, bool curr_A_required);
 
-        virtual double _asy_push_swap(Agent &agent, std::vector<State*> &Sto,
+        double _asy_push_swap(Agent &agent, std::vector<State*> &Sto,
                              const std::vector<State*> &Sfrom, const std::vector<Agent *> &curr_agents,
                              double tmin2, double curr_t,std::vector<long> &constrain_list, bool bp);
 
 
-        virtual bool highest_pri_agents(Agent &agent);
+        bool highest_pri_agents(Agent &agent);
 
 
         void set_swap(bool swap) {_swap = swap;}
 
-        void set_edge_cost(std::unordered_map<int,std::unordered_map<int,double>> edge_cost) {this->edge_cost = edge_cost;}
+        void set_infeasible_policy(InfeasiblePolicy policy) {_infeasible_policy = policy;}
+
+        /**
+         * @brief Ids of the agents found infeasible by the last Solve, see InfeasiblePolicy.
+         */
+        const std::vector<long>& get_infeasible_agents() const {return _infeasible;}
+
+        /**
+         * @brief Connected component labels of the graph (see ComputeComponents), e.g. computed once per map and
+         * shared by the planners on it, must outlive the planner. Capacities do not change them, only the arcs.
+         * Without labels of the size of the graph, Solve computes them and reuses them until ArcVersion changes.
+         */
+        void set_component_labels(const std::vector<long>* label) {_ext_labels = label;}
+
+        // Precomputed unit distances to a goal, e.g. BinaryMap::GetHopTable. Agents without edge_cost
+        // overrides whose goal has a table skip their BFS, get_h scales the hop count by the duration.
+        typedef std::function<HopTable(long goal)> HopTableSource;
+        void set_hop_table_source(HopTableSource src) {_hop_source = src;}
 
-        int edge_hash (long a, long b) const;
+        void set_seed(unsigned seed) {_seed = seed; _rng.seed(seed);}
+
+        /**
+         * @brief Record the decisions of the next Solve into a binary log (see decision_log.hpp).
+         */
+        void set_decision_log(const std::string& fname) {_dlog_path = fname; _dlog_replay = false;}
+
+        /**
+         * @brief Re-execute the next Solve with the seed and options stored in the log, and compare every
+         * decision with the logged one. The result is available from get_decision_log().Report().
+         */
+        void set_replay_log(const std::string& fname) {_dlog_path = fname; _dlog_replay = true;}
+
+        const DecisionLog& get_decision_log() const {return _dlog;}
+
+        /**
+         * @brief Bytes currently held by each subsystem of this planner.
+         */
+        LsrpMemory GetMemoryUsage();
+
+        /**
+         * @brief Predict the footprint of a solve before running it.
+         * n_events is the expected number of events of the event loop, e.g. the n_events of GetStats on
+         * similar instances, 0 for DefaultEventBound. Each event is assumed to replan all agents, so the
+         * prediction is an upper bound in practice. heuristic is the source of the distance tables, the hop
+         * tables themselves belong to their source and are not counted, as in GetMemoryUsage. kngh is the
+         * number of neighbors of a vertex, 4 or 8 for a Grid2d.
+         */
+        static LsrpMemory EstimateMemory(size_t n_agents, size_t n_vertices, size_t n_events = 0,
+                                         HeuristicSource heuristic = HeuristicSource::HASH_MAP, int kngh = 4);
+
+        /**
+         * @brief Events assumed by EstimateMemory when none is given: one event per move of every agent,
+         * along a path of twice the side of a square grid of n_vertices cells. On the demo warehouse map
+         * (10 agents, 511 events) it gives 2014.
+         */
+        static size_t DefaultEventBound(size_t n_agents, size_t n_vertices);
+
+        // per agent durations of edges, keyed by edge_hash.
+        void set_edge_cost(std::unordered_map<int,std::unordered_map<EdgeKey,double>> edge_cost) {this->edge_cost = edge_cost;}
+        // Same, keyed by the 32-bit Cantor pairing (a+b)*(a+b+1)/2+min(a,b) used before EdgeKey.
+        // That key overflows once a+b exceeds ~65000, so only small maps can use it.
+        void set_edge_cost(const std::unordered_map<int,std::unordered_map<int,double>>& edge_cost);
+
+        EdgeKey edge_hash (long a, long b) const {return MakeEdgeKey(a, b);}
 
         std::vector<std::vector<std::tuple<long, long, double, double>>>* get_all_paths() {return &_all_paths;}
 
 
-    private:
+    protected:
+
+        ArcSpan succs(long v) const {return LsrpGraphOps<G>::Succs(_g, v);}
+
+        size_t out_degree(long v) const {return LsrpGraphOps<G>::OutDegree(_g, v);}
 
         void insert_policy(const std::vector<std::tuple<Agent, State*>> &agent_state_list,
                            std::unordered_map<double, std::vector<State*>> &new_policy) const;
@@ -222,8 +385,27 @@ namespace raplab {
 
         double get_h(const Agent &agent, const long &coord);
 
+        /**
+         * @brief Fill _infeasible from the connected components of the graph, O(V+E) when they are computed.
+         */
+        void find_infeasible_agents();
+
         void set_agents();
 
+        State* new_state(const State& s);
+
+        void open_decision_log();
+
+        void log_event(double t, const std::vector<Agent*>& curr_agents);
+
+        void log_shuffle(const Agent& agent, const std::vector<long>& C);
+
+        void log_push(const Agent& agent, const Agent& pushed, bool success);
+
+        void log_swap(const Agent& agent, const Agent& partner, bool applied);
+
+        void log_decision(const Agent& agent, long v, int outcome, double endT);
+
         std::vector<std::vector<State*>> set_initPolicy();
 
         State generate_state(const long &v, const Agent &agent,
@@ -233,8 +415,17 @@ namespace raplab {
         std::vector<long> _Sinit;
         std::vector<long> _Send;
         std::vector<double> _duration;
-        std::unordered_map<int,std::unordered_map<int,double>> edge_cost; // use when specified edge cost
+        std::unordered_map<int,std::unordered_map<EdgeKey,double>> edge_cost; // use when specified edge cost
         std::vector<std::unordered_map<long,double>> _dis_table;
+        HopTableSource _hop_source;
+        std::vector<HopTable> _dis_hops; // per agent, hops is nullptr if the agent has its own table.
+        std::vector<std::vector<double>> _dis_steps; // per agent, _dis_steps[k] is the BFS value of k moves.
+        InfeasiblePolicy _infeasible_policy = InfeasiblePolicy::REJECT;
+        std::vector<long> _infeasible;
+        const std::vector<long>* _ext_labels = nullptr;
+        std::vector<long> _labels; // computed by find_infeasible_agents, for _labels_graph at _labels_version.
+        const PlannerGraph* _labels_graph = nullptr;
+        uint64_t _labels_version = 0;
         std::priority_queue<double, std::vector<double>, std::greater<double>> _T;
         std::unordered_set<double> _T_set;
         std::unordered_map<double, std::vector<State*>> _cache;
@@ -246,10 +437,27 @@ namespace raplab {
         double _time_limit;
         double _runtime;
         std::mt19937 _rng = std::mt19937(0);
+        unsigned _seed = 0;
+        DecisionLog _dlog;
+        std::string _dlog_path;
+        bool _dlog_replay = false;
         bool _swap;
         std::unordered_map<std::string, double> _stats;
+        LsrpStats _counters;
+        long _push_depth = 0;
         TimePathSet _paths;
         std::vector<std::vector<std::tuple<long, long, double, double>>> _all_paths;
+        G* _g = nullptr; // _graph as a G
+    };
+
+    /**
+     * @brief LSRP over any PlannerGraph, through virtual calls.
+     */
+    class Lsrp : public LsrpT<PlannerGraph> {
+    public:
+        Lsrp();
+
+        virtual ~Lsrp();
     };
 }
 
@@ -0,0 +1,59 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_MAPPED_FILE_H_
+#define RAPLAB_BASIC_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief Read-only view of a whole file. The file is memory-mapped where mmap is available,
+ * otherwise it is read into an owned buffer. The view stays valid until Close or destruction.
+ */
+class MappedFile
+{
+public:
+  /**
+   * @brief
+   */
+  MappedFile() ;
+  /**
+   * @brief unmaps.
+   */
+  virtual ~MappedFile() ;
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  /**
+   * @brief Return 1 if succeed, -1 otherwise.
+   */
+  virtual int Open(const std::string& fname) ;
+  /**
+   * @brief
+   */
+  virtual void Close() ;
+
+  bool IsOpen() const {return _data != nullptr;};
+  const char* Data() const {return _data;};
+  size_t Size() const {return _size;};
+  /**
+   * @brief True if the data is mapped, false if it was read into memory.
+   */
+  bool IsMapped() const {return _mapped;};
+
+protected:
+  const char* _data = nullptr;
+  size_t _size = 0;
+  bool _mapped = false;
+  std::vector<char> _buf; // fallback storage
+};
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_MAPPED_FILE_H_
@@ -0,0 +1,59 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_PARALLEL_FOR_H_
+#define RAPLAB_BASIC_PARALLEL_FOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief n_threads if it is positive, otherwise the number of hardware threads (at least 1).
+ */
+inline int NumWorkers(int n_threads) {
+  return n_threads > 0 ? n_threads : int(std::max(1u, std::thread::hardware_concurrency()));
+};
+
+/**
+ * @brief Call fn(worker, i) for every i in [0, n), on NumWorkers(n_threads) threads but not more than n,
+ * the calling thread is worker 0. The threads take the next i from a shared counter, so jobs of uneven
+ * cost are balanced; worker (in [0, NumWorkers(n_threads))) indexes per-thread state.
+ */
+template <typename Fn>
+void ParallelForWorkers(size_t n, int n_threads, const Fn& fn) {
+  size_t n_workers = std::min(size_t(NumWorkers(n_threads)), std::max(n, size_t(1)));
+  std::atomic<size_t> next(0);
+  auto work = [&](int worker) {
+    for (size_t i = next++; i < n; i = next++) {
+      fn(worker, i);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (size_t w = 1; w < n_workers; w++) {
+    pool.emplace_back(work, int(w));
+  }
+  work(0);
+  for (auto& t : pool) {
+    t.join();
+  }
+};
+
+/**
+ * @brief Call fn(i) for every i in [0, n), see ParallelForWorkers.
+ */
+template <typename Fn>
+void ParallelFor(size_t n, int n_threads, const Fn& fn) {
+  ParallelForWorkers(n, n_threads, [&fn](int, size_t i) {fn(i);});
+};
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_PARALLEL_FOR_H_
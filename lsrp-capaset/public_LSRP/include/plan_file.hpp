@@ -0,0 +1,173 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_PLAN_FILE_H_
+#define RAPLAB_BASIC_PLAN_FILE_H_
+
+#include "mapped_file.hpp"
+#include "varint.hpp"
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief Fixed size file header of a binary plan.
+ */
+struct PlanFileHeader
+{
+  char magic[8] = {'L','S','R','P','P','L','A','N'};
+  uint32_t version = 1;
+  uint32_t n_agents = 0;
+  int64_t rows = 0; // size of the grid, vertices are row-major cell ids.
+  int64_t cols = 0;
+  uint32_t ticks_per_unit = 1000; // times are stored as integers, rounded to 1/ticks_per_unit.
+  uint32_t flags = 0; // reserved.
+  double runtime = 0;
+  double soc = 0;
+  double makespan = 0;
+};
+
+/**
+ * @brief One section of a path: the agent moves from vertex from to vertex to (or waits if they are equal)
+ * during [start, end].
+ */
+struct PlanSection
+{
+  long from = 0;
+  long to = 0;
+  double start = 0;
+  double end = 0;
+};
+
+/**
+ * @brief Encoding of the paths of a plan, shared by the plan file and the planner server.
+ *
+ * Every agent is: varint number of sections, double duration, then its sections.
+ * A section is four varints, each relative to the previous section of the agent (zero for the first):
+ * zigzag(from - previous to), zigzag(to - from), zigzag(start - previous end) and zigzag(end - start),
+ * the times in ticks. Consecutive sections of a path are adjacent, so most sections take 4 to 6 bytes.
+ * Times must be finite and below 2^62 ticks in magnitude (see ValidTime).
+ */
+struct PlanEncoder
+{
+  uint32_t ticks_per_unit = 1000;
+  long prev_to = 0;
+  int64_t prev_end = 0;
+
+  void BeginAgent(std::string* out, size_t n_sections, double duration) ;
+  /**
+   * @brief Return false if start or end is not a ValidTime, the section is then stored with both times
+   * at the end of the previous section, so that the output stays decodable.
+   */
+  bool PutSection(std::string* out, long from, long to, double start, double end) ;
+  /**
+   * @brief t is finite and fits in ticks.
+   */
+  bool ValidTime(double t) const ;
+};
+
+/**
+ * @brief Decode one agent written by PlanEncoder from [*p, end), advance *p.
+ * Return false if the input is truncated.
+ */
+bool GetPlanAgent(const char** p, const char* end, uint32_t ticks_per_unit, double* duration,
+                  std::vector<PlanSection>* sections) ;
+
+/**
+ * @brief Streaming writer of a binary plan: the header, then every agent encoded by PlanEncoder.
+ * Records are built in a buffer which is written to the file in large blocks.
+ */
+class PlanWriter
+{
+public:
+  /**
+   * @brief
+   */
+  PlanWriter() ;
+  /**
+   * @brief closes.
+   */
+  virtual ~PlanWriter() ;
+  /**
+   * @brief header.n_agents agents must follow. Return 1 if succeed, -1 otherwise.
+   */
+  virtual int Open(const std::string& fname, const PlanFileHeader& header) ;
+  /**
+   * @brief Start the next agent, n_sections sections must follow.
+   */
+  void BeginAgent(size_t n_sections, double duration) ;
+  /**
+   * @brief A time that is not finite is rejected, see PlanEncoder::PutSection, and Close fails.
+   */
+  void PutSection(long from, long to, double start, double end) ;
+  /**
+   * @brief Flush and close the file. Return 1 if every agent of the header was written, -1 otherwise
+   * (also if a write failed, e.g. on a full disk, or a time was rejected).
+   */
+  virtual int Close() ;
+
+  bool IsOpen() const {return _file != nullptr;};
+
+protected:
+  void _flush() ;
+
+  std::FILE* _file = nullptr;
+  std::string _fname;
+  bool _write_failed = false;
+  bool _invalid_time = false;
+  std::string _buf;
+  PlanFileHeader _h;
+  PlanEncoder _enc;
+  uint32_t _n_agents = 0;
+};
+
+/**
+ * @brief Sequential reader of a binary plan, the file is memory-mapped.
+ */
+class PlanReader
+{
+public:
+  /**
+   * @brief
+   */
+  PlanReader() ;
+  /**
+   * @brief
+   */
+  virtual ~PlanReader() ;
+  /**
+   * @brief Map the file and check the header. Return 1 if succeed, -1 otherwise.
+   */
+  virtual int Open(const std::string& fname) ;
+  /**
+   * @brief
+   */
+  const PlanFileHeader& Header() const {return _h;};
+  /**
+   * @brief Decode the next agent. Return 1 if succeed, 0 after the last agent, -1 if the file is truncated.
+   */
+  virtual int NextAgent(double* duration, std::vector<PlanSection>* sections) ;
+
+protected:
+  MappedFile _file;
+  PlanFileHeader _h;
+  const char* _p = nullptr;
+  uint32_t _n_read = 0;
+};
+
+/**
+ * @brief Write the paths of Lsrp::get_all_paths, vertex ids must already be row-major cell ids.
+ * Return 1 if succeed, -1 otherwise.
+ */
+int WritePlan(const std::string& fname, const PlanFileHeader& header, const std::vector<double>& durations,
+              const std::vector< std::vector< std::tuple<long, long, double, double> > >& paths) ;
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_PLAN_FILE_H_
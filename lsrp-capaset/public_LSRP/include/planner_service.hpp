@@ -0,0 +1,184 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_PLANNER_SERVICE_H_
+#define RAPLAB_BASIC_PLANNER_SERVICE_H_
+
+#include "binary_map.hpp"
+#include "heuristic_store.hpp"
+#include "mapfaa_lsrp.hpp"
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief One instance on the map of a PlannerService. Vertices are row-major cell ids.
+ */
+struct SolveRequest
+{
+  uint64_t id = 0;
+  std::vector<long> starts;
+  std::vector<long> goals;
+  std::vector<double> durations;
+  std::vector< std::pair<long, int> > capacities; // vertex, capacity; the other vertices have capacity 1.
+  double time_limit = 30; // seconds.
+  bool swap = false;
+};
+
+enum SolveStatus : uint8_t {SOLVE_OK = 0, SOLVE_TIMEOUT = 1, SOLVE_INFEASIBLE = 2, SOLVE_INVALID = 3};
+
+/**
+ * @brief Vertices of the paths are row-major cell ids, paths is empty unless the status is SOLVE_OK or SOLVE_TIMEOUT.
+ */
+struct SolveResult
+{
+  uint64_t id = 0;
+  SolveStatus status = SOLVE_INVALID;
+  double runtime = 0;
+  double makespan = 0;
+  double soc = 0;
+  std::vector<double> durations; // of the agents, with the paths.
+  std::vector< std::vector< std::tuple<long, long, double, double> > > paths;
+};
+
+/**
+ * @brief A map kept in memory with its goal table cache, which solves instances on it.
+ *
+ * The neighbor table is built once, each Solve plans on its own Grid2d attached to it (no copy), so that
+ * the occupancy and capacities of concurrent instances are independent. Goal tables come from the
+ * precompiled map if it has them, otherwise from a HeuristicStore shared by all instances. The connected
+ * components of the map, used to find the agents that cannot reach their goal, are labeled once by LoadMap
+ * or SetMap; the capacities of a request do not change them.
+ *
+ * Solve, Prefetch, Flush, NumHits and NumMisses may run concurrently on several threads. A Solve keeps
+ * the goal tables it uses pinned (see HeuristicStore::Get), so a concurrent Flush remaps the store without
+ * freeing them. Missing goal tables are searched outside of the store lock. LoadMap, SetMap, OpenStore and
+ * the setters must not run concurrently with any other call.
+ */
+class PlannerService
+{
+public:
+  /**
+   * @brief
+   */
+  PlannerService() ;
+  /**
+   * @brief
+   */
+  virtual ~PlannerService() ;
+  /**
+   * @brief Load a MovingAI .map file or a precompiled map (order is then ignored). Return 1 if succeed, -1 otherwise.
+   */
+  virtual int LoadMap(const std::string& map_path, GridOrder order = GridOrder::ROW_MAJOR) ;
+  /**
+   * @brief Use a row-major byte array as the map, see Grid2d::SetOccuCellsPtr. The array is not copied and
+   * must outlive the service. Return 1 if succeed, -1 otherwise.
+   */
+  virtual int SetMap(const uint8_t* cells, long rows, long cols, long row_stride = 0,
+                     GridOrder order = GridOrder::ROW_MAJOR) ;
+  /**
+   * @brief Keep the goal tables in a persistent store (see HeuristicStore), written by Flush.
+   * Without it the tables are only kept in memory. Must be called after LoadMap. Return 1 if succeed, -1 otherwise.
+   */
+  virtual int OpenStore(const std::string& store_path) ;
+  /**
+   * @brief Compute the tables of the goals (row-major cell ids) that are not cached yet, in one batch.
+   */
+  virtual void Prefetch(const std::vector<long>& goals) ;
+  /**
+   * @brief Plan one instance, thread safe.
+   */
+  virtual SolveResult Solve(const SolveRequest& req) ;
+  /**
+   * @brief Write the new goal tables to the store file, if any, may run during Solve.
+   * Return 1 if succeed, -1 otherwise.
+   */
+  virtual int Flush() ;
+
+  /**
+   * @brief Bound the memory of the goal tables computed and not flushed, see HeuristicStore::SetMemoryLimit.
+   */
+  void SetMemoryLimit(size_t bytes) ;
+  void SetInfeasiblePolicy(InfeasiblePolicy policy) {_infeasible_policy = policy;};
+  /**
+   * @brief The shared grid, read only.
+   */
+  const Grid2d& Grid() const {return _grid;};
+  size_t NumHits() const ;
+  size_t NumMisses() const ;
+
+protected:
+  /**
+   * @brief The request is in range and consistent.
+   */
+  bool _valid(const SolveRequest& req) const ;
+
+  BinaryMap _bin_map; // a precompiled map, must outlive _grid.
+  OccupancyBitmap _occupancy;
+  Grid2d _grid;
+  std::vector<long> _labels; // connected components of _grid, see ComputeComponents.
+  HeuristicStore _store;
+  std::string _store_path;
+  mutable std::mutex _store_mtx; // guards _store.
+  InfeasiblePolicy _infeasible_policy = InfeasiblePolicy::REJECT;
+};
+
+/**
+ * @brief Framed protocol of the planner server. Every frame is a 4 byte little-endian payload length,
+ * then the payload. Integers are varints (see varint.hpp), doubles 8 raw bytes.
+ *
+ * Request payloads start with a tag:
+ *   SERVE_SOLVE: id, time_limit (double), flags (bit 0: swap), n, n x (start, goal, duration (double)),
+ *                n_capacities, n_capacities x (vertex, capacity).
+ *   SERVE_SHUTDOWN: no field, the server stops after the pending requests.
+ * Response payloads:
+ *   SERVE_PLAN: id, status (SolveStatus), runtime, makespan, soc (doubles), ticks_per_unit, n,
+ *               then n agents encoded by PlanEncoder.
+ * Responses of a connection are sent in completion order, matched to the requests by id. A SERVE_SOLVE
+ * payload that cannot be decoded is answered with SOLVE_INVALID and its id, or id 0 if the id itself
+ * could not be read.
+ */
+enum ServeTag : uint8_t {SERVE_SOLVE = 1, SERVE_SHUTDOWN = 2, SERVE_PLAN = 3};
+
+/**
+ * @brief Parse a SERVE_SOLVE payload, tag included. Return false if it is malformed; req->id is then
+ * the id of the payload if it could be read, 0 otherwise.
+ */
+bool DecodeSolveRequest(const std::string& payload, SolveRequest* req) ;
+/**
+ * @brief Build the SERVE_PLAN payload of a result. A plan with a time that is not finite is sent as
+ * SOLVE_INVALID without paths.
+ */
+void EncodeSolveResult(const SolveResult& res, std::string* payload, uint32_t ticks_per_unit = 1000) ;
+/**
+ * @brief Build the SERVE_SOLVE payload of a request.
+ */
+void EncodeSolveRequest(const SolveRequest& req, std::string* payload) ;
+/**
+ * @brief Parse a SERVE_PLAN payload, tag included. Times are rounded to the ticks of the payload.
+ * Return false if it is malformed.
+ */
+bool DecodeSolveResult(const std::string& payload, SolveResult* res) ;
+
+/**
+ * @brief Serve the frames read from in_fd, answer on out_fd, until end of input or SERVE_SHUTDOWN.
+ * Requests are solved concurrently on n_workers threads (0 for one per hardware thread).
+ * Return 1 if the input ended cleanly, -1 otherwise.
+ */
+int ServeStream(PlannerService* service, int in_fd, int out_fd, int n_workers = 0) ;
+/**
+ * @brief Listen on a Unix domain socket, each connection is served like ServeStream, all connections
+ * share the workers. Stops after a SERVE_SHUTDOWN. Return 1 if succeed, -1 otherwise.
+ */
+int ServeUnixSocket(PlannerService* service, const std::string& socket_path, int n_workers = 0) ;
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_PLANNER_SERVICE_H_
@@ -74,6 +74,7 @@ protected:
 	 */
 	virtual void _init_more() override;
 
+	Grid2d* _grid = nullptr; // _graph, cast once per search.
 	long _vd_r;
 	long _vd_c;
 };
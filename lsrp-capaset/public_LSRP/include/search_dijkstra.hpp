@@ -9,7 +9,7 @@
 #define ZHONGQIANGREN_BASIC_SEARCH_DIJKSTRA_H_
 
 #include "search.hpp"
-#include <set>
+#include "indexed_heap.hpp"
 
 #define DEBUG_DIJKSTRA 0
 
@@ -20,6 +20,8 @@ namespace raplab{
  * 
  * CAVEAT: The graph vertex ID should be within range [0,N], since std::vector is used as the underlying storage.
  * NOTE: This implementation assumes the entire graph is available.
+ * NOTE: The search state is kept between queries on a graph of the same size, only the vertices
+ *   touched by the previous query are reset, so repeated queries on a large graph do not pay O(N) each.
  */
 class Dijkstra : public GraphSearch
 {
@@ -71,6 +73,15 @@ protected:
 
 	virtual int _search() ;
 
+	/**
+	 * @brief Generate the neighbors of v (successors, or predecessors in mode 1) and relax them.
+	 */
+	virtual void _expand(long v, double dist_v) ;
+	/**
+	 * @brief If dist_u improves u, record it with parent v and (re-)open u. Return true if u is improved.
+	 */
+	bool _relax(long v, long u, double dist_u) ;
+
 	// with this method, A* can be easily implemented by inheriting Dijkstra.
 	virtual void _add_open(long v, double g) ;
 
@@ -87,8 +98,12 @@ protected:
 	short _mode; // 0 = start-goal path finding, 1 = exhaustive backwards, 2 = exhaustive forwards.
 	std::vector<long> _parent; // help reconstruct the path.
 	std::vector<double> _v2d; // store the results.
-	std::vector<std::vector<double>> _cvec; // the corresponding cost vector of the path to vd.
-	std::set< std::pair<double, long> > _open;
+	// the corresponding cost vector of the path to v is _cflat[v*_n_cost .. (v+1)*_n_cost), only filled if _n_cost > 1,
+	// otherwise the cost vector is {_v2d[v]}.
+	std::vector<double> _cflat;
+	size_t _n_cost = 1;
+	std::vector<long> _touched; // vertices whose _v2d/_parent differ from the initial value.
+	IndexedMinHeap _open; // keyed by g (Dijkstra) or f (A*), one entry per vertex.
 	std::string _class_name = "Dijkstra";
 };
 
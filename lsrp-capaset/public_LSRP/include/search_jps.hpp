@@ -0,0 +1,152 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_SEARCH_JPS_H_
+#define RAPLAB_BASIC_SEARCH_JPS_H_
+
+#include "search_astar.hpp"
+
+#define DEBUG_JPS 0
+
+namespace raplab{
+
+/**
+ * @brief Jump point search on a Grid2d with uniform costs (straight 1, diagonal 1.4, times the cost scale factor).
+ *
+ * Only jump points are generated and put into OPEN, the cells in between are skipped, which makes
+ * point to point queries on open maps much cheaper than AstarGrid2d. For 8-connected grids the
+ * diagonal moves may cut corners, same as the neighbor table of Grid2d. For 4-connected grids,
+ * canonical paths move vertically first and only turn back to vertical where an obstacle forces it.
+ *
+ * GetPath returns every cell of the path, like Dijkstra. GetDistValue/GetDistAll are only
+ * meaningful for the generated jump points. ExhaustiveBackwards/ExhaustiveForwards fall back to
+ * a plain search over all neighbors.
+ */
+class JpsGrid2d : public AstarGrid2d
+{
+public:
+  /**
+   *
+   */
+  JpsGrid2d() ;
+  /**
+   *
+   */
+  virtual ~JpsGrid2d() ;
+  /**
+   * @brief Return the full path to v, the jump points are connected by straight or diagonal runs.
+   */
+  virtual std::vector<long> GetPath(long v, bool do_reverse=true) override ;
+
+protected:
+  /**
+   * @brief Octile (8-connected) or Manhattan (4-connected) distance to the goal, scaled like the arc costs.
+   */
+  virtual double _heuristic(long v) override ;
+  /**
+   * @brief
+   */
+  virtual void _init_more() override ;
+  /**
+   * @brief Generate the jump points reachable from v along the directions kept by the pruning rules.
+   */
+  virtual void _expand(long v, double dist_v) override ;
+  /**
+   * @brief From cell (r,c), move in direction (dr,dc) until a jump point or the goal is met.
+   * Return its vertex id and the number of steps, or -1 if the run hits an obstacle or the border.
+   */
+  virtual long _jump(long r, long c, int dr, int dc, long* steps) ;
+  /**
+   * @brief Cell (r,c) is inside the grid and not an obstacle.
+   */
+  bool _free(long r, long c) const {
+    return r >= 0 && r < _rows && c >= 0 && c < _cols && !_grid->IsObstacle(_grid->ToInternal(r * _cols + c));
+  };
+  /**
+   * @brief Try the direction (dr,dc) from v at (r,c).
+   */
+  void _try(long v, double dist_v, long r, long c, int dr, int dc) ;
+  /**
+   * @brief Cell (r,c), entered by a move in direction (dr,dc), has a forced neighbor.
+   * Only the local obstacle test, the scans of a diagonal move are done by _jump.
+   */
+  bool _forced(long r, long c, int dr, int dc) const ;
+  /**
+   * @brief Moves in direction (dr,dc) stop where a scan along one of its component directions finds a
+   * jump point: the diagonal moves of 8-connected grids, and the vertical moves of 4-connected grids.
+   */
+  bool _scans(int dr, int dc) const {return (dr != 0 && dc != 0) || (_kngh == 4 && dr != 0);};
+  /**
+   * @brief Bind the grid and its neighborhood, without the goal.
+   */
+  void _bind_grid() ;
+
+  long _rows = 0;
+  long _cols = 0;
+  int _kngh = 4;
+  double _cost_straight = 1.0;
+  double _cost_diag = 1.4;
+};
+
+/**
+ * @brief JPS+, jump distances of every cell in every direction are computed once by Preprocess, then
+ * each jump is a table lookup instead of a scan. The jumps and the paths are the same as JpsGrid2d.
+ *
+ * Preprocess is called by the first search on a grid, and again by the first search after the grid
+ * changed (see PlannerGraph::ArcVersion).
+ */
+class JpsPlusGrid2d : public JpsGrid2d
+{
+public:
+  /**
+   *
+   */
+  JpsPlusGrid2d() ;
+  /**
+   *
+   */
+  virtual ~JpsPlusGrid2d() ;
+  /**
+   * @brief Compute the jump distance table of the current graph, O(number of cells) time.
+   */
+  virtual void Preprocess() ;
+  /**
+   * @brief Number of bytes of the jump distance table.
+   */
+  size_t TableBytes() const {return _dist.size() * sizeof(int32_t);};
+
+protected:
+  /**
+   * @brief
+   */
+  virtual void _init_more() override ;
+  /**
+   * @brief Same result as JpsGrid2d::_jump, read from the table.
+   */
+  virtual long _jump(long r, long c, int dr, int dc, long* steps) override ;
+  /**
+   * @brief Index of direction (dr,dc) in the table, 0..7.
+   */
+  static int _dir(int dr, int dc) {return (dr + 1) * 3 + (dc + 1) - ((dr + 1) * 3 + (dc + 1) > 4);};
+  /**
+   * @brief Jump distance of vertex v in direction d: k > 0 means a jump point k steps away,
+   * k <= 0 means there is no jump point and the run has -k free cells before an obstacle or the border.
+   */
+  int32_t _jd(long v, int d) const {return _dist[v * 8 + d];};
+  /**
+   * @brief If the goal is on the straight run from (r,c) in direction (dr,dc) within the jump distance,
+   * return the number of steps, otherwise -1.
+   */
+  long _steps_to_goal(long r, long c, int dr, int dc) const ;
+
+  std::vector<int32_t> _dist;
+  PlannerGraph* _table_of = nullptr; // the graph _dist was computed for.
+  uint64_t _table_version = 0; // ArcVersion of _table_of when _dist was computed.
+};
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_SEARCH_JPS_H_
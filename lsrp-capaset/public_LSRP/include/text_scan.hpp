@@ -0,0 +1,106 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_TEXT_SCAN_H_
+#define RAPLAB_BASIC_TEXT_SCAN_H_
+
+#include <cstdlib>
+#include <cstring>
+
+namespace raplab{
+
+/**
+ * @brief Lines of a memory-mapped text file, without the LF or CRLF terminator.
+ */
+struct LineReader
+{
+  const char* p;
+  const char* end;
+  long n_lines = 0;
+
+  LineReader(const char* b, const char* e) : p(b), end(e) {};
+
+  bool Next(const char** b, const char** e) {
+    if (p >= end) {return false;}
+    const char* nl = static_cast<const char*>(std::memchr(p, '\n', size_t(end - p)));
+    const char* le = nl ? nl : end;
+    *b = p;
+    *e = (le > p && le[-1] == '\r') ? le - 1 : le;
+    p = nl ? nl + 1 : end;
+    n_lines++;
+    return true;
+  };
+};
+
+inline bool IsSpace(char c) {return c == ' ' || c == '\t';}
+
+inline const char* SkipSpaces(const char* p, const char* e) {
+  while (p < e && IsSpace(*p)) {p++;}
+  return p;
+}
+
+/**
+ * @brief The next token of [*p, e), false if there is none.
+ */
+inline bool NextToken(const char** p, const char* e, const char** tb, const char** te) {
+  const char* q = SkipSpaces(*p, e);
+  if (q == e) {return false;}
+  *tb = q;
+  while (q < e && !IsSpace(*q)) {q++;}
+  *te = q;
+  *p = q;
+  return true;
+}
+
+/**
+ * @brief A non-negative integer token, the data is not null-terminated so strtol can not be used.
+ */
+inline bool NextLong(const char** p, const char* e, long* out) {
+  const char* tb;
+  const char* te;
+  if (!NextToken(p, e, &tb, &te) || te - tb > 18) {return false;}
+  long v = 0;
+  for (const char* q = tb; q < te; q++) {
+    if (*q < '0' || *q > '9') {return false;}
+    v = v * 10 + (*q - '0');
+  }
+  *out = v;
+  return true;
+}
+
+/**
+ * @brief A floating point token. Integers of up to 15 digits are exact in a double and converted directly,
+ * other tokens are copied to a small buffer for strtod.
+ */
+inline bool NextDouble(const char** p, const char* e, double* out) {
+  const char* tb;
+  const char* te;
+  if (!NextToken(p, e, &tb, &te) || te - tb > 63) {return false;}
+  if (te - tb <= 15) {
+    long v = 0;
+    const char* q = tb;
+    while (q < te && *q >= '0' && *q <= '9') {v = v * 10 + (*q++ - '0');}
+    if (q == te) {
+      *out = double(v);
+      return true;
+    }
+  }
+  char buf[64];
+  std::memcpy(buf, tb, size_t(te - tb));
+  buf[te - tb] = '\0';
+  char* stop;
+  *out = std::strtod(buf, &stop);
+  return stop == buf + (te - tb);
+}
+
+inline bool TokenIs(const char* tb, const char* te, const char* word) {
+  size_t n = std::strlen(word);
+  return size_t(te - tb) == n && std::memcmp(tb, word, n) == 0;
+}
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_TEXT_SCAN_H_
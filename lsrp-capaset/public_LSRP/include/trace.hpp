@@ -0,0 +1,119 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_TRACE_H_
+#define RAPLAB_BASIC_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace raplab{
+
+/**
+ * @brief A completed span. name and arg_names must point to string literals,
+ * they are stored as raw pointers and only dereferenced when the trace is dumped.
+ */
+struct TraceEvent
+{
+  const char* name = nullptr;
+  const char* arg_names[2] = {nullptr, nullptr};
+  double args[2] = {0, 0};
+  int64_t ts_ns = 0; // start, relative to the moment tracing was enabled.
+  int64_t dur_ns = 0;
+};
+
+/**
+ * @brief Fixed size ring buffer of spans, written only by its owning thread.
+ * When full, the oldest spans are overwritten.
+ */
+class TraceRing
+{
+public:
+  TraceRing(size_t capacity, int tid) ;
+  /**
+   * @brief Producer side, lock-free, called by the owning thread only.
+   */
+  void Push(const TraceEvent& e) {
+    size_t h = _head.load(std::memory_order_relaxed);
+    _events[h & _mask] = e;
+    _head.store(h + 1, std::memory_order_release);
+  };
+  /**
+   * @brief Copy the retained spans (oldest first) into out. Return the number of dropped spans.
+   */
+  size_t Snapshot(std::vector<TraceEvent>* out) const ;
+  int Tid() const {return _tid;};
+
+protected:
+  std::vector<TraceEvent> _events;
+  size_t _mask;
+  std::atomic<size_t> _head;
+  int _tid;
+};
+
+namespace trace_detail {
+extern std::atomic<bool> enabled;
+int64_t NowNs();
+void Record(const TraceEvent& e);
+}
+
+/**
+ * @brief Start recording spans, each thread gets a ring of ring_capacity spans (rounded up to a power of two).
+ * Previously recorded spans are discarded. Must not be called while spans are open.
+ */
+void TraceEnable(size_t ring_capacity = (1 << 16)) ;
+/**
+ * @brief Stop recording, recorded spans are kept until the next TraceEnable.
+ */
+void TraceDisable() ;
+/**
+ * @brief
+ */
+inline bool TraceEnabled() {
+  return trace_detail::enabled.load(std::memory_order_relaxed);
+};
+/**
+ * @brief Write all recorded spans as Chrome trace-event JSON, which can be opened by
+ * chrome://tracing or ui.perfetto.dev. Return 1 if succeed, -1 otherwise.
+ */
+int TraceDumpChrome(const std::string& fname) ;
+
+/**
+ * @brief RAII span. When tracing is disabled, it costs one relaxed atomic load.
+ */
+class TraceSpan
+{
+public:
+  explicit TraceSpan(const char* name) : _on(TraceEnabled()) {
+    if (_on) {_ev.name = name; _ev.ts_ns = trace_detail::NowNs();}
+  };
+  TraceSpan(const char* name, const char* key, double value) : _on(TraceEnabled()) {
+    if (_on) {_ev.name = name; SetArg(0, key, value); _ev.ts_ns = trace_detail::NowNs();}
+  };
+  ~TraceSpan() {
+    if (_on) {
+      _ev.dur_ns = trace_detail::NowNs() - _ev.ts_ns;
+      trace_detail::Record(_ev);
+    }
+  };
+  /**
+   * @brief Attach an argument to the span, idx is 0 or 1.
+   */
+  void SetArg(int idx, const char* key, double value) {
+    if (_on) {_ev.arg_names[idx] = key; _ev.args[idx] = value;}
+  };
+
+protected:
+  bool _on;
+  TraceEvent _ev;
+};
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_TRACE_H_
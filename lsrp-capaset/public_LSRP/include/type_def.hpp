@@ -1,4 +1,3 @@
-
 /*******************************************
  * Author: Zhongqiang Richard Ren. 
  * All Rights Reserved. 
@@ -8,11 +7,51 @@
 #ifndef ZHONGQIANGREN_BASIC_TYPE_DEF_H_
 #define ZHONGQIANGREN_BASIC_TYPE_DEF_H_
 
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+// bits of the vertex ids stored in adjacency arrays (ArcSpan, CSR and neighbor tables), 32 or 64.
+// Vertex ids in the API are always long; 32 halves the arrays and limits graphs to 2^32-1 vertices.
+#ifndef RAPLAB_VID_BITS
+#define RAPLAB_VID_BITS 64
+#endif
+
 namespace raplab{
 
 typedef std::vector<double> CostVec;
 // typedef std::vector<long> CostVec;
 
+#if RAPLAB_VID_BITS == 32
+typedef uint32_t vid_t;
+#elif RAPLAB_VID_BITS == 64
+typedef int64_t vid_t;
+#else
+#error "RAPLAB_VID_BITS must be 32 or 64"
+#endif
+
+/**
+ * @brief Throw if a graph with n_vertex vertices does not fit in vid_t, instead of silently truncating ids.
+ */
+inline void CheckVidRange(long n_vertex, const char* where) {
+  if (n_vertex > 0 && uint64_t(n_vertex - 1) > uint64_t(std::numeric_limits<vid_t>::max())) {
+    std::cout << "[ERROR] " << where << ", " << n_vertex << " vertices do not fit in " << RAPLAB_VID_BITS
+      << "-bit vertex ids, build with -DRAPLAB_VID_BITS=64" << std::endl;
+    throw std::runtime_error("[ERROR] vertex ids out of range");
+  }
+};
+
+/**
+ * @brief Key of the undirected edge {a,b}, a,b >= 0 and < 2^32.
+ */
+typedef uint64_t EdgeKey;
+
+inline EdgeKey MakeEdgeKey(long a, long b) {
+  return a < b ? (uint64_t(a) << 32) | uint64_t(b) : (uint64_t(b) << 32) | uint64_t(a);
+};
+
 } // end namespace zr
 
 #endif  // ZHONGQIANGREN_BASIC_TYPE_DEF_H_
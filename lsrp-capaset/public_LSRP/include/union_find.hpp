@@ -1,4 +1,3 @@
-
 /*******************************************
  * Author: Zhongqiang Richard Ren. 
  * All Rights Reserved. 
@@ -7,49 +6,46 @@
 #ifndef ZHONGQIANGREN_BASIC_UNIONFIND_H_
 #define ZHONGQIANGREN_BASIC_UNIONFIND_H_
 
-// #include <iostream>
-#include <string>
-#include <unordered_map>
 #include <vector>
-#include <iostream>
 
 namespace raplab {
 
 /**
- * @brief Find operation in Union-find data structure. 
- *  Assume a is in dic. No safety check. You should do that outside.
+ * @brief Union-find over the elements 0..n-1, stored in flat arrays (union by rank, path halving).
  */
-    template<typename DataType>
-    DataType UFFind(std::unordered_map<DataType, DataType> *dic, DataType a) {
-        // if (dic->find(a) == dic->end()) {return -1;}
-        while ((*dic)[a] != a) {
-            (*dic)[a] = (*dic)[(*dic)[a]]; // path compression
-            a = (*dic)[a];
+class UnionFind {
+public:
+    /**
+     * @brief n singletons.
+     */
+    explicit UnionFind(long n = 0) ;
+    /**
+     * @brief Make n singletons again, the arrays are reused.
+     */
+    void Reset(long n) ;
+    /**
+     * @brief Representative of the set that contains a. a must be in [0,n).
+     */
+    long Find(long a) {
+        while (_parent[a] != a) {
+            _parent[a] = _parent[_parent[a]]; // path halving
+            a = _parent[a];
         }
         return a;
     };
+    /**
+     * @brief Union the sets that contain a and b. Return 1 if they were merged, 0 if already in the same set.
+     */
+    int Union(long a, long b) ;
+    /**
+     * @brief Number of elements.
+     */
+    long Size() const {return long(_parent.size());};
 
-/**
- * @brief Union the sets that contains element a and b.
- *  Returned value int indicates the running status of this func.
- */
-    template<typename DataType>
-    int UFUnion(std::unordered_map<DataType, DataType> *dic, const DataType &a, const DataType &b) {
-        if (dic->find(a) == dic->end()) { return -1; }
-        if (dic->find(b) == dic->end()) { return -2; }
-        auto rooti = UFFind(dic, a);
-        auto rootj = UFFind(dic, b);
-        if (rooti == rootj) {
-            return 0;
-        } else {
-            if (rooti > rootj) {
-                (*dic)[rootj] = rooti;
-            } else {
-                (*dic)[rooti] = rootj;
-            }
-            return 1;
-        }
-    } // end rzq
+protected:
+    std::vector<long> _parent;
+    std::vector<unsigned char> _rank;
+};
 
 }
 #endif  // ZHONGQIANGREN_BASIC_UNIONFIND_H_
@@ -0,0 +1,83 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#ifndef RAPLAB_BASIC_VARINT_H_
+#define RAPLAB_BASIC_VARINT_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace raplab{
+
+/**
+ * @brief LEB128 encoding, 7 bits per byte, small values take one byte.
+ */
+inline void PutVarint(std::string* out, uint64_t v) {
+  while (v >= 0x80) {
+    out->push_back(char((v & 0x7f) | 0x80));
+    v >>= 7;
+  }
+  out->push_back(char(v));
+};
+
+/**
+ * @brief Map signed to unsigned so that values close to zero stay small: 0,-1,1,-2 -> 0,1,2,3.
+ */
+inline uint64_t ZigZag(int64_t v) {
+  return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+};
+
+inline int64_t UnZigZag(uint64_t v) {
+  return int64_t(v >> 1) ^ -int64_t(v & 1);
+};
+
+inline void PutSignedVarint(std::string* out, int64_t v) {
+  PutVarint(out, ZigZag(v));
+};
+
+inline void PutDouble(std::string* out, double v) {
+  char buf[sizeof(double)];
+  std::memcpy(buf, &v, sizeof(double));
+  out->append(buf, sizeof(double));
+};
+
+/**
+ * @brief Decode one varint from [*p, end), advance *p. Return false if the input is truncated.
+ */
+inline bool GetVarint(const char** p, const char* end, uint64_t* v) {
+  uint64_t out = 0;
+  int shift = 0;
+  while (*p < end && shift < 64) {
+    uint8_t b = uint8_t(**p);
+    (*p)++;
+    out |= uint64_t(b & 0x7f) << shift;
+    if (b < 0x80) {
+      *v = out;
+      return true;
+    }
+    shift += 7;
+  }
+  return false;
+};
+
+inline bool GetSignedVarint(const char** p, const char* end, int64_t* v) {
+  uint64_t u;
+  if (!GetVarint(p, end, &u)) {return false;}
+  *v = UnZigZag(u);
+  return true;
+};
+
+inline bool GetDouble(const char** p, const char* end, double* v) {
+  if (end - *p < long(sizeof(double))) {return false;}
+  std::memcpy(v, *p, sizeof(double));
+  *p += sizeof(double);
+  return true;
+};
+
+} // end namespace raplab
+
+#endif  // RAPLAB_BASIC_VARINT_H_
@@ -0,0 +1,215 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// Python module of the planner, built with -DLSRP_BUILD_PYTHON=ON (needs pybind11).
+//
+//   import numpy as np, lsrp_py
+//   planner = lsrp_py.Planner(occ)              # uint8 array [rows, cols], nonzero cells are obstacles, not copied
+//   res = planner.solve(starts, goals, durations, time_limit=30.0, swap=False)
+//   res["status"], res["soc"], res["plan"]      # plan: structured array (agent, from, to, start, end)
+//
+// Vertices are row-major cell ids (row*cols+col). The GIL is released while planning, so solve, prefetch
+// and flush may be called from several Python threads, solve_many runs a list of instances on C++ worker
+// threads. open_store and the setters must not run while another call is in progress.
+
+#include "parallel_for.hpp"
+#include "planner_service.hpp"
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+#include <memory>
+#include <stdexcept>
+
+namespace py = pybind11;
+
+namespace {
+
+// one row of the plan array, a section of the path of an agent.
+struct PlanRecord
+{
+  int32_t agent;
+  int64_t from;
+  int64_t to;
+  double start;
+  double end;
+};
+
+const char* StatusName(raplab::SolveStatus s) {
+  switch (s) {
+    case raplab::SOLVE_OK: return "solved";
+    case raplab::SOLVE_TIMEOUT: return "timeout";
+    case raplab::SOLVE_INFEASIBLE: return "infeasible";
+    default: return "invalid";
+  }
+}
+
+raplab::GridOrder ParseOrder(const std::string& order) {
+  if (order == "row") {return raplab::GridOrder::ROW_MAJOR;}
+  if (order == "hilbert") {return raplab::GridOrder::HILBERT;}
+  if (order == "bfs") {return raplab::GridOrder::BFS;}
+  throw std::invalid_argument("vertex order must be 'row', 'hilbert' or 'bfs'");
+}
+
+template <typename T>
+std::vector<T> ToVector(const py::array_t<T, py::array::c_style | py::array::forcecast>& a, const char* name) {
+  if (a.ndim() != 1) {
+    throw std::invalid_argument(std::string(name) + " must be a 1-d array");
+  }
+  return std::vector<T>(a.data(), a.data() + a.size());
+}
+
+raplab::SolveRequest MakeRequest(py::array_t<int64_t, py::array::c_style | py::array::forcecast> starts,
+                                 py::array_t<int64_t, py::array::c_style | py::array::forcecast> goals,
+                                 py::array_t<double, py::array::c_style | py::array::forcecast> durations,
+                                 double time_limit, bool swap, py::object capacities) {
+  raplab::SolveRequest req;
+  std::vector<int64_t> s = ToVector(starts, "starts");
+  std::vector<int64_t> g = ToVector(goals, "goals");
+  req.starts.assign(s.begin(), s.end());
+  req.goals.assign(g.begin(), g.end());
+  req.durations = ToVector(durations, "durations");
+  req.time_limit = time_limit;
+  req.swap = swap;
+  if (!capacities.is_none()) {
+    // {vertex: capacity}, the other vertices have capacity 1.
+    for (auto item : capacities.cast<py::dict>()) {
+      req.capacities.emplace_back(item.first.cast<long>(), item.second.cast<int>());
+    }
+  }
+  return req;
+}
+
+py::dict MakeResult(const raplab::SolveResult& res) {
+  size_t n = 0;
+  for (const auto& path : res.paths) {n += path.size();}
+  py::array_t<PlanRecord> plan(n);
+  PlanRecord* rec = plan.mutable_data();
+  for (size_t i = 0; i < res.paths.size(); ++i) {
+    for (const auto& s : res.paths[i]) {
+      rec->agent = int32_t(i);
+      rec->from = std::get<0>(s);
+      rec->to = std::get<1>(s);
+      rec->start = std::get<2>(s);
+      rec->end = std::get<3>(s);
+      ++rec;
+    }
+  }
+  py::dict out;
+  out["status"] = StatusName(res.status);
+  out["runtime"] = res.runtime;
+  out["makespan"] = res.makespan;
+  out["soc"] = res.soc;
+  out["durations"] = py::array_t<double>(res.durations.size(), res.durations.data());
+  out["plan"] = plan;
+  return out;
+}
+
+// the service and the array it reads the map from.
+class PyPlanner
+{
+public:
+  PyPlanner(py::array occupancy, const std::string& order) : _cells(occupancy) {
+    if (!py::isinstance<py::array_t<uint8_t> >(occupancy) || occupancy.ndim() != 2 || occupancy.strides(1) != 1 ||
+        occupancy.strides(0) < occupancy.shape(1)) {
+      throw std::invalid_argument("occupancy must be a 2-d uint8 array with contiguous rows");
+    }
+    if (_service.SetMap(static_cast<const uint8_t*>(occupancy.data()), long(occupancy.shape(0)), long(occupancy.shape(1)),
+                        long(occupancy.strides(0)), ParseOrder(order)) != 1) {
+      throw std::invalid_argument("empty occupancy array");
+    }
+  };
+  PyPlanner(const std::string& map_path, const std::string& order) {
+    if (_service.LoadMap(map_path, ParseOrder(order)) != 1) {
+      throw std::runtime_error("could not load map '" + map_path + "'");
+    }
+  };
+
+  raplab::PlannerService& Service() {return _service;};
+
+private:
+  py::object _cells; // keeps the borrowed array alive, declared first so that it outlives the service.
+  raplab::PlannerService _service;
+};
+
+} // end namespace
+
+PYBIND11_MODULE(lsrp_py, m) {
+  m.doc() = "LSRP multi-agent path finding with asynchronous actions and capacities.";
+  PYBIND11_NUMPY_DTYPE(PlanRecord, agent, from, to, start, end);
+
+  py::class_<PyPlanner>(m, "Planner")
+    .def(py::init<py::array, const std::string&>(), py::arg("occupancy"), py::arg("order") = "row",
+         "Plan on a uint8 array [rows, cols], nonzero cells are obstacles. The array is not copied, "
+         "it must not be modified while the planner exists.")
+    .def_static("from_file", [](const std::string& path, const std::string& order) {
+        return std::unique_ptr<PyPlanner>(new PyPlanner(path, order));
+      }, py::arg("map_path"), py::arg("order") = "row", "Load a MovingAI .map file or a precompiled map.")
+    .def("set_quarantine_infeasible", [](PyPlanner& p, bool on) {
+        p.Service().SetInfeasiblePolicy(on ? raplab::InfeasiblePolicy::QUARANTINE : raplab::InfeasiblePolicy::REJECT);
+      }, py::arg("on"))
+    .def("open_store", [](PyPlanner& p, const std::string& path) {
+        if (p.Service().OpenStore(path) != 1) {throw std::runtime_error("could not open store '" + path + "'");}
+      }, py::arg("store_path"), "Keep the goal tables in a file, written by flush.")
+    .def("set_memory_limit", [](PyPlanner& p, size_t bytes) {
+        p.Service().SetMemoryLimit(bytes);
+      }, py::arg("bytes"), "Bound the memory of the goal tables that are not flushed, 0 for no bound.")
+    .def("flush", [](PyPlanner& p) {
+        py::gil_scoped_release release;
+        return p.Service().Flush() == 1;
+      })
+    .def("prefetch", [](PyPlanner& p, py::array_t<int64_t, py::array::c_style | py::array::forcecast> goals) {
+        std::vector<int64_t> g = ToVector(goals, "goals");
+        std::vector<long> v(g.begin(), g.end());
+        py::gil_scoped_release release;
+        p.Service().Prefetch(v);
+      }, py::arg("goals"), "Compute the goal tables of many goals at once.")
+    .def("solve", [](PyPlanner& p, py::array_t<int64_t, py::array::c_style | py::array::forcecast> starts,
+                     py::array_t<int64_t, py::array::c_style | py::array::forcecast> goals,
+                     py::array_t<double, py::array::c_style | py::array::forcecast> durations,
+                     double time_limit, bool swap, py::object capacities) {
+        raplab::SolveRequest req = MakeRequest(starts, goals, durations, time_limit, swap, capacities);
+        raplab::SolveResult res;
+        {
+          py::gil_scoped_release release;
+          res = p.Service().Solve(req);
+        }
+        return MakeResult(res);
+      }, py::arg("starts"), py::arg("goals"), py::arg("durations"), py::arg("time_limit") = 30.0,
+         py::arg("swap") = false, py::arg("capacities") = py::none())
+    .def("solve_many", [](PyPlanner& p, py::list instances, double time_limit, bool swap, int jobs) {
+        // instances: (starts, goals, durations) or (starts, goals, durations, capacities) tuples.
+        std::vector<raplab::SolveRequest> reqs;
+        std::vector<long> all_goals;
+        for (auto item : instances) {
+          py::tuple t = item.cast<py::tuple>();
+          if (t.size() != 3 && t.size() != 4) {
+            throw std::invalid_argument("an instance is (starts, goals, durations[, capacities])");
+          }
+          reqs.push_back(MakeRequest(t[0].cast<py::array_t<int64_t, py::array::c_style | py::array::forcecast> >(),
+                                     t[1].cast<py::array_t<int64_t, py::array::c_style | py::array::forcecast> >(),
+                                     t[2].cast<py::array_t<double, py::array::c_style | py::array::forcecast> >(),
+                                     time_limit, swap, t.size() == 4 ? py::object(t[3]) : py::object(py::none())));
+          all_goals.insert(all_goals.end(), reqs.back().goals.begin(), reqs.back().goals.end());
+        }
+        std::vector<raplab::SolveResult> results(reqs.size());
+        {
+          py::gil_scoped_release release;
+          p.Service().Prefetch(all_goals);
+          raplab::ParallelFor(reqs.size(), jobs, [&](size_t i) {
+            results[i] = p.Service().Solve(reqs[i]);
+          });
+        }
+        py::list out;
+        for (const auto& res : results) {
+          out.append(MakeResult(res));
+        }
+        return out;
+      }, py::arg("instances"), py::arg("time_limit") = 30.0, py::arg("swap") = false, py::arg("jobs") = 0,
+         "Solve many instances on worker threads, the results are in the order of the instances.")
+    .def_property_readonly("shape", [](PyPlanner& p) {
+        return py::make_tuple(p.Service().Grid().GetTableView().rows, p.Service().Grid().GetTableView().cols);
+      });
+}
@@ -0,0 +1,86 @@
+# Tests of the Python module, run by ctest when it is built with -DLSRP_BUILD_PYTHON=ON
+# (needs pytest and numpy), or by hand: PYTHONPATH=<build dir> python -m pytest python/test_lsrp_py.py
+
+import os
+import threading
+
+import numpy as np
+import pytest
+
+import lsrp_py
+
+DEMO = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "demo")
+MAP = os.path.join(DEMO, "warehouse-10-20-10-2-1.map")
+
+
+def demo_instance():
+    """The first agents of the demo scenario, one per line of the duration file."""
+    with open(os.path.join(DEMO, "duration.txt")) as f:
+        durations = [float(line.split()[-1]) for line in f if line.strip()]
+    starts, goals = [], []
+    with open(os.path.join(DEMO, "warehouse-10-20-10-2-1-random-1.scen")) as f:
+        next(f)  # version
+        for line in f:
+            fields = line.split()
+            cols = int(fields[2])
+            sx, sy, gx, gy = (int(v) for v in fields[4:8])
+            starts.append(sy * cols + sx)
+            goals.append(gy * cols + gx)
+            if len(starts) == len(durations):
+                break
+    return np.array(starts), np.array(goals), np.array(durations)
+
+
+def test_solve_demo():
+    planner = lsrp_py.Planner.from_file(MAP)
+    starts, goals, durations = demo_instance()
+    res = planner.solve(starts, goals, durations, time_limit=30.0, swap=True)
+    assert res["status"] == "solved"
+    assert res["makespan"] == pytest.approx(87.0, abs=1e-6)
+    assert res["soc"] == pytest.approx(208.1, abs=1e-6)
+    plan = res["plan"]
+    assert set(plan["agent"]) == set(range(len(starts)))
+    for i in range(len(starts)):
+        path = plan[plan["agent"] == i]
+        assert path["from"][0] == starts[i]
+        assert path["to"][-1] == goals[i]
+
+
+def test_solve_array_map():
+    occ = np.zeros((4, 5), dtype=np.uint8)
+    occ[1, 1:4] = 1
+    planner = lsrp_py.Planner(occ)
+    assert planner.shape == (4, 5)
+    res = planner.solve(np.array([0, 4]), np.array([19, 15]), np.array([1.0, 0.5]))
+    assert res["status"] == "solved"
+    res = planner.solve(np.array([0]), np.array([6]), np.array([1.0]))  # goal on an obstacle
+    assert res["status"] == "invalid"
+
+
+def test_flush_during_solve(tmp_path):
+    planner = lsrp_py.Planner.from_file(MAP)
+    planner.open_store(str(tmp_path / "goals.hst"))
+    starts, goals, durations = demo_instance()
+    stop = threading.Event()
+    flushed = []
+
+    def flush():
+        while not stop.is_set():
+            flushed.append(planner.flush())
+
+    t = threading.Thread(target=flush)
+    t.start()
+    try:
+        results = planner.solve_many([(starts, goals, durations)] * 8, swap=True, jobs=4)
+    finally:
+        stop.set()
+        t.join()
+    assert all(flushed)
+    assert [r["status"] for r in results] == ["solved"] * 8
+    assert all(r["soc"] == pytest.approx(208.1, abs=1e-6) for r in results)
+
+    # a new planner maps the flushed store.
+    assert planner.flush()
+    again = lsrp_py.Planner.from_file(MAP)
+    again.open_store(str(tmp_path / "goals.hst"))
+    assert again.solve(starts, goals, durations, swap=True)["status"] == "solved"
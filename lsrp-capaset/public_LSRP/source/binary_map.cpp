@@ -0,0 +1,338 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#include "binary_map.hpp"
+#include "decision_log.hpp"
+#include "parallel_for.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace raplab{
+
+namespace {
+const uint64_t kAlign = 64;
+
+uint64_t AlignUp(uint64_t off) {
+  return (off + kAlign - 1) / kAlign * kAlign;
+}
+
+void WriteSection(std::ofstream& fout, uint64_t off, const void* data, size_t n) {
+  static const char zeros[kAlign] = {0};
+  uint64_t pos = uint64_t(fout.tellp());
+  fout.write(zeros, std::streamsize(off - pos));
+  fout.write(static_cast<const char*>(data), std::streamsize(n));
+}
+}
+
+uint64_t GridContentHash(const GridTableView& view) {
+  int64_t dims[4] = {view.rows, view.cols, view.kngh, int64_t(view.order)};
+  uint64_t h = DigestBytes(dims, sizeof(dims));
+  size_t n_words = size_t((view.rows * view.cols + 63) / 64);
+  h = DigestBytes(view.obst_bits, n_words * sizeof(uint64_t), h);
+  if (view.to_external) {
+    h = DigestBytes(view.to_external, size_t(view.rows * view.cols) * sizeof(vid_t), h);
+  }
+  return h;
+};
+
+bool IsValidHopTable(const uint32_t* hops, size_t n, long goal, uint32_t max_hop) {
+  if (goal < 0 || size_t(goal) >= n || uint64_t(max_hop) >= uint64_t(n) || hops[goal] != 0) {return false;}
+  for (size_t v = 0; v < n; v++) {
+    if (hops[v] > max_hop && hops[v] != kUnreachableHop) {return false;}
+  }
+  return true;
+};
+
+namespace {
+// the table doubles as the visited set, the queue is a plain array of rows*cols entries since every vertex enters it once.
+uint32_t HopBfs(const GridTableView& view, long goal, uint32_t* out, long* queue) {
+  long n = view.rows * view.cols;
+  std::fill(out, out + n, kUnreachableHop);
+  if (goal < 0 || goal >= n) {return 0;}
+  size_t head = 0, tail = 0;
+  queue[tail++] = goal;
+  out[goal] = 0;
+  uint32_t max_hop = 0;
+  while (head < tail) {
+    long u = queue[head++];
+    uint32_t next = out[u] + 1;
+    for (long a = view.offsets[u]; a < view.offsets[u+1]; a++) {
+      long v = view.targets[a];
+      if (out[v] == kUnreachableHop) {
+        out[v] = next;
+        max_hop = next;
+        queue[tail++] = v;
+      }
+    }
+  }
+  return max_hop;
+};
+}
+
+uint32_t ComputeHopTable(const GridTableView& view, long goal, uint32_t* out) {
+  std::vector<long> queue(size_t(view.rows * view.cols));
+  return HopBfs(view, goal, out, queue.data());
+};
+
+void ComputeHopTables(const GridTableView& view, const long* goals, size_t n_goals,
+  uint32_t* const* outs, uint32_t* max_hops, int n_threads)
+{
+  // one search per goal, each worker reuses its own queue.
+  std::vector< std::vector<long> > queues(size_t(NumWorkers(n_threads)));
+  ParallelForWorkers(n_goals, n_threads, [&](int worker, size_t i) {
+    std::vector<long>& queue = queues[size_t(worker)];
+    queue.resize(static_cast<size_t>(view.rows * view.cols));
+    max_hops[i] = HopBfs(view, goals[i], outs[i], queue.data());
+  });
+};
+
+int WriteBinaryMap(const std::string& fname, const Grid2d& g,
+  const std::unordered_map<long, int>& capacities, const std::vector<long>& hop_goals)
+{
+  static_assert(sizeof(long) == sizeof(int64_t), "the binary map stores offsets as int64");
+  const GridTableView& view = g.GetTableView();
+  if (view.offsets == nullptr) {
+    std::cout << "[ERROR] WriteBinaryMap, the grid has no neighbor table" << std::endl;
+    return -1;
+  }
+  long n = view.rows * view.cols;
+  BinaryMapHeader h;
+  h.kngh = view.kngh;
+  h.order = int32_t(view.order);
+  h.rows = view.rows;
+  h.cols = view.cols;
+  h.n_arcs = view.offsets[n];
+  h.cost_scale = g.GetCostScaleFactor();
+  h.content_hash = GridContentHash(view);
+
+  std::vector<long> goals(hop_goals);
+  std::sort(goals.begin(), goals.end());
+  goals.erase(std::unique(goals.begin(), goals.end()), goals.end());
+  h.n_hop_tables = goals.size();
+
+  h.off_bits = AlignUp(sizeof(BinaryMapHeader));
+  h.off_offsets = AlignUp(h.off_bits + (n + 63) / 64 * sizeof(uint64_t));
+  h.off_targets = AlignUp(h.off_offsets + (n + 1) * sizeof(int64_t));
+  h.off_costs = AlignUp(h.off_targets + h.n_arcs * sizeof(vid_t));
+  h.off_capacities = AlignUp(h.off_costs + h.n_arcs * sizeof(double));
+  h.off_order = AlignUp(h.off_capacities + n * sizeof(int32_t));
+  uint64_t order_bytes = view.to_external ? 2 * n * sizeof(vid_t) : 0;
+  h.off_hop_index = AlignUp(h.off_order + order_bytes);
+  h.off_hop_sums = AlignUp(h.off_hop_index + h.n_hop_tables * sizeof(HopTableEntry));
+  h.off_hops = AlignUp(h.off_hop_sums + h.n_hop_tables * sizeof(uint64_t));
+  h.file_size = h.off_hops + h.n_hop_tables * n * sizeof(uint32_t);
+
+  std::vector<int32_t> caps(n, 1);
+  for (const auto& kv : capacities) {
+    if (kv.first < 0 || kv.first >= n) {
+      std::cout << "[ERROR] WriteBinaryMap, capacity of vertex " << kv.first << " is outside the grid" << std::endl;
+      return -1;
+    }
+    caps[kv.first] = kv.second;
+  }
+  std::vector<HopTableEntry> index(goals.size());
+  std::vector< std::vector<uint32_t> > hops(goals.size(), std::vector<uint32_t>(n));
+  std::vector<uint32_t*> outs(goals.size());
+  std::vector<uint32_t> max_hops(goals.size());
+  for (size_t i = 0; i < goals.size(); i++) {
+    if (goals[i] < 0 || goals[i] >= n) {
+      std::cout << "[ERROR] WriteBinaryMap, goal " << goals[i] << " is outside the grid" << std::endl;
+      return -1;
+    }
+    index[i].goal = goals[i];
+    outs[i] = hops[i].data();
+  }
+  ComputeHopTables(view, goals.data(), goals.size(), outs.data(), max_hops.data());
+  std::vector<uint64_t> sums(goals.size());
+  for (size_t i = 0; i < goals.size(); i++) {
+    index[i].max_hop = max_hops[i];
+    sums[i] = DigestBytes(hops[i].data(), n * sizeof(uint32_t));
+  }
+
+  std::ofstream fout(fname, std::ios::binary | std::ios::trunc);
+  if (!fout) {
+    std::cerr << "[Error] file '" << fname << "' could not be opened" << std::endl;
+    return -1;
+  }
+  fout.write(reinterpret_cast<const char*>(&h), sizeof(h));
+  WriteSection(fout, h.off_bits, view.obst_bits, (n + 63) / 64 * sizeof(uint64_t));
+  WriteSection(fout, h.off_offsets, view.offsets, (n + 1) * sizeof(int64_t));
+  WriteSection(fout, h.off_targets, view.targets, h.n_arcs * sizeof(vid_t));
+  WriteSection(fout, h.off_costs, view.costs, h.n_arcs * sizeof(double));
+  WriteSection(fout, h.off_capacities, caps.data(), n * sizeof(int32_t));
+  if (view.to_external) {
+    WriteSection(fout, h.off_order, view.to_internal, n * sizeof(vid_t));
+    WriteSection(fout, h.off_order + n * sizeof(vid_t), view.to_external, n * sizeof(vid_t));
+  }
+  WriteSection(fout, h.off_hop_index, index.data(), index.size() * sizeof(HopTableEntry));
+  WriteSection(fout, h.off_hop_sums, sums.data(), sums.size() * sizeof(uint64_t));
+  for (size_t i = 0; i < hops.size(); i++) {
+    WriteSection(fout, h.off_hops + i * n * sizeof(uint32_t), hops[i].data(), n * sizeof(uint32_t));
+  }
+  if (!fout) {
+    std::cerr << "[Error] file '" << fname << "' could not be written" << std::endl;
+    return -1;
+  }
+  return 1;
+};
+
+BinaryMap::BinaryMap() {};
+
+BinaryMap::~BinaryMap() {};
+
+bool BinaryMap::IsBinaryMap(const std::string& fname) {
+  std::ifstream fin(fname, std::ios::binary);
+  char magic[8] = {0};
+  fin.read(magic, sizeof(magic));
+  BinaryMapHeader ref;
+  return fin && std::memcmp(magic, ref.magic, sizeof(magic)) == 0;
+};
+
+int BinaryMap::Open(const std::string& fname) {
+  static_assert(sizeof(long) == sizeof(int64_t), "the binary map stores offsets as int64");
+  if (_file.Open(fname) != 1) {return -1;}
+  BinaryMapHeader ref;
+  if (_file.Size() < sizeof(BinaryMapHeader) ||
+      std::memcmp(_file.Data(), ref.magic, sizeof(ref.magic)) != 0) {
+    std::cerr << "[Error] BinaryMap, '" << fname << "' is not a precompiled map" << std::endl;
+    _file.Close();
+    return -1;
+  }
+  std::memcpy(&_h, _file.Data(), sizeof(BinaryMapHeader));
+  std::string err;
+  // every size is bounded by the file before it is multiplied, so that the section checks cannot wrap.
+  uint64_t fs = _file.Size();
+  bool sizes_ok = _h.rows >= 0 && _h.cols >= 0 && _h.rows <= 0x7fffffff && _h.cols <= 0x7fffffff &&
+    uint64_t(_h.rows) * uint64_t(_h.cols) <= fs * 8 && _h.n_arcs >= 0 && uint64_t(_h.n_arcs) <= fs &&
+    _h.n_hop_tables <= fs && _h.off_bits <= fs && _h.off_offsets <= fs && _h.off_targets <= fs &&
+    _h.off_costs <= fs && _h.off_capacities <= fs && _h.off_order <= fs && _h.off_hop_index <= fs && _h.off_hop_sums <= fs &&
+    _h.off_hops <= fs;
+  uint64_t n = sizes_ok ? uint64_t(_h.rows) * uint64_t(_h.cols) : 0;
+  if (_h.version != ref.version) {
+    err = "unsupported version " + std::to_string(_h.version);
+  } else if (_h.endian != ref.endian) {
+    err = "the file was written on a machine with another byte order";
+  } else if (_h.id_bytes != sizeof(vid_t)) {
+    err = "the map has " + std::to_string(_h.id_bytes * 8) + "-bit vertex ids, this build uses " +
+      std::to_string(sizeof(vid_t) * 8) + ", convert the map again";
+  } else if (_h.file_size != _file.Size()) {
+    err = "the file is truncated";
+  } else if (!sizes_ok ||
+      _h.off_bits + (n + 63) / 64 * sizeof(uint64_t) > _h.off_offsets ||
+      _h.off_offsets + (n + 1) * sizeof(int64_t) > _h.off_targets ||
+      _h.off_targets + _h.n_arcs * sizeof(vid_t) > _h.off_costs ||
+      _h.off_costs + _h.n_arcs * sizeof(double) > _h.off_capacities ||
+      _h.off_capacities + n * sizeof(int32_t) > _h.off_order ||
+      _h.order < 0 || _h.order > int32_t(GridOrder::BFS) ||
+      _h.off_order + (_h.order ? 2 * n * sizeof(vid_t) : 0) > _h.off_hop_index ||
+      _h.off_hop_index + _h.n_hop_tables * sizeof(HopTableEntry) > _h.off_hop_sums ||
+      _h.off_hop_sums + _h.n_hop_tables * sizeof(uint64_t) > _h.off_hops ||
+      (n > 0 && _h.n_hop_tables > (_h.file_size - _h.off_hops) / (n * sizeof(uint32_t))) ||
+      _h.off_bits % kAlign || _h.off_offsets % kAlign || _h.off_targets % kAlign || _h.off_costs % kAlign ||
+      _h.off_hop_index % kAlign || _h.off_hop_sums % kAlign || _h.off_hops % kAlign) {
+    err = "corrupted section table";
+  } else if (!_check_tables()) {
+    err = "corrupted neighbor table, vertex order or hop index";
+  } else if (GridContentHash(TableView()) != _h.content_hash) {
+    err = "content hash mismatch";
+  }
+  if (!err.empty()) {
+    std::cerr << "[Error] BinaryMap, '" << fname << "': " << err << std::endl;
+    _file.Close();
+    return -1;
+  }
+  _fname = fname;
+  _hop_checked = std::vector< std::atomic<uint8_t> >(size_t(_h.n_hop_tables));
+  return 1;
+};
+
+bool BinaryMap::_check_tables() const {
+  // the content hash covers the obstacles and the order, not the neighbor table: every index the
+  // planner follows is checked once here.
+  long n = NumVertex();
+  const int64_t* offsets = _section<int64_t>(_h.off_offsets);
+  const vid_t* targets = _section<vid_t>(_h.off_targets);
+  if (offsets[0] != 0 || offsets[n] != _h.n_arcs) {return false;}
+  for (long v = 0; v < n; v++) {
+    if (offsets[v] > offsets[v + 1]) {return false;}
+  }
+  for (int64_t a = 0; a < _h.n_arcs; a++) {
+    if (uint64_t(targets[a]) >= uint64_t(n)) {return false;}
+  }
+  if (_h.order != int32_t(GridOrder::ROW_MAJOR)) {
+    const vid_t* order = _section<vid_t>(_h.off_order);
+    for (long k = 0; k < 2 * n; k++) {
+      if (uint64_t(order[k]) >= uint64_t(n)) {return false;}
+    }
+  }
+  // the tables themselves are checked by GetHopTable, the first time they are used.
+  const HopTableEntry* index = _section<HopTableEntry>(_h.off_hop_index);
+  for (uint64_t i = 0; i < _h.n_hop_tables; i++) {
+    if (index[i].goal < 0 || index[i].goal >= n || uint64_t(index[i].max_hop) >= uint64_t(n) ||
+        (i > 0 && index[i - 1].goal >= index[i].goal)) {return false;}
+  }
+  return true;
+};
+
+GridTableView BinaryMap::TableView() const {
+  GridTableView out;
+  out.rows = _h.rows;
+  out.cols = _h.cols;
+  out.kngh = _h.kngh;
+  out.order = GridOrder(_h.order);
+  if (_h.order != int32_t(GridOrder::ROW_MAJOR)) {
+    out.to_internal = _section<vid_t>(_h.off_order);
+    out.to_external = out.to_internal + NumVertex();
+  }
+  out.obst_bits = _section<uint64_t>(_h.off_bits);
+  out.offsets = _section<long>(_h.off_offsets);
+  out.targets = _section<vid_t>(_h.off_targets);
+  out.costs = _section<double>(_h.off_costs);
+  return out;
+};
+
+HopTable BinaryMap::GetHopTable(long goal) const {
+  HopTable out;
+  const HopTableEntry* first = _section<HopTableEntry>(_h.off_hop_index);
+  const HopTableEntry* last = first + _h.n_hop_tables;
+  const HopTableEntry* it = std::lower_bound(first, last, goal,
+    [](const HopTableEntry& e, long g) {return e.goal < g;});
+  if (it == last || it->goal != goal) {return out;}
+  size_t i = size_t(it - first);
+  const uint32_t* hops = _section<uint32_t>(_h.off_hops) + i * size_t(NumVertex());
+  if (_hop_checked[i] == 0) {
+    // concurrent first uses may both check the table, they store the same result.
+    bool ok = DigestBytes(hops, size_t(NumVertex()) * sizeof(uint32_t)) == _section<uint64_t>(_h.off_hop_sums)[i] &&
+      IsValidHopTable(hops, size_t(NumVertex()), goal, it->max_hop);
+    _hop_checked[i] = ok ? 1 : 2;
+    if (!ok) {
+      std::cout << "[CAVEAT] BinaryMap, the hop table of goal " << goal << " in '" << _fname
+                << "' is corrupted, it is not used." << std::endl;
+    }
+  }
+  if (_hop_checked[i] != 1) {return out;}
+  out.hops = hops;
+  out.max_hop = it->max_hop;
+  return out;
+};
+
+int AttachBinaryMap(const BinaryMap& map, Grid2d* g) {
+  if (!map.IsOpen()) {
+    std::cout << "[ERROR] AttachBinaryMap, the map is not open" << std::endl;
+    return -1;
+  }
+  g->AttachTableView(map.TableView());
+  g->SetCostScaleFactor(map.Header().cost_scale);
+  const int32_t* caps = map.Capacities();
+  for (long v = 0; v < map.NumVertex(); v++) {
+    if (caps[v] != 1) {g->SetVertexMaxCapacity(v, caps[v]);}
+  }
+  return 1;
+};
+
+} // end namespace raplab
@@ -0,0 +1,186 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#include "decision_log.hpp"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace raplab{
+
+namespace {
+const size_t kFlushBytes = 1 << 16;
+}
+
+DecisionLog::DecisionLog() {};
+
+DecisionLog::~DecisionLog() {
+  Close();
+};
+
+int DecisionLog::OpenRecord(const std::string& fname, const DecisionLogHeader& header) {
+  Close();
+  _file = std::fopen(fname.c_str(), "wb");
+  if (!_file) {
+    std::cerr << "[Error] file '" << fname << "' could not be opened" << std::endl;
+    return -1;
+  }
+  if (std::fwrite(&header, sizeof(header), 1, _file) != 1) {
+    std::cerr << "[Error] DecisionLog, could not write to '" << fname << "'" << std::endl;
+    std::fclose(_file);
+    _file = nullptr;
+    return -1;
+  }
+  _mode = RECORD;
+  _n_records = 0;
+  _write_failed = false;
+  _n_writer_waits = 0;
+  _closing = false;
+  _buf.clear();
+  _buf.reserve(kFlushBytes * 2);
+  _writer = std::thread(&DecisionLog::_writer_loop, this);
+  return 1;
+};
+
+int DecisionLog::OpenVerify(const std::string& fname, DecisionLogHeader* header) {
+  Close();
+  std::ifstream fin(fname, std::ios::binary);
+  if (!fin) {
+    std::cerr << "[Error] file '" << fname << "' could not be opened" << std::endl;
+    return -1;
+  }
+  std::stringstream ss;
+  ss << fin.rdbuf();
+  std::string content = ss.str();
+  DecisionLogHeader ref;
+  if (content.size() < sizeof(DecisionLogHeader) ||
+      std::memcmp(content.data(), ref.magic, sizeof(ref.magic)) != 0) {
+    std::cerr << "[Error] DecisionLog, '" << fname << "' is not a decision log" << std::endl;
+    return -1;
+  }
+  std::memcpy(header, content.data(), sizeof(DecisionLogHeader));
+  if (header->version != ref.version) {
+    std::cerr << "[Error] DecisionLog, unsupported version " << header->version << std::endl;
+    return -1;
+  }
+  _expected = content.substr(sizeof(DecisionLogHeader));
+  _offset = 0;
+  _mode = VERIFY;
+  _n_records = 0;
+  _diverged = false;
+  _reason.clear();
+  return 1;
+};
+
+void DecisionLog::End() {
+  if (_mode == RECORD) {
+    _buf.append(_rec);
+    if (_buf.size() >= kFlushBytes) {
+      _handoff();
+    }
+  } else if (_mode == VERIFY && !_diverged) {
+    if (_expected.size() - _offset < _rec.size() ||
+        _expected.compare(_offset, _rec.size(), _rec) != 0) {
+      _diverged = true;
+      _n_records_at_divergence = _n_records;
+      if (_offset >= _expected.size()) {
+        _reason = "log ended early";
+      } else if (_rec[0] != _expected[_offset]) {
+        _reason = "record tag " + std::to_string(int(uint8_t(_rec[0]))) + " but logged tag " +
+          std::to_string(int(uint8_t(_expected[_offset])));
+      } else {
+        _reason = "fields of record tag " + std::to_string(int(uint8_t(_rec[0]))) + " differ";
+      }
+    } else {
+      _offset += _rec.size();
+    }
+  }
+  _n_records++;
+};
+
+int DecisionLog::Close() {
+  int ret = 1;
+  if (_mode == RECORD) {
+    _handoff();
+    {
+      std::lock_guard<std::mutex> lock(_mtx);
+      _closing = true;
+    }
+    _cv.notify_one();
+    _writer.join();
+    if (std::fclose(_file) != 0) {
+      _write_failed = true;
+    }
+    _file = nullptr;
+    if (_write_failed) {
+      std::cerr << "[Error] DecisionLog, some records could not be written, the log is incomplete" << std::endl;
+      ret = -1;
+    }
+  } else if (_mode == VERIFY && !_diverged && _offset != _expected.size()) {
+    _diverged = true;
+    _n_records_at_divergence = _n_records;
+    _reason = "replay ended before the log";
+  }
+  _mode = OFF;
+  return ret;
+};
+
+std::string DecisionLog::Report() const {
+  if (_write_failed) {
+    return "write error, the log of " + std::to_string(_n_records) + " records is incomplete";
+  }
+  if (!_diverged) {
+    return "no divergence in " + std::to_string(_n_records) + " records";
+  }
+  return "diverged at record " + std::to_string(_n_records_at_divergence) + ": " + _reason;
+};
+
+void DecisionLog::_handoff() {
+  if (_buf.empty()) {return;}
+  {
+    std::unique_lock<std::mutex> lock(_mtx);
+    if (_queue.size() >= kMaxQueuedBuffers) {
+      _n_writer_waits++;
+      _cv_space.wait(lock, [this]() {return _queue.size() < kMaxQueuedBuffers;});
+    }
+    _queue.push_back(std::string());
+    _queue.back().swap(_buf);
+  }
+  _cv.notify_one();
+  _buf.reserve(kFlushBytes * 2);
+};
+
+void DecisionLog::_writer_loop() {
+  std::vector<std::string> todo;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(_mtx);
+      _cv.wait(lock, [this]() {return _closing || !_queue.empty();});
+      todo.swap(_queue);
+      if (todo.empty() && _closing) {return;}
+    }
+    _cv_space.notify_one();
+    for (auto& chunk : todo) {
+      // after a failed write the remaining chunks are dropped, the log is incomplete anyway.
+      if (!_write_failed && std::fwrite(chunk.data(), 1, chunk.size(), _file) != chunk.size()) {
+        _write_failed = true;
+      }
+    }
+    todo.clear();
+  }
+};
+
+uint64_t DigestBytes(const void* data, size_t n, uint64_t h) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < n; i++) {
+    h ^= p[i];
+    h *= 1099511628211ull;
+  }
+  return h;
+};
+
+} // end namespace raplab
@@ -6,9 +6,68 @@
 
 #include "graph.hpp"
 #include "vec_type.hpp"
+#include "union_find.hpp"
+#include <algorithm>
 
 namespace raplab{
 
+ArcSpan PlannerGraph::GetSuccArcs(long v) {
+  return _flat_span(_get_arc_index().succ, v);
+};
+
+ArcSpan PlannerGraph::GetPredArcs(long v) {
+  return _flat_span(_get_arc_index().pred, v);
+};
+
+const PlannerGraph::_ArcIndex& PlannerGraph::_get_arc_index() {
+  uint64_t stamp = _arc_stamp();
+  if (_arc_index.stamp.load(std::memory_order_acquire) != stamp) {
+    std::lock_guard<std::mutex> lock(_arc_index.mtx);
+    if (_arc_index.stamp.load(std::memory_order_relaxed) != stamp) {
+      _build_arc_index(&_arc_index.succ, &_arc_index.pred);
+      _arc_index.stamp.store(stamp, std::memory_order_release);
+    }
+  }
+  return _arc_index;
+};
+
+void PlannerGraph::_build_arc_index(_FlatArcs* succ, _FlatArcs* pred) {
+  std::vector<long> vs = AllVertex();
+  std::sort(vs.begin(), vs.end());
+  size_t nV = vs.empty() ? 0 : size_t(vs.back() + 1);
+  CheckVidRange(long(nV), "PlannerGraph, arc index");
+  for (int dir = 0; dir < 2; dir++) {
+    _FlatArcs& f = (dir == 0) ? *succ : *pred;
+    f.offsets.assign(nV + 1, 0);
+    f.ids.clear();
+    f.costs.clear();
+    size_t k = 0;
+    for (size_t v = 0; v < nV; v++) {
+      if (k < vs.size() && vs[k] == long(v)) {
+        std::vector<long> ids = (dir == 0) ? GetSuccs(v) : GetPreds(v);
+        f.ids.insert(f.ids.end(), ids.begin(), ids.end());
+        for (auto& c : (dir == 0) ? GetSuccCosts(v) : GetPredCosts(v)) {
+          f.costs.insert(f.costs.end(), c.begin(), c.end());
+        }
+        k++;
+      }
+      f.offsets[v + 1] = f.ids.size();
+    }
+  }
+};
+
+ArcSpan PlannerGraph::_flat_span(const _FlatArcs& f, long v) {
+  ArcSpan out;
+  if (v < 0 || v + 1 >= long(f.offsets.size())) {return out;}
+  size_t cdim = CostDim();
+  long b = f.offsets[v];
+  out.ids = f.ids.data() + b;
+  out.costs = f.costs.data() + b * cdim;
+  out.size = f.offsets[v+1] - b;
+  out.cdim = cdim;
+  out.arc_stride = cdim;
+  return out;
+};
 
 // ############################################################
 // ############################################################
@@ -51,10 +110,12 @@ void SparseGraph::DecreaseVertexOccupiedCapacity(long v) {
   }
 }
 bool SparseGraph::HasVertex(long v) {
-  return v < _to.size();
+  return v >= 0 && size_t(v) < NumVertex();
 };
 
 bool SparseGraph::HasArc(long v, long u) {
+  if (!HasVertex(v)) {return false;}
+  if (_frozen) {return _csr_find(_csr_to, v, u) >= 0;}
   for (auto k : _to[v]){
     if (k == u) {return true;}
   }
@@ -63,34 +124,63 @@ bool SparseGraph::HasArc(long v, long u) {
 
 std::vector<long> SparseGraph::GetSuccs(long v) {
   if (!HasVertex(v)) {return std::vector<long>(); }
-  return _to[v];
+  if (_frozen) {
+    ArcSpan arcs = _csr_span(_csr_to, v);
+    return std::vector<long>(arcs.begin(), arcs.end());
+  }
+  return std::vector<long>(_to[v].begin(), _to[v].end());
 };
 
 std::vector<long> SparseGraph::GetPreds(long v) {
   if (!HasVertex(v)) {return std::vector<long>(); }
-  return _from[v];
+  if (_frozen) {
+    ArcSpan arcs = _csr_span(_csr_from, v);
+    return std::vector<long>(arcs.begin(), arcs.end());
+  }
+  return std::vector<long>(_from[v].begin(), _from[v].end());
 };
 
 CostVec SparseGraph::GetCost(long u, long v) {
-  for (size_t idx = 0; idx < _to_cost[u].size(); idx++){
+  if (_frozen) {
+    long a = HasVertex(u) ? _csr_find(_csr_to, u, v) : -1;
+    if (a < 0) {return std::vector<double>();}
+    CostVec out(_cdim);
+    for (size_t d = 0; d < _cdim; d++) {out[d] = ArcCost(a, d);}
+    return out;
+  }
+  if (!HasVertex(u)) {return std::vector<double>();}
+  for (size_t idx = 0; idx < _to[u].size(); idx++){
     if (_to[u][idx] == v) {
-      return _to_cost[u][idx];
+      return CostVec(_to_cost[u].begin() + idx * _cdim, _to_cost[u].begin() + (idx + 1) * _cdim);
     }
   }
   return std::vector<double>();
 };
 
 std::vector< CostVec > SparseGraph::GetSuccCosts(long u) {
-  if (!HasVertex(u)) {return std::vector<std::vector<double>>(); }
-  return _to_cost[u];
+  std::vector< CostVec > out;
+  if (!HasVertex(u)) {return out; }
+  ArcSpan arcs = GetSuccArcs(u);
+  for (size_t idx = 0; idx < arcs.size; idx++) {
+    out.push_back(CostVec(_cdim));
+    for (size_t d = 0; d < _cdim; d++) {out.back()[d] = arcs.Cost(idx, d);}
+  }
+  return out;
 };
 
 std::vector< CostVec > SparseGraph::GetPredCosts(long u) {
-  if (!HasVertex(u)) {return std::vector<std::vector<double>>(); }
-  return _from_cost[u];
+  std::vector< CostVec > out;
+  if (!HasVertex(u)) {return out; }
+  ArcSpan arcs = GetPredArcs(u);
+  for (size_t idx = 0; idx < arcs.size; idx++) {
+    out.push_back(CostVec(_cdim));
+    for (size_t d = 0; d < _cdim; d++) {out.back()[d] = arcs.Cost(idx, d);}
+  }
+  return out;
 };
 
 size_t SparseGraph::NumVertex() {
+  if (_frozen) {return _csr_to.offsets.size() - 1;}
   return _to.size();
 };
 
@@ -113,14 +203,230 @@ size_t SparseGraph::CostDim() {
 std::vector<long> SparseGraph::AllVertex() 
 {
   std::vector<long> out;
-  for (int i = 0; i < _to.size(); i++){
+  for (long i = 0; i < long(NumVertex()); i++){
     out.push_back(i);
   }
   return out;
 };
 
+size_t SparseGraph::MemoryBytes() {
+  size_t out = sizeof(SparseGraph);
+  for (size_t v = 0; v < _to.size(); v++) {
+    out += (_to[v].capacity() + _from[v].capacity()) * sizeof(vid_t);
+    out += (_to_cost[v].capacity() + _from_cost[v].capacity()) * sizeof(double);
+  }
+  out += (_to.capacity() + _from.capacity()) * sizeof(std::vector<vid_t>);
+  out += (_to_cost.capacity() + _from_cost.capacity()) * sizeof(std::vector<double>);
+  out += (_vertex_max_capacities.capacity() + _vertex_occupied_capacities.capacity()) * sizeof(long);
+  for (auto* c : {&_csr_to, &_csr_from}) {
+    out += c->offsets.capacity() * sizeof(long) + c->ids.capacity() * sizeof(vid_t) + c->costs.capacity() * sizeof(double);
+  }
+  return out;
+};
+
+ArcSpan SparseGraph::GetSuccArcs(long v) {
+  ArcSpan out;
+  if (!HasVertex(v)) {return out; }
+  if (_frozen) {return _csr_span(_csr_to, v);}
+  out.ids = _to[v].data();
+  out.costs = _to_cost[v].data();
+  out.size = _to[v].size();
+  out.cdim = _cdim;
+  out.arc_stride = _cdim;
+  return out;
+};
+
+ArcSpan SparseGraph::GetPredArcs(long v) {
+  ArcSpan out;
+  if (!HasVertex(v)) {return out; }
+  if (_frozen) {return _csr_span(_csr_from, v);}
+  out.ids = _from[v].data();
+  out.costs = _from_cost[v].data();
+  out.size = _from[v].size();
+  out.cdim = _cdim;
+  out.arc_stride = _cdim;
+  return out;
+};
+
+size_t SparseGraph::OutDegree(long v) {
+  if (!HasVertex(v)) {return 0; }
+  if (_frozen) {return _csr_to.offsets[v+1] - _csr_to.offsets[v];}
+  return _to[v].size();
+};
+
+void SparseGraph::Freeze() {
+  if (_frozen) {return;}
+  size_t nV = _to.size();
+  std::vector<long> order;
+  for (int dir = 0; dir < 2; dir++) {
+    const std::vector< std::vector<vid_t> >& adj = (dir == 0) ? _to : _from;
+    std::vector< std::vector<double> >& adj_cost = (dir == 0) ? _to_cost : _from_cost;
+    std::vector<long> src, tgt;
+    std::vector<double> costs;
+    for (size_t v = 0; v < nV; v++) {
+      src.insert(src.end(), adj[v].size(), long(v));
+      tgt.insert(tgt.end(), adj[v].begin(), adj[v].end());
+      costs.insert(costs.end(), adj_cost[v].begin(), adj_cost[v].end());
+    }
+    _build_csr(nV, src.size(), src.data(), tgt.data(), costs.data(), _cdim, (dir == 0) ? &_csr_to : &_csr_from,
+      false, &order);
+  }
+  std::vector< std::vector<vid_t> >().swap(_to);
+  std::vector< std::vector<double> >().swap(_to_cost);
+  std::vector< std::vector<vid_t> >().swap(_from);
+  std::vector< std::vector<double> >().swap(_from_cost);
+  _frozen = true;
+  _arcs_changed();
+};
+
+void SparseGraph::CreateFrozenFromArcs(const std::vector<long>& sources, const std::vector<long>& targets,
+  const std::vector<double>& costs, size_t cdim, bool merge_duplicates)
+{
+  _create_frozen(sources, targets, costs, cdim, merge_duplicates);
+};
+
+void SparseGraph::CreateFrozenFromIds(const std::vector<vid_t>& sources, const std::vector<vid_t>& targets,
+  const std::vector<double>& costs, size_t cdim, bool merge_duplicates)
+{
+  _create_frozen(sources, targets, costs, cdim, merge_duplicates);
+};
+
+template <typename Id>
+void SparseGraph::_create_frozen(const std::vector<Id>& sources, const std::vector<Id>& targets,
+  const std::vector<double>& costs, size_t cdim, bool merge_duplicates)
+{
+  if (sources.size() != targets.size() || costs.size() != sources.size() * cdim) {
+    std::cout << "[ERROR] SparseGraph::CreateFrozenFromArcs, " << sources.size() << " sources, "
+      << targets.size() << " targets and " << costs.size() << " costs do not match" << std::endl;
+    throw std::runtime_error("[ERROR] SparseGraph::CreateFrozenFromArcs, input sizes do not match");
+  }
+  _to.clear();
+  _to_cost.clear();
+  _from.clear();
+  _from_cost.clear();
+  // the vertices are 0 ... the largest id of an arc, none without arcs.
+  long max_id = -1;
+  for (size_t i = 0; i < sources.size(); i++){
+    if (long(sources[i]) < 0 || long(targets[i]) < 0) {
+      std::cout << "[ERROR] SparseGraph::CreateFrozenFromArcs, arc " << i << " (" << sources[i] << ", "
+        << targets[i] << ") has a negative vertex id" << std::endl;
+      throw std::runtime_error("[ERROR] SparseGraph::CreateFrozenFromArcs, negative vertex id");
+    }
+    if (long(sources[i]) > max_id) { max_id = long(sources[i]); }
+    if (long(targets[i]) > max_id) { max_id = long(targets[i]); }
+  }
+  _cdim = cdim;
+  std::vector<long> order;
+  _build_csr(max_id+1, sources.size(), sources.data(), targets.data(), costs.data(), cdim, &_csr_to, merge_duplicates, &order);
+  _build_csr(max_id+1, sources.size(), targets.data(), sources.data(), costs.data(), cdim, &_csr_from, merge_duplicates, &order);
+  _n_arc = _csr_to.ids.size();
+  _frozen = true;
+  _arcs_changed();
+};
+
+long SparseGraph::FindArc(long u, long v) const {
+  if (!_frozen || u < 0 || u + 1 >= long(_csr_to.offsets.size())) {return -1;}
+  return _csr_find(_csr_to, u, v);
+};
+
+template <typename Id>
+void SparseGraph::_build_csr(size_t n_vertex, size_t m, const Id* src, const Id* tgt,
+  const double* costs, size_t cdim, _Csr* out, bool merge_duplicates, std::vector<long>* order_buf)
+{
+  CheckVidRange(long(n_vertex), "SparseGraph, CSR");
+  out->offsets.assign(n_vertex + 1, 0);
+  for (size_t a = 0; a < m; a++) {
+    out->offsets[src[a] + 1]++;
+  }
+  for (size_t v = 0; v < n_vertex; v++) {
+    out->offsets[v + 1] += out->offsets[v];
+  }
+  std::vector<long>& order = *order_buf;
+  order.resize(m);
+  {
+    std::vector<long> pos(out->offsets.begin(), out->offsets.end() - 1);
+    for (size_t a = 0; a < m; a++) {
+      order[pos[src[a]]++] = a;
+    }
+  }
+  for (size_t v = 0; v < n_vertex; v++) {
+    std::sort(order.begin() + out->offsets[v], order.begin() + out->offsets[v + 1],
+      [&](long x, long y) {return tgt[x] < tgt[y] || (tgt[x] == tgt[y] && x < y);});
+  }
+  if (merge_duplicates) {
+    // equal targets are sorted by arc index, the last one of each run is kept.
+    size_t w = 0;
+    long b = 0;
+    for (size_t v = 0; v < n_vertex; v++) {
+      long e = out->offsets[v + 1];
+      for (long i = b; i < e; i++) {
+        if (i + 1 < e && tgt[order[i + 1]] == tgt[order[i]]) {continue;}
+        order[w++] = order[i];
+      }
+      b = e;
+      out->offsets[v + 1] = long(w);
+    }
+    m = w;
+  }
+  out->ids.resize(m);
+  out->costs.resize(m * cdim);
+  for (size_t i = 0; i < m; i++) {
+    out->ids[i] = vid_t(tgt[order[i]]);
+    for (size_t d = 0; d < cdim; d++) {
+      out->costs[d * m + i] = costs[order[i] * cdim + d];
+    }
+  }
+};
+
+ArcSpan SparseGraph::_csr_span(const _Csr& c, long v) const {
+  ArcSpan out;
+  long b = c.offsets[v];
+  out.ids = c.ids.data() + b;
+  out.costs = c.costs.data() + b;
+  out.size = c.offsets[v + 1] - b;
+  out.cdim = _cdim;
+  out.arc_stride = 1;
+  out.dim_stride = c.ids.size();
+  return out;
+};
+
+long SparseGraph::_csr_find(const _Csr& c, long u, long v) const {
+  if (v < 0) {return -1;}
+  const vid_t* first = c.ids.data() + c.offsets[u];
+  const vid_t* last = c.ids.data() + c.offsets[u + 1];
+  const vid_t* it = std::lower_bound(first, last, vid_t(v));
+  if (it == last || long(*it) != v) {return -1;}
+  return it - c.ids.data();
+};
+
+void SparseGraph::_thaw() {
+  if (!_frozen) {return;}
+  size_t nV = _csr_to.offsets.size() - 1;
+  for (int dir = 0; dir < 2; dir++) {
+    const _Csr& c = (dir == 0) ? _csr_to : _csr_from;
+    std::vector< std::vector<vid_t> >& adj = (dir == 0) ? _to : _from;
+    std::vector< std::vector<double> >& adj_cost = (dir == 0) ? _to_cost : _from_cost;
+    adj.assign(nV, std::vector<vid_t>());
+    adj_cost.assign(nV, std::vector<double>());
+    size_t m = c.ids.size();
+    for (size_t v = 0; v < nV; v++) {
+      for (long a = c.offsets[v]; a < c.offsets[v + 1]; a++) {
+        adj[v].push_back(c.ids[a]);
+        for (size_t d = 0; d < _cdim; d++) {adj_cost[v].push_back(c.costs[d * m + a]);}
+      }
+    }
+  }
+  _csr_to = _Csr();
+  _csr_from = _Csr();
+  _frozen = false;
+  _arcs_changed();
+};
+
 void SparseGraph::AddVertex(long v) {
+  if (_frozen) {_thaw();}
   if (!HasVertex(v)) {
+    _arcs_changed();
+    CheckVidRange(v+1, "SparseGraph::AddVertex");
     _to.resize(v+1);
     _to_cost.resize(v+1);
     _from.resize(v+1);
@@ -136,6 +442,8 @@ void SparseGraph::AddEdge(long u, long v, std::vector<double> c) {
 };
 
 void SparseGraph::AddArc(long u, long v, std::vector<double> c) {
+  if (_frozen) {_thaw();}
+  _arcs_changed();
   if (!HasVertex(u)) {
     AddVertex(u);
   }
@@ -155,28 +463,28 @@ void SparseGraph::AddArc(long u, long v, std::vector<double> c) {
   bool updated = false;
   for (size_t idx = 0; idx < _to[u].size(); idx++){
     if (_to[u][idx] == v) {
-      _to_cost[u][idx] = c;
+      std::copy(c.begin(), c.end(), _to_cost[u].begin() + idx * _cdim);
       updated = true;
       break;
     }
   }
   if (!updated) {
     _to[u].push_back(v);
-    _to_cost[u].push_back(c);
+    _to_cost[u].insert(_to_cost[u].end(), c.begin(), c.end());
     _n_arc++;
   }
 
   updated = false;
   for (size_t idx = 0; idx < _from[v].size(); idx++){
     if (_from[v][idx] == u) {
-      _from_cost[v][idx] = c;
+      std::copy(c.begin(), c.end(), _from_cost[v].begin() + idx * _cdim);
       updated = true;
       break;
     }
   }
   if (!updated) {
     _from[v].push_back(u);
-    _from_cost[v].push_back(c);
+    _from_cost[v].insert(_from_cost[v].end(), c.begin(), c.end());
     _n_arc++;
   }
   return ;
@@ -185,6 +493,10 @@ void SparseGraph::AddArc(long u, long v, std::vector<double> c) {
 void SparseGraph::CreateFromEdges(std::vector<long> sources, 
     std::vector<long> targets, std::vector<std::vector<double>> costs)
 {
+  _arcs_changed();
+  _csr_to = _Csr();
+  _csr_from = _Csr();
+  _frozen = false;
   _to.clear();
   _to_cost.clear();
   _from.clear();
@@ -194,19 +506,22 @@ void SparseGraph::CreateFromEdges(std::vector<long> sources,
     if (sources[i] > max_id) { max_id = sources[i]; }
     if (targets[i] > max_id) { max_id = targets[i]; }
   }
+  CheckVidRange(max_id+1, "SparseGraph::CreateFromEdges");
   _to.resize(max_id+1);
   _to_cost.resize(max_id+1);
   _from.resize(max_id+1);
   _from_cost.resize(max_id+1);
+  _set_cdim_from(costs);
   for (size_t i = 0; i < sources.size(); i++) {
+    const std::vector<double>& c = costs[i];
     _to[sources[i]].push_back(targets[i]);
-    _to_cost[sources[i]].push_back(costs[i]);
+    _to_cost[sources[i]].insert(_to_cost[sources[i]].end(), c.begin(), c.end());
     _from[targets[i]].push_back(sources[i]);
-    _from_cost[targets[i]].push_back(costs[i]);
+    _from_cost[targets[i]].insert(_from_cost[targets[i]].end(), c.begin(), c.end());
     _to[targets[i]].push_back(sources[i]);
-    _to_cost[targets[i]].push_back(costs[i]);
+    _to_cost[targets[i]].insert(_to_cost[targets[i]].end(), c.begin(), c.end());
     _from[sources[i]].push_back(targets[i]);
-    _from_cost[sources[i]].push_back(costs[i]);
+    _from_cost[sources[i]].insert(_from_cost[sources[i]].end(), c.begin(), c.end());
   }
   return ;
 };
@@ -214,6 +529,10 @@ void SparseGraph::CreateFromEdges(std::vector<long> sources,
 void SparseGraph::CreateFromArcs(std::vector<long> sources, 
     std::vector<long> targets, std::vector<std::vector<double>> costs)
 {
+  _arcs_changed();
+  _csr_to = _Csr();
+  _csr_from = _Csr();
+  _frozen = false;
   _to.clear();
   _to_cost.clear();
   _from.clear();
@@ -223,34 +542,50 @@ void SparseGraph::CreateFromArcs(std::vector<long> sources,
     if (sources[i] > max_id) { max_id = sources[i]; }
     if (targets[i] > max_id) { max_id = targets[i]; }
   }
+  CheckVidRange(max_id+1, "SparseGraph::CreateFromArcs");
   _to.resize(max_id+1);
   _to_cost.resize(max_id+1);
   _from.resize(max_id+1);
   _from_cost.resize(max_id+1);
+  _set_cdim_from(costs);
   for (size_t i = 0; i < sources.size(); i++) {
+    const std::vector<double>& c = costs[i];
     _to[sources[i]].push_back(targets[i]);
-    _to_cost[sources[i]].push_back(costs[i]);
+    _to_cost[sources[i]].insert(_to_cost[sources[i]].end(), c.begin(), c.end());
     _from[targets[i]].push_back(sources[i]);
-    _from_cost[targets[i]].push_back(costs[i]);
+    _from_cost[targets[i]].insert(_from_cost[targets[i]].end(), c.begin(), c.end());
   }
   return ;
 };
 
 void SparseGraph::ChangeCostDim(size_t new_cdim, double default_value) {
-  for (size_t i = 0; i < _to.size(); i++) {
-    for (size_t j = 0; j < _to[i].size(); j++) {
-      _to_cost[i][j].resize(new_cdim, default_value);
-    }
-  }
-  for (size_t i = 0; i < _from.size(); i++) {
-    for (size_t j = 0; j < _from[i].size(); j++) {
-      _from_cost[i][j].resize(new_cdim, default_value);
+  if (_frozen) {_thaw();}
+  _arcs_changed();
+  size_t n_keep = std::min(_cdim, new_cdim);
+  for (auto* costs : {&_to_cost, &_from_cost}) {
+    for (auto& flat : *costs) {
+      size_t n_arcs = (_cdim == 0) ? 0 : flat.size() / _cdim;
+      std::vector<double> resized(n_arcs * new_cdim, default_value);
+      for (size_t j = 0; j < n_arcs; j++) {
+        std::copy(flat.begin() + j * _cdim, flat.begin() + j * _cdim + n_keep, resized.begin() + j * new_cdim);
+      }
+      flat.swap(resized);
     }
   }
   _cdim = new_cdim;
   return ;
 };
 
+void SparseGraph::_set_cdim_from(const std::vector< std::vector<double> >& costs) {
+  _cdim = costs.empty() ? 0 : costs[0].size();
+  for (auto& c : costs) {
+    if (c.size() != _cdim) {
+      std::cout << "[ERROR] SparseGraph cdim does not match: " << _cdim << " != " << c.size() << std::endl;
+      throw std::runtime_error("[ERROR] SparseGraph cdim does not match");
+    }
+  }
+};
+
 bool SparseGraph::SetArcCost(long u, long v, const std::vector<double>& new_cost) {
   if (new_cost.size() != _cdim){
     std::cout << "[ERROR] SparseGraph::SetArcCost new edge cost dimension does not match! Maybe call ChangeCostDim() at first." << std::endl;
@@ -267,11 +602,26 @@ bool SparseGraph::SetArcCost(long u, long v, const std::vector<double>& new_cost
     throw std::runtime_error("[ERROR] SparseGraph::SetArcCost input vector size mismatch!") ;
     return false;
   }
+  _arcs_changed();
+
+  if (_frozen) {
+    long a = _csr_find(_csr_to, u, v);
+    long b = _csr_find(_csr_from, v, u);
+    if (a < 0 || b < 0) {
+      std::cout << "[ERROR] SparseGraph::SetArcCost arc does not exist!" << std::endl;
+      throw std::runtime_error("[ERROR] SparseGraph::SetArcCost arc does not exist!") ;
+    }
+    for (size_t d = 0; d < _cdim; d++) {
+      _csr_to.costs[d * _csr_to.ids.size() + a] = new_cost[d];
+      _csr_from.costs[d * _csr_from.ids.size() + b] = new_cost[d];
+    }
+    return true;
+  }
 
   bool found = false;
   for (int i = 0; i < _to[u].size(); i++){
     if (_to[u][i] == v) {
-      _to_cost[u][i] = new_cost;
+      std::copy(new_cost.begin(), new_cost.end(), _to_cost[u].begin() + i * _cdim);
       found = true;
       break;
     }
@@ -284,7 +634,7 @@ bool SparseGraph::SetArcCost(long u, long v, const std::vector<double>& new_cost
   found = false;
   for (int i = 0; i < _from[v].size(); i++){
     if (_from[v][i] == u) {
-      _from_cost[v][i] = new_cost;
+      std::copy(new_cost.begin(), new_cost.end(), _from_cost[v].begin() + i * _cdim);
       found = true;
       break;
     }
@@ -297,12 +647,18 @@ bool SparseGraph::SetArcCost(long u, long v, const std::vector<double>& new_cost
 };
 
 std::string SparseGraph::ToStr() const {
+  if (_frozen) {
+    SparseGraph copy(*this);
+    copy._thaw();
+    return copy.ToStr();
+  }
   std::string out;
   out += "=== SparseGraph Begin ===\n |V| = " + std::to_string(_to.size()) + " outgoing edges \n";
   for (long v = 0; v < _to.size(); v++) {
     out += " -- " + std::to_string(v) + ":[";
     for (size_t idy = 0; idy < _to[v].size(); idy++){
-      out += std::to_string(_to[v][idy]) + "(" + ToString(_to_cost[v][idy]) + "),";
+      out += std::to_string(_to[v][idy]) + "(" + ToString(CostVec(_to_cost[v].begin() + idy * _cdim,
+        _to_cost[v].begin() + (idy + 1) * _cdim)) + "),";
     }
     out += "]\n";
   }
@@ -310,7 +666,8 @@ std::string SparseGraph::ToStr() const {
   for (long v = 0; v < _to.size(); v++) {
     out += " -- " + std::to_string(v) + ":[";
     for (size_t idy = 0; idy < _from[v].size(); idy++){
-      out += std::to_string(_from[v][idy]) + "(" + ToString(_from_cost[v][idy]) + "),";
+      out += std::to_string(_from[v][idy]) + "(" + ToString(CostVec(_from_cost[v].begin() + idy * _cdim,
+        _from_cost[v].begin() + (idy + 1) * _cdim)) + "),";
     }
     out += "]\n";
   }
@@ -328,6 +685,7 @@ std::ostream& operator<<(std::ostream& os, const SparseGraph& c) {
 // ############################################################
 
 Grid2d::Grid2d() {
+  _occu_grid_ptr = nullptr;
   SetKNeighbor(4); // by default
 };
 
@@ -367,10 +725,7 @@ void Grid2d::DecreaseVertexOccupiedCapacity(long v) {
 }
 bool Grid2d::HasVertex(long v)
 {
-  if ( (_k2r(v) < _occu_grid_ptr->size()) && (_k2c(v) < _occu_grid_ptr->at(0).size()) ){
-    return true;
-  }
-  return false;
+  return (v >= 0) && (v < _n_rows * _n_cols);
 };
 
 bool Grid2d::HasArc(long v, long u) {
@@ -388,18 +743,8 @@ bool Grid2d::HasArc(long v, long u) {
 
 std::vector<long> Grid2d::GetSuccs(long v)
 {
-  std::vector<long> out;
-  long r = _k2r(v);
-  long c = _k2c(v);
-  for (size_t idx = 0; idx < _kngh; idx++) {
-    long nr = r+_act_r[idx];
-    if (nr >= _occu_grid_ptr->size()) {continue;}
-    long nc = c+_act_c[idx];
-    if (nc >= _occu_grid_ptr->at(0).size()) {continue;}
-    if (_occu_grid_ptr->at(nr).at(nc) > 0) {continue;} // obstacle
-    out.push_back(_rc2k(nr,nc));
-  }
-  return out;
+  if (!HasVertex(v)) {return std::vector<long>();}
+  return std::vector<long>(SuccBegin(v), SuccEnd(v));
 };
 
 std::vector<long> Grid2d::GetPreds(long v)
@@ -412,8 +757,8 @@ CostVec Grid2d::GetCost(long u, long v)
 {
   // v is the target vertex of arc (u,v)
   std::vector<double> out;
-  long r = _k2r(v);
-  long c = _k2c(v);
+  long r = _k2r(u);
+  long c = _k2c(u);
   long r2 = _k2r(v);
   long c2 = _k2c(v);
   if ((r != r2) && (c != c2)) {
@@ -428,24 +773,10 @@ CostVec Grid2d::GetCost(long u, long v)
 std::vector< CostVec > Grid2d::GetSuccCosts(long u)
 {
   std::vector<std::vector<double>> out;
-  long r = _k2r(u);
-  long c = _k2c(u);
-  for (size_t idx = 0; idx < _kngh; idx++) {
-    long nr = r+_act_r[idx];
-    // if (nr >= _occu_grid_ptr->size()) {continue;}
-    long nc = c+_act_c[idx];
-    // if (nc >= _occu_grid_ptr->at(0).size()) {continue;}
-    if (! IsWithinBorder(nr, nc)) {continue;};
-    if (_occu_grid_ptr->at(nr).at(nc) > 0) {continue;} // obstacle
-    std::vector<double> c;
-    if (idx <= 3) { 
-      c.push_back(1.0*_cost_scale);
-    }
-    else if (idx <= 7) {
-      c.push_back(1.4*_cost_scale);
-    }
-    else { throw std::runtime_error( "[ERROR], Grid2d _kngh > 8, not supported!" ); }
-    out.push_back(c);
+  if (!HasVertex(u)) {return out;}
+  out.reserve(NumSuccs(u));
+  for (const double* c = SuccCostBegin(u); c != SuccCostBegin(u) + NumSuccs(u); c++) {
+    out.push_back(std::vector<double>(1, *c));
   }
   return out;
 };
@@ -455,29 +786,13 @@ std::vector< CostVec > Grid2d::GetPredCosts(long u) {
 };
 
 size_t Grid2d::NumVertex() {
-  if (_occu_grid_ptr->size() == 0) {return 0;}
-  return _occu_grid_ptr->size() * _occu_grid_ptr->at(0).size() ;
+  return size_t(_n_rows * _n_cols);
 } ;
 
 size_t Grid2d::NumArc() {
-  if (_occu_grid_ptr) {
-    size_t rows = _occu_grid_ptr->size();
-    if (rows > 0) {
-        size_t cols = _occu_grid_ptr->at(0).size();
-        // 假设是 4 连通网格图
-        size_t num_arcs = 0;
-        for (size_t i = 0; i < rows; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                if (i > 0) num_arcs++; // 向上的弧
-                if (i < rows - 1) num_arcs++; // 向下的弧
-                if (j > 0) num_arcs++; // 向左的弧
-                if (j < cols - 1) num_arcs++; // 向右的弧
-            }
-        }
-        return num_arcs;
-    }
-}
-return 0;
+  // 假设是 4 连通网格图, every pair of adjacent cells, obstacles included.
+  if (_n_rows == 0 || _n_cols == 0) {return 0;}
+  return size_t(2 * (_n_rows * (_n_cols - 1) + _n_cols * (_n_rows - 1)));
 };
 
 size_t Grid2d::NumEdge() {
@@ -490,27 +805,64 @@ size_t Grid2d::CostDim() {
 
 std::vector<long> Grid2d::AllVertex() 
 {
-  std::vector<long> out;
+  std::vector<long> out(_n_rows * _n_cols);
+  for (long k = 0; k < _n_rows * _n_cols; ++k) {
+    out[k] = k;
+  }
+  return out;
+};
+
+size_t Grid2d::MemoryBytes() {
+  size_t out = sizeof(Grid2d);
   if (_occu_grid_ptr) {
-      size_t rows = _occu_grid_ptr->size();
-      if (rows > 0) {
-          size_t cols = _occu_grid_ptr->at(0).size();
-          for (size_t i = 0; i < rows; ++i) {
-              for (size_t j = 0; j < cols; ++j) {
-                  long vertex_id = i * cols + j;
-                  out.push_back(vertex_id);
-              }
-          }
-      }
+    out += _occu_grid_ptr->capacity() * sizeof(std::vector<double>);
+    for (auto& row : *_occu_grid_ptr) { out += row.capacity() * sizeof(double); }
+  }
+  if (_occu_bits_ptr) {
+    out += _occu_bits_ptr->bits.capacity() * sizeof(uint64_t);
   }
+  if (_occu_cells_ptr) {
+    out += size_t(_cells_rows * _cells_cols);
+  }
+  if (_occu_grid_ptr != &_mat_from_py) {
+    for (auto& row : _mat_from_py) { out += row.capacity() * sizeof(double); }
+  }
+  out += (_vertex_max_capacities.capacity() + _vertex_occupied_capacities.capacity()) * sizeof(long);
+  out += _obst_bits.capacity() * sizeof(uint64_t);
+  out += _nbr_offsets.capacity() * sizeof(long) + _nbr_targets.capacity() * sizeof(vid_t);
+  out += _nbr_costs.capacity() * sizeof(double);
+  out += (_to_int.capacity() + _to_ext.capacity()) * sizeof(vid_t);
+  return out;
+};
+
+ArcSpan Grid2d::GetSuccArcs(long v) {
+  ArcSpan out;
+  if (!HasVertex(v)) {return out;}
+  out.ids = SuccBegin(v);
+  out.costs = SuccCostBegin(v);
+  out.size = NumSuccs(v);
+  out.cdim = 1;
+  out.arc_stride = 1;
   return out;
 };
 
+ArcSpan Grid2d::GetPredArcs(long v) {
+  return GetSuccArcs(v);
+};
+
+size_t Grid2d::OutDegree(long v) {
+  if (!HasVertex(v)) {return 0;}
+  return NumSuccs(v);
+};
+
 ////////////
 
 void Grid2d::SetOccuGridPtr(std::vector< std::vector<double> >* in)
 {
   _occu_grid_ptr = in;
+  _occu_bits_ptr = nullptr;
+  _occu_cells_ptr = nullptr;
+  RebuildNeighborTable();
   return ;
 };
 
@@ -525,9 +877,32 @@ void Grid2d::SetOccuGridObject(std::vector< std::vector<double> >& in)
   SetOccuGridPtr(&_mat_from_py);
 };
 
+void Grid2d::SetOccuBitmapPtr(const OccupancyBitmap* in)
+{
+  _occu_grid_ptr = nullptr;
+  _occu_bits_ptr = in;
+  _occu_cells_ptr = nullptr;
+  RebuildNeighborTable();
+};
+
+void Grid2d::SetOccuCellsPtr(const uint8_t* cells, long rows, long cols, long row_stride)
+{
+  if (rows < 0 || cols < 0 || (row_stride != 0 && row_stride < cols)) {
+    std::cout << "[ERROR] Grid2d::SetOccuCellsPtr, bad shape " << rows << " x " << cols << " stride " << row_stride << std::endl;
+    throw std::runtime_error("[ERROR] Grid2d::SetOccuCellsPtr, bad shape");
+  }
+  _occu_grid_ptr = nullptr;
+  _occu_bits_ptr = nullptr;
+  _occu_cells_ptr = cells;
+  _cells_rows = rows;
+  _cells_cols = cols;
+  _cells_stride = (row_stride == 0) ? cols : row_stride;
+  RebuildNeighborTable();
+};
+
 bool Grid2d::IsWithinBorder(long nr, long nc) {
-    if (nr >= _occu_grid_ptr->size() || nr < 0) {return false;}
-    if (nc >= _occu_grid_ptr->at(0).size() || nc < 0) {return false;}
+    if (nr >= _n_rows || nr < 0) {return false;}
+    if (nc >= _n_cols || nc < 0) {return false;}
     return true;
 };
 
@@ -541,6 +916,7 @@ bool Grid2d::SetKNeighbor(int kngh) {
       _act_r = std::vector<long>({ 0, 0,-1, 1, -1,-1, 1, 1});
       _act_c = std::vector<long>({-1, 1, 0, 0, -1, 1,-1, 1});
     }
+    if (_has_occupancy()) {RebuildNeighborTable();}
     return true;
   }
   return false;
@@ -548,21 +924,195 @@ bool Grid2d::SetKNeighbor(int kngh) {
 
 void Grid2d::SetCostScaleFactor(const double in) {
   _cost_scale = in;
+  if (_has_occupancy()) {RebuildNeighborTable();}
+};
+
+void Grid2d::RebuildNeighborTable() {
+  _n_rows = 0;
+  _n_cols = 0;
+  if (_occu_bits_ptr) {
+    _n_rows = _occu_bits_ptr->rows;
+    _n_cols = _occu_bits_ptr->cols;
+  } else if (_occu_cells_ptr) {
+    _n_rows = _cells_rows;
+    _n_cols = _cells_cols;
+  } else if (_occu_grid_ptr && _occu_grid_ptr->size() > 0) {
+    _n_rows = _occu_grid_ptr->size();
+    _n_cols = _occu_grid_ptr->at(0).size();
+  }
+  long n = _n_rows * _n_cols;
+  CheckVidRange(n, "Grid2d");
+  if (_kngh > 8) { throw std::runtime_error( "[ERROR], Grid2d _kngh > 8, not supported!" ); }
+  // row-major obstacle flags first, the order is computed from them.
+  std::vector<bool> blocked(n, false);
+  for (long k = 0; _occu_bits_ptr && k < n; k++) {
+    blocked[k] = _occu_bits_ptr->IsBlocked(k);
+  }
+  for (long r = 0; _occu_cells_ptr && r < _n_rows; r++) {
+    const uint8_t* row = _occu_cells_ptr + r * _cells_stride;
+    for (long c = 0; c < _n_cols; c++) {
+      blocked[r * _n_cols + c] = row[c] != 0;
+    }
+  }
+  for (long r = 0; _occu_grid_ptr && r < _n_rows; r++) {
+    const std::vector<double>& row = (*_occu_grid_ptr)[r];
+    if (long(row.size()) != _n_cols) {
+      std::cout << "[ERROR] Grid2d, row " << r << " has " << row.size() << " cells, expect " << _n_cols << std::endl;
+      throw std::runtime_error("[ERROR] Grid2d, the occupancy grid is not rectangular");
+    }
+    for (long c = 0; c < _n_cols; c++) {
+      blocked[r * _n_cols + c] = row[c] > 0;
+    }
+  }
+  _compute_order(blocked);
+  _tbl.rows = _n_rows;
+  _tbl.cols = _n_cols;
+  _tbl.kngh = _kngh;
+  _obst_bits.assign((n + 63) / 64, 0);
+  for (long v = 0; v < n; v++) {
+    if (blocked[ToExternal(v)]) {_obst_bits[v >> 6] |= (uint64_t(1) << (v & 63));}
+  }
+  _tbl.obst_bits = _obst_bits.data();
+  _nbr_offsets.assign(n + 1, 0);
+  _nbr_targets.clear();
+  _nbr_costs.clear();
+  _nbr_targets.reserve(n * _kngh);
+  _nbr_costs.reserve(n * _kngh);
+  for (long v = 0; v < n; v++) {
+    long k = ToExternal(v);
+    long r = k / _n_cols;
+    long c = k % _n_cols;
+    for (int idx = 0; idx < _kngh; idx++) {
+      long nr = r+_act_r[idx];
+      long nc = c+_act_c[idx];
+      if (! IsWithinBorder(nr, nc)) {continue;}
+      long nk = nr * _n_cols + nc;
+      if (blocked[nk]) {continue;}
+      _nbr_targets.push_back(vid_t(ToInternal(nk)));
+      _nbr_costs.push_back( (idx <= 3 ? 1.0 : 1.4) * _cost_scale );
+    }
+    _nbr_offsets[v+1] = _nbr_targets.size();
+  }
+  _nbr_targets.shrink_to_fit();
+  _nbr_costs.shrink_to_fit();
+  _tbl.offsets = _nbr_offsets.data();
+  _tbl.targets = _nbr_targets.data();
+  _tbl.costs = _nbr_costs.data();
+  _arcs_changed();
+};
+
+void Grid2d::AttachTableView(const GridTableView& view) {
+  _occu_grid_ptr = nullptr;
+  _occu_bits_ptr = nullptr;
+  _occu_cells_ptr = nullptr;
+  if (!SetKNeighbor(view.kngh)) {
+    std::cout << "[ERROR] Grid2d::AttachTableView, unsupported kngh " << view.kngh << std::endl;
+    throw std::runtime_error("[ERROR] Grid2d::AttachTableView, unsupported kngh");
+  }
+  std::vector<uint64_t>().swap(_obst_bits);
+  std::vector<long>().swap(_nbr_offsets);
+  std::vector<vid_t>().swap(_nbr_targets);
+  std::vector<double>().swap(_nbr_costs);
+  std::vector<vid_t>().swap(_to_int);
+  std::vector<vid_t>().swap(_to_ext);
+  _n_rows = view.rows;
+  _n_cols = view.cols;
+  _order = view.order;
+  _tbl = view;
+  _arcs_changed();
+};
+
+void Grid2d::SetVertexOrder(GridOrder order) {
+  _order = order;
+  if (_has_occupancy()) {RebuildNeighborTable();}
+};
+
+namespace {
+// index of cell (x,y) along the Hilbert curve filling a side x side square, side is a power of two.
+uint64_t HilbertIndex(uint64_t side, uint64_t x, uint64_t y) {
+  uint64_t d = 0;
+  for (uint64_t s = side / 2; s > 0; s /= 2) {
+    uint64_t rx = (x & s) > 0;
+    uint64_t ry = (y & s) > 0;
+    d += s * s * ((3 * rx) ^ ry);
+    if (ry == 0) {
+      if (rx == 1) {
+        x = side - 1 - x;
+        y = side - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return d;
+}
+}
+
+void Grid2d::_compute_order(const std::vector<bool>& blocked) {
+  long n = _n_rows * _n_cols;
+  _tbl.order = _order;
+  if (_order == GridOrder::ROW_MAJOR) {
+    std::vector<vid_t>().swap(_to_int);
+    std::vector<vid_t>().swap(_to_ext);
+    _tbl.to_internal = nullptr;
+    _tbl.to_external = nullptr;
+    return;
+  }
+  _to_ext.clear();
+  _to_ext.reserve(n);
+  if (_order == GridOrder::HILBERT) {
+    uint64_t side = 1;
+    while (side < uint64_t(std::max(_n_rows, _n_cols))) {side *= 2;}
+    std::vector<uint64_t> key(n);
+    for (long k = 0; k < n; k++) {
+      _to_ext.push_back(vid_t(k));
+      key[k] = HilbertIndex(side, uint64_t(k % _n_cols), uint64_t(k / _n_cols));
+    }
+    std::sort(_to_ext.begin(), _to_ext.end(), [&key](vid_t a, vid_t b) {return key[a] < key[b];});
+  } else {
+    std::vector<bool> seen(n, false);
+    for (long s = 0; s < n; s++) {
+      if (blocked[s] || seen[s]) {continue;}
+      seen[s] = true;
+      size_t head = _to_ext.size();
+      _to_ext.push_back(vid_t(s));
+      while (head < _to_ext.size()) {
+        long k = long(_to_ext[head++]);
+        for (int idx = 0; idx < _kngh; idx++) {
+          long nr = k / _n_cols + _act_r[idx];
+          long nc = k % _n_cols + _act_c[idx];
+          if (!IsWithinBorder(nr, nc)) {continue;}
+          long nk = nr * _n_cols + nc;
+          if (blocked[nk] || seen[nk]) {continue;}
+          seen[nk] = true;
+          _to_ext.push_back(vid_t(nk));
+        }
+      }
+    }
+    for (long k = 0; k < n; k++) {
+      if (blocked[k]) {_to_ext.push_back(vid_t(k));}
+    }
+  }
+  _to_int.resize(n);
+  for (long v = 0; v < n; v++) {
+    _to_int[_to_ext[v]] = vid_t(v);
+  }
+  _tbl.to_internal = _to_int.data();
+  _tbl.to_external = _to_ext.data();
 };
 
 long Grid2d::_rc2k(const long r, const long c) const 
 {
-  return r * _occu_grid_ptr->at(0).size() + c;
+  return ToInternal(r * _n_cols + c);
 };
 
 long Grid2d::_k2r(const long k) const
 {
-  return long(k / _occu_grid_ptr->at(0).size());
+  return ToExternal(k) / _n_cols;
 };
 
 long Grid2d::_k2c(const long k) const 
 {
-  return k % _occu_grid_ptr->at(0).size();
+  return ToExternal(k) % _n_cols;
 };
 
 /////////////////////////////////////////////////////////////////
@@ -606,7 +1156,7 @@ void HybridGraph2d::DecreaseVertexOccupiedCapacity(long v) {
 }
 
 bool HybridGraph2d::HasVertex(long v) {
-  if (v < 0) {return false;}
+  if (v < 0 || _nid_ends.empty()) {return false;}
   if (v < _nid_ends.back()) {return true;}
   return false;
 };
@@ -614,35 +1164,37 @@ bool HybridGraph2d::HasVertex(long v) {
 bool HybridGraph2d::HasArc(long v, long u) {
   if (!HasVertex(v)) {return false;}
   if (!HasVertex(u)) {return false;}
-  if (_find_subgraph(v) == _find_subgraph(u)) {return true;}
-  for (int i = 0; i < _ig_arc_srcs.size(); i++){
-    if (v == _ig_arc_srcs[i] && u == _ig_arc_tgts[i]){return true;}
+  int idx = _find_subgraph(v);
+  if (idx == _find_subgraph(u)) {
+    int kk = _index_map[idx];
+    PlannerGraph* sub = (kk >= 0) ? static_cast<PlannerGraph*>(_grids[kk]) : _roadmaps[-kk-1];
+    if (sub->HasArc(v - _nid_starts[idx], u - _nid_starts[idx])) {return true;}
+  }
+  auto it = _ig_by_src.find(v);
+  if (it == _ig_by_src.end()) {return false;}
+  for (size_t j : it->second){
+    if (u == _ig_arc_tgts[j]){return true;}
   }
   return false;
 };
 
 std::vector<long> HybridGraph2d::GetSuccs(long v) {
-  // for (int i = 0; i < _nid_starts.size(); i++){
-  //   std::cout << " a, b = " << _nid_starts[i] << ", " << _nid_ends[i] << " ,,, " << _index_map[i] << std::endl;
-  // }
   std::vector<long> out;
   int idx = _find_subgraph(v);
   if (idx < 0) {return out;}
-  long nid = _g2l_nid(v);
+  long nid = v - _nid_starts[idx];
   int kk = _index_map[idx];
-  std::cout << " idx = " << idx << " nid = " << nid << " kk = " << kk << std::endl;
   if (kk >= 0){
     out = _grids[kk]->GetSuccs(nid);
   }else{
-    std::cout << " -kk-1 = " << -kk-1 << std::endl;
     out = _roadmaps[-kk-1]->GetSuccs(nid);
   }
   for (int j = 0; j < out.size(); j++){
     out[j] += _nid_starts[idx];
   }
-  //
-  for (int j = 0; j < _ig_arc_srcs.size(); j++){
-    if (_ig_arc_srcs[j] == v){
+  auto it = _ig_by_src.find(v);
+  if (it != _ig_by_src.end()) {
+    for (size_t j : it->second){
       out.push_back(_ig_arc_tgts[j]);
     }
   }
@@ -653,7 +1205,7 @@ std::vector<long> HybridGraph2d::GetPreds(long v) {
   std::vector<long> out;
   int idx = _find_subgraph(v);
   if (idx < 0) {return out;}
-  long nid = _g2l_nid(v);
+  long nid = v - _nid_starts[idx];
   int kk = _index_map[idx];
   if (kk >= 0){
     out = _grids[kk]->GetPreds(nid);
@@ -663,8 +1215,9 @@ std::vector<long> HybridGraph2d::GetPreds(long v) {
   for (int j = 0; j < out.size(); j++){
     out[j] += _nid_starts[idx];
   }
-  for (int j = 0; j < _ig_arc_tgts.size(); j++){
-    if (_ig_arc_tgts[j] == v){
+  auto it = _ig_by_tgt.find(v);
+  if (it != _ig_by_tgt.end()) {
+    for (size_t j : it->second){
       out.push_back(_ig_arc_srcs[j]);
     }
   }
@@ -677,9 +1230,8 @@ CostVec HybridGraph2d::GetCost(long u, long v) {
   int idy = _find_subgraph(v);
   if (idx < 0 || idy < 0) {return out;}
   if (idx == idy){
-    long uu = _g2l_nid(u);
-    long vv = _g2l_nid(v);
-    // std::cout << " uu = " << uu << ", vv = " << vv << std::endl;
+    long uu = u - _nid_starts[idx];
+    long vv = v - _nid_starts[idx];
     int kk = _index_map[idx];
     if (kk >= 0){
       return _grids[kk]->GetCost(uu,vv);
@@ -687,10 +1239,10 @@ CostVec HybridGraph2d::GetCost(long u, long v) {
       return _roadmaps[-kk-1]->GetCost(uu,vv);
     }
   }
-  for (int j = 0; j < _ig_arc_srcs.size(); j++){
-    // std::cout << " _ig_arc = " << _ig_arc_srcs[j] << ", " << _ig_arc_tgts[j] << std::endl;
-    // std::cout << " u = " << u << ", v = " << v << std::endl;
-    if (_ig_arc_srcs[j] == u && _ig_arc_tgts[j] == v){
+  auto it = _ig_by_src.find(u);
+  if (it == _ig_by_src.end()) {return out;}
+  for (size_t j : it->second){
+    if (_ig_arc_tgts[j] == v){
       return _ig_costs[j];
     }
   }
@@ -701,15 +1253,16 @@ std::vector< CostVec > HybridGraph2d::GetSuccCosts(long u) {
   std::vector< CostVec > out;
   int idx = _find_subgraph(u);
   if (idx < 0) {return out;}
-  long nid = _g2l_nid(u);
+  long nid = u - _nid_starts[idx];
   int kk = _index_map[idx];
   if (kk >= 0){
     out = _grids[kk]->GetSuccCosts(nid);
   }else{
     out = _roadmaps[-kk-1]->GetSuccCosts(nid);
   }
-  for (int j = 0; j < _ig_arc_srcs.size(); j++){
-    if (_ig_arc_srcs[j] == u){
+  auto it = _ig_by_src.find(u);
+  if (it != _ig_by_src.end()) {
+    for (size_t j : it->second){
       out.push_back(_ig_costs[j]);
     }
   }
@@ -720,15 +1273,16 @@ std::vector< CostVec > HybridGraph2d::GetPredCosts(long u) {
   std::vector< CostVec > out;
   int idx = _find_subgraph(u);
   if (idx < 0) {return out;}
-  long nid = _g2l_nid(u);
+  long nid = u - _nid_starts[idx];
   int kk = _index_map[idx];
   if (kk >= 0){
     out = _grids[kk]->GetPredCosts(nid);
   }else{
     out = _roadmaps[-kk-1]->GetPredCosts(nid);
   }
-  for (int j = 0; j < _ig_arc_tgts.size(); j++){
-    if (_ig_arc_tgts[j] == u){
+  auto it = _ig_by_tgt.find(u);
+  if (it != _ig_by_tgt.end()) {
+    for (size_t j : it->second){
       out.push_back(_ig_costs[j]);
     }
   }
@@ -785,7 +1339,94 @@ std::vector<long> HybridGraph2d::AllVertex() {
   return out;
 };
 
+size_t HybridGraph2d::MemoryBytes() {
+  size_t out = sizeof(HybridGraph2d);
+  for (auto p : _grids){ out += p->MemoryBytes(); }
+  for (auto p : _roadmaps){ out += p->MemoryBytes(); }
+  out += (_ig_arc_srcs.capacity() + _ig_arc_tgts.capacity()) * sizeof(long);
+  for (auto& c : _ig_costs){ out += sizeof(CostVec) + c.capacity() * sizeof(double); }
+  out += (_nid_starts.capacity() + _nid_ends.capacity()) * sizeof(long) + _index_map.capacity() * sizeof(int);
+  for (auto* index : {&_ig_by_src, &_ig_by_tgt}) {
+    out += index->bucket_count() * sizeof(void*);
+    for (auto& kv : *index) {out += sizeof(kv) + 2 * sizeof(void*) + kv.second.capacity() * sizeof(size_t);}
+  }
+  out += (_vertex_max_capacities.capacity() + _vertex_occupied_capacities.capacity()) * sizeof(long);
+  for (auto* f : {&_arc_index.succ, &_arc_index.pred}) {
+    out += f->offsets.capacity() * sizeof(long) + f->ids.capacity() * sizeof(vid_t) + f->costs.capacity() * sizeof(double);
+  }
+  return out;
+};
+
+ArcSpan HybridGraph2d::GetSuccArcs(long v) {
+  if (!HasVertex(v)) {return ArcSpan();}
+  return _flat_span(_get_arc_index().succ, v);
+};
+
+ArcSpan HybridGraph2d::GetPredArcs(long v) {
+  if (!HasVertex(v)) {return ArcSpan();}
+  return _flat_span(_get_arc_index().pred, v);
+};
+
+size_t HybridGraph2d::OutDegree(long v) {
+  return GetSuccArcs(v).size;
+};
+
+void HybridGraph2d::RebuildArcIndex() {
+  _get_arc_index();
+};
+
+uint64_t HybridGraph2d::_arc_stamp() const {
+  uint64_t out = _arc_version;
+  for (auto* g : _grids) {out += g->ArcVersion();}
+  for (auto* g : _roadmaps) {out += g->ArcVersion();}
+  return out;
+};
+
+void HybridGraph2d::_build_arc_index(_FlatArcs* succ, _FlatArcs* pred) {
+  size_t nV = NumVertex();
+  size_t cdim = CostDim();
+  CheckVidRange(long(nV), "HybridGraph2d::RebuildArcIndex");
+  for (auto& c : _ig_costs) {
+    if (c.size() != cdim) {
+      std::cout << "[ERROR] HybridGraph2d::RebuildArcIndex, extra edge cost dim " << c.size() << " != " << cdim << std::endl;
+      throw std::runtime_error("[ERROR] HybridGraph2d::RebuildArcIndex, extra edge cost dim does not match");
+    }
+  }
+  for (int dir = 0; dir < 2; dir++) {
+    _FlatArcs& f = (dir == 0) ? *succ : *pred;
+    const std::vector<long>& ig_from = (dir == 0) ? _ig_arc_srcs : _ig_arc_tgts;
+    const std::vector<long>& ig_to = (dir == 0) ? _ig_arc_tgts : _ig_arc_srcs;
+    // group the inter-graph arcs by their first vertex.
+    std::vector<size_t> ig_order(ig_from.size());
+    for (size_t j = 0; j < ig_order.size(); j++) {ig_order[j] = j;}
+    std::stable_sort(ig_order.begin(), ig_order.end(),
+      [&](size_t a, size_t b) {return ig_from[a] < ig_from[b];});
+    size_t k = 0;
+    f.offsets.assign(nV + 1, 0);
+    f.ids.clear();
+    f.costs.clear();
+    for (size_t idx = 0; idx < _nid_starts.size(); idx++) {
+      int kk = _index_map[idx];
+      PlannerGraph* sub = (kk >= 0) ? static_cast<PlannerGraph*>(_grids[kk]) : _roadmaps[-kk-1];
+      for (long v = _nid_starts[idx]; v < _nid_ends[idx]; v++) {
+        ArcSpan arcs = (dir == 0) ? sub->GetSuccArcs(v - _nid_starts[idx]) : sub->GetPredArcs(v - _nid_starts[idx]);
+        for (size_t j = 0; j < arcs.size; j++) {
+          f.ids.push_back(vid_t(arcs.ids[j] + _nid_starts[idx]));
+          for (size_t d = 0; d < cdim; d++) {f.costs.push_back(arcs.Cost(j, d));}
+        }
+        while (k < ig_order.size() && ig_from[ig_order[k]] < v) {k++;} // arcs from non-existing vertices.
+        for (; k < ig_order.size() && ig_from[ig_order[k]] == v; k++) {
+          f.ids.push_back(vid_t(ig_to[ig_order[k]]));
+          f.costs.insert(f.costs.end(), _ig_costs[ig_order[k]].begin(), _ig_costs[ig_order[k]].end());
+        }
+        f.offsets[v+1] = f.ids.size();
+      }
+    }
+  }
+};
+
 void HybridGraph2d::AddGrid2d(Grid2d* g) {
+  _arcs_changed();
   _grids.push_back(g);
   if (_nid_starts.size() == 0) {
     _nid_starts.push_back(0);
@@ -800,6 +1441,7 @@ void HybridGraph2d::AddGrid2d(Grid2d* g) {
 };
 
 void HybridGraph2d::AddSparseGraph(SparseGraph* g) {
+  _arcs_changed();
   _roadmaps.push_back(g);
   if (_nid_starts.size() == 0) {
     _nid_starts.push_back(0);
@@ -814,6 +1456,9 @@ void HybridGraph2d::AddSparseGraph(SparseGraph* g) {
 };
 
 void HybridGraph2d::AddExtraEdge(long u, long v, CostVec c) {
+  _arcs_changed();
+  _ig_by_src[u].push_back(_ig_arc_srcs.size());
+  _ig_by_tgt[v].push_back(_ig_arc_tgts.size());
   _ig_arc_srcs.push_back(u);
   _ig_arc_tgts.push_back(v);
   _ig_costs.push_back(c);
@@ -821,23 +1466,37 @@ void HybridGraph2d::AddExtraEdge(long u, long v, CostVec c) {
 };
 
 int HybridGraph2d::_find_subgraph(long v) {
-  for (int i = 0; i < _nid_ends.size(); i++){
-    if (v >= _nid_starts[i] && v < _nid_ends[i]){
-      return i;
-    }
-  }
-  return -1;
+  // _nid_starts is increasing, find the last sub-graph that starts at or before v.
+  auto it = std::upper_bound(_nid_starts.begin(), _nid_starts.end(), v);
+  if (it == _nid_starts.begin()) {return -1;}
+  int i = int(it - _nid_starts.begin()) - 1;
+  if (v >= _nid_ends[i]) {return -1;}
+  return i;
 };
 
 long HybridGraph2d::_g2l_nid(long v) {
-  for (int i = 0; i < _nid_ends.size(); i++){
-    if (v >= _nid_starts[i] && v < _nid_ends[i]){
-      return v - _nid_starts[i];
+  int i = _find_subgraph(v);
+  if (i < 0) {return -1;}
+  return v - _nid_starts[i];
+};
+
+
+void ComputeComponents(PlannerGraph* g, std::vector<long>* label) {
+  long n = long(g->NumVertex());
+  Grid2d* grid = dynamic_cast<Grid2d*>(g);
+  UnionFind uf(n);
+  for (long v = 0; v < n; v++) {
+    if (grid && grid->IsObstacle(v)) {continue;} // the neighbor table also lists the free neighbors of obstacles.
+    ArcSpan arcs = g->GetSuccArcs(v);
+    for (size_t j = 0; j < arcs.size; j++) {
+      uf.Union(v, long(arcs.ids[j]));
     }
   }
-  return -1;
+  label->resize(n);
+  for (long v = 0; v < n; v++) {
+    (*label)[v] = (grid && grid->IsObstacle(v)) ? -1 : uf.Find(v);
+  }
 };
 
-
 } // end namespace zr
 
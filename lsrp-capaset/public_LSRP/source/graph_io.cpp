@@ -1,73 +1,179 @@
 
 
 #include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <sstream>
 #include <fstream>
 
-#include "graph.hpp"
+#include "graph_io.hpp"
+#include "mapped_file.hpp"
+#include "parallel_for.hpp"
+#include "text_scan.hpp"
 #include "vec_type.hpp"
 
 namespace raplab{
 
-int LoadSparseGraphDIMAC(std::vector<std::string> edge_cost_fnames, SparseGraph* out) {
+namespace {
+
+// a piece of a mapped file made of whole lines, parsed by one worker.
+struct DimacsChunk
+{
+  const char* b = nullptr;
+  const char* e = nullptr;
+  size_t n_arcs = 0; // "a" lines of the chunk,
+  size_t first = 0; // and the index of its first arc in the file.
+  std::string err; // the first bad line, if any.
+};
+
+// about n chunks of at least 1 MiB, each ends after a newline (or at the end of the file).
+std::vector<DimacsChunk> SplitLines(const char* data, size_t size, size_t n) {
+  const size_t kMinChunk = size_t(1) << 20;
+  n = std::max(size_t(1), std::min(n, size / kMinChunk + 1));
+  std::vector<DimacsChunk> out;
+  const char* end = data + size;
+  const char* p = data;
+  for (size_t i = 1; i <= n && p < end; i++) {
+    const char* q = (i == n) ? end : data + size / n * i;
+    if (q < p) {q = p;}
+    if (q < end) {
+      const char* nl = static_cast<const char*>(std::memchr(q, '\n', size_t(end - q)));
+      q = nl ? nl + 1 : end;
+    }
+    DimacsChunk c;
+    c.b = p;
+    c.e = q;
+    out.push_back(c);
+    p = q;
+  }
+  return out;
+}
+
+bool IsArcLine(const char* b, const char* e) {
+  return b < e && b[0] == 'a' && (b + 1 == e || IsSpace(b[1]));
+}
+
+// v is a vertex id that fits in the adjacency arrays.
+bool IsVid(long v) {
+  return v >= 0 && uint64_t(v) <= uint64_t(std::numeric_limits<vid_t>::max());
+}
+
+}
+
+int LoadSparseGraphDIMAC(const std::vector<std::string>& edge_cost_fnames, SparseGraph* out, int n_threads) {
 
 	std::cout << "[INFO] LoadSparseGraphDIMAC starts " << std::endl;
-	for (int i = 0; i < edge_cost_fnames.size(); i++) {
+	for (size_t i = 0; i < edge_cost_fnames.size(); i++) {
 		std::cout << "[INFO] --- cost_fname " << i << ": " << edge_cost_fnames[i] << std::endl;
 	}
-
-	std::ifstream f_costs[100]; // todo: not very elegant, exceeding 100?
-	for (int i = 0; i < edge_cost_fnames.size(); i++) {
-		f_costs[i].open(edge_cost_fnames[i]);
-		if (!f_costs[i]) {
-			std::cerr << "[Error] file '" << edge_cost_fnames[i] << "' could not be opened" << std::endl;
+	size_t cost_dim = edge_cost_fnames.size();
+	if (cost_dim == 0) {
+		std::cerr << "[Error] LoadSparseGraphDIMAC, no cost file" << std::endl;
+		return -1;
+	}
+	n_threads = NumWorkers(n_threads);
+
+	// the files are read one after the other, each in parallel chunks: the first pass counts the arcs of
+	// every chunk, the second parses them into their final place. The first file gives the arcs, every
+	// file the cost of the same dimension, line for line.
+	std::vector<vid_t> sources;
+	std::vector<vid_t> targets;
+	std::vector<double> costs;
+	size_t m = 0;
+	for (size_t k = 0; k < cost_dim; k++) {
+		const std::string& fname = edge_cost_fnames[k];
+		MappedFile file;
+		if (file.Open(fname) != 1) {
 			return -1;
 		}
-	}
-
-	int cost_dim = edge_cost_fnames.size();
-
-	std::string line;
-	int num_nodes = -1;
-	int num_edges = -1;
-	while (std::getline(f_costs[0], line)) {
-		std::vector<std::string> lines;
-		lines.push_back(line);
-		for (int i = 1; i < edge_cost_fnames.size(); i++) {
-			std::getline(f_costs[i], line);
-			lines.push_back(line);
+		std::vector<DimacsChunk> chunks = SplitLines(file.Data(), file.Size(), size_t(n_threads) * 8);
+		ParallelFor(chunks.size(), n_threads, [&chunks](size_t i) {
+			LineReader in(chunks[i].b, chunks[i].e);
+			const char* b;
+			const char* e;
+			while (in.Next(&b, &e)) {
+				if (IsArcLine(b, e)) {chunks[i].n_arcs++;}
+			}
+		});
+		size_t n_arcs = 0;
+		for (auto& c : chunks) {
+			c.first = n_arcs;
+			n_arcs += c.n_arcs;
 		}
-		line = lines[0];
-		if (line[0] == 'p') {
-			int index = line.find_first_of(" ", 5);
-			num_nodes = stoi(line.substr(5, index));
-			num_edges = stoi(line.substr(index + 1));
-			std::cout << "[INFO] num_nodes: " << num_nodes << std::endl;
-			std::cout << "[INFO] num_edges: " << num_edges << std::endl;
-			// out->Init(num_nodes, cost_dim);
-		} else if (line[0] == 'a') {
-			// find u, v
-			int index1 = line.find_first_of(" ", 2);
-			int index2 = line.find_first_of(" ", index1 + 1);
-			long u = stol(line.substr(2, index1));
-			long v = stol(line.substr(index1 + 1, index2));
-			// find costs
-			auto cv = InitVecType(cost_dim, 0.0);
-			// CostVector cv = CostVector(0, cost_dim);
-			for (int i = 0; i < edge_cost_fnames.size(); i++) {
-				cv[i] = stod(lines[i].substr(lines[i].find_last_of(" ") + 1));
-				if (cv[i] < 0) {
-					throw std::runtime_error("[ERROR] LoadSparseGraphDIMAC, input graph has negative cost !?");
+		if (k == 0) {
+			// the problem line is at the top, it is only reported.
+			LineReader in(file.Data(), file.Data() + file.Size());
+			const char* b;
+			const char* e;
+			const char* tb;
+			const char* te;
+			long num_nodes;
+			long num_edges;
+			while (in.Next(&b, &e) && !IsArcLine(b, e)) {
+				if (NextToken(&b, e, &tb, &te) && TokenIs(tb, te, "p") && NextToken(&b, e, &tb, &te) &&
+				    NextLong(&b, e, &num_nodes) && NextLong(&b, e, &num_edges)) {
+					std::cout << "[INFO] num_nodes: " << num_nodes << std::endl;
+					std::cout << "[INFO] num_edges: " << num_edges << std::endl;
+					if (size_t(num_edges) != n_arcs) {
+						std::cout << "[CAVEAT] LoadSparseGraphDIMAC, '" << fname << "' has " << n_arcs << " arcs, the problem line says " << num_edges << std::endl;
+					}
 				}
 			}
-
-			out->AddArc(u, v, cv);
+			m = n_arcs;
+			sources.resize(m);
+			targets.resize(m);
+			costs.resize(m * cost_dim);
+		} else if (n_arcs != m) {
+			std::cerr << "[Error] LoadSparseGraphDIMAC, '" << fname << "' has " << n_arcs << " arcs, '"
+			          << edge_cost_fnames[0] << "' has " << m << std::endl;
+			return -1;
+		}
+		std::atomic<bool> negative(false);
+		ParallelFor(chunks.size(), n_threads, [&, k](size_t i) {
+			DimacsChunk& c = chunks[i];
+			LineReader in(c.b, c.e);
+			const char* b;
+			const char* e;
+			size_t a = c.first;
+			while (in.Next(&b, &e)) {
+				if (!IsArcLine(b, e)) {continue;}
+				const char* p = b + 1;
+				long u;
+				long v;
+				double w;
+				if (!NextLong(&p, e, &u) || !NextLong(&p, e, &v) || !NextDouble(&p, e, &w) || !IsVid(u) || !IsVid(v) ||
+				    (k > 0 && (vid_t(u) != sources[a] || vid_t(v) != targets[a]))) {
+					c.err.assign(b, e);
+					return;
+				}
+				if (w < 0) {negative = true;}
+				if (k == 0) {
+					sources[a] = vid_t(u);
+					targets[a] = vid_t(v);
+				}
+				costs[a * cost_dim + k] = w;
+				a++;
+			}
+		});
+		for (const auto& c : chunks) {
+			if (!c.err.empty()) {
+				std::cerr << "[Error] LoadSparseGraphDIMAC, '" << fname << "' has a bad arc line '" << c.err << "'"
+				          << (k > 0 ? ", or an arc that is not the one of the same line of the first file" : "") << std::endl;
+				return -1;
+			}
+		}
+		if (negative) {
+			throw std::runtime_error("[ERROR] LoadSparseGraphDIMAC, input graph has negative cost !?");
 		}
 	}
-	
+	// parallel arcs of a file replace each other, as AddArc did.
+	out->CreateFrozenFromIds(sources, targets, costs, cost_dim, true);
+
 	std::cout << "[INFO] LoadSparseGraphDIMAC ends " << std::endl;
 
 	return 1; // true, succeed.
@@ -137,96 +243,151 @@ int LoadCoordDIMAC(std::string coord_file, std::vector< std::vector<double> >* o
 };
 
 
+int ParseMap_MovingAI(const std::string& fname, OccupancyBitmap* out) {
+  MappedFile file;
+  if (file.Open(fname) != 1) {
+    return -1;
+  }
+  LineReader in(file.Data(), file.Data() + file.Size());
+  const char* b;
+  const char* e;
+  long height = -1;
+  long width = -1;
+  bool body = false;
+  while (!body && in.Next(&b, &e)) {
+    const char* tb;
+    const char* te;
+    if (!NextToken(&b, e, &tb, &te)) {continue;}
+    if (TokenIs(tb, te, "map")) {
+      body = true;
+    } else if (TokenIs(tb, te, "height") && !NextLong(&b, e, &height)) {
+      height = -1;
+    } else if (TokenIs(tb, te, "width") && !NextLong(&b, e, &width)) {
+      width = -1;
+    }
+  }
+  if (!body || height <= 0 || width <= 0) {
+    std::cerr << "[Error] ParseMap_MovingAI, '" << fname << "' has no valid height, width and map header" << std::endl;
+    return -1;
+  }
+  if (height > long(file.Size()) || width > long(file.Size()) || height * width > long(file.Size())) {
+    std::cerr << "[Error] ParseMap_MovingAI, '" << fname << "' is too short for " << height << " x " << width << " cells" << std::endl;
+    return -1;
+  }
+  out->Resize(height, width);
+  for (long r = 0; r < height; r++) {
+    if (!in.Next(&b, &e)) {
+      std::cerr << "[Error] ParseMap_MovingAI, '" << fname << "' has " << r << " rows, expect " << height << std::endl;
+      return -1;
+    }
+    if (e - b != width) {
+      std::cerr << "[Error] ParseMap_MovingAI, '" << fname << "' row " << r << " has " << (e - b)
+                << " cells, expect " << width << std::endl;
+      return -1;
+    }
+    long k = r * width;
+    for (const char* q = b; q < e; q++, k++) {
+      if (*q != '.' && *q != 'G') {out->SetBlocked(k);}
+    }
+  }
+  while (in.Next(&b, &e)) {
+    if (SkipSpaces(b, e) != e) {
+      std::cerr << "[Error] ParseMap_MovingAI, '" << fname << "' has more than " << height << " rows" << std::endl;
+      return -1;
+    }
+  }
+  return 1;
+};
+
 int LoadMap_MovingAI(
     std::string map_file_path, std::vector<std::vector<double> >* output)
 {
     // read the .map file and return a corresponding an occupancy grid via the output pointer.
     // the output grid should map the file in terms of rows and columns.
     // output[row][col]=1 if that place is an obstacle and output[row][col]=0 if that place is free.
-
-    std::ifstream ifs;
-    ifs.open(map_file_path);
-    if (!ifs.is_open()) {
-        std::cout << "Fail to open" << map_file_path << std::endl;
-        return 0;
+    OccupancyBitmap bits;
+    if (ParseMap_MovingAI(map_file_path, &bits) != 1) {
+        return -1;
     }
-    
-    std::vector<std::vector<double>> grid;
-    std::string line;
-    bool read = false;
-    
-    while (std::getline(ifs,line)) {
-        //判断是不是开始阅读地图信息
-        if (line.find_first_of(".@TG")!=std::string::npos) {
-            read = true;
-        }
-        //开始读写
-        if (read) {
-            std::vector<double> ROW;
-            for (char pixel : line) {
-                if (pixel == '.'||pixel=='G') {
-                    ROW.push_back(0);
-                }
-                else  {
-                    ROW.push_back(1);
-                }
-            }
-            grid.push_back(ROW);
+    output->assign(bits.rows, std::vector<double>(bits.cols, 0));
+    for (long r = 0; r < bits.rows; r++) {
+        for (long c = 0; c < bits.cols; c++) {
+            if (bits.IsBlocked(r * bits.cols + c)) {(*output)[r][c] = 1;}
         }
     }
-    *output = grid;
-
-    ifs.close();
-
-
     return 1;
 };
 
+int ParseScenarios_MovingAI(const std::string& fname, const ScenarioSelection& sel,
+                            std::vector<long>* starts, std::vector<long>* goals, std::tuple<int,int>* width_height) {
+  MappedFile file;
+  if (file.Open(fname) != 1) {
+    return -1;
+  }
+  const char* data = file.Data();
+  const char* end = data + file.Size();
+  // one entry per line, reserve for the smaller of the line count and the selection.
+  size_t n_lines = 0;
+  for (const char* q = data; q < end; q++) {
+    q = static_cast<const char*>(std::memchr(q, '\n', size_t(end - q)));
+    if (!q) {break;}
+    n_lines++;
+  }
+  size_t n_reserve = (sel.count >= 0 && size_t(sel.count) < n_lines) ? size_t(sel.count) : n_lines + 1;
+  starts->reserve(starts->size() + n_reserve);
+  goals->reserve(goals->size() + n_reserve);
+
+  LineReader in(data, end);
+  const char* b;
+  const char* e;
+  const char* tb;
+  const char* te;
+  if (!in.Next(&b, &e) || !NextToken(&b, e, &tb, &te) || !TokenIs(tb, te, "version")) {
+    std::cerr << "[Error] ParseScenarios_MovingAI, '" << fname << "' does not start with a version line" << std::endl;
+    return -1;
+  }
+  long width = sel.width;
+  long height = sel.height;
+  long n_selected = 0;
+  long n_taken = 0;
+  while ((sel.count < 0 || n_taken < sel.count) && in.Next(&b, &e)) {
+    if (SkipSpaces(b, e) == e) {continue;}
+    long f[7]; // bucket, width, height, start x, start y, goal x, goal y
+    bool ok = NextLong(&b, e, &f[0]) && NextToken(&b, e, &tb, &te); // the map name is not checked.
+    for (int i = 1; ok && i < 7; i++) {
+      ok = NextLong(&b, e, &f[i]);
+    }
+    if (!ok) {
+      std::cerr << "[Error] ParseScenarios_MovingAI, '" << fname << "' line " << in.n_lines << " is not a scenario entry" << std::endl;
+      return -1;
+    }
+    if (width <= 0 || height <= 0) {
+      width = f[1];
+      height = f[2];
+    }
+    if (f[1] != width || f[2] != height) {
+      std::cerr << "[Error] ParseScenarios_MovingAI, '" << fname << "' line " << in.n_lines << " refers to a "
+                << f[1] << " x " << f[2] << " map, expect " << width << " x " << height << std::endl;
+      return -1;
+    }
+    if (f[3] >= width || f[5] >= width || f[4] >= height || f[6] >= height) {
+      std::cerr << "[Error] ParseScenarios_MovingAI, '" << fname << "' line " << in.n_lines << " has a cell outside the map" << std::endl;
+      return -1;
+    }
+    if (f[0] < sel.bucket_min || f[0] > sel.bucket_max || n_selected++ < sel.skip) {continue;}
+    // in long, width*height can exceed int on large maps.
+    starts->push_back(f[4] * width + f[3]);
+    goals->push_back(f[6] * width + f[5]);
+    n_taken++;
+  }
+  *width_height = std::make_tuple(int(width), int(height));
+  return 1;
+};
 
     int LoadScenarios(std::string filePath, int n, std::vector<long>* starts, std::vector<long>* goals, std::tuple<int,int>* width_height) {
-        std::ifstream infile(filePath);
-        std::string line;
-        int lineCount = 0;
-        bool firstLine = true;
-
-
-        if (!infile.is_open()) {
-            std::cerr << "Failed to open file: " << filePath << std::endl;
-            return -1;
-        }
-
-        while (std::getline(infile, line) && lineCount < n) {
-            if (firstLine) {
-                firstLine = false; // Skip the version line
-                continue;
-            }
-
-            std::istringstream iss(line);
-            int bucket, mapWidth, mapHeight, startX, startY, goalX, goalY;
-            std::string mapFile;
-            double optimalLength;
-
-            if (!(iss >> bucket >> mapFile >> mapWidth >> mapHeight >> startX >> startY >> goalX >> goalY >> optimalLength)) {
-                std::cerr << "Failed to parse line: " << line << std::endl;
-                break;
-            }
-
-            // Convert (x, y) to node ID
-            long startID = startY * mapWidth + startX;
-            long goalID = goalY * mapWidth + goalX;
-
-            starts->push_back(startID);
-            goals->push_back(goalID);
-
-        	// Set width and height in the tuple
-        	if (lineCount == 0) {
-        		*width_height = std::make_tuple(mapWidth, mapHeight);
-        	}
-
-            lineCount++;
-        }
-
-        return 1;
+        ScenarioSelection sel;
+        sel.count = n;
+        return ParseScenarios_MovingAI(filePath, sel, starts, goals, width_height);
     }
 
 	int LoadNodeCapacities(std::string capacity_file, std::unordered_map<long, int>* node_capacities) {
@@ -246,4 +407,23 @@ int LoadMap_MovingAI(
 		fin.close();
 		return 1;
 	}
+
+int ParseAgentDurations(const std::string& fname, std::vector<double>* durations) {
+  MappedFile file;
+  if (file.Open(fname) != 1) {
+    return -1;
+  }
+  LineReader in(file.Data(), file.Data() + file.Size());
+  const char* b;
+  const char* e;
+  const char* tb;
+  const char* te;
+  double v;
+  while (in.Next(&b, &e)) {
+    if (NextToken(&b, e, &tb, &te) && NextDouble(&b, e, &v)) {
+      durations->push_back(v);
+    }
+  }
+  return 1;
+};
 } // end namespace raplab
@@ -0,0 +1,378 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#include "heuristic_store.hpp"
+#include "decision_log.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RAPLAB_HAS_FLOCK 1
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace raplab{
+
+namespace {
+const uint64_t kAlign = 64;
+
+uint64_t AlignUp(uint64_t off) {
+  return (off + kAlign - 1) / kAlign * kAlign;
+}
+
+uint64_t TableSum(const uint32_t* table, size_t n) {
+  return DigestBytes(table, n * sizeof(uint32_t));
+}
+
+// digest of the header (with meta_sum 0), the index and the checksums.
+uint64_t MetaSum(HeuristicStoreHeader h, const HopTableEntry* index, const uint64_t* sums) {
+  h.meta_sum = 0;
+  uint64_t s = DigestBytes(&h, sizeof(h));
+  s = DigestBytes(index, h.n_tables * sizeof(HopTableEntry), s);
+  return DigestBytes(sums, h.n_tables * sizeof(uint64_t), s);
+}
+
+bool FileExists(const std::string& fname) {
+  std::ifstream probe(fname);
+  return probe.good();
+}
+
+// exclusive lock of a store between processes, held until destruction.
+class StoreLock
+{
+public:
+  explicit StoreLock(const std::string& fname) {
+#ifdef RAPLAB_HAS_FLOCK
+    _fd = ::open((fname + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+    if (_fd >= 0 && ::flock(_fd, LOCK_EX) != 0) {
+      ::close(_fd);
+      _fd = -1;
+    }
+#else
+    _fd = 0; // no lock between processes on this platform.
+#endif
+  };
+  ~StoreLock() {
+#ifdef RAPLAB_HAS_FLOCK
+    if (_fd >= 0) {::close(_fd);} // releases the lock.
+#endif
+  };
+  bool Ok() const {return _fd >= 0;};
+
+private:
+  int _fd = -1;
+};
+
+// a new, uniquely named file next to fname, opened for writing.
+std::FILE* CreateTemp(const std::string& fname, std::string* tmp) {
+#ifdef RAPLAB_HAS_FLOCK
+  std::vector<char> name(fname.begin(), fname.end());
+  const char suffix[] = ".tmp.XXXXXX";
+  name.insert(name.end(), suffix, suffix + sizeof(suffix));
+  int fd = ::mkstemp(name.data());
+  if (fd < 0) {return nullptr;}
+  ::fchmod(fd, 0644);
+  *tmp = name.data();
+  return ::fdopen(fd, "wb");
+#else
+  *tmp = fname + ".tmp";
+  return std::fopen(tmp->c_str(), "wb");
+#endif
+}
+}
+
+HeuristicStore::HeuristicStore() : _file(std::make_shared<MappedFile>()) {};
+
+HeuristicStore::~HeuristicStore() {
+  Close();
+};
+
+int HeuristicStore::Open(const std::string& fname, const GridTableView& view) {
+  Close();
+  if (view.offsets == nullptr) {
+    std::cout << "[ERROR] HeuristicStore::Open, the grid has no neighbor table" << std::endl;
+    return -1;
+  }
+  _fname = fname;
+  _view = view;
+  _hash = GridContentHash(view);
+  _n_hits = 0;
+  _n_misses = 0;
+  if (FileExists(fname) && !_map_file()) {
+    std::cout << "[CAVEAT] HeuristicStore, '" << fname << "' does not match the map, it will be rebuilt." << std::endl;
+  }
+  return 1;
+};
+
+bool HeuristicStore::_open_store_file(const std::string& fname, MappedFile* file, HeuristicStoreHeader* h) const {
+  *h = HeuristicStoreHeader();
+  if (file->Open(fname) != 1) {return false;}
+  HeuristicStoreHeader ref;
+  HeuristicStoreHeader fh;
+  uint64_t n = uint64_t(_view.rows * _view.cols);
+  uint64_t fs = file->Size();
+  bool ok = fs >= sizeof(HeuristicStoreHeader);
+  if (ok) {
+    std::memcpy(&fh, file->Data(), sizeof(HeuristicStoreHeader));
+    // the sizes are bounded by the file before they are multiplied.
+    ok = std::memcmp(fh.magic, ref.magic, sizeof(ref.magic)) == 0 && fh.version == ref.version &&
+      fh.endian == ref.endian && fh.content_hash == _hash && uint64_t(fh.n_vertex) == n &&
+      fh.file_size == fs && fh.n_tables <= fs && fh.off_index <= fs && fh.off_sums <= fs && fh.off_hops <= fs &&
+      fh.off_index >= sizeof(HeuristicStoreHeader) &&
+      fh.off_index + fh.n_tables * sizeof(HopTableEntry) <= fh.off_sums &&
+      fh.off_sums + fh.n_tables * sizeof(uint64_t) <= fh.off_hops &&
+      fh.off_index % kAlign == 0 && fh.off_sums % kAlign == 0 && fh.off_hops % kAlign == 0 &&
+      (n == 0 || fh.n_tables <= (fs - fh.off_hops) / (n * sizeof(uint32_t)));
+    ok = ok && MetaSum(fh, reinterpret_cast<const HopTableEntry*>(file->Data() + fh.off_index),
+                       reinterpret_cast<const uint64_t*>(file->Data() + fh.off_sums)) == fh.meta_sum;
+  }
+  if (!ok) {
+    file->Close();
+    return false;
+  }
+  *h = fh;
+  return true;
+};
+
+void HeuristicStore::_release_file() {
+  _file = std::make_shared<MappedFile>();
+  _h = HeuristicStoreHeader();
+  _checked.clear();
+};
+
+bool HeuristicStore::_map_file() {
+  _release_file();
+  bool ok = _open_store_file(_fname, _file.get(), &_h);
+  _checked.assign(size_t(_h.n_tables), 0);
+  return ok;
+};
+
+long HeuristicStore::_find_mapped(long goal) {
+  if (_h.n_tables == 0) {return -1;}
+  const HopTableEntry* first = _index();
+  const HopTableEntry* last = first + _h.n_tables;
+  const HopTableEntry* it = std::lower_bound(first, last, goal,
+    [](const HopTableEntry& e, long g) {return e.goal < g;});
+  if (it == last || it->goal != goal) {return -1;}
+  size_t i = size_t(it - first);
+  if (_checked[i] == 0) {
+    _checked[i] = (TableSum(_hops(i), size_t(_h.n_vertex)) == _sums()[i] &&
+                   IsValidHopTable(_hops(i), size_t(_h.n_vertex), goal, it->max_hop)) ? 1 : 2;
+    if (_checked[i] == 2) {
+      std::cout << "[CAVEAT] HeuristicStore, the table of goal " << goal << " in '" << _fname
+                << "' is corrupted, it is computed again." << std::endl;
+    }
+  }
+  return (_checked[i] == 1) ? long(i) : -1;
+};
+
+HopTable HeuristicStore::_lookup(long goal, HopTablePin* pin) {
+  HopTable out;
+  if (_view.offsets == nullptr || goal < 0 || goal >= _view.rows * _view.cols) {return out;}
+  long i = _find_mapped(goal);
+  if (i >= 0) {
+    out.hops = _hops(size_t(i));
+    out.max_hop = _index()[i].max_hop;
+    if (pin) {*pin = _file;}
+    return out;
+  }
+  auto it = _new_tables.find(goal);
+  if (it == _new_tables.end()) {return out;}
+  _lru.splice(_lru.begin(), _lru, _lru_pos[goal]);
+  out.hops = it->second->data();
+  out.max_hop = _new_entries[goal].max_hop;
+  if (pin) {*pin = it->second;}
+  return out;
+};
+
+HopTable HeuristicStore::Find(long goal, HopTablePin* pin) {
+  HopTable out = _lookup(goal, pin);
+  if (out.hops != nullptr && _prefetched.erase(goal) == 0) {
+    _n_hits++; // the first use of a prefetched goal was already counted as a miss.
+  }
+  return out;
+};
+
+HopTable HeuristicStore::Get(long goal, HopTablePin* pin) {
+  HopTable out = Find(goal, pin);
+  if (out.hops != nullptr || _view.offsets == nullptr || goal < 0 || goal >= _view.rows * _view.cols) {return out;}
+  std::vector<uint32_t> table(size_t(_view.rows * _view.cols));
+  uint32_t max_hop = ComputeHopTable(_view, goal, table.data());
+  return Insert(goal, std::move(table), max_hop, false, pin);
+};
+
+std::vector<long> HeuristicStore::Missing(const std::vector<long>& goals) {
+  std::vector<long> out;
+  if (_view.offsets == nullptr) {return out;}
+  long n = _view.rows * _view.cols;
+  std::unordered_set<long> seen;
+  for (long goal : goals) {
+    if (goal < 0 || goal >= n || !seen.insert(goal).second || _new_tables.count(goal) || _find_mapped(goal) >= 0) {
+      continue;
+    }
+    out.push_back(goal);
+  }
+  return out;
+};
+
+HopTable HeuristicStore::Insert(long goal, std::vector<uint32_t>&& table, uint32_t max_hop, bool prefetched,
+                                HopTablePin* pin) {
+  if (table.size() != size_t(_view.rows * _view.cols)) {return HopTable();}
+  HopTable out = _lookup(goal, pin);
+  if (out.hops != nullptr || _view.offsets == nullptr || goal < 0 || goal >= _view.rows * _view.cols) {
+    return out; // stored by another caller in the meantime, or out of range.
+  }
+  _n_misses++;
+  _new_tables[goal] = std::make_shared< std::vector<uint32_t> >(std::move(table));
+  HopTableEntry& e = _new_entries[goal];
+  e.goal = goal;
+  e.max_hop = max_hop;
+  _lru.push_front(goal);
+  _lru_pos[goal] = _lru.begin();
+  if (prefetched) {_prefetched.insert(goal);}
+  _trim(); // keeps the newest table, in memory or in the file.
+  return _lookup(goal, pin);
+};
+
+void HeuristicStore::Prefetch(const std::vector<long>& goals) {
+  std::vector<long> todo = Missing(goals);
+  if (todo.empty()) {return;}
+  std::vector< std::vector<uint32_t> > tables(todo.size(), std::vector<uint32_t>(size_t(_view.rows * _view.cols)));
+  std::vector<uint32_t*> outs(todo.size());
+  std::vector<uint32_t> max_hops(todo.size());
+  for (size_t i = 0; i < todo.size(); i++) {
+    outs[i] = tables[i].data();
+  }
+  ComputeHopTables(_view, todo.data(), todo.size(), outs.data(), max_hops.data());
+  for (size_t i = 0; i < todo.size(); i++) {
+    Insert(todo[i], std::move(tables[i]), max_hops[i], true);
+  }
+};
+
+void HeuristicStore::_clear_new() {
+  _new_tables.clear();
+  _new_entries.clear();
+  _prefetched.clear();
+  _lru.clear();
+  _lru_pos.clear();
+};
+
+void HeuristicStore::_trim() {
+  size_t table_bytes = size_t(_view.rows * _view.cols) * sizeof(uint32_t);
+  if (_memory_limit == 0 || _new_tables.size() * table_bytes <= _memory_limit) {return;}
+  if (!_fname.empty() && Flush() == 1) {return;} // the tables are then read from the file.
+  while (_new_tables.size() > 1 && _new_tables.size() * table_bytes > _memory_limit) {
+    long goal = _lru.back();
+    _lru.pop_back();
+    _lru_pos.erase(goal);
+    _new_tables.erase(goal);
+    _new_entries.erase(goal);
+    _prefetched.erase(goal);
+  }
+};
+
+int HeuristicStore::Flush() {
+  if (_new_tables.empty() || _fname.empty()) {return 1;}
+  StoreLock lock(_fname);
+  if (!lock.Ok()) {
+    std::cerr << "[Error] file '" << _fname << ".lock' could not be locked" << std::endl;
+    return -1;
+  }
+  // another process may have flushed since the file was mapped, so the file as it is now is merged.
+  _release_file();
+  if (FileExists(_fname)) {_map_file();}
+  if (_write_merged(_fname) != 1) {return -1;}
+  _clear_new();
+  _map_file();
+  return 1;
+};
+
+int HeuristicStore::_write_merged(const std::string& fname) {
+  // the valid tables of the mapped file that are not computed again, then the new ones, sorted by goal.
+  std::vector<HopTableEntry> index;
+  std::vector<const uint32_t*> tables;
+  std::vector<uint64_t> sums;
+  size_t n = size_t(_view.rows * _view.cols);
+  for (size_t i = 0; i < _h.n_tables; i++) {
+    long goal = long(_index()[i].goal);
+    if (_new_tables.count(goal) || _find_mapped(goal) < 0) {continue;}
+    index.push_back(_index()[i]);
+    tables.push_back(_hops(i));
+    sums.push_back(_sums()[i]);
+  }
+  for (auto& kv : _new_entries) {
+    index.push_back(kv.second);
+    tables.push_back(_new_tables[kv.first]->data());
+    sums.push_back(TableSum(tables.back(), n));
+  }
+  std::vector<size_t> order(index.size());
+  for (size_t i = 0; i < order.size(); i++) {order[i] = i;}
+  std::sort(order.begin(), order.end(), [&index](size_t a, size_t b) {return index[a].goal < index[b].goal;});
+  std::vector<HopTableEntry> sorted_index;
+  std::vector<uint64_t> sorted_sums;
+  for (size_t i : order) {
+    sorted_index.push_back(index[i]);
+    sorted_sums.push_back(sums[i]);
+  }
+
+  HeuristicStoreHeader h;
+  h.n_vertex = long(n);
+  h.content_hash = _hash;
+  h.n_tables = index.size();
+  h.off_index = AlignUp(sizeof(HeuristicStoreHeader));
+  h.off_sums = AlignUp(h.off_index + h.n_tables * sizeof(HopTableEntry));
+  h.off_hops = AlignUp(h.off_sums + h.n_tables * sizeof(uint64_t));
+  h.file_size = h.off_hops + h.n_tables * n * sizeof(uint32_t);
+  h.meta_sum = MetaSum(h, sorted_index.data(), sorted_sums.data());
+
+  std::string tmp;
+  std::FILE* f = CreateTemp(fname, &tmp);
+  if (!f) {
+    std::cerr << "[Error] a temporary file next to '" << fname << "' could not be created" << std::endl;
+    return -1;
+  }
+  static const char zeros[kAlign] = {0};
+  bool ok = true;
+  auto put = [&](const void* p, size_t bytes) {
+    ok = ok && std::fwrite(p, 1, bytes, f) == bytes;
+  };
+  put(&h, sizeof(h));
+  put(zeros, size_t(h.off_index - sizeof(h)));
+  put(sorted_index.data(), sorted_index.size() * sizeof(HopTableEntry));
+  put(zeros, size_t(h.off_sums - h.off_index - h.n_tables * sizeof(HopTableEntry)));
+  put(sorted_sums.data(), sorted_sums.size() * sizeof(uint64_t));
+  put(zeros, size_t(h.off_hops - h.off_sums - h.n_tables * sizeof(uint64_t)));
+  for (size_t i : order) {
+    put(tables[i], n * sizeof(uint32_t));
+  }
+  ok = ok && std::fflush(f) == 0;
+#ifdef RAPLAB_HAS_FLOCK
+  ok = ok && ::fsync(::fileno(f)) == 0;
+#endif
+  ok = (std::fclose(f) == 0) && ok;
+  if (!ok || std::rename(tmp.c_str(), fname.c_str()) != 0) {
+    std::cerr << "[Error] file '" << fname << "' could not be written" << std::endl;
+    std::remove(tmp.c_str());
+    return -1;
+  }
+  return 1;
+};
+
+void HeuristicStore::Close() {
+  if (!_fname.empty()) {Flush();}
+  _clear_new();
+  _release_file();
+  _fname.clear();
+  _view = GridTableView();
+};
+
+} // end namespace raplab
@@ -0,0 +1,398 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#include "instance_file.hpp"
+#include "binary_map.hpp"
+#include "mapped_file.hpp"
+#include "text_scan.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace raplab{
+
+namespace {
+const char kTextMagic[] = "lsrp-instance";
+const uint64_t kAlign = 8;
+
+uint64_t AlignUp(uint64_t off) {
+  return (off + kAlign - 1) / kAlign * kAlign;
+}
+
+void WriteSection(std::ofstream& fout, uint64_t off, const void* data, size_t n) {
+  static const char zeros[kAlign] = {0};
+  uint64_t pos = uint64_t(fout.tellp());
+  fout.write(zeros, std::streamsize(off - pos));
+  fout.write(static_cast<const char*>(data), std::streamsize(n));
+}
+
+template <typename T>
+void ReadSection(const char* data, uint64_t off, size_t n, std::vector<T>* out) {
+  out->resize(n);
+  if (n > 0) {std::memcpy(&(*out)[0], data + off, n * sizeof(T));}
+}
+
+// the shortest decimal form that reads back as the same double.
+std::string ShortestDouble(double v) {
+  char buf[32];
+  for (int prec = 6; prec < 17; prec++) {
+    std::snprintf(buf, sizeof(buf), "%.*g", prec, v);
+    if (std::strtod(buf, nullptr) == v) {return buf;}
+  }
+  std::snprintf(buf, sizeof(buf), "%.17g", v);
+  return buf;
+}
+
+// a relative path of an instance is relative to the instance file.
+std::string ResolvePath(const std::string& fname, const std::string& path) {
+  if (path.empty() || path[0] == '/') {return path;}
+  size_t slash = fname.find_last_of('/');
+  return (slash == std::string::npos) ? path : fname.substr(0, slash + 1) + path;
+}
+
+// the arrays agree with each other and with the map size, if it is known.
+bool CheckInstance(const Instance& inst, std::string* err) {
+  long n = inst.rows * inst.cols;
+  for (size_t i = 0; i < inst.starts.size(); i++) {
+    if (inst.starts[i] < 0 || inst.goals[i] < 0 || (n > 0 && (inst.starts[i] >= n || inst.goals[i] >= n))) {
+      *err = "agent " + std::to_string(i) + " has a start or goal outside the map";
+      return false;
+    }
+    if (!(inst.durations[i] > 0) || !std::isfinite(inst.durations[i])) {
+      *err = "agent " + std::to_string(i) + " has a duration that is not positive";
+      return false;
+    }
+  }
+  for (size_t j = 0; j < inst.cap_vertices.size(); j++) {
+    if (inst.cap_vertices[j] < 0 || (n > 0 && inst.cap_vertices[j] >= n) || inst.cap_values[j] < 0) {
+      *err = "capacity " + std::to_string(j) + " is outside the map or negative";
+      return false;
+    }
+  }
+  return true;
+}
+
+int LoadBinaryInstance(const std::string& fname, const MappedFile& file, Instance* out) {
+  InstanceFileHeader h;
+  InstanceFileHeader ref;
+  std::string err;
+  if (file.Size() < sizeof(InstanceFileHeader)) {
+    err = "the file is truncated";
+  } else {
+    std::memcpy(&h, file.Data(), sizeof(InstanceFileHeader));
+    bool embedded = (h.flags & kInstanceEmbeddedMap) != 0;
+    uint64_t n_words = (h.rows > 0 && h.cols > 0) ? (uint64_t(h.rows) * uint64_t(h.cols) + 63) / 64 : 0;
+    if (h.version != ref.version) {
+      err = "unsupported version " + std::to_string(h.version);
+    } else if (h.endian != ref.endian) {
+      err = "the file was written on a machine with another byte order";
+    } else if (h.file_size != file.Size()) {
+      err = "the file is truncated";
+    } else if (h.rows < 0 || h.cols < 0 || h.rows > 0x7fffffff || h.cols > 0x7fffffff || (embedded && n_words == 0) ||
+        h.n_agents > h.file_size || h.n_capacities > h.file_size || h.map_path_len > h.file_size ||
+        h.off_starts < sizeof(InstanceFileHeader) ||
+        h.off_starts + h.n_agents * sizeof(int64_t) > h.off_goals ||
+        h.off_goals + h.n_agents * sizeof(int64_t) > h.off_durations ||
+        h.off_durations + h.n_agents * sizeof(double) > h.off_cap_vertices ||
+        h.off_cap_vertices + h.n_capacities * sizeof(int64_t) > h.off_cap_values ||
+        h.off_cap_values + h.n_capacities * sizeof(int32_t) > h.off_map ||
+        h.off_map + (embedded ? n_words * sizeof(uint64_t) : h.map_path_len) > h.file_size ||
+        h.off_starts % kAlign || h.off_goals % kAlign || h.off_durations % kAlign ||
+        h.off_cap_vertices % kAlign || h.off_cap_values % kAlign || h.off_map % kAlign) {
+      err = "corrupted section table";
+    }
+  }
+  if (!err.empty()) {
+    std::cerr << "[Error] LoadInstance, '" << fname << "': " << err << std::endl;
+    return -1;
+  }
+  static_assert(sizeof(long) == sizeof(int64_t), "the binary instance stores vertices as int64");
+  const char* data = file.Data();
+  out->rows = long(h.rows);
+  out->cols = long(h.cols);
+  ReadSection(data, h.off_starts, size_t(h.n_agents), &out->starts);
+  ReadSection(data, h.off_goals, size_t(h.n_agents), &out->goals);
+  ReadSection(data, h.off_durations, size_t(h.n_agents), &out->durations);
+  ReadSection(data, h.off_cap_vertices, size_t(h.n_capacities), &out->cap_vertices);
+  ReadSection(data, h.off_cap_values, size_t(h.n_capacities), &out->cap_values);
+  if (h.flags & kInstanceEmbeddedMap) {
+    out->map.rows = out->rows;
+    out->map.cols = out->cols;
+    ReadSection(data, h.off_map, size_t(h.rows * h.cols + 63) / 64, &out->map.bits);
+    out->map_path.clear();
+  } else {
+    out->map = OccupancyBitmap();
+    out->map_path = ResolvePath(fname, std::string(data + h.off_map, size_t(h.map_path_len)));
+  }
+  return 1;
+}
+
+int LoadTextInstance(const std::string& fname, const MappedFile& file, Instance* out) {
+  LineReader in(file.Data(), file.Data() + file.Size());
+  const char* b;
+  const char* e;
+  const char* tb;
+  const char* te;
+  // the next line which is neither empty nor a comment, its first token in tb, te.
+  auto next_line = [&]() {
+    while (in.Next(&b, &e)) {
+      if (NextToken(&b, e, &tb, &te) && *tb != '#') {return true;}
+    }
+    return false;
+  };
+  auto fail = [&](const std::string& what) {
+    std::cerr << "[Error] LoadInstance, '" << fname << "' line " << in.n_lines << ": " << what << std::endl;
+    return -1;
+  };
+  long version;
+  if (!next_line() || !TokenIs(tb, te, kTextMagic) || !NextLong(&b, e, &version) || version != 1) {
+    return fail("expect '" + std::string(kTextMagic) + " 1'");
+  }
+  *out = Instance();
+  if (!next_line()) {return fail("expect 'map' or 'grid'");}
+  if (TokenIs(tb, te, "map")) {
+    const char* pe = e;
+    while (pe > b && IsSpace(pe[-1])) {pe--;}
+    const char* pb = SkipSpaces(b, pe);
+    if (pb == pe) {return fail("'map' without a path");}
+    out->map_path = ResolvePath(fname, std::string(pb, pe));
+    if (!next_line()) {return fail("expect 'agents'");}
+    if (TokenIs(tb, te, "size")) {
+      if (!NextLong(&b, e, &out->rows) || !NextLong(&b, e, &out->cols) || out->rows > 0x7fffffff || out->cols > 0x7fffffff) {
+        return fail("expect 'size <height> <width>'");
+      }
+      if (!next_line()) {return fail("expect 'agents'");}
+    }
+  } else if (TokenIs(tb, te, "grid")) {
+    long height;
+    long width;
+    if (!NextLong(&b, e, &height) || !NextLong(&b, e, &width) || height <= 0 || width <= 0 ||
+        height > long(file.Size()) || width > long(file.Size()) || height * width > long(file.Size())) {
+      return fail("expect 'grid <height> <width>' of a grid that fits in the file");
+    }
+    out->rows = height;
+    out->cols = width;
+    out->map.Resize(height, width);
+    for (long r = 0; r < height; r++) {
+      if (!in.Next(&b, &e) || e - b != width) {return fail("expect a row of " + std::to_string(width) + " cells");}
+      long k = r * width;
+      for (const char* q = b; q < e; q++, k++) {
+        if (*q != '.' && *q != 'G') {out->map.SetBlocked(k);}
+      }
+    }
+    if (!next_line()) {return fail("expect 'agents'");}
+  } else {
+    return fail("expect 'map' or 'grid'");
+  }
+
+  long n;
+  if (!TokenIs(tb, te, "agents") || !NextLong(&b, e, &n) || n > long(file.Size())) {
+    return fail("expect 'agents <n>'");
+  }
+  out->starts.resize(n);
+  out->goals.resize(n);
+  out->durations.resize(n);
+  for (long i = 0; i < n; i++) {
+    if (!next_line()) {return fail("expect " + std::to_string(n) + " agents");}
+    // the first token was consumed by next_line, the line is read again from it.
+    const char* p = tb;
+    if (!NextLong(&p, e, &out->starts[i]) || !NextLong(&p, e, &out->goals[i]) || !NextDouble(&p, e, &out->durations[i])) {
+      return fail("expect '<start> <goal> <duration>' of agent " + std::to_string(i));
+    }
+  }
+  if (next_line()) {
+    long m;
+    if (!TokenIs(tb, te, "capacities") || !NextLong(&b, e, &m) || m > long(file.Size())) {
+      return fail("expect 'capacities <m>'");
+    }
+    out->cap_vertices.resize(m);
+    out->cap_values.resize(m);
+    for (long j = 0; j < m; j++) {
+      if (!next_line()) {return fail("expect " + std::to_string(m) + " capacities");}
+      const char* p = tb;
+      long c;
+      if (!NextLong(&p, e, &out->cap_vertices[j]) || !NextLong(&p, e, &c) || c > 0x7fffffffL) {
+        return fail("expect '<vertex> <capacity>' of capacity " + std::to_string(j));
+      }
+      out->cap_values[j] = int32_t(c);
+    }
+    if (next_line()) {return fail("unexpected content after the capacities");}
+  }
+  return 1;
+}
+}
+
+bool IsInstanceFile(const std::string& fname) {
+  std::ifstream fin(fname, std::ios::binary);
+  char head[sizeof(kTextMagic) - 1] = {0};
+  fin.read(head, sizeof(head));
+  InstanceFileHeader ref;
+  return fin && (std::memcmp(head, ref.magic, sizeof(ref.magic)) == 0 ||
+                 std::memcmp(head, kTextMagic, sizeof(head)) == 0);
+};
+
+int LoadInstance(const std::string& fname, Instance* out) {
+  MappedFile file;
+  if (file.Open(fname) != 1) {
+    return -1;
+  }
+  InstanceFileHeader ref;
+  int ret;
+  if (file.Size() >= sizeof(ref.magic) && std::memcmp(file.Data(), ref.magic, sizeof(ref.magic)) == 0) {
+    ret = LoadBinaryInstance(fname, file, out);
+  } else {
+    ret = LoadTextInstance(fname, file, out);
+  }
+  std::string err;
+  if (ret == 1 && !CheckInstance(*out, &err)) {
+    std::cerr << "[Error] LoadInstance, '" << fname << "': " << err << std::endl;
+    return -1;
+  }
+  return ret;
+};
+
+int WriteInstance(const std::string& fname, const Instance& inst, bool text) {
+  std::string err;
+  if (inst.goals.size() != inst.starts.size() || inst.durations.size() != inst.starts.size() ||
+      inst.cap_values.size() != inst.cap_vertices.size()) {
+    err = "the arrays have different sizes";
+  } else if (inst.HasEmbeddedMap() && (inst.map.rows != inst.rows || inst.map.cols != inst.cols)) {
+    err = "the embedded map is not rows x cols";
+  } else if (!inst.HasEmbeddedMap() && inst.map_path.empty()) {
+    err = "no map";
+  } else {
+    CheckInstance(inst, &err);
+  }
+  if (!err.empty()) {
+    std::cerr << "[Error] WriteInstance, " << err << std::endl;
+    return -1;
+  }
+  std::ofstream fout(fname, text ? std::ios::trunc : (std::ios::binary | std::ios::trunc));
+  if (!fout) {
+    std::cerr << "[Error] file '" << fname << "' could not be opened" << std::endl;
+    return -1;
+  }
+  if (text) {
+    fout << kTextMagic << " 1\n";
+    if (inst.HasEmbeddedMap()) {
+      fout << "grid " << inst.rows << " " << inst.cols << "\n";
+      std::string row;
+      for (long r = 0; r < inst.rows; r++) {
+        row.assign(size_t(inst.cols), '.');
+        for (long c = 0; c < inst.cols; c++) {
+          if (inst.map.IsBlocked(r * inst.cols + c)) {row[c] = '@';}
+        }
+        fout << row << "\n";
+      }
+    } else {
+      fout << "map " << inst.map_path << "\n";
+      if (inst.rows > 0) {fout << "size " << inst.rows << " " << inst.cols << "\n";}
+    }
+    fout << "agents " << inst.NumAgents() << "\n";
+    for (size_t i = 0; i < inst.NumAgents(); i++) {
+      fout << inst.starts[i] << " " << inst.goals[i] << " " << ShortestDouble(inst.durations[i]) << "\n";
+    }
+    if (!inst.cap_vertices.empty()) {
+      fout << "capacities " << inst.cap_vertices.size() << "\n";
+      for (size_t j = 0; j < inst.cap_vertices.size(); j++) {
+        fout << inst.cap_vertices[j] << " " << inst.cap_values[j] << "\n";
+      }
+    }
+  } else {
+    InstanceFileHeader h;
+    uint64_t n_words = inst.HasEmbeddedMap() ? inst.map.bits.size() : 0;
+    h.flags = inst.HasEmbeddedMap() ? kInstanceEmbeddedMap : 0;
+    h.rows = inst.rows;
+    h.cols = inst.cols;
+    h.n_agents = inst.NumAgents();
+    h.n_capacities = inst.cap_vertices.size();
+    h.map_path_len = inst.HasEmbeddedMap() ? 0 : inst.map_path.size();
+    h.off_starts = AlignUp(sizeof(InstanceFileHeader));
+    h.off_goals = AlignUp(h.off_starts + h.n_agents * sizeof(int64_t));
+    h.off_durations = AlignUp(h.off_goals + h.n_agents * sizeof(int64_t));
+    h.off_cap_vertices = AlignUp(h.off_durations + h.n_agents * sizeof(double));
+    h.off_cap_values = AlignUp(h.off_cap_vertices + h.n_capacities * sizeof(int64_t));
+    h.off_map = AlignUp(h.off_cap_values + h.n_capacities * sizeof(int32_t));
+    h.file_size = h.off_map + (inst.HasEmbeddedMap() ? n_words * sizeof(uint64_t) : h.map_path_len);
+    fout.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    WriteSection(fout, h.off_starts, inst.starts.data(), inst.starts.size() * sizeof(int64_t));
+    WriteSection(fout, h.off_goals, inst.goals.data(), inst.goals.size() * sizeof(int64_t));
+    WriteSection(fout, h.off_durations, inst.durations.data(), inst.durations.size() * sizeof(double));
+    WriteSection(fout, h.off_cap_vertices, inst.cap_vertices.data(), inst.cap_vertices.size() * sizeof(int64_t));
+    WriteSection(fout, h.off_cap_values, inst.cap_values.data(), inst.cap_values.size() * sizeof(int32_t));
+    if (inst.HasEmbeddedMap()) {
+      WriteSection(fout, h.off_map, inst.map.bits.data(), n_words * sizeof(uint64_t));
+    } else {
+      WriteSection(fout, h.off_map, inst.map_path.data(), inst.map_path.size());
+    }
+  }
+  if (!fout) {
+    std::cerr << "[Error] file '" << fname << "' could not be written" << std::endl;
+    return -1;
+  }
+  return 1;
+};
+
+int AssembleInstance(const std::string& map_path, const std::string& scen_path, const std::string& duration_path,
+                     const std::string& capacity_path, const ScenarioSelection& sel, bool embed_map, Instance* out) {
+  *out = Instance();
+  if (ParseAgentDurations(duration_path, &out->durations) != 1) {
+    return -1;
+  }
+  if (BinaryMap::IsBinaryMap(map_path)) {
+    BinaryMap bin_map;
+    if (bin_map.Open(map_path) != 1) {return -1;}
+    out->rows = long(bin_map.Header().rows);
+    out->cols = long(bin_map.Header().cols);
+    out->map_path = map_path;
+  } else {
+    if (ParseMap_MovingAI(map_path, &out->map) != 1) {return -1;}
+    out->rows = out->map.rows;
+    out->cols = out->map.cols;
+    if (!embed_map) {
+      out->map = OccupancyBitmap();
+      out->map_path = map_path;
+    }
+  }
+  ScenarioSelection s = sel;
+  if (s.count < 0) {s.count = long(out->durations.size());}
+  s.width = out->cols;
+  s.height = out->rows;
+  std::tuple<int, int> width_height;
+  if (ParseScenarios_MovingAI(scen_path, s, &out->starts, &out->goals, &width_height) != 1) {
+    return -1;
+  }
+  if (out->durations.size() < out->starts.size()) {
+    std::cerr << "[Error] AssembleInstance, '" << duration_path << "' has " << out->durations.size()
+              << " durations for " << out->starts.size() << " agents" << std::endl;
+    return -1;
+  }
+  out->durations.resize(out->starts.size());
+  if (!capacity_path.empty()) {
+    std::unordered_map<long, int> caps;
+    if (LoadNodeCapacities(capacity_path, &caps) != 1) {return -1;}
+    // sorted by vertex, so that the same files always give the same instance.
+    std::vector< std::pair<long, int> > sorted(caps.begin(), caps.end());
+    std::sort(sorted.begin(), sorted.end());
+    for (const auto& kv : sorted) {
+      out->cap_vertices.push_back(kv.first);
+      out->cap_values.push_back(int32_t(kv.second));
+    }
+  }
+  std::string err;
+  if (!CheckInstance(*out, &err)) {
+    std::cerr << "[Error] AssembleInstance: " << err << std::endl;
+    return -1;
+  }
+  return 1;
+};
+
+} // end namespace raplab
@@ -6,76 +6,237 @@
 #include <iostream>
 #include <string>
 #include "graph_io.hpp"
+#include "binary_map.hpp"
+#include "heuristic_store.hpp"
+#include "trace.hpp"
+#include "plan_file.hpp"
+#include "planner_service.hpp"
+#include "instance_file.hpp"
+#include "parallel_for.hpp"
 #include <vector>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
 #include <unordered_map>
+#include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <unistd.h>
 
-int Test(const std::string& mapPath, const std::string& scenPath, const std::string& durationPath, double time_limit, bool swap, const std::string& capacityPath);
-void write_result_to_xml(std::vector<std::vector<std::tuple<std::tuple<int, int>, std::tuple<int, int>, double, double>>>& result, const std::vector<double>& durations, const std::string& map_path,
-                         double runtime, double soc, double makespan);
-std::vector<std::tuple<int, int, int>> assign_colors(size_t agent_count);
-std::vector<std::vector<std::tuple<std::tuple<int, int>, std::tuple<int, int>, double, double>>> visual_convert(std::tuple<int, int>* width_height, std::vector<std::vector<std::tuple<long, long, double, double>>>* all_paths);
-std::vector<double> readAgentValues(const std::string& filename);
+// optional command line flags, see the usage message.
+struct RunOptions {
+    std::string tracePath = "";
+    long estimateEvents = 0; // events of the memory estimate printed before solving, 0 for Lsrp::DefaultEventBound
+    std::string logPath = "";
+    std::string replayPath = "";
+    std::string heuristicStorePath = "";
+    raplab::GridOrder vertexOrder = raplab::GridOrder::ROW_MAJOR;
+    bool quarantine = false;
+    raplab::ScenarioSelection scenario; // bucket range and skipped entries, count is the number of durations.
+    std::string planPath = "result.plan";
+    std::string batchPath = ""; // manifest of the batch mode
+    std::string batchOutPath = ""; // results of the batch mode, stdout if empty
+    int jobs = 0; // worker threads of the batch and server modes, 0 for one per hardware thread
+    std::string servePath = ""; // Unix socket of the server mode, "-" for stdin/stdout
+    long heuristicMemoryMb = 0; // bound of the goal tables kept in memory by the batch and server modes, 0 for none
+};
+
+int Test(const raplab::Instance& inst, double time_limit, bool swap, const RunOptions& opt);
+int RunBatch(const std::string& mapPath, double time_limit, bool swap, const RunOptions& opt);
+int RunServer(const std::string& mapPath, const RunOptions& opt);
 
 int main(int argc, char* argv[]) {
-    if (argc < 5 && argc >7) {
-        std::cerr << "Usage: " << argv[0] << " <map_path> <scen_path> <duration_path> <runtime> [swap]" << std::endl;
+    // options are removed before the positional arguments are parsed.
+    std::vector<std::string> args;
+    RunOptions opt;
+    for (int i = 0; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--trace" && i + 1 < argc) {
+            opt.tracePath = argv[++i];
+        } else if (a == "--estimate-events" && i + 1 < argc) {
+            opt.estimateEvents = std::stol(argv[++i]);
+        } else if (a == "--log" && i + 1 < argc) {
+            opt.logPath = argv[++i];
+        } else if (a == "--replay" && i + 1 < argc) {
+            opt.replayPath = argv[++i];
+        } else if (a == "--heuristic-store" && i + 1 < argc) {
+            opt.heuristicStorePath = argv[++i];
+        } else if (a == "--buckets" && i + 1 < argc) {
+            std::string b = argv[++i];
+            size_t sep = b.find(':');
+            opt.scenario.bucket_min = std::stoi(b.substr(0, sep));
+            opt.scenario.bucket_max = (sep == std::string::npos) ? opt.scenario.bucket_min : std::stoi(b.substr(sep + 1));
+        } else if (a == "--skip-agents" && i + 1 < argc) {
+            opt.scenario.skip = std::stol(argv[++i]);
+        } else if (a == "--batch" && i + 1 < argc) {
+            opt.batchPath = argv[++i];
+        } else if (a == "--batch-out" && i + 1 < argc) {
+            opt.batchOutPath = argv[++i];
+        } else if (a == "--serve" && i + 1 < argc) {
+            opt.servePath = argv[++i];
+        } else if (a == "--jobs" && i + 1 < argc) {
+            opt.jobs = std::stoi(argv[++i]);
+        } else if (a == "--heuristic-memory" && i + 1 < argc) {
+            opt.heuristicMemoryMb = std::stol(argv[++i]);
+        } else if (a == "--plan" && i + 1 < argc) {
+            opt.planPath = argv[++i];
+        } else if (a == "--quarantine-infeasible") {
+            opt.quarantine = true;
+        } else if (a == "--vertex-order" && i + 1 < argc) {
+            std::string o = argv[++i];
+            if (o == "hilbert") {
+                opt.vertexOrder = raplab::GridOrder::HILBERT;
+            } else if (o == "bfs") {
+                opt.vertexOrder = raplab::GridOrder::BFS;
+            } else if (o != "row") {
+                std::cerr << "Unknown vertex order: " << o << std::endl;
+                return -1;
+            }
+        } else {
+            args.push_back(a);
+        }
+    }
+    argc = int(args.size());
+    if (!opt.servePath.empty()) {
+        if (argc != 2 || !opt.batchPath.empty() || !opt.tracePath.empty() || !opt.logPath.empty() || !opt.replayPath.empty()) {
+            std::cerr << "Usage: " << args[0] << " --serve <socket_path|-> <map_path> [--jobs <n>] [--heuristic-memory <MB>]"
+                      << " [--heuristic-store <store_path>] [--vertex-order row|hilbert|bfs] [--quarantine-infeasible]" << std::endl;
+            return -1;
+        }
+        return RunServer(args[1], opt);
+    }
+    if (!opt.batchPath.empty()) {
+        if (argc < 3 || argc > 4 || (argc == 4 && args[3] != "swap") || !opt.tracePath.empty() || !opt.logPath.empty() || !opt.replayPath.empty()) {
+            std::cerr << "Usage: " << args[0] << " --batch <manifest_path> <map_path> <runtime> [swap] [--jobs <n>] [--batch-out <out_path>] [--heuristic-memory <MB>]"
+                      << " [--heuristic-store <store_path>] [--vertex-order row|hilbert|bfs] [--quarantine-infeasible] [--buckets <min>:<max>] [--skip-agents <n>]" << std::endl;
+            return -1;
+        }
+        return RunBatch(args[1], std::stod(args[2]), argc == 4, opt);
+    }
+    const std::string usage = " <map_path> <scen_path> <duration_path> <runtime> [swap] [capacity_path] | <instance_path> <runtime> [swap]"
+        " [--trace <json_path>] [--estimate-events <n>] [--log <log_path> | --replay <log_path>] [--heuristic-store <store_path>]"
+        " [--vertex-order row|hilbert|bfs] [--quarantine-infeasible] [--buckets <min>:<max>] [--skip-agents <n>] [--plan <plan_path>]";
+    // either one instance file, or the map, scenario, duration and optional capacity files.
+    bool fromInstance = (argc == 3 || argc == 4) && raplab::IsInstanceFile(args[1]);
+    if (fromInstance ? (argc == 4 && args[3] != "swap") : (argc < 5 || argc > 7 || (argc == 7 && args[5] != "swap"))) {
+        std::cerr << "Usage: " << args[0] << usage << std::endl;
         return -1;
     }
-
-
-    std::string mapPath = argv[1];
-    std::string scenPath = argv[2];
-    std::string durationPath = argv[3];
-    double runtime = std::stod(argv[4]);
-    bool swap = false;
-    std::string capacityPath = "";
-    if (argc == 6 && std::string(argv[5]) == "swap") {
-        swap = true;
-    }
-    else if (argc == 6 && std::string(argv[5]) != "swap") {
-        capacityPath = argv[5];
-    }
-    else if(argc == 7&& std::string(argv[5]) == "swap"){
-        swap = true;
-        capacityPath = argv[6];
-    }
-    return Test(mapPath, scenPath, durationPath, runtime, swap, capacityPath);
+    raplab::Instance inst;
+    double runtime = std::stod(args[fromInstance ? 2 : 4]);
+    bool swap = fromInstance ? argc == 4 : (argc >= 6 && args[5] == "swap");
+    if (fromInstance) {
+        if (raplab::LoadInstance(args[1], &inst) != 1) {
+            std::cerr << "Failed to load instance: " << args[1] << std::endl;
+            return -1;
+        }
+    } else {
+        std::string capacityPath = (argc == 7) ? args[6] : ((argc == 6 && !swap) ? args[5] : "");
+        if (raplab::AssembleInstance(args[1], args[2], args[3], capacityPath, opt.scenario, false, &inst) != 1) {
+            std::cerr << "Failed to load instance: " << args[1] << " " << args[2] << " " << args[3] << " " << capacityPath << std::endl;
+            return -1;
+        }
+    }
+    if (!opt.tracePath.empty()) {
+        raplab::TraceEnable();
+    }
+    int ret = Test(inst, runtime, swap, opt);
+    if (!opt.tracePath.empty()) {
+        raplab::TraceDisable();
+        raplab::TraceDumpChrome(opt.tracePath);
+    }
+    return ret;
 }
 
 
-int Test(const std::string& mapPath, const std::string& scenPath, const std::string& durationPath, double time_limit, bool swap, const std::string& capacityPath) {
+int Test(const raplab::Instance& inst, double time_limit, bool swap, const RunOptions& opt) {
     std::cout << "####### LSRP Begin #######" << std::endl;
-    auto duration = readAgentValues(durationPath);
+    const std::vector<double>& duration = inst.durations;
     if (duration.empty()) {
         std::cerr << "Agent number is zero." << std::endl;
         return -1;
     }
+    raplab::BinaryMap binMap; // a precompiled map, must outlive g
     raplab::Grid2d g;
-    std::vector<std::vector<double>> occupancy_grid;
-    raplab::LoadMap_MovingAI(mapPath, &occupancy_grid);
-    g.SetOccuGridPtr(&occupancy_grid);
-    std::vector<long> starts;
-    std::vector<long> goals;
-    std::tuple<int, int> width_height;
-    raplab::LoadScenarios(scenPath, int(duration.size()), &starts, &goals, &width_height);
-    raplab::Lsrp planner;
+    raplab::OccupancyBitmap occupancy;
+    const std::string& mapPath = inst.map_path;
+    if (inst.HasEmbeddedMap()) {
+        g.SetVertexOrder(opt.vertexOrder);
+        g.SetOccuBitmapPtr(&inst.map);
+    } else if (raplab::BinaryMap::IsBinaryMap(mapPath)) {
+        if (binMap.Open(mapPath) != 1 || raplab::AttachBinaryMap(binMap, &g) != 1) {
+            std::cerr << "Failed to load precompiled map: " << mapPath << std::endl;
+            return -1;
+        }
+    } else {
+        if (raplab::ParseMap_MovingAI(mapPath, &occupancy) != 1) {
+            std::cerr << "Failed to load map: " << mapPath << std::endl;
+            return -1;
+        }
+        g.SetVertexOrder(opt.vertexOrder);
+        g.SetOccuBitmapPtr(&occupancy);
+    }
+    long rows = g.GetTableView().rows;
+    long cols = g.GetTableView().cols;
+    if ((inst.rows > 0 && inst.rows != rows) || (inst.cols > 0 && inst.cols != cols)) {
+        std::cerr << "The instance refers to a " << inst.rows << " x " << inst.cols << " map, the map is " << rows << " x " << cols << std::endl;
+        return -1;
+    }
+    // the input and output files use row-major cell ids, the planner the vertex ids of g.
+    std::vector<long> starts(inst.starts);
+    std::vector<long> goals(inst.goals);
+    for (size_t i = 0; i < starts.size(); ++i) {
+        if (g.HasVertex(starts[i])) {starts[i] = g.ToInternal(starts[i]);}
+        if (g.HasVertex(goals[i])) {goals[i] = g.ToInternal(goals[i]);}
+    }
+    raplab::LsrpT<raplab::Grid2d> planner; // the grid specialized planner
     planner.SetGraphPtr(&g);
     planner.Setduration(duration);
     planner.set_swap(swap);
-
-    std::unordered_map<long, int> node_capacities;
-    if (!capacityPath.empty()) {
-        if (raplab::LoadNodeCapacities(capacityPath, &node_capacities) != 1) {
-            std::cerr << "Failed to load node capacities from file: " << capacityPath << std::endl;
-            return -1;
-        }
-        // 设置节点容量
-        for (const auto& pair : node_capacities) {
-            g.SetVertexMaxCapacity(pair.first, pair.second);
+    if (opt.quarantine) {
+        planner.set_infeasible_policy(raplab::InfeasiblePolicy::QUARANTINE);
+    }
+    raplab::HeuristicStore heuStore; // refers to the arrays of g
+    if (!opt.heuristicStorePath.empty() && heuStore.Open(opt.heuristicStorePath, g.GetTableView()) != 1) {
+        return -1;
+    }
+    bool useStore = !opt.heuristicStorePath.empty();
+    if (useStore || (binMap.IsOpen() && binMap.NumHopTables() > 0)) {
+        // tables precompiled into the map first, then the store.
+        planner.set_hop_table_source([&binMap, &heuStore, useStore](long goal) {
+            raplab::HopTable t;
+            if (binMap.IsOpen()) {t = binMap.GetHopTable(goal);}
+            if (t.hops == nullptr && useStore) {t = heuStore.Get(goal);}
+            return t;
+        });
+    }
+    if (useStore) {
+        // compute the missing tables in one multithreaded batch, instead of one search per agent.
+        std::vector<long> missing;
+        for (long goal : goals) {
+            if (!binMap.IsOpen() || binMap.GetHopTable(goal).hops == nullptr) {missing.push_back(goal);}
         }
+        heuStore.Prefetch(missing);
+    }
+    {
+        bool hopTables = useStore || (binMap.IsOpen() && binMap.NumHopTables() > 0);
+        auto estimate = raplab::Lsrp::EstimateMemory(starts.size(), g.NumVertex(), size_t(std::max(0L, opt.estimateEvents)),
+            hopTables ? raplab::HeuristicSource::HOP_TABLE : raplab::HeuristicSource::HASH_MAP, g.GetTableView().kngh);
+        std::cout << "Estimated memory footprint (MB): " << std::fixed << std::setprecision(2)
+                  << estimate.total() / 1048576.0 << std::endl;
+    }
+    if (!opt.replayPath.empty()) {
+        planner.set_replay_log(opt.replayPath);
+    } else if (!opt.logPath.empty()) {
+        planner.set_decision_log(opt.logPath);
+    }
+
+    // 设置节点容量
+    for (size_t j = 0; j < inst.cap_vertices.size(); ++j) {
+        long v = inst.cap_vertices[j];
+        g.SetVertexMaxCapacity(g.HasVertex(v) ? g.ToInternal(v) : v, inst.cap_values[j]);
     }
     // 初始化智能体所在节点的占用容量
     for (long start : starts) {
@@ -85,8 +246,8 @@ int Test(const std::string& mapPath, const std::string& scenPath, const std::str
     std::vector<long> allVertices = g.AllVertex();
     std::cout << "\n===== Initial Node Capacity Information =====\n";
     for (long vertex : allVertices) {
-        long maxCapacity = g.GetVertexMaxCapacity(vertex);
-        long occupiedCapacity = g.GetVertexOccupiedCapacity(vertex);
+        long maxCapacity = g.GetVertexMaxCapacity(g.ToInternal(vertex));
+        long occupiedCapacity = g.GetVertexOccupiedCapacity(g.ToInternal(vertex));
         if(occupiedCapacity!=0)
         {std::cout << "Node: " << vertex 
                   << ", Max Capacity: " << maxCapacity 
@@ -94,13 +255,25 @@ int Test(const std::string& mapPath, const std::string& scenPath, const std::str
     }
     // ================================================================
 
-    planner.Solve(starts, goals, time_limit, 5.0);  // eps 仅为满足输入要求
+    if (planner.Solve(starts, goals, time_limit, 5.0) != 1) {  // eps 仅为满足输入要求
+        std::cerr << "The instance has infeasible agents, rerun with --quarantine-infeasible to keep them at their start." << std::endl;
+        return -1;
+    }
+    if (useStore) {
+        std::cout << "Heuristic store: " << heuStore.NumHits() << " hits, " << heuStore.NumMisses() << " misses" << std::endl;
+        heuStore.Flush();
+    }
+    if (!opt.replayPath.empty()) {
+        std::cout << "Replay: " << planner.get_decision_log().Report() << std::endl;
+    } else if (!opt.logPath.empty() && planner.get_decision_log().WriteFailed()) {
+        std::cerr << "[Error] Decision log: " << planner.get_decision_log().Report() << std::endl;
+    }
 
     // ====================== 添加规划完成后节点容量输出 ======================
     std::cout << "\n===== Final Node Capacity Information After Planning =====\n";
     for (long vertex : allVertices) {
-        long maxCapacity = g.GetVertexMaxCapacity(vertex);
-        long occupiedCapacity = g.GetVertexOccupiedCapacity(vertex);
+        long maxCapacity = g.GetVertexMaxCapacity(g.ToInternal(vertex));
+        long occupiedCapacity = g.GetVertexOccupiedCapacity(g.ToInternal(vertex));
         if(occupiedCapacity!=0)
         {std::cout << "Node: " << vertex 
                   << ", Max Capacity: " << maxCapacity 
@@ -116,9 +289,28 @@ int Test(const std::string& mapPath, const std::string& scenPath, const std::str
         std::cout << "Runtime: " << std::fixed << std::setprecision(3) << runtime << std::endl;
         std::cout << "Makespan: " << std::fixed << std::setprecision(2) << makespan << std::endl;
         std::cout << "Soc: " << std::fixed << std::setprecision(2) << soc << std::endl;
+        std::cout << "\n===== Planner Statistics =====\n";
+        auto stats = planner.GetStats();
+        std::map<std::string, double> sorted_stats(stats.begin(), stats.end());
+        for (const auto& kv : sorted_stats) {
+            std::cout << kv.first << ": " << std::defaultfloat << std::setprecision(6) << kv.second << std::endl;
+        }
         auto* all_paths = planner.get_all_paths();
-        auto visual_paths = visual_convert(&width_height, all_paths);
-        write_result_to_xml(visual_paths, duration, mapPath, runtime, soc, makespan);
+        for (auto& path : *all_paths) {
+            for (auto& section : path) {
+                std::get<0>(section) = g.ToExternal(std::get<0>(section));
+                std::get<1>(section) = g.ToExternal(std::get<1>(section));
+            }
+        }
+        raplab::PlanFileHeader header;
+        header.rows = g.GetTableView().rows;
+        header.cols = g.GetTableView().cols;
+        header.runtime = runtime;
+        header.soc = soc;
+        header.makespan = makespan;
+        if (raplab::WritePlan(opt.planPath, header, duration, *all_paths) != 1) {
+            return -1;
+        }
     } else {
         std::cout << "Solution found: false" << std::endl;
     }
@@ -126,145 +318,157 @@ int Test(const std::string& mapPath, const std::string& scenPath, const std::str
     return 1;
 }
 
-void write_result_to_xml(std::vector<std::vector<std::tuple<std::tuple<int, int>, std::tuple<int, int>, double, double>>>& result, const std::vector<double>& durations, const std::string& map_path,
-                         double runtime, double soc, double makespan) {
-    std::ofstream file("result.xml");
-    if (!file.is_open()) {
-        std::cerr << "Unable to open file for writing: " << "result.xml" << std::endl;
-        return;
-    }
-
-    file << "<?xml version=\"1.0\" ?>" << std::endl;
-    file << "<root>" << std::endl;
+// one instance of the batch mode, loaded before the workers start.
+struct BatchJob {
+    std::string scenPath;
+    std::string durationPath;
+    std::string capacityPath;
+    raplab::SolveRequest req; // row-major cell ids
+    bool loaded = false;
+};
 
-    std::ifstream map_file(map_path);
-    if (!map_file.is_open()) {
-        std::cerr << "Unable to open map file: random.map" << std::endl;
-        file << "</root>" << std::endl;
-        file.close();
-        return;
+int RunBatch(const std::string& mapPath, double time_limit, bool swap, const RunOptions& opt) {
+    auto t0 = std::chrono::steady_clock::now();
+    // manifest: one instance per line, "<scen_path> <duration_path> [capacity_path]" or "<instance_path>",
+    // relative to the manifest.
+    std::ifstream manifest(opt.batchPath);
+    if (!manifest.is_open()) {
+        std::cerr << "[Error] file '" << opt.batchPath << "' could not be opened" << std::endl;
+        return -1;
     }
-
+    size_t slash = opt.batchPath.find_last_of("/\\");
+    std::string dir = (slash == std::string::npos) ? "" : opt.batchPath.substr(0, slash + 1);
+    auto resolve = [&dir](const std::string& p) {return (p.empty() || p[0] == '/') ? p : dir + p;};
+    std::vector<BatchJob> jobs;
     std::string line;
-    int width = 0, height = 0;
-    std::vector<std::vector<int>> grid;
-
-    while (std::getline(map_file, line)) {
-        if (line.substr(0, 5) == "width") {
-            width = std::stoi(line.substr(6));
-        } else if (line.substr(0, 6) == "height") {
-            height = std::stoi(line.substr(7));
-        } else if (line.substr(0, 3) == "map") {
-            for (int i = 0; i < height; ++i) {
-                std::getline(map_file, line);
-                std::vector<int> row;
-                for (char c : line) {
-                    if (c == '.') {
-                        row.push_back(0); //
-                    } else if (c == '@') {
-                        row.push_back(1); //
-                    } else if (c == 'T') {
-                        row.push_back(2); //
-                    }
-                }
-                grid.push_back(row);
-            }
-        }
+    while (std::getline(manifest, line)) {
+        std::istringstream iss(line);
+        BatchJob job;
+        if (!(iss >> job.scenPath) || job.scenPath[0] == '#') {continue;}
+        iss >> job.durationPath >> job.capacityPath;
+        job.scenPath = resolve(job.scenPath);
+        job.durationPath = resolve(job.durationPath);
+        job.capacityPath = resolve(job.capacityPath);
+        jobs.push_back(job);
     }
 
-    file << "    <map>" << std::endl;
-    file << "        <grid width=\"" << width << "\" height=\"" << height << "\">" << std::endl;
-    for (const auto& row : grid) {
-        file << "            <row>";
-        for (int cell : row) {
-            file << cell << " ";
-        }
-        file << "</row>" << std::endl;
+    // the map is loaded once, every instance attaches its grid to its arrays.
+    raplab::PlannerService service;
+    if (service.LoadMap(mapPath, opt.vertexOrder) != 1 ||
+        (!opt.heuristicStorePath.empty() && service.OpenStore(opt.heuristicStorePath) != 1)) {
+        std::cerr << "Failed to load map: " << mapPath << std::endl;
+        return -1;
     }
-    file << "        </grid>" << std::endl;
-    file << "    </map>" << std::endl;
-
-    file << "    <log>" << std::endl;
-    file << "        <summary time=\"" << runtime << "\" flowtime=\"" << soc << "\" makespan=\"" << makespan << "\"/>" << std::endl;
-    auto colors = assign_colors(result.size());
-    for (size_t i = 0; i < result.size(); ++i) {
-        file << "        <agent number=\"" << i << "\">" << std::endl;
-        file << "            <color RGB=\"(" << std::get<0>(colors[i]) << ", " << std::get<1>(colors[i]) << ", " << std::get<2>(colors[i]) << ")\"/>" << std::endl;
-        file << "            <path duration=\"" << durations[i] << "\">" << std::endl;
-
-        for (size_t j = 0; j < result[i].size(); ++j) {
-            const auto& section = result[i][j];
-            file << "                <section number=\"" << j << "\" start_i=\"" << std::get<0>(std::get<0>(section)) << "\" start_j=\"" << std::get<1>(std::get<0>(section)) << "\" goal_i=\"" << std::get<0>(std::get<1>(section)) << "\" goal_j=\"" << std::get<1>(std::get<1>(section)) << "\" duration=\"" << std::get<3>(section) - std::get<2>(section) << "\"/>" << std::endl;
-        }
-
-        file << "            </path>" << std::endl;
-        file << "        </agent>" << std::endl;
+    if (opt.quarantine) {
+        service.SetInfeasiblePolicy(raplab::InfeasiblePolicy::QUARANTINE);
     }
-    file << "    </log>" << std::endl;
-
-    file << "</root>" << std::endl;
-    file.close();
-}
-
-std::vector<double> readAgentValues(const std::string& filename) {
-    std::vector<double> values;
-    std::ifstream file(filename);
+    service.SetMemoryLimit(size_t(std::max(0L, opt.heuristicMemoryMb)) << 20);
+    int nWorkers = raplab::NumWorkers(opt.jobs);
 
-    if (!file.is_open()) {
-        std::cerr << "无法打开文件：" << filename << std::endl;
-        return values;  // 返回空vector
+    // the instances are independent, they are loaded by the workers too.
+    long rows = service.Grid().GetTableView().rows;
+    long cols = service.Grid().GetTableView().cols;
+    raplab::ParallelFor(jobs.size(), nWorkers, [&](size_t i) {
+        BatchJob& job = jobs[i];
+        raplab::SolveRequest& req = job.req;
+        req.time_limit = time_limit;
+        req.swap = swap;
+        if (job.durationPath.empty() && raplab::IsInstanceFile(job.scenPath)) {
+            // the map of the instance is not used, it must have the size of the map of the batch.
+            raplab::Instance inst;
+            if (raplab::LoadInstance(job.scenPath, &inst) != 1) {return;}
+            if ((inst.rows > 0 && inst.rows != rows) || (inst.cols > 0 && inst.cols != cols)) {
+                std::cerr << "[Error] batch, '" << job.scenPath << "' refers to a " << inst.rows << " x " << inst.cols
+                          << " map, the map is " << rows << " x " << cols << std::endl;
+                return;
+            }
+            req.starts.swap(inst.starts);
+            req.goals.swap(inst.goals);
+            req.durations.swap(inst.durations);
+            for (size_t j = 0; j < inst.cap_vertices.size(); ++j) {
+                req.capacities.emplace_back(inst.cap_vertices[j], int(inst.cap_values[j]));
+            }
+        } else {
+            raplab::ScenarioSelection sel = opt.scenario;
+            std::tuple<int, int> width_height;
+            std::unordered_map<long, int> capacities;
+            if (raplab::ParseAgentDurations(job.durationPath, &req.durations) != 1 || req.durations.empty()) {return;}
+            sel.count = long(req.durations.size());
+            sel.width = cols;
+            sel.height = rows;
+            if (raplab::ParseScenarios_MovingAI(job.scenPath, sel, &req.starts, &req.goals, &width_height) != 1 ||
+                (!job.capacityPath.empty() && raplab::LoadNodeCapacities(job.capacityPath, &capacities) != 1)) {
+                return;
+            }
+            req.durations.resize(req.starts.size());
+            req.capacities.assign(capacities.begin(), capacities.end());
+        }
+        job.loaded = !req.starts.empty();
+    });
+    std::vector<long> allGoals;
+    for (const auto& job : jobs) {
+        allGoals.insert(allGoals.end(), job.req.goals.begin(), job.req.goals.end());
     }
+    // the goal tables are shared by all instances, the missing ones are computed in one batch.
+    service.Prefetch(allGoals);
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string agent;
-        double value;
-        if (iss >> agent >> value) {
-            values.push_back(value);
+    std::ofstream outFile;
+    if (!opt.batchOutPath.empty()) {
+        outFile.open(opt.batchOutPath);
+        if (!outFile.is_open()) {
+            std::cerr << "[Error] file '" << opt.batchOutPath << "' could not be opened" << std::endl;
+            return -1;
         }
     }
+    std::ostream& out = opt.batchOutPath.empty() ? std::cout : outFile;
+    std::mutex outMtx;
+    out << "index\tscen\tstatus\tn_agents\truntime\tmakespan\tsoc" << std::endl;
 
-    file.close();
-    return values;
-}
-
-std::vector<std::tuple<int, int, int>> assign_colors(size_t agent_count) {
-    std::vector<std::tuple<int, int, int>> colors;
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, 255);
-
-    for (size_t _ = 0; _ < agent_count; ++_) {
-        while (true) {
-            std::tuple<int, int, int> color = std::make_tuple(dis(gen), dis(gen), dis(gen));
-            if (color != std::make_tuple(255, 255, 255) && std::find(colors.begin(), colors.end(), color) == colors.end()) {
-                colors.push_back(color);
-                break;
-            }
+    const char* statusNames[] = {"solved", "timeout", "infeasible", "error"};
+    std::atomic<size_t> nSolved(0);
+    raplab::ParallelFor(jobs.size(), nWorkers, [&](size_t i) {
+        BatchJob& job = jobs[i];
+        raplab::SolveResult res;
+        if (job.loaded) {
+            res = service.Solve(job.req);
         }
-    }
-    return colors;
+        nSolved += (res.status == raplab::SOLVE_OK) ? 1 : 0;
+        std::ostringstream row;
+        row << i << "\t" << job.scenPath << "\t" << statusNames[res.status] << "\t" << job.req.starts.size() << "\t"
+            << std::fixed << std::setprecision(3) << res.runtime << "\t" << std::setprecision(2)
+            << res.makespan << "\t" << res.soc;
+        std::lock_guard<std::mutex> lock(outMtx);
+        out << row.str() << std::endl;
+    });
+    service.Flush();
+    std::cerr << "Batch: " << nSolved << " of " << jobs.size() << " instances solved, " << nWorkers << " workers, "
+              << std::fixed << std::setprecision(3) << std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count()
+              << " s" << std::endl;
+    return 1;
 }
 
-
-std::vector<std::vector<std::tuple<std::tuple<int, int>, std::tuple<int, int>, double, double>>> visual_convert(std::tuple<int, int>* width_height, std::vector<std::vector<std::tuple<long, long, double, double>>>* all_paths){
-    std::vector<std::vector<std::tuple<std::tuple<int, int>, std::tuple<int, int>, double, double>>> result;
-    int width = std::get<0>(*width_height);
-    int height = std::get<1>(*width_height);
-    for (size_t i = 0; i < all_paths->size(); ++i) {
-        std::vector<std::tuple<std::tuple<int, int>, std::tuple<int, int>, double, double>> agent_path;
-        for (size_t j = 0; j < all_paths->at(i).size(); ++j) {
-            const auto& section = all_paths->at(i)[j];
-            int start_i = std::get<0>(section) % width;
-            int start_j = std::get<0>(section) / width;
-            int goal_i = std::get<1>(section) % width;
-            int goal_j = std::get<1>(section) / width;
-            double start_time = std::get<2>(section);
-            double end_time = std::get<3>(section);
-            agent_path.push_back(std::make_tuple(std::make_tuple(start_j, start_i), std::make_tuple(goal_j, goal_i), start_time, end_time));
-        }
-        result.push_back(agent_path);
+int RunServer(const std::string& mapPath, const RunOptions& opt) {
+    raplab::PlannerService service;
+    if (service.LoadMap(mapPath, opt.vertexOrder) != 1 ||
+        (!opt.heuristicStorePath.empty() && service.OpenStore(opt.heuristicStorePath) != 1)) {
+        std::cerr << "Failed to load map: " << mapPath << std::endl;
+        return -1;
+    }
+    if (opt.quarantine) {
+        service.SetInfeasiblePolicy(raplab::InfeasiblePolicy::QUARANTINE);
+    }
+    service.SetMemoryLimit(size_t(std::max(0L, opt.heuristicMemoryMb)) << 20);
+    int ret;
+    if (opt.servePath == "-") {
+        // stdout carries the frames, everything printed goes to stderr instead.
+        int out = dup(1);
+        dup2(2, 1);
+        ret = raplab::ServeStream(&service, 0, out, opt.jobs);
+        close(out);
+    } else {
+        std::cerr << "Serving " << mapPath << " on " << opt.servePath << std::endl;
+        ret = raplab::ServeUnixSocket(&service, opt.servePath, opt.jobs);
     }
-    return result;
+    service.Flush();
+    return ret;
 }
@@ -4,11 +4,37 @@
  *******************************************/
 
  #include "mapfaa_lsrp.hpp"
+ #include "trace.hpp"
  #include <functional>
  #include <fstream>
+ #include <chrono>
+ #include <cmath>
+ #ifdef __unix__
+ #include <sys/resource.h>
+ #endif
  
  namespace raplab{
  
+     namespace {
+         double seconds_since(const std::chrono::steady_clock::time_point& t0) {
+             return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+         }
+
+         // keeps LsrpT::_push_depth in sync on every return path of the push recursion
+         struct DepthGuard {
+             explicit DepthGuard(long& depth) : _depth(depth) {++_depth;}
+             ~DepthGuard() {--_depth;}
+             long& _depth;
+         };
+
+         // approximated footprint of a libstdc++ node based hash map: buckets + one node per element.
+         template<typename Map>
+         size_t hash_map_bytes(const Map& m) {
+             return m.bucket_count() * sizeof(void*) +
+                    m.size() * (sizeof(void*) + sizeof(typename Map::value_type) + sizeof(size_t));
+         }
+     }
+ 
      /**
       * State of certain agent in a period of time
       * @param parent_v parent vertex
@@ -117,38 +143,157 @@
  
  
      //Lsrp part main function
-     Lsrp::Lsrp() {};
+     template <typename G>
+     LsrpT<G>::LsrpT() {};
  
-     Lsrp::~Lsrp() {
+     template <typename G>
+     LsrpT<G>::~LsrpT() {
          for (Agent* agent : _agents) {
              delete agent;
          }
          _agents.clear();
      };
  
-     CostVec Lsrp::GetPlanCost(long nid) {
+     template <typename G>
+     CostVec LsrpT<G>::GetPlanCost(long nid) {
          CostVec out(_graph->CostDim(), 0);
          out[0] = re_soc();
          out[1] = re_makespan();
          return out;
      }
  
-     int Lsrp::Solve(std::vector<long> &starts, std::vector<long> &goals, double time_limit, double eps)
+     template <typename G>
+     int LsrpT<G>::Solve(std::vector<long> &starts, std::vector<long> &goals, double time_limit, double eps)
      {
          if (starts.empty()) {return 1;}
+         if (starts.size() > size_t(std::numeric_limits<int>::max()) || goals.size() != starts.size()) {
+             std::cout << "[ERROR] Lsrp::Solve, " << starts.size() << " starts and " << goals.size()
+                       << " goals, agent ids are int" << std::endl;
+             throw std::runtime_error("[ERROR] Lsrp::Solve, invalid number of agents");
+         }
+         TraceSpan span("Solve", "n_agents", starts.size());
+         _counters = LsrpStats();
          _Sinit = starts;
          _Send = goals;
+         find_infeasible_agents();
+         _counters.n_infeasible = _infeasible.size();
+         if (!_infeasible.empty()) {
+             std::cout << "[CAVEAT] Lsrp::Solve, " << _infeasible.size() << " agents cannot reach their goal:";
+             for (size_t i = 0; i < _infeasible.size() && i < 10; ++i) {std::cout << " " << _infeasible[i];}
+             std::cout << (_infeasible.size() > 10 ? " ..." : "") << std::endl;
+             if (_infeasible_policy == InfeasiblePolicy::REJECT) {
+                 return 0;
+             }
+             for (long i : _infeasible) {
+                 _Send[i] = _Sinit[i]; // quarantined, the agent stays at its start.
+             }
+         }
+         if (!_dlog_path.empty()) {
+             open_decision_log();
+         }
+         auto t_heu = std::chrono::steady_clock::now();
          _dis_table = generate_distable();
+         _counters.t_heuristic = seconds_since(t_heu);
          set_agents();
          _S_T = set_initPolicy();
           Set_minduration();
          _time_limit = time_limit;
          _lsrp();
+         if (_dlog.Active()) {
+             _dlog.Begin(DLOG_END);
+             _dlog.PutU(_counters.n_events);
+             _dlog.PutF(_soc);
+             _dlog.PutF(_makespan);
+             _dlog.End();
+             _dlog.Close();
+         }
          return 1;
      }
+
+     template <typename G>
+     void LsrpT<G>::open_decision_log() {
+         DecisionLogHeader header;
+         header.n_agents = _Sinit.size();
+         header.input_digest = DigestBytes(_Sinit.data(), _Sinit.size() * sizeof(long));
+         header.input_digest = DigestBytes(_Send.data(), _Send.size() * sizeof(long), header.input_digest);
+         header.input_digest = DigestBytes(_duration.data(), _duration.size() * sizeof(double), header.input_digest);
+         if (!_dlog_replay) {
+             header.seed = _seed;
+             header.flags = _swap ? 1 : 0;
+             _dlog.OpenRecord(_dlog_path, header);
+             return;
+         }
+         DecisionLogHeader logged;
+         if (_dlog.OpenVerify(_dlog_path, &logged) != 1) {
+             return;
+         }
+         if (logged.n_agents != header.n_agents || logged.input_digest != header.input_digest) {
+             std::cout << "[CAVEAT] Lsrp, the replayed instance differs from the logged one." << std::endl;
+         }
+         // re-execute with the logged options.
+         set_seed(logged.seed);
+         _swap = (logged.flags & 1) != 0;
+     }
+
+     template <typename G>
+     void LsrpT<G>::log_event(double t, const std::vector<Agent*>& curr_agents) {
+         if (!_dlog.Active()) {return;}
+         _dlog.Begin(DLOG_EVENT);
+         _dlog.PutF(t);
+         _dlog.PutU(curr_agents.size());
+         for (const Agent* a : curr_agents) {
+             _dlog.PutU(a->get_id());
+         }
+         _dlog.End();
+     }
+
+     template <typename G>
+     void LsrpT<G>::log_shuffle(const Agent& agent, const std::vector<long>& C) {
+         if (!_dlog.Active()) {return;}
+         _dlog.Begin(DLOG_SHUFFLE);
+         _dlog.PutU(agent.get_id());
+         _dlog.PutU(C.size());
+         for (long v : C) {
+             _dlog.PutS(v);
+         }
+         _dlog.End();
+     }
+
+     template <typename G>
+     void LsrpT<G>::log_push(const Agent& agent, const Agent& pushed, bool success) {
+         if (!_dlog.Active()) {return;}
+         _dlog.Begin(DLOG_PUSH);
+         _dlog.PutU(agent.get_id());
+         _dlog.PutU(pushed.get_id());
+         _dlog.PutU(success);
+         _dlog.End();
+     }
+
+     template <typename G>
+     void LsrpT<G>::log_swap(const Agent& agent, const Agent& partner, bool applied) {
+         if (!_dlog.Active()) {return;}
+         _dlog.Begin(DLOG_SWAP);
+         _dlog.PutU(agent.get_id());
+         _dlog.PutU(partner.get_id());
+         _dlog.PutU(applied);
+         _dlog.End();
+     }
+
+     // outcome: 0 = moved or waited directly, 1 = waits for a pushed agent then moves, 2 = no candidate left.
+     template <typename G>
+     void LsrpT<G>::log_decision(const Agent& agent, long v, int outcome, double endT) {
+         if (!_dlog.Active()) {return;}
+         _dlog.Begin(DLOG_DECISION);
+         _dlog.PutU(agent.get_id());
+         _dlog.PutS(v);
+         _dlog.PutU(outcome);
+         _dlog.PutF(endT);
+         _dlog.End();
+     }
  
  
-     void Lsrp::Set_minduration()
+     template <typename G>
+     void LsrpT<G>::Set_minduration()
      {
          _min_duration = *std::min_element(_duration.begin(), _duration.end());
          if (!edge_cost.empty()) {
@@ -164,10 +309,34 @@
  
  // A list stored all the distance_table for each agent.
  // Heuristic function related
-     std::vector<std::unordered_map<long, double>> Lsrp::generate_distable() {
+     template <typename G>
+     std::vector<std::unordered_map<long, double>> LsrpT<G>::generate_distable() {
          std::vector<std::unordered_map<long, double>> distable;
+         _dis_hops.assign(_hop_source ? _Sinit.size() : 0, HopTable());
+         _dis_steps.assign(_dis_hops.size(), std::vector<double>());
          for (size_t i = 0; i < _Sinit.size(); ++i) {
-             distable.push_back(generate_single_dis_table(static_cast<int>(i)));
+             TraceSpan span("generate_distable", "agent", i);
+             if (_hop_source && edge_cost.find(int(i)) == edge_cost.end()) {
+                 _dis_hops[i] = _hop_source(_Send[i]);
+                 // a BFS distance is below the vertex count, a larger max_hop comes from a corrupted table.
+                 if (_dis_hops[i].hops && uint64_t(_dis_hops[i].max_hop) >= uint64_t(_graph->NumVertex())) {
+                     _dis_hops[i] = HopTable();
+                 }
+             }
+             if (!_dis_hops.empty() && _dis_hops[i].hops) {
+                 // the BFS adds the duration once per move, so repeat the same additions to get
+                 // bit-identical values.
+                 std::vector<double>& steps = _dis_steps[i];
+                 steps.resize(size_t(_dis_hops[i].max_hop) + 1);
+                 steps[0] = 0;
+                 for (size_t k = 1; k < steps.size(); ++k) {
+                     steps[k] = steps[k-1] + _duration[i];
+                 }
+                 // keep the indices of the other tables aligned with the agent ids.
+                 distable.push_back(std::unordered_map<long, double>());
+             } else {
+                 distable.push_back(generate_single_dis_table(static_cast<int>(i)));
+             }
          }
          return distable;
      }
@@ -175,7 +344,8 @@
  //A method generate bfs value for each agent, each coordination corresponds to a specific value and were used as
  //heuristic value for each state
  //Because bfs promises the optimal path for a single agent and it is relatively fast
-     std::unordered_map<long, double> Lsrp::generate_single_dis_table(int agent) {
+     template <typename G>
+     std::unordered_map<long, double> LsrpT<G>::generate_single_dis_table(int agent) {
          std::deque<long> tmp;
          tmp.push_back(_Send[agent]);
          const double inf = std::numeric_limits<double>::max();
@@ -186,7 +356,7 @@
          while (!tmp.empty()) {
              long curr = tmp.front();
              tmp.pop_front();
-             std::vector<long> successors = _graph->GetSuccs(curr);
+             ArcSpan successors = succs(curr);
              for (long neigh : successors) {
                  if (!edge_cost.empty() && edge_cost.find(agent) != edge_cost.end() && edge_cost[agent].find(edge_hash(curr, neigh)) != edge_cost[agent].end()) {
                      // this edge cost for this agent is specified
@@ -206,32 +376,77 @@
          return dist_table;
      }
  
-     // A method using cantor hash the edges
-     int Lsrp::edge_hash(long a, long b) const{
-         if (a > b)
-         {
-             return(a + b) * (a + b + 1) / 2 + b;
+     // Convert the cantor hash of the edges into EdgeKey
+     template <typename G>
+     void LsrpT<G>::set_edge_cost(const std::unordered_map<int,std::unordered_map<int,double>>& cantor_cost) {
+         edge_cost.clear();
+         for (const auto& agent_cost : cantor_cost) {
+             auto& out = edge_cost[agent_cost.first];
+             for (const auto& kv : agent_cost.second) {
+                 // z = s*(s+1)/2 + min(a,b) with s = a+b, and min(a,b) <= s, so s is the largest
+                 // integer with s*(s+1)/2 <= z.
+                 long z = kv.first;
+                 long s = long((std::sqrt(8.0 * double(z) + 1.0) - 1.0) / 2.0);
+                 while (s * (s + 1) / 2 > z) {s--;}
+                 while ((s + 1) * (s + 2) / 2 <= z) {s++;}
+                 long lo = z - s * (s + 1) / 2;
+                 out[edge_hash(lo, s - lo)] = kv.second;
+             }
          }
-         return(a + b) * (b + a + 1) / 2 + a;
      }
  
  //A function calculates heuristic value of a given state
  //        take in a serial number of a agent eg: 1
  //        and a coordination id eg: 34
  //        return h value
-     double Lsrp::get_h(const Agent& agent, const long& coord) {
-         return _dis_table[agent.get_id()].at(coord);
+     template <typename G>
+     double LsrpT<G>::get_h(const Agent& agent, const long& coord) {
+         if (!_dis_hops.empty() && _dis_hops[agent.get_id()].hops) {
+             uint32_t k = _dis_hops[agent.get_id()].hops[coord];
+             if (k == kUnreachableHop) {return std::numeric_limits<double>::infinity();}
+             const std::vector<double>& steps = _dis_steps[agent.get_id()];
+             // the sources check their tables, an entry above max_hop would be a bug: stay in bounds.
+             assert(k < steps.size());
+             return k < steps.size() ? steps[k] : double(k) * _duration[agent.get_id()];
+         }
+         const std::unordered_map<long, double>& table = _dis_table[agent.get_id()];
+         auto it = table.find(coord);
+         return it == table.end() ? std::numeric_limits<double>::infinity() : it->second;
+     }
+
+     template <typename G>
+     void LsrpT<G>::find_infeasible_agents() {
+         _infeasible.clear();
+         const std::vector<long>* label = _ext_labels;
+         if (label == nullptr || label->size() != _graph->NumVertex()) {
+             if (_labels_graph != _graph || _labels_version != _graph->ArcVersion() || _labels.size() != _graph->NumVertex()) {
+                 ComputeComponents(_graph, &_labels);
+                 _labels_graph = _graph;
+                 _labels_version = _graph->ArcVersion();
+             }
+             label = &_labels;
+         }
+         long n = long(label->size());
+         for (size_t i = 0; i < _Sinit.size(); ++i) {
+             long s = _Sinit[i];
+             long g = _Send[i];
+             if (s < 0 || s >= n || g < 0 || g >= n || (*label)[s] < 0 || (*label)[s] != (*label)[g]) {
+                 _infeasible.push_back(long(i));
+             }
+         }
      }
  
  //Set up initial priority based on decreasing order of their duration
  //        set a list of agents class, contains a numbers of agents
  //        And set up initial priority by given a unique value in the interval between 0 - 1
-     void Lsrp::set_agents() {
+     template <typename G>
+     void LsrpT<G>::set_agents() {
          size_t n = _Send.size();
          double gap = 1.0 / (n + 1);
          for (int i = 0; i < _Sinit.size(); ++i) {
              _agents.push_back(new Agent(static_cast<int>(i), _Sinit[i], _Send[i]));
          }
+         if (LSRP_STATS) {_counters.n_states += _Sinit.size();}
          for (int i = 0; i<_agents.size(); i++) {
              _agents[i]->set_init_priority(i * gap);
          }
@@ -240,7 +455,8 @@
  // A method set initial states
  // eg: [(s11, s21, s31, s41, ·······)]
  // also set occupation and referred time policy
-     std::vector<std::vector<State*>> Lsrp::set_initPolicy() {
+     template <typename G>
+     std::vector<std::vector<State*>> LsrpT<G>::set_initPolicy() {
          std::vector<std::vector<State*>> policy;
          std::vector<State*> States_init;
          States_init.reserve(_Sinit.size());
@@ -252,7 +468,8 @@
      }
  
  // Check if all agents reach goal
-     bool Lsrp::reach_Goal() const {
+     template <typename G>
+     bool LsrpT<G>::reach_Goal() const {
          for (const auto& agent : _agents) {
              if (!agent->is_at_goal()) {
                  return false;
@@ -266,7 +483,8 @@
  // Using for the wait time of certain agent
  // Inspired by ls-rM*
  // if there are no time, return None
-     double Lsrp::get_tmin2() const {
+     template <typename G>
+     double LsrpT<G>::get_tmin2() const {
          if (_T.empty()) {
              return -1; // Return NaN if there is no next time
          }
@@ -275,7 +493,8 @@
  
  // A function which extracts agents from all agents
  // The filter is based on the given t and extracts agent whose curr state with arriving time at t
-     std::vector<Agent*> Lsrp::extract_Agents(double t) {
+     template <typename G>
+     std::vector<Agent*> LsrpT<G>::extract_Agents(double t) {
          std::vector<Agent*> return_agents;
          for (int i = 0; i <  _agents.size(); i++) {
              if (_agents[i]->get_curr()->get_endT() == t) {
@@ -289,7 +508,8 @@
  //A method that generate state tuple
  //that agent no needed to plan in this timestamp are added in
  //while those reach endT are set to be None and implemented by Lsrp later
-     std::vector<State*> Lsrp::get_rawSnext(std::vector<State*> S_from,
+     template <typename G>
+     std::vector<State*> LsrpT<G>::get_rawSnext(std::vector<State*> S_from,
                                                             const std::vector<Agent*>& curr_agents, double t) const {
          std::vector<State*> re_S;
          const std::vector<State*>* t_policy_ptr = nullptr;
@@ -322,7 +542,8 @@
  
  //Update the priority of each agent, even though some of their agent still at their last moving state
  //There are three versions of it. Referred to the details from following content.
-     void Lsrp::update_Priority() {
+     template <typename G>
+     void LsrpT<G>::update_Priority() {
          for (int i = 0; i <  _agents.size(); i++) {
              if (_agents[i]->is_at_goal()) {
                  _agents[i]->set_priority(_agents[i]->get_init_priority());
@@ -333,7 +554,8 @@
      }
  
  // return the given duration
-     double Lsrp::get_duration(const Agent& agent,long v1, long v2) const {
+     template <typename G>
+     double LsrpT<G>::get_duration(const Agent& agent,long v1, long v2) const {
          auto edge = edge_hash(v1,v2);
          if (!edge_cost.empty() && edge_cost.find(agent.get_id()) != edge_cost.end() && edge_cost.at(agent.get_id()).find(edge) != edge_cost.at(agent.get_id()).end())
          {
@@ -343,7 +565,8 @@
      }
  
  // A Method generate state
-     State Lsrp::generate_state(const long& v, const Agent& agent,
+     template <typename G>
+     State LsrpT<G>::generate_state(const long& v, const Agent& agent,
                                     const std::vector<State*>& Sfrom, double* tmin2) const {
          auto parent_ptr = Sfrom[agent.get_id()];
          if (parent_ptr == nullptr) {
@@ -368,7 +591,8 @@
  //the collision model wo used here is the same as lsrm*
  //No worry edge collision， p is occupied and no swap would happened
  //Also avoid that vertex is being pibted
-     bool Lsrp::check_Occupied(const Agent& agent, const long& v,
+     template <typename G>
+     bool LsrpT<G>::check_Occupied(const Agent& agent, const long& v,
                                    const std::vector<State*>& Sto,
                                    const std::vector<long>& constrain_list, bool in_push_possible) const {
          for (size_t index = 0; index < Sto.size(); ++index) {
@@ -403,7 +627,8 @@
  
  //A method check if the low priority deadlock situation is going to happen
  //If it is, Return True and starts the lsrp process
-     bool Lsrp::check_potential_deadlock(const long& v, const Agent& ag,
+     template <typename G>
+     bool LsrpT<G>::check_potential_deadlock(const long& v, const Agent& ag,
                                              const std::vector<State*>& Sfrom,
                                              const std::vector<State*>& Sto) const {
          auto parent = Sfrom[ag.get_id()];
@@ -414,7 +639,8 @@
      }
  
  //generate the ag that needed to be inheritance priority
-     Agent* Lsrp::push_required(const std::vector<Agent*>& curr_agents, const Agent& agent,
+     template <typename G>
+     Agent* LsrpT<G>::push_required(const std::vector<Agent*>& curr_agents, const Agent& agent,
                                               const long& v,
                                               const std::vector<State*>& Sfrom,
                                               const std::vector<State*>& Sto) const {
@@ -432,7 +658,8 @@
  
  //Helper function
  //insert state to specific time's policy
-     void Lsrp::insert_policy(const std::vector<std::tuple<Agent, State*>>& agent_state_list,
+     template <typename G>
+     void LsrpT<G>::insert_policy(const std::vector<std::tuple<Agent, State*>>& agent_state_list,
                                   std::unordered_map<double, std::vector<State*>>& new_policy) const {
          for (const auto& agent_state : agent_state_list) {
              const Agent& agent = std::get<0>(agent_state);
@@ -447,7 +674,8 @@
  
  // Merge successful policy with self.t_policy
  // Also insert time to the timestamp list
-     void Lsrp::merge_policy(const std::unordered_map<double, std::vector<State*>>& new_policy, double curr_t) {
+     template <typename G>
+     void LsrpT<G>::merge_policy(const std::unordered_map<double, std::vector<State*>>& new_policy, double curr_t) {
          for (const auto& pair : new_policy) {
              const auto& t = pair.first;
              const auto& S_t = pair.second;
@@ -472,8 +700,16 @@
          }
      }
  
+ // Every state created during the search goes through here, so that it is counted.
+     template <typename G>
+     State* LsrpT<G>::new_state(const State& s) {
+         if (LSRP_STATS) {++_counters.n_states;}
+         return new State(s);
+     }
+
  // Update all the information
-     void Lsrp::update(const std::vector<Agent*>& curr_agents, std::vector<State*> Sto) {
+     template <typename G>
+     void LsrpT<G>::update(const std::vector<Agent*>& curr_agents, std::vector<State*> Sto) {
          _S_T.push_back(Sto);
  
          for (Agent* agent : curr_agents) {
@@ -499,7 +735,8 @@
  
  
  // Calculate the soc cost of the algorithm
-     double Lsrp::get_Soc() {
+     template <typename G>
+     double LsrpT<G>::get_Soc() {
          //double g = 0.0;
          std::vector<double> sum_g(_agents.size(), 0.0);
  
@@ -533,7 +770,8 @@
      }
  
  //Return makespan cost
-     double Lsrp::get_makespan() {
+     template <typename G>
+     double LsrpT<G>::get_makespan() {
          // Get the last policy entry
          const std::vector<State*>& Sfrom = _S_T.back();
  
@@ -551,7 +789,8 @@
  // """
  //        extract each agents' policy
  //        """
-     void Lsrp::extract_policy(){
+     template <typename G>
+     void LsrpT<G>::extract_policy(){
          std::vector<std::vector<std::tuple<long, long, double, double>>> all_paths(_agents.size());
  
          // Add the first
@@ -597,7 +836,8 @@
      }
  
  
-     Agent *Lsrp::swap_required_possible(const std::vector<Agent *> &curr_agents, const Agent &agent,
+     template <typename G>
+     Agent *LsrpT<G>::swap_required_possible(const std::vector<Agent *> &curr_agents, const Agent &agent,
                                          const std::vector<State *> &Sfrom, std::vector<State *> &Sto,
                                          std::vector<long> &C) {
          if (C[0] == Sfrom[agent.get_id()]->get_v()) {return nullptr;} // the agent wants to stay here
@@ -607,7 +847,7 @@
          && swap_possible(Sfrom,Sto,Sfrom[aj->get_id()]->get_v(),Sfrom[agent.get_id()]->get_v())) {
              return aj;
          }
-         for (long u : _graph->GetSuccs(Sfrom[agent.get_id()]->get_v()))
+         for (long u : succs(Sfrom[agent.get_id()]->get_v()))
          {
              auto ak = Check_occupied_forSwap(curr_agents,u,Sfrom,Sto, true);
              if (ak == nullptr || C[0] == Sfrom[ak->get_id()]->get_v()) { continue;}
@@ -619,21 +859,22 @@
          return nullptr;
      }
  
-     bool Lsrp::swap_required(const Agent &pusher, const Agent &puller, const std::vector<State *> &Sfrom,
+     template <typename G>
+     bool LsrpT<G>::swap_required(const Agent &pusher, const Agent &puller, const std::vector<State *> &Sfrom,
                               std::vector<State *> &Sto,long v_pusher_init,long v_puller_init) {
          //initialize
          long v_pusher = v_pusher_init;
          long v_puller = v_puller_init;
-         long next;  // the next move of puller
+         long next = -1;  // the next move of puller, set whenever n == 1 below
          while (get_h(pusher,v_puller) < get_h(pusher,v_pusher))  // avoid endless loop
          {
-             std::vector<long> v_puller_nghs = _graph->GetSuccs(v_puller);
-             int n = v_puller_nghs.size();
+             ArcSpan v_puller_nghs = succs(v_puller);
+             int n = v_puller_nghs.size;
              for (long u : v_puller_nghs)
              {
                  auto a = Check_occupied_forSwap({},u,Sfrom,Sto, false);
                  if (u == v_pusher ||
-                     (_graph->GetSuccs(u)).size() == 1 && a != nullptr && _Send[a->get_id()] == u){
+                     out_degree(u) == 1 && a != nullptr && _Send[a->get_id()] == u){
                      --n;
                  } else {
                      next = u;
@@ -652,21 +893,22 @@
          // check if  when reach the dead end, the distance of pusher and puller to their goal are lowest among two of them
      }
  
-     bool Lsrp::swap_possible(const std::vector<State *> &Sfrom, std::vector<State *> &Sto, long v_pusher_init,
+     template <typename G>
+     bool LsrpT<G>::swap_possible(const std::vector<State *> &Sfrom, std::vector<State *> &Sto, long v_pusher_init,
                               long v_puller_init) {
          //initialize
          long v_pusher = v_pusher_init;
          long v_puller = v_puller_init;
-         long next;  // the next move of puller
+         long next = -1;  // the next move of puller, set whenever n == 1 below
          while (v_puller != v_pusher_init)  // avoid endless loop
          {
-             std::vector<long> v_puller_nghs = _graph->GetSuccs(v_puller);
-             int n = v_puller_nghs.size();
+             ArcSpan v_puller_nghs = succs(v_puller);
+             int n = v_puller_nghs.size;
              for (long u : v_puller_nghs)
              {
                  auto a = Check_occupied_forSwap({},u,Sfrom,Sto, false);
                  if (u == v_pusher ||
-                 (_graph->GetSuccs(u)).size() == 1 && a != nullptr && _Send[a->get_id()] == u){
+                 out_degree(u) == 1 && a != nullptr && _Send[a->get_id()] == u){
                      --n;
                  } else {
                      next = u;
@@ -681,7 +923,8 @@
          return false; // swap impossible there is a loop here
      }
  
-     Agent *Lsrp::Check_occupied_forSwap(const std::vector<Agent *> &curr_agents, const long &u,
+     template <typename G>
+     Agent *LsrpT<G>::Check_occupied_forSwap(const std::vector<Agent *> &curr_agents, const long &u,
                                          const std::vector<State *> &Sfrom, const std::vector<State *> &Sto,
                                          bool curr_A_required) {
          if (curr_A_required) {
@@ -702,9 +945,16 @@
          }
      }
  
-        double Lsrp::_asy_push(Agent &agent, std::vector<State *> &Sto, const std::vector<State *> &Sfrom,
+        template <typename G>
+        double LsrpT<G>::_asy_push(Agent &agent, std::vector<State *> &Sto, const std::vector<State *> &Sfrom,
                         const std::vector<Agent *> &curr_agents, double tmin2, double curr_t, std::vector<long> &constrain_list, bool bp) {
          //abandoned version   The integration of push_required_possible and  pibt
+         DepthGuard depth_guard(_push_depth);
+         TraceSpan span("_asy_push", "depth", _push_depth);
+         if (LSRP_STATS) {
+             ++_counters.n_push_calls;
+             _counters.max_push_depth = std::max(_counters.max_push_depth, _push_depth);
+         }
          std::vector<long> C;
          if (!bp)
          {
@@ -713,10 +963,11 @@
          {
              C = {};
          }
-         const auto& neighbors = _graph->GetSuccs(agent.get_curr()->get_v());
+         ArcSpan neighbors = succs(agent.get_curr()->get_v());
          C.insert(C.end(), neighbors.begin(), neighbors.end());
  
          std::shuffle(C.begin(), C.end(), _rng);
+         log_shuffle(agent, C);
          std::sort(C.begin(), C.end(), [&](const long& coord1, const long& coord2) {
              return get_h(agent, coord1) < get_h(agent, coord2);
          });
@@ -732,6 +983,7 @@
  
          for (const auto& v : C) {
              if (check_Occupied(agent, v, Sto, constrain_list, bp)) {
+                 if (LSRP_STATS) {++_counters.n_occupied_reject;}
                  continue;
              }
  
@@ -744,16 +996,19 @@
                  double twait;
                  // std::tie(twait, new_policy) = push_possible(*ag, Sto, Sfrom, curr_agents, tmin2, curr_t, new_constrain_list);
                  twait = _asy_push(*ag, Sto, Sfrom, curr_agents, tmin2, curr_t, constrain_list, true);
+                 log_push(agent, *ag, twait != -1);
                  if (twait == -1) {
+                     if (LSRP_STATS) {++_counters.n_push_fail;}
                      continue;
                  }
+                 if (LSRP_STATS) {++_counters.n_push_success;}
  
                  auto parent = Sfrom[agent.get_id()];
-                 State* next_state = new State(parent->get_v(), parent->get_v(), parent->get_endT(), twait);
+                 State* next_state = new_state(State(parent->get_v(), parent->get_v(), parent->get_endT(), twait));
                  Sto[agent.get_id()] = next_state;
                  // push possible so we wait here
                  double tmove = twait + get_duration(agent,parent->get_v(),v);
-                 State* next_next_state = new State(parent->get_v(), v, twait, tmove);
+                 State* next_next_state = new_state(State(parent->get_v(), v, twait, tmove));
                  // at next timestamp, go to the push_required agent's place
                  std::vector<std::tuple<Agent, State*>> agent_state_list;
                  agent_state_list.push_back({agent, next_state});
@@ -761,9 +1016,10 @@
                  std::unordered_map<double, std::vector<State*>> new_policy;
                  insert_policy(agent_state_list, new_policy);
                  merge_policy(new_policy, curr_t);
+                 log_decision(agent, v, 1, tmove);
                  return tmove;
              } else {
-                 State* next_state = new State(generate_state(v, agent, Sfrom, &tmin2));
+                 State* next_state = new_state(generate_state(v, agent, Sfrom, &tmin2));
                  Sto[agent.get_id()] = next_state;
                  // directly insert next state because this must be the final step of push_possible
                  std::unordered_map<double, std::vector<State*>> new_policy;
@@ -771,15 +1027,24 @@
                  agent_state_list.push_back({agent, next_state});
                  insert_policy(agent_state_list, new_policy);
                  merge_policy(new_policy, curr_t);
+                 log_decision(agent, v, 0, next_state->get_endT());
                  return next_state->get_endT();
              }
          }
+         log_decision(agent, -1, 2, -1);
          return -1;
      }
  
-     double Lsrp::_asy_push_swap(Agent &agent, std::vector<State *> &Sto, const std::vector<State *> &Sfrom,
+     template <typename G>
+     double LsrpT<G>::_asy_push_swap(Agent &agent, std::vector<State *> &Sto, const std::vector<State *> &Sfrom,
                         const std::vector<Agent *> &curr_agents, double tmin2, double curr_t,std::vector<long> &constrain_list, bool bp) {
          //abandoned version   The integration of push_required_possible and  pibt
+         DepthGuard depth_guard(_push_depth);
+         TraceSpan span("_asy_push", "depth", _push_depth);
+         if (LSRP_STATS) {
+             ++_counters.n_push_calls;
+             _counters.max_push_depth = std::max(_counters.max_push_depth, _push_depth);
+         }
          std::vector<long> C;
          if (!bp)
          {
@@ -788,15 +1053,18 @@
          {
              C = {};
          }
-         const auto& neighbors = _graph->GetSuccs(agent.get_curr()->get_v());
+         ArcSpan neighbors = succs(agent.get_curr()->get_v());
          C.insert(C.end(), neighbors.begin(), neighbors.end());
  
          std::shuffle(C.begin(), C.end(), _rng);
+         log_shuffle(agent, C);
          std::sort(C.begin(), C.end(), [&](const long& coord1, const long& coord2) {
              return get_h(agent, coord1) < get_h(agent, coord2);
          });
          auto ak = swap_required_possible(curr_agents,agent,Sfrom,Sto,C);
          if (ak != nullptr) {
+             if (LSRP_STATS) {++_counters.n_swap_triggered;}
+             log_swap(agent, *ak, false);
              std::reverse(C.begin(), C.end());
          }
  
@@ -811,6 +1079,7 @@
  
              for (const auto& v : C) {
                  if (check_Occupied(agent, v, Sto, constrain_list, bp)) {
+                     if (LSRP_STATS) {++_counters.n_occupied_reject;}
                      continue;
                  }
  
@@ -823,18 +1092,21 @@
                      double twait;
                      // std::tie(twait, new_policy) = push_possible(*ag, Sto, Sfrom, curr_agents, tmin2, curr_t, new_constrain_list);
                      twait = _asy_push_swap(*ag, Sto, Sfrom, curr_agents, tmin2, curr_t, constrain_list, true);
+                     log_push(agent, *ag, twait != -1);
                      if (twait == -1) {
                          // not push_possible  we go with
+                         if (LSRP_STATS) {++_counters.n_push_fail;}
                          continue;
                      }
+                     if (LSRP_STATS) {++_counters.n_push_success;}
  
                      std::unordered_map<double, std::vector<State*>> new_policy;
                      auto parent = Sfrom[agent.get_id()];
-                     State* next_state = new State(parent->get_v(), parent->get_v(), parent->get_endT(), twait);
+                     State* next_state = new_state(State(parent->get_v(), parent->get_v(), parent->get_endT(), twait));
                      Sto[agent.get_id()] = next_state;
                      // push possible so we wait here
                      double tmove = twait + get_duration(agent,parent->get_v(),v);
-                     State* next_next_state = new State(parent->get_v(), v, twait, tmove);
+                     State* next_next_state = new_state(State(parent->get_v(), v, twait, tmove));
                      // at next timestamp, go to the push_required agent's place
                      std::vector<std::tuple<Agent, State*>> agent_state_list;
                      agent_state_list.push_back({agent, next_state});
@@ -842,44 +1114,52 @@
                      if (!bp && v == C.front() && v != Sfrom[agent.get_id()]->get_v() && ak != nullptr &&
                      Sto[ak->get_id()] == nullptr) {
                          const State* parent_ak = Sfrom[ak->get_id()];
-                         State* next_ak_state = new State(parent_ak->get_v(),parent_ak->get_v(),
-                                                          parent_ak->get_endT(),tmove);
+                         State* next_ak_state = new_state(State(parent_ak->get_v(),parent_ak->get_v(),
+                                                          parent_ak->get_endT(),tmove));
                          Sto[ak->get_id()] = next_ak_state;
-                         State* next_next_ak_state = new State(parent_ak->get_v(),Sfrom[agent.get_id()]->get_v(),
-                                                               tmove,tmove + get_duration(*ak,parent_ak->get_v(),Sfrom[agent.get_id()]->get_v()));
+                         State* next_next_ak_state = new_state(State(parent_ak->get_v(),Sfrom[agent.get_id()]->get_v(),
+                                                               tmove,tmove + get_duration(*ak,parent_ak->get_v(),Sfrom[agent.get_id()]->get_v())));
                          agent_state_list.push_back({*ak, next_ak_state});
                          agent_state_list.push_back({*ak, next_next_ak_state});
+                         if (LSRP_STATS) {++_counters.n_swap_applied;}
+                         log_swap(agent, *ak, true);
                      }
                      insert_policy(agent_state_list, new_policy);
                      merge_policy(new_policy, curr_t);
+                     log_decision(agent, v, 1, tmove);
                      return tmove;
                  } else {
-                     State* next_state = new State(generate_state(v, agent, Sfrom, &tmin2));
+                     State* next_state = new_state(generate_state(v, agent, Sfrom, &tmin2));
                      Sto[agent.get_id()] = next_state;
                      std::vector<std::tuple<Agent, State*>> agent_state_list;
                      std::unordered_map<double, std::vector<State*>> new_policy;
                      if (!bp && v == C.front() && v != Sfrom[agent.get_id()]->get_v() && ak != nullptr &&
                      Sto[ak->get_id()] == nullptr) {
                          const State* parent_ak = Sfrom[ak->get_id()];
-                         State* next_ak_state = new State(parent_ak->get_v(),parent_ak->get_v(),
-                                                          parent_ak->get_endT(),curr_t + get_duration(agent,Sfrom[agent.get_id()]->get_v(),v));
+                         State* next_ak_state = new_state(State(parent_ak->get_v(),parent_ak->get_v(),
+                                                          parent_ak->get_endT(),curr_t + get_duration(agent,Sfrom[agent.get_id()]->get_v(),v)));
                          Sto[ak->get_id()] = next_ak_state;
-                         State* next_next_ak_state = new State(parent_ak->get_v(),Sfrom[agent.get_id()]->get_v(),
+                         State* next_next_ak_state = new_state(State(parent_ak->get_v(),Sfrom[agent.get_id()]->get_v(),
                                                                curr_t + get_duration(agent,Sfrom[agent.get_id()]->get_v(),v),
-                                                               curr_t + get_duration(agent,Sfrom[agent.get_id()]->get_v(),v) + get_duration(*ak,parent_ak->get_v(),Sfrom[agent.get_id()]->get_v()));
+                                                               curr_t + get_duration(agent,Sfrom[agent.get_id()]->get_v(),v) + get_duration(*ak,parent_ak->get_v(),Sfrom[agent.get_id()]->get_v())));
                          agent_state_list.push_back({*ak, next_ak_state});
                          agent_state_list.push_back({*ak, next_next_ak_state});
+                         if (LSRP_STATS) {++_counters.n_swap_applied;}
+                         log_swap(agent, *ak, true);
                      }
                      agent_state_list.push_back({agent, next_state});
                      insert_policy(agent_state_list, new_policy);
                      merge_policy(new_policy, curr_t);
+                     log_decision(agent, v, 0, next_state->get_endT());
                      return next_state->get_endT();
                  }
              }
+         log_decision(agent, -1, 2, -1);
          return -1;
      }
  
-     int Lsrp::_lsrp() {
+     template <typename G>
+     int LsrpT<G>::_lsrp() {
          _T.push(0.0);  // start time: 0 for all
          _T_set.insert(0.0);
  
@@ -892,6 +1172,7 @@
              if (elapsed_time > timeout_limit) {
                  std::chrono::duration<double> duration = current_time - start_time;
                  _runtime =  duration.count();
+                 _counters.t_search = _runtime;
                  return {};
              }
  
@@ -900,6 +1181,7 @@
              double t = _T.top();
              _T.pop();
              _T_set.erase(t);
+             TraceSpan span("_lsrp event", "t", t);
  
              // get the next t
              double t2 = get_tmin2();
@@ -908,14 +1190,23 @@
                  auto current_time = std::chrono::steady_clock::now();
                  std::chrono::duration<double> duration = current_time - start_time;
                  _runtime = duration.count();
+                 _counters.t_search = _runtime;
+                 auto t_ext = std::chrono::steady_clock::now();
                  get_makespan();
                  get_Soc();
                  extract_policy();
+                 _counters.t_extract = seconds_since(t_ext);
                  return 1;
              }
  
              // extract the agents who should move in this planning loop
              auto curr_agents = extract_Agents(t);
+             span.SetArg(1, "n_agents", curr_agents.size());
+             if (LSRP_STATS) {
+                 ++_counters.n_events;
+                 _counters.n_agents_planned += curr_agents.size();
+                 _counters.max_agents_per_event = std::max(_counters.max_agents_per_event, long(curr_agents.size()));
+             }
  
              // generate raw Sto from Sfrom and curr_agents
              std::vector<State*> Snext = get_rawSnext(_S_T.back(), curr_agents, t);
@@ -927,6 +1218,7 @@
              std::sort(curr_agents.begin(), curr_agents.end(), [](const Agent* a, const Agent* b) {
                  return a->get_priority() > b->get_priority();
              });
+             log_event(t, curr_agents);
  
  
              // Generate path
@@ -947,28 +1239,142 @@
          }
      }
  
-     double Lsrp::re_makespan() {
+     template <typename G>
+     double LsrpT<G>::re_makespan() {
          return _makespan;
      }
  
-     double Lsrp::re_soc() {
+     template <typename G>
+     double LsrpT<G>::re_soc() {
          return _soc;
      }
  
-     TimePathSet Lsrp::GetPlan(long nid) {
+     template <typename G>
+     TimePathSet LsrpT<G>::GetPlan(long nid) {
          return _paths;
      }
  
-     std::unordered_map<std::string, double> Lsrp::GetStats() {
+     template <typename G>
+     LsrpMemory LsrpT<G>::GetMemoryUsage() {
+         LsrpMemory out;
+         for (const auto& table : _dis_table) {
+             out.heuristics += sizeof(table) + hash_map_bytes(table);
+         }
+         // the hop tables themselves belong to their source.
+         for (const auto& steps : _dis_steps) {
+             out.heuristics += sizeof(steps) + steps.capacity() * sizeof(double);
+         }
+         out.history = _S_T.capacity() * sizeof(std::vector<State*>);
+         for (const auto& S : _S_T) {
+             out.history += S.capacity() * sizeof(State*);
+         }
+         out.cache = hash_map_bytes(_cache);
+         for (const auto& kv : _cache) {
+             out.cache += kv.second.capacity() * sizeof(State*);
+         }
+         out.states = _counters.n_states * sizeof(State);
+         if (_graph) {
+             out.graph = _graph->MemoryBytes();
+         }
+         return out;
+     }
+
+     template <typename G>
+     size_t LsrpT<G>::DefaultEventBound(size_t n_agents, size_t n_vertices) {
+         return n_agents * size_t(2 * std::ceil(std::sqrt(double(n_vertices))));
+     }
+
+     template <typename G>
+     LsrpMemory LsrpT<G>::EstimateMemory(size_t n_agents, size_t n_vertices, size_t n_events,
+                                         HeuristicSource heuristic, int kngh) {
+         LsrpMemory out;
+         if (n_events == 0) {
+             n_events = DefaultEventBound(n_agents, n_vertices);
+         }
+         if (heuristic == HeuristicSource::HOP_TABLE) {
+             // the step values of an agent, at most one per vertex.
+             out.heuristics = n_agents * (sizeof(std::vector<double>) + n_vertices * sizeof(double));
+         } else {
+             // every vertex is assumed reachable, the bucket array is about as large as the element count.
+             size_t node = sizeof(void*) + sizeof(std::pair<const long, double>) + sizeof(size_t);
+             out.heuristics = n_agents * (sizeof(std::unordered_map<long, double>) + n_vertices * (node + sizeof(void*)));
+         }
+         size_t joint_state = sizeof(std::vector<State*>) + n_agents * sizeof(State*);
+         out.history = n_events * joint_state;
+         out.cache = n_events * (joint_state + sizeof(void*) * 2 + sizeof(double) + sizeof(size_t));
+         out.states = n_events * n_agents * sizeof(State);
+         // Grid2d: a dense grid of double, the maximal and occupied capacities, the obstacle bitmap, the
+         // vertex order and a neighbor table of kngh arcs per vertex.
+         out.graph = n_vertices * (sizeof(double) + 3 * sizeof(long) + 2 * sizeof(vid_t) +
+                                   size_t(kngh) * (sizeof(vid_t) + sizeof(double))) + n_vertices / 8;
+         return out;
+     }
+
+     template <typename G>
+     std::unordered_map<std::string, double> LsrpT<G>::GetStats() {
+         _stats["runtime"] = _runtime;
+         _stats["t_heuristic"] = _counters.t_heuristic;
+         _stats["t_search"] = _counters.t_search;
+         _stats["t_extract"] = _counters.t_extract;
+         _stats["n_agents"] = _agents.size();
+         _stats["n_events"] = _counters.n_events;
+         _stats["n_agents_planned"] = _counters.n_agents_planned;
+         _stats["avg_agents_per_event"] = (_counters.n_events > 0) ?
+                 double(_counters.n_agents_planned) / _counters.n_events : 0.0;
+         _stats["max_agents_per_event"] = _counters.max_agents_per_event;
+         _stats["n_push_calls"] = _counters.n_push_calls;
+         _stats["max_push_depth"] = _counters.max_push_depth;
+         _stats["n_push_success"] = _counters.n_push_success;
+         _stats["n_push_fail"] = _counters.n_push_fail;
+         _stats["n_swap_triggered"] = _counters.n_swap_triggered;
+         _stats["n_swap_applied"] = _counters.n_swap_applied;
+         _stats["n_occupied_reject"] = _counters.n_occupied_reject;
+         _stats["n_states"] = _counters.n_states;
+         _stats["n_infeasible"] = _counters.n_infeasible;
+         if (_dlog_replay) {
+             _stats["replay_diverged"] = _dlog.Diverged();
+             _stats["replay_divergence_record"] = _dlog.DivergedRecord();
+         }
+         LsrpMemory mem = GetMemoryUsage();
+         _stats["mem_heuristics"] = mem.heuristics;
+         _stats["mem_history"] = mem.history;
+         _stats["mem_cache"] = mem.cache;
+         _stats["mem_states"] = mem.states;
+         _stats["mem_graph"] = mem.graph;
+         _stats["mem_total"] = mem.total();
+ #ifdef __unix__
+         struct rusage usage;
+         if (getrusage(RUSAGE_SELF, &usage) == 0) {
+             _stats["mem_peak_rss"] = double(usage.ru_maxrss) * 1024; // kilobytes on linux
+         }
+ #endif
          return _stats;
      }
  
-     bool Lsrp::highest_pri_agents(Agent &agent) {
+     template <typename G>
+     bool LsrpT<G>::highest_pri_agents(Agent &agent) {
          double pri = agent.get_priority();
          for (int i = 0; i < _agents.size(); i++) {
              if (_agents[i]->get_priority() > pri) {return false;}
          }
          return true;
      }
+
+     template <typename G>
+     void LsrpT<G>::SetGraphPtr(PlannerGraph* g) {
+         MAPFAAPlanner::SetGraphPtr(g);
+         _g = dynamic_cast<G*>(g);
+         if (g != nullptr && _g == nullptr) {
+             std::cout << "[ERROR] LsrpT::SetGraphPtr, the graph type does not match the planner" << std::endl;
+             throw std::runtime_error("[ERROR] LsrpT::SetGraphPtr, the graph type does not match the planner");
+         }
+     }
+
+     template class LsrpT<PlannerGraph>;
+     template class LsrpT<Grid2d>;
+
+     Lsrp::Lsrp() {};
+
+     Lsrp::~Lsrp() {};
  
  }
\ No newline at end of file
@@ -0,0 +1,84 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#include "mapped_file.hpp"
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RAPLAB_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace raplab{
+
+// an empty file still gets a valid pointer, so that IsOpen is true.
+static const char kEmpty[1] = {0};
+
+MappedFile::MappedFile() {};
+
+MappedFile::~MappedFile() {
+  Close();
+};
+
+int MappedFile::Open(const std::string& fname) {
+  Close();
+#ifdef RAPLAB_HAS_MMAP
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "[Error] file '" << fname << "' could not be opened" << std::endl;
+    return -1;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    std::cerr << "[Error] file '" << fname << "' could not be opened" << std::endl;
+    return -1;
+  }
+  _size = size_t(st.st_size);
+  if (_size == 0) {
+    ::close(fd);
+    _data = kEmpty;
+    return 1;
+  }
+  void* p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd); // the mapping keeps its own reference to the file.
+  if (p != MAP_FAILED) {
+    _data = static_cast<const char*>(p);
+    _mapped = true;
+    return 1;
+  }
+  _size = 0;
+#endif
+  std::ifstream fin(fname, std::ios::binary | std::ios::ate);
+  if (!fin) {
+    std::cerr << "[Error] file '" << fname << "' could not be opened" << std::endl;
+    return -1;
+  }
+  _buf.resize(size_t(fin.tellg()));
+  fin.seekg(0);
+  fin.read(_buf.data(), _buf.size());
+  _size = _buf.size();
+  _data = _buf.empty() ? kEmpty : _buf.data();
+  return 1;
+};
+
+void MappedFile::Close() {
+#ifdef RAPLAB_HAS_MMAP
+  if (_mapped) {
+    ::munmap(const_cast<char*>(_data), _size);
+  }
+#endif
+  std::vector<char>().swap(_buf);
+  _data = nullptr;
+  _size = 0;
+  _mapped = false;
+};
+
+} // end namespace raplab
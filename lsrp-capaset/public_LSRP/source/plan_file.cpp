@@ -0,0 +1,191 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#include "plan_file.hpp"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace raplab{
+
+namespace {
+const size_t kFlushBytes = 1 << 16;
+const double kMaxTicks = 4611686018427387904.0; // 2^62, the differences of two times still fit in int64.
+}
+
+void PlanEncoder::BeginAgent(std::string* out, size_t n_sections, double duration) {
+  PutVarint(out, n_sections);
+  PutDouble(out, duration);
+  prev_to = 0;
+  prev_end = 0;
+};
+
+bool PlanEncoder::ValidTime(double t) const {
+  return std::isfinite(t) && std::fabs(t * ticks_per_unit) < kMaxTicks;
+};
+
+bool PlanEncoder::PutSection(std::string* out, long from, long to, double start, double end) {
+  bool ok = ValidTime(start) && ValidTime(end);
+  int64_t t0 = ok ? int64_t(std::llround(start * ticks_per_unit)) : prev_end;
+  int64_t t1 = ok ? int64_t(std::llround(end * ticks_per_unit)) : prev_end;
+  PutSignedVarint(out, from - prev_to);
+  PutSignedVarint(out, to - from);
+  PutSignedVarint(out, t0 - prev_end);
+  PutSignedVarint(out, t1 - t0);
+  prev_to = to;
+  prev_end = t1;
+  return ok;
+};
+
+bool GetPlanAgent(const char** p, const char* end, uint32_t ticks_per_unit, double* duration,
+                  std::vector<PlanSection>* sections) {
+  uint64_t n;
+  if (!GetVarint(p, end, &n) || !GetDouble(p, end, duration) || n > uint64_t(end - *p)) {
+    return false;
+  }
+  sections->resize(n);
+  double scale = 1.0 / ticks_per_unit;
+  int64_t prev_to = 0;
+  int64_t prev_end = 0;
+  for (uint64_t i = 0; i < n; i++) {
+    int64_t d[4];
+    for (int j = 0; j < 4; j++) {
+      if (!GetSignedVarint(p, end, &d[j])) {return false;}
+    }
+    PlanSection& s = (*sections)[i];
+    s.from = long(prev_to + d[0]);
+    s.to = long(s.from + d[1]);
+    int64_t t0 = prev_end + d[2];
+    int64_t t1 = t0 + d[3];
+    s.start = t0 * scale;
+    s.end = t1 * scale;
+    prev_to = s.to;
+    prev_end = t1;
+  }
+  return true;
+};
+
+////////////////////////////
+
+PlanWriter::PlanWriter() {};
+
+PlanWriter::~PlanWriter() {
+  Close();
+};
+
+int PlanWriter::Open(const std::string& fname, const PlanFileHeader& header) {
+  Close();
+  _file = std::fopen(fname.c_str(), "wb");
+  if (!_file) {
+    std::cerr << "[Error] file '" << fname << "' could not be opened" << std::endl;
+    return -1;
+  }
+  _fname = fname;
+  _write_failed = false;
+  _invalid_time = false;
+  _h = header;
+  if (_h.ticks_per_unit == 0) {_h.ticks_per_unit = 1;}
+  if (std::fwrite(&_h, sizeof(_h), 1, _file) != 1) {_write_failed = true;}
+  _enc = PlanEncoder();
+  _enc.ticks_per_unit = _h.ticks_per_unit;
+  _n_agents = 0;
+  _buf.clear();
+  _buf.reserve(kFlushBytes * 2);
+  return 1;
+};
+
+void PlanWriter::BeginAgent(size_t n_sections, double duration) {
+  _enc.BeginAgent(&_buf, n_sections, duration);
+  _n_agents++;
+};
+
+void PlanWriter::PutSection(long from, long to, double start, double end) {
+  if (!_enc.PutSection(&_buf, from, to, start, end)) {
+    _invalid_time = true;
+  }
+  if (_buf.size() >= kFlushBytes) {
+    _flush();
+  }
+};
+
+int PlanWriter::Close() {
+  if (!_file) {return 1;}
+  _flush();
+  if (std::ferror(_file)) {_write_failed = true;}
+  if (std::fclose(_file) != 0) {_write_failed = true;}
+  _file = nullptr;
+  if (_write_failed) {
+    std::cerr << "[Error] PlanWriter, write to '" << _fname << "' failed, the plan is truncated" << std::endl;
+    return -1;
+  }
+  if (_invalid_time) {
+    std::cerr << "[Error] PlanWriter, '" << _fname << "' has a time that is not finite or too large" << std::endl;
+    return -1;
+  }
+  if (_n_agents != _h.n_agents) {
+    std::cerr << "[Error] PlanWriter, " << _n_agents << " agents written, the header has " << _h.n_agents << std::endl;
+    return -1;
+  }
+  return 1;
+};
+
+void PlanWriter::_flush() {
+  if (std::fwrite(_buf.data(), 1, _buf.size(), _file) != _buf.size()) {_write_failed = true;}
+  _buf.clear();
+};
+
+////////////////////////////
+
+PlanReader::PlanReader() {};
+
+PlanReader::~PlanReader() {};
+
+int PlanReader::Open(const std::string& fname) {
+  if (_file.Open(fname) != 1) {
+    return -1;
+  }
+  PlanFileHeader ref;
+  if (_file.Size() < sizeof(PlanFileHeader) || std::memcmp(_file.Data(), ref.magic, sizeof(ref.magic)) != 0) {
+    std::cerr << "[Error] PlanReader, '" << fname << "' is not a plan file" << std::endl;
+    return -1;
+  }
+  std::memcpy(&_h, _file.Data(), sizeof(PlanFileHeader));
+  if (_h.version != ref.version || _h.ticks_per_unit == 0) {
+    std::cerr << "[Error] PlanReader, unsupported version " << _h.version << std::endl;
+    return -1;
+  }
+  _p = _file.Data() + sizeof(PlanFileHeader);
+  _n_read = 0;
+  return 1;
+};
+
+int PlanReader::NextAgent(double* duration, std::vector<PlanSection>* sections) {
+  if (_n_read >= _h.n_agents) {return 0;}
+  if (!GetPlanAgent(&_p, _file.Data() + _file.Size(), _h.ticks_per_unit, duration, sections)) {
+    return -1;
+  }
+  _n_read++;
+  return 1;
+};
+
+int WritePlan(const std::string& fname, const PlanFileHeader& header, const std::vector<double>& durations,
+              const std::vector< std::vector< std::tuple<long, long, double, double> > >& paths) {
+  PlanWriter w;
+  PlanFileHeader h = header;
+  h.n_agents = uint32_t(paths.size());
+  if (w.Open(fname, h) != 1) {
+    return -1;
+  }
+  for (size_t i = 0; i < paths.size(); i++) {
+    w.BeginAgent(paths[i].size(), i < durations.size() ? durations[i] : 0.0);
+    for (const auto& s : paths[i]) {
+      w.PutSection(std::get<0>(s), std::get<1>(s), std::get<2>(s), std::get<3>(s));
+    }
+  }
+  return w.Close();
+};
+
+} // end namespace raplab
@@ -0,0 +1,544 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#include "planner_service.hpp"
+#include "graph_io.hpp"
+#include "parallel_for.hpp"
+#include "plan_file.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <set>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RAPLAB_HAS_UNIX_SOCKET 1
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace raplab{
+
+PlannerService::PlannerService() {};
+
+PlannerService::~PlannerService() {};
+
+int PlannerService::LoadMap(const std::string& map_path, GridOrder order) {
+  if (BinaryMap::IsBinaryMap(map_path)) {
+    if (_bin_map.Open(map_path) != 1 || AttachBinaryMap(_bin_map, &_grid) != 1) {
+      return -1;
+    }
+  } else {
+    if (ParseMap_MovingAI(map_path, &_occupancy) != 1) {
+      return -1;
+    }
+    _grid.SetVertexOrder(order);
+    _grid.SetOccuBitmapPtr(&_occupancy);
+  }
+  ComputeComponents(&_grid, &_labels);
+  _store_path.clear();
+  return _store.Open("", _grid.GetTableView()); // in memory until OpenStore.
+};
+
+int PlannerService::SetMap(const uint8_t* cells, long rows, long cols, long row_stride, GridOrder order) {
+  if (cells == nullptr || rows <= 0 || cols <= 0) {
+    std::cerr << "[Error] PlannerService::SetMap, empty map" << std::endl;
+    return -1;
+  }
+  _grid.SetVertexOrder(order);
+  _grid.SetOccuCellsPtr(cells, rows, cols, row_stride);
+  ComputeComponents(&_grid, &_labels);
+  _store_path.clear();
+  return _store.Open("", _grid.GetTableView());
+};
+
+int PlannerService::OpenStore(const std::string& store_path) {
+  _store_path = store_path;
+  return _store.Open(store_path, _grid.GetTableView());
+};
+
+void PlannerService::Prefetch(const std::vector<long>& goals) {
+  std::vector<long> todo;
+  for (long goal : goals) {
+    if (goal < 0 || goal >= long(_grid.GetTableView().rows * _grid.GetTableView().cols)) {continue;}
+    long v = _grid.ToInternal(goal);
+    if (!_bin_map.IsOpen() || _bin_map.GetHopTable(v).hops == nullptr) {todo.push_back(v);}
+  }
+  {
+    std::lock_guard<std::mutex> lock(_store_mtx);
+    todo = _store.Missing(todo);
+  }
+  if (todo.empty()) {return;}
+  // the searches run unlocked, a goal searched by two threads at once is stored once.
+  const GridTableView& view = _grid.GetTableView();
+  std::vector< std::vector<uint32_t> > tables(todo.size(), std::vector<uint32_t>(size_t(view.rows * view.cols)));
+  std::vector<uint32_t*> outs(todo.size());
+  std::vector<uint32_t> max_hops(todo.size());
+  for (size_t i = 0; i < todo.size(); i++) {
+    outs[i] = tables[i].data();
+  }
+  ComputeHopTables(view, todo.data(), todo.size(), outs.data(), max_hops.data());
+  std::lock_guard<std::mutex> lock(_store_mtx);
+  for (size_t i = 0; i < todo.size(); i++) {
+    _store.Insert(todo[i], std::move(tables[i]), max_hops[i], true);
+  }
+};
+
+void PlannerService::SetMemoryLimit(size_t bytes) {
+  std::lock_guard<std::mutex> lock(_store_mtx);
+  _store.SetMemoryLimit(bytes);
+};
+
+size_t PlannerService::NumHits() const {
+  std::lock_guard<std::mutex> lock(_store_mtx);
+  return _store.NumHits();
+};
+
+size_t PlannerService::NumMisses() const {
+  std::lock_guard<std::mutex> lock(_store_mtx);
+  return _store.NumMisses();
+};
+
+int PlannerService::Flush() {
+  if (_store_path.empty()) {return 1;}
+  std::lock_guard<std::mutex> lock(_store_mtx);
+  return _store.Flush();
+};
+
+bool PlannerService::_valid(const SolveRequest& req) const {
+  const GridTableView& view = _grid.GetTableView();
+  long n = view.rows * view.cols;
+  if (req.starts.empty() || req.goals.size() != req.starts.size() || req.durations.size() != req.starts.size() ||
+      !(req.time_limit > 0)) {
+    return false;
+  }
+  for (size_t i = 0; i < req.starts.size(); i++) {
+    if (req.starts[i] < 0 || req.starts[i] >= n || req.goals[i] < 0 || req.goals[i] >= n || !(req.durations[i] > 0) ||
+        _grid.IsObstacle(_grid.ToInternal(req.starts[i])) || _grid.IsObstacle(_grid.ToInternal(req.goals[i]))) {
+      return false;
+    }
+  }
+  for (const auto& c : req.capacities) {
+    if (c.first < 0 || c.first >= n || c.second < 1) {return false;}
+  }
+  return true;
+};
+
+SolveResult PlannerService::Solve(const SolveRequest& req) {
+  SolveResult res;
+  res.id = req.id;
+  if (!_valid(req)) {return res;}
+  // per instance occupancy and capacities, the arrays of the map are shared.
+  Grid2d g;
+  if (_bin_map.IsOpen()) {
+    AttachBinaryMap(_bin_map, &g);
+  } else {
+    g.AttachTableView(_grid.GetTableView());
+  }
+  for (const auto& c : req.capacities) {
+    g.SetVertexMaxCapacity(g.ToInternal(c.first), c.second);
+  }
+  std::vector<long> starts(req.starts.size());
+  std::vector<long> goals(req.goals.size());
+  for (size_t i = 0; i < starts.size(); i++) {
+    starts[i] = g.ToInternal(req.starts[i]);
+    goals[i] = g.ToInternal(req.goals[i]);
+    g.IncreaseVertexOccupiedCapacity(starts[i]);
+  }
+  Prefetch(req.goals);
+  // the tables used by this instance, so that a concurrent Flush does not unmap them. Outlives the planner.
+  std::vector<HeuristicStore::HopTablePin> pins;
+  LsrpT<Grid2d> planner;
+  planner.SetGraphPtr(&g);
+  planner.Setduration(req.durations);
+  planner.set_swap(req.swap);
+  planner.set_infeasible_policy(_infeasible_policy);
+  planner.set_component_labels(&_labels);
+  BinaryMap* bin_map = &_bin_map;
+  HeuristicStore* store = &_store;
+  std::mutex* mtx = &_store_mtx;
+  std::vector<HeuristicStore::HopTablePin>* pins_ptr = &pins;
+  const GridTableView* view = &_grid.GetTableView();
+  planner.set_hop_table_source([bin_map, store, mtx, pins_ptr, view](long goal) {
+    HopTable t;
+    if (bin_map->IsOpen()) {t = bin_map->GetHopTable(goal);}
+    if (t.hops != nullptr) {return t;}
+    pins_ptr->emplace_back();
+    {
+      std::lock_guard<std::mutex> lock(*mtx);
+      t = store->Find(goal, &pins_ptr->back());
+    }
+    if (t.hops == nullptr) {
+      // a miss is searched unlocked, as in Prefetch.
+      std::vector<uint32_t> table(size_t(view->rows * view->cols));
+      uint32_t max_hop = ComputeHopTable(*view, goal, table.data());
+      std::lock_guard<std::mutex> lock(*mtx);
+      t = store->Insert(goal, std::move(table), max_hop, false, &pins_ptr->back());
+    }
+    return t;
+  });
+  int ret = planner.Solve(starts, goals, req.time_limit, 5.0);
+  res.runtime = planner.GetRuntime();
+  if (ret != 1) {
+    res.status = SOLVE_INFEASIBLE;
+    return res;
+  }
+  res.status = (res.runtime <= req.time_limit) ? SOLVE_OK : SOLVE_TIMEOUT;
+  res.makespan = planner.re_makespan();
+  res.soc = planner.re_soc();
+  res.durations = req.durations;
+  res.paths = *planner.get_all_paths();
+  for (auto& path : res.paths) {
+    for (auto& section : path) {
+      std::get<0>(section) = g.ToExternal(std::get<0>(section));
+      std::get<1>(section) = g.ToExternal(std::get<1>(section));
+    }
+  }
+  return res;
+};
+
+////////////////////////////
+
+bool DecodeSolveRequest(const std::string& payload, SolveRequest* req) {
+  const char* p = payload.data();
+  const char* end = p + payload.size();
+  uint64_t id, flags, n, n_cap;
+  req->id = 0;
+  if (p == end || uint8_t(*p++) != SERVE_SOLVE || !GetVarint(&p, end, &id)) {return false;}
+  req->id = id; // known from here on, also when the rest is malformed.
+  if (!GetDouble(&p, end, &req->time_limit) || !GetVarint(&p, end, &flags) || !GetVarint(&p, end, &n) ||
+      n > uint64_t(end - p)) {
+    return false;
+  }
+  req->swap = (flags & 1) != 0;
+  req->starts.resize(n);
+  req->goals.resize(n);
+  req->durations.resize(n);
+  for (uint64_t i = 0; i < n; i++) {
+    uint64_t s, g;
+    if (!GetVarint(&p, end, &s) || !GetVarint(&p, end, &g) || !GetDouble(&p, end, &req->durations[i])) {return false;}
+    req->starts[i] = long(s);
+    req->goals[i] = long(g);
+  }
+  if (!GetVarint(&p, end, &n_cap) || n_cap > uint64_t(end - p)) {return false;}
+  req->capacities.resize(n_cap);
+  for (uint64_t i = 0; i < n_cap; i++) {
+    uint64_t v, c;
+    if (!GetVarint(&p, end, &v) || !GetVarint(&p, end, &c)) {return false;}
+    req->capacities[i] = std::make_pair(long(v), int(c));
+  }
+  return p == end;
+};
+
+void EncodeSolveRequest(const SolveRequest& req, std::string* payload) {
+  payload->clear();
+  payload->push_back(char(SERVE_SOLVE));
+  PutVarint(payload, req.id);
+  PutDouble(payload, req.time_limit);
+  PutVarint(payload, req.swap ? 1 : 0);
+  PutVarint(payload, req.starts.size());
+  for (size_t i = 0; i < req.starts.size(); i++) {
+    PutVarint(payload, uint64_t(req.starts[i]));
+    PutVarint(payload, uint64_t(req.goals[i]));
+    PutDouble(payload, i < req.durations.size() ? req.durations[i] : 0.0);
+  }
+  PutVarint(payload, req.capacities.size());
+  for (const auto& c : req.capacities) {
+    PutVarint(payload, uint64_t(c.first));
+    PutVarint(payload, uint64_t(c.second));
+  }
+};
+
+void EncodeSolveResult(const SolveResult& res, std::string* payload, uint32_t ticks_per_unit) {
+  payload->clear();
+  payload->push_back(char(SERVE_PLAN));
+  PutVarint(payload, res.id);
+  PutVarint(payload, res.status);
+  PutDouble(payload, res.runtime);
+  PutDouble(payload, res.makespan);
+  PutDouble(payload, res.soc);
+  PutVarint(payload, ticks_per_unit);
+  PutVarint(payload, res.paths.size());
+  PlanEncoder enc;
+  enc.ticks_per_unit = ticks_per_unit;
+  bool ok = true;
+  for (size_t i = 0; i < res.paths.size(); i++) {
+    const auto& path = res.paths[i];
+    enc.BeginAgent(payload, path.size(), i < res.durations.size() ? res.durations[i] : 0.0);
+    for (const auto& s : path) {
+      ok = enc.PutSection(payload, std::get<0>(s), std::get<1>(s), std::get<2>(s), std::get<3>(s)) && ok;
+    }
+  }
+  if (!ok) {
+    std::cerr << "[Error] planner server, the plan of request " << res.id << " has a time that is not finite or too large" << std::endl;
+    SolveResult invalid; // SOLVE_INVALID
+    invalid.id = res.id;
+    EncodeSolveResult(invalid, payload, ticks_per_unit);
+  }
+};
+
+bool DecodeSolveResult(const std::string& payload, SolveResult* res) {
+  const char* p = payload.data();
+  const char* end = p + payload.size();
+  uint64_t id, status, ticks, n;
+  if (p == end || uint8_t(*p++) != SERVE_PLAN || !GetVarint(&p, end, &id) || !GetVarint(&p, end, &status) ||
+      status > SOLVE_INVALID || !GetDouble(&p, end, &res->runtime) || !GetDouble(&p, end, &res->makespan) ||
+      !GetDouble(&p, end, &res->soc) || !GetVarint(&p, end, &ticks) || ticks == 0 || ticks > 0xffffffffu ||
+      !GetVarint(&p, end, &n) || n > uint64_t(end - p)) {
+    return false;
+  }
+  res->id = id;
+  res->status = SolveStatus(status);
+  res->durations.resize(n);
+  res->paths.resize(n);
+  std::vector<PlanSection> sections;
+  for (uint64_t i = 0; i < n; i++) {
+    if (!GetPlanAgent(&p, end, uint32_t(ticks), &res->durations[i], &sections)) {return false;}
+    res->paths[i].clear();
+    for (const auto& s : sections) {
+      res->paths[i].push_back(std::make_tuple(s.from, s.to, s.start, s.end));
+    }
+  }
+  return p == end;
+};
+
+////////////////////////////
+
+namespace {
+
+const uint32_t kMaxFrameBytes = 1u << 28;
+
+// fixed number of threads running the submitted tasks in order.
+class WorkerPool
+{
+public:
+  explicit WorkerPool(int n) {
+    for (int i = NumWorkers(n); i > 0; i--) {
+      _threads.emplace_back(&WorkerPool::_loop, this);
+    }
+  };
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(_mtx);
+      _closing = true;
+    }
+    _cv.notify_all();
+    for (auto& t : _threads) {t.join();}
+  };
+  void Submit(std::function<void()> task) {
+    {
+      std::lock_guard<std::mutex> lock(_mtx);
+      _tasks.push_back(std::move(task));
+    }
+    _cv.notify_one();
+  };
+
+private:
+  void _loop() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(_mtx);
+        _cv.wait(lock, [this]() {return _closing || !_tasks.empty();});
+        if (_tasks.empty()) {return;} // closing, and every task is done.
+        task = std::move(_tasks.front());
+        _tasks.pop_front();
+      }
+      task();
+    }
+  };
+
+  std::vector<std::thread> _threads;
+  std::deque< std::function<void()> > _tasks;
+  std::mutex _mtx;
+  std::condition_variable _cv;
+  bool _closing = false;
+};
+
+#if RAPLAB_HAS_UNIX_SOCKET
+
+bool ReadFull(int fd, char* buf, size_t n) {
+  while (n > 0) {
+    ssize_t k = ::read(fd, buf, n);
+    if (k < 0 && errno == EINTR) {continue;}
+    if (k <= 0) {return false;}
+    buf += k;
+    n -= size_t(k);
+  }
+  return true;
+}
+
+bool WriteFull(int fd, const char* buf, size_t n) {
+  while (n > 0) {
+    ssize_t k = ::write(fd, buf, n);
+    if (k < 0 && errno == EINTR) {continue;}
+    if (k <= 0) {return false;}
+    buf += k;
+    n -= size_t(k);
+  }
+  return true;
+}
+
+// one client, the responses of concurrent requests are written whole, one at a time.
+struct Connection
+{
+  int in_fd;
+  int out_fd;
+  bool owns_fd;
+  std::mutex write_mtx;
+
+  Connection(int in, int out, bool owns) : in_fd(in), out_fd(out), owns_fd(owns) {};
+  ~Connection() {
+    if (owns_fd) {::close(in_fd);}
+  };
+  bool Send(const std::string& payload) {
+    char len[4];
+    for (int i = 0; i < 4; i++) {len[i] = char((payload.size() >> (8 * i)) & 0xff);}
+    std::lock_guard<std::mutex> lock(write_mtx);
+    return WriteFull(out_fd, len, 4) && WriteFull(out_fd, payload.data(), payload.size());
+  };
+};
+
+// read the frames of a connection until the end of input or a shutdown, solving on the pool.
+// Return 1 at the end of input, 0 after a shutdown, -1 on a malformed frame.
+int ServeConnection(PlannerService* service, std::shared_ptr<Connection> conn, WorkerPool* pool) {
+  std::string payload;
+  while (true) {
+    unsigned char len[4];
+    if (!ReadFull(conn->in_fd, reinterpret_cast<char*>(len), 4)) {return 1;}
+    uint32_t n = uint32_t(len[0]) | (uint32_t(len[1]) << 8) | (uint32_t(len[2]) << 16) | (uint32_t(len[3]) << 24);
+    if (n == 0 || n > kMaxFrameBytes) {
+      std::cerr << "[Error] planner server, invalid frame of " << n << " bytes" << std::endl;
+      return -1;
+    }
+    payload.resize(n);
+    if (!ReadFull(conn->in_fd, &payload[0], n)) {return 1;}
+    if (uint8_t(payload[0]) == SERVE_SHUTDOWN) {return 0;}
+    auto req = std::make_shared<SolveRequest>();
+    if (!DecodeSolveRequest(payload, req.get())) {
+      SolveResult invalid; // SOLVE_INVALID
+      invalid.id = req->id;
+      std::string out;
+      EncodeSolveResult(invalid, &out);
+      conn->Send(out);
+      continue;
+    }
+    pool->Submit([service, conn, req]() {
+      SolveResult res = service->Solve(*req);
+      std::string out;
+      EncodeSolveResult(res, &out);
+      conn->Send(out);
+    });
+  }
+}
+
+#endif
+
+}
+
+int ServeStream(PlannerService* service, int in_fd, int out_fd, int n_workers) {
+#if RAPLAB_HAS_UNIX_SOCKET
+  std::signal(SIGPIPE, SIG_IGN);
+  int ret;
+  {
+    WorkerPool pool(n_workers);
+    ret = ServeConnection(service, std::make_shared<Connection>(in_fd, out_fd, false), &pool);
+  } // the pool finishes the pending requests.
+  return ret >= 0 ? 1 : -1;
+#else
+  std::cout << "[ERROR] ServeStream, not supported on this platform" << std::endl;
+  return -1;
+#endif
+};
+
+int ServeUnixSocket(PlannerService* service, const std::string& socket_path, int n_workers) {
+#if RAPLAB_HAS_UNIX_SOCKET
+  std::signal(SIGPIPE, SIG_IGN);
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    std::cerr << "[Error] planner server, socket path '" << socket_path << "' is too long" << std::endl;
+    return -1;
+  }
+  std::memcpy(addr.sun_path, socket_path.c_str(), socket_path.size() + 1);
+  int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::unlink(socket_path.c_str());
+  if (listen_fd < 0 || ::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(listen_fd, 64) != 0) {
+    std::cerr << "[Error] planner server, could not listen on '" << socket_path << "'" << std::endl;
+    if (listen_fd >= 0) {::close(listen_fd);}
+    return -1;
+  }
+  std::atomic<bool> stop(false);
+  std::mutex conn_mtx;
+  std::set<int> open_fds; // connections with a reader, the fd is closed after it is removed.
+  struct Reader {
+    std::thread t;
+    std::shared_ptr< std::atomic<bool> > done;
+  };
+  std::list<Reader> readers;
+  {
+    WorkerPool pool(n_workers);
+    while (!stop) {
+      for (auto it = readers.begin(); it != readers.end();) {
+        if (*it->done) {
+          it->t.join();
+          it = readers.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      pollfd pfd = {listen_fd, POLLIN, 0};
+      if (::poll(&pfd, 1, 200) <= 0) {continue;}
+      int fd = ::accept(listen_fd, nullptr, nullptr);
+      if (fd < 0) {continue;}
+      {
+        std::lock_guard<std::mutex> lock(conn_mtx);
+        open_fds.insert(fd);
+      }
+      Reader reader;
+      reader.done = std::make_shared< std::atomic<bool> >(false);
+      std::shared_ptr< std::atomic<bool> > done = reader.done;
+      reader.t = std::thread([service, fd, done, &pool, &stop, &conn_mtx, &open_fds]() {
+        auto conn = std::make_shared<Connection>(fd, fd, true);
+        int ret = ServeConnection(service, conn, &pool);
+        {
+          std::lock_guard<std::mutex> lock(conn_mtx);
+          open_fds.erase(fd);
+        }
+        if (ret == 0) {stop = true;}
+        *done = true;
+      });
+      readers.push_back(std::move(reader));
+    }
+    {
+      // wake up the readers blocked on idle connections.
+      std::lock_guard<std::mutex> lock(conn_mtx);
+      for (int fd : open_fds) {::shutdown(fd, SHUT_RD);}
+    }
+    for (auto& reader : readers) {reader.t.join();}
+  } // the pool finishes the pending requests.
+  ::close(listen_fd);
+  ::unlink(socket_path.c_str());
+  return 1;
+#else
+  std::cout << "[ERROR] ServeUnixSocket, not supported on this platform" << std::endl;
+  return -1;
+#endif
+};
+
+} // end namespace raplab
@@ -5,7 +5,6 @@
  *******************************************/
 
 #include "search_astar.hpp"
-#include <set>
 #include <limits>
 
 namespace raplab{
@@ -24,8 +23,7 @@ double Astar::_heuristic(long v) {
 
 void Astar::_add_open(long u, double dist_u) {
   double f = dist_u + _wh*_heuristic(u);
-  auto temp_pair = std::make_pair(f,u);
-  _open.insert(temp_pair); // re-insert
+  _open.Push(u, f); // insert, decrease-key, or re-open a closed vertex.
 };
 
 void Astar::SetHeuWeight(double w) {
@@ -49,16 +47,19 @@ AstarGrid2d::~AstarGrid2d() {
 };
 
 double AstarGrid2d::_heuristic(long v) {
-  auto gg = dynamic_cast<Grid2d*>( _graph );
-  auto r = gg->_k2r(v);
-  auto c = gg->_k2c(v);
+  auto r = _grid->_k2r(v);
+  auto c = _grid->_k2c(v);
   return abs(r - _vd_r) + abs(c - _vd_c);
 };
 
 void AstarGrid2d::_init_more() {
-  auto gg = dynamic_cast<Grid2d*>( _graph );
-  _vd_r = gg->_k2r(_vg);
-  _vd_c = gg->_k2c(_vg);
+  _grid = dynamic_cast<Grid2d*>( _graph );
+  if (_grid == nullptr) {
+    std::cout << "[ERROR] AstarGrid2d, the graph is not a Grid2d" << std::endl;
+    throw std::runtime_error("[ERROR] AstarGrid2d, the graph is not a Grid2d");
+  }
+  _vd_r = _grid->_k2r(_vg);
+  _vd_c = _grid->_k2c(_vg);
 };
 
 } // end namespace zr
@@ -5,7 +5,7 @@
  *******************************************/
 
 #include "search_dijkstra.hpp"
-#include <set>
+#include <algorithm>
 #include <limits>
 
 namespace raplab{
@@ -64,45 +64,55 @@ int Dijkstra::_search() {
     return -2;
   } 
   auto tstart = std::chrono::steady_clock::now();
+  bool check_time = (_time_limit < std::numeric_limits<double>::infinity());
 
-  // DataType is defined in cost_vector.hpp, which is by default double.
-  // std::set< std::pair<double, long> >& open = _open; // nickname, @2024-5-14, I'm lazy to change.
-    // open list, leverage property of set, which is sorted by the first value in pair.
-
-  // init search
+  // init search, reuse the buffers of the previous query if the graph size is unchanged.
   size_t nV = _graph->NumVertex();
-  _v2d.clear();
-  _v2d.resize(nV, std::numeric_limits<double>::infinity() );
-  _parent.clear();
-  _parent.resize(nV, -1);
-  _cvec.clear();
-  _cvec.resize(nV);
-  _open.insert(std::make_pair(0.0, _vs));
+  _n_cost = _graph->CostDim();
+  if (_v2d.size() != nV) {
+    _v2d.assign(nV, std::numeric_limits<double>::infinity() );
+    _parent.assign(nV, -1);
+  } else {
+    for (long u : _touched) {
+      _v2d[u] = std::numeric_limits<double>::infinity();
+      _parent[u] = -1;
+    }
+  }
+  _touched.clear();
+  if (_n_cost > 1 && _cflat.size() != nV*_n_cost) {
+    _cflat.assign(nV*_n_cost, 0);
+  }
+  _open.Clear();
+  _open.Reserve(nV);
+
   _v2d[_vs] = 0.0;
-  _cvec[_vs].resize(_graph->CostDim(), 0); // the corresponding cost vector of the path.
+  _touched.push_back(_vs);
+  if (_n_cost > 1) {
+    std::fill(_cflat.begin() + _vs*_n_cost, _cflat.begin() + (_vs+1)*_n_cost, 0.0);
+  }
 
   _init_more();
+  _add_open(_vs, 0.0);
 
   int success = 0;
+  size_t n_pop = 0;
 
   // main search loop
-  while(!_open.empty()){
-
-    // check time limit
-    auto tnow = std::chrono::steady_clock::now();
-    if ( std::chrono::duration<double>(tnow-tstart).count() > _time_limit) {
-      break; // fails. timeout.
+  while(!_open.Empty()){
+
+    // check time limit, the clock is read once every 256 expansions.
+    if (check_time && ((++n_pop) & 255) == 0) {
+      auto tnow = std::chrono::steady_clock::now();
+      if ( std::chrono::duration<double>(tnow-tstart).count() > _time_limit) {
+        break; // fails. timeout.
+      }
     }
 
-    // extract from OPEN
-    std::pair<double, long> curr_pair = *(_open.begin());
-    _open.erase(_open.begin());
+    // extract from OPEN, the heap holds one entry per vertex, so no entry is outdated.
+    std::pair<double, long> curr_pair = _open.Pop();
     auto v = curr_pair.second;
-    if (DEBUG_DIJKSTRA){ std::cout << "[DEBUG] Dijkstra::_search, - popped v = " << v << " g = " << curr_pair.first << std::endl; }
-    if (_class_name == "Dijkstra" && curr_pair.first > _v2d[v]) { // this candidate is outdated.
-    	// std::cout << "[INFO] Dijkstra::_search, outdated vertex exists" << std::endl;
-    	continue;
-    }
+    double dist_v = _v2d[v];
+    if (DEBUG_DIJKSTRA){ std::cout << "[DEBUG] Dijkstra::_search, - popped v = " << v << " g = " << dist_v << std::endl; }
 
     // check goal
     if (_mode == 0 && v == _vg) {
@@ -110,54 +120,62 @@ int Dijkstra::_search() {
     	break; // termination
     }
 
-    // expansion
-    std::vector<long> nghs;
-    std::vector< std::vector<double> > ngh_costs;
-    if (_mode == 1) { 
-      nghs = _graph->GetPreds(v);
-      ngh_costs = _graph->GetPredCosts(v);
-    }else if (_mode == 0 || _mode == 2){
-      nghs = _graph->GetSuccs(v);
-      ngh_costs = _graph->GetSuccCosts(v);
-    }else{
-      std::cout << "[ERROR] Dijkstra::_search, _mode = " << _mode << std::endl;
-      throw std::runtime_error( "[ERROR] Dijkstra::_search, unknown _mode !!" );
-    }
-    if(DEBUG_DIJKSTRA){std::cout << "[DEBUG] Dijkstra::_search, - get " << nghs.size() << " successors " << std::endl;}
-    for (size_t j = 0; j < nghs.size(); j++) {
-      // generation
-      long u = nghs[j];
-      auto cvec = ngh_costs[j];
-      auto c = cvec[_cdim];
-      if (c < 0){
-        // negative edge !! Input graph has ERROR!!
-        std::cout << "[ERROR] v = " << v << " u = " << u << " cost_vec(u,v) = " << cvec << " c = " << c << std::endl;
-        throw std::runtime_error( "[ERROR] Dijkstra::_search, encounter negative edge costs !!" );
-        _v2d.clear();
-        return -3; // failed
-      } // end if
-      auto dist_u = curr_pair.first + c;
-      auto cvec_u = _cvec[v] + cvec; // the corresponding cost vector of the path to vd.
-      if (DEBUG_DIJKSTRA){ std::cout << "[DEBUG] Dijkstra::_search, --- generate u = " << u << " g = " << dist_u << std::endl; }
-
-      // pruning and add open for non-pruned successors
-      if ( dist_u < _v2d[u] ){
-        if (DEBUG_DIJKSTRA){ std::cout << "[DEBUG] Dijkstra::_search, --- g' = " << dist_u << " < g[u]=" << _v2d[u] << ", will update and add u to open..." << std::endl; }
-        _v2d[u] = dist_u;
-        _cvec[u] = cvec_u;
-        _parent[u] = v;
-        _add_open(u, dist_u);
-
-      } // end if 
-    }// end for
+    _expand(v, dist_v);
   }// end while
   
   return success;
 };
 
+void Dijkstra::_expand(long v, double dist_v) {
+  // expansion
+  ArcSpan nghs;
+  if (_mode == 1) { 
+    nghs = _graph->GetPredArcs(v);
+  }else if (_mode == 0 || _mode == 2){
+    nghs = _graph->GetSuccArcs(v);
+  }else{
+    std::cout << "[ERROR] Dijkstra::_expand, _mode = " << _mode << std::endl;
+    throw std::runtime_error( "[ERROR] Dijkstra::_expand, unknown _mode !!" );
+  }
+  if(DEBUG_DIJKSTRA){std::cout << "[DEBUG] Dijkstra::_expand, - get " << nghs.size << " successors " << std::endl;}
+  for (size_t j = 0; j < nghs.size; j++) {
+    // generation
+    long u = nghs.ids[j];
+    auto c = nghs.Cost(j, _cdim);
+    if (c < 0){
+      // negative edge !! Input graph has ERROR!!
+      std::cout << "[ERROR] v = " << v << " u = " << u << " c = " << c << std::endl;
+      throw std::runtime_error( "[ERROR] Dijkstra::_expand, encounter negative edge costs !!" );
+    } // end if
+    auto dist_u = dist_v + c;
+    if (DEBUG_DIJKSTRA){ std::cout << "[DEBUG] Dijkstra::_expand, --- generate u = " << u << " g = " << dist_u << std::endl; }
+
+    // pruning and add open for non-pruned successors
+    if ( _relax(v, u, dist_u) && _n_cost > 1 ){
+      // the corresponding cost vector of the path to u, skipped for single objective graphs.
+      for (size_t k = 0; k < _n_cost; k++) {
+        _cflat[u*_n_cost+k] = _cflat[v*_n_cost+k] + nghs.Cost(j, k);
+      }
+    } // end if 
+  }// end for
+};
+
+bool Dijkstra::_relax(long v, long u, double dist_u) {
+  if ( !(dist_u < _v2d[u]) ){
+    return false;
+  }
+  if (DEBUG_DIJKSTRA){ std::cout << "[DEBUG] Dijkstra::_relax, --- g' = " << dist_u << " < g[u]=" << _v2d[u] << ", will update and add u to open..." << std::endl; }
+  if (_v2d[u] == std::numeric_limits<double>::infinity()) {
+    _touched.push_back(u);
+  }
+  _v2d[u] = dist_u;
+  _parent[u] = v;
+  _add_open(u, dist_u);
+  return true;
+};
+
 void Dijkstra::_add_open(long u, double dist_u) {
-  auto temp_pair = std::make_pair(dist_u,u);
-  _open.insert(temp_pair); // re-insert
+  _open.Push(u, dist_u); // insert or decrease-key
 };
 
 void Dijkstra::_init_more() {
@@ -165,7 +183,7 @@ void Dijkstra::_init_more() {
 };
 
 std::vector<long> Dijkstra::GetPath(long v, bool do_reverse) {
-  std::cout << " .s.s.s. GetPath v = " << v << std::endl;
+  if (DEBUG_DIJKSTRA){ std::cout << "[DEBUG] Dijkstra::GetPath v = " << v << std::endl; }
   std::vector<long> out;
   if ((_parent.size() == 0) || (_parent.size() <= v) ){
     return out ;
@@ -196,11 +214,20 @@ double Dijkstra::GetDistValue(long v) {
 };
 
 std::vector<double> Dijkstra::GetSolutionCost() {
-  return _cvec[_vg];
+  return GetPathCost(_vg);
 } ;
 
 std::vector<double> Dijkstra::GetPathCost(long v) {
-  return _cvec[v];
+  std::vector<double> out;
+  if (v < 0 || size_t(v) >= _v2d.size() || _v2d[v] == std::numeric_limits<double>::infinity()) {
+    return out; // not reached.
+  }
+  if (_n_cost == 1) {
+    out.push_back(_v2d[v]);
+  } else {
+    out.assign(_cflat.begin() + v*_n_cost, _cflat.begin() + (v+1)*_n_cost);
+  }
+  return out;
 };
 
 
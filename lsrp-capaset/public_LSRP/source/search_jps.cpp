@@ -0,0 +1,285 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#include "search_jps.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace raplab{
+
+namespace {
+int Sign(long x) {return (x > 0) - (x < 0);}
+}
+
+JpsGrid2d::JpsGrid2d() {
+  _class_name = "JpsGrid2d";
+};
+
+JpsGrid2d::~JpsGrid2d() {
+
+};
+
+void JpsGrid2d::_bind_grid() {
+  _grid = dynamic_cast<Grid2d*>( _graph );
+  if (_grid == nullptr) {
+    std::cout << "[ERROR] " << _class_name << ", the graph is not a Grid2d" << std::endl;
+    throw std::runtime_error("[ERROR] JpsGrid2d, the graph is not a Grid2d");
+  }
+  const GridTableView& view = _grid->GetTableView();
+  _rows = view.rows;
+  _cols = view.cols;
+  _kngh = view.kngh;
+  _cost_straight = 1.0 * _grid->GetCostScaleFactor();
+  _cost_diag = 1.4 * _grid->GetCostScaleFactor();
+};
+
+void JpsGrid2d::_init_more() {
+  AstarGrid2d::_init_more();
+  _bind_grid();
+};
+
+double JpsGrid2d::_heuristic(long v) {
+  long dr = std::abs(_grid->_k2r(v) - _vd_r);
+  long dc = std::abs(_grid->_k2c(v) - _vd_c);
+  if (_kngh == 4) {
+    return _cost_straight * (dr + dc);
+  }
+  return _cost_straight * (std::max(dr, dc) - std::min(dr, dc)) + _cost_diag * std::min(dr, dc);
+};
+
+bool JpsGrid2d::_forced(long r, long c, int dr, int dc) const {
+  if (_kngh == 8) {
+    if (dr != 0 && dc != 0) {
+      return (!_free(r, c-dc) && _free(r+dr, c-dc)) || (!_free(r-dr, c) && _free(r-dr, c+dc));
+    }else if (dr == 0) {
+      return (!_free(r+1, c) && _free(r+1, c+dc)) || (!_free(r-1, c) && _free(r-1, c+dc));
+    }
+    return (!_free(r, c+1) && _free(r+dr, c+1)) || (!_free(r, c-1) && _free(r+dr, c-1));
+  }
+  if (dr == 0) {
+    return (_free(r+1, c) && !_free(r+1, c-dc)) || (_free(r-1, c) && !_free(r-1, c-dc));
+  }
+  return false; // vertical moves of a 4-connected grid scan both sides instead.
+};
+
+long JpsGrid2d::_jump(long r, long c, int dr, int dc, long* steps) {
+  long k = 0;
+  long s;
+  while (true) {
+    r += dr;
+    c += dc;
+    k++;
+    if (!_free(r, c)) {return -1;}
+    if ((r == _vd_r && c == _vd_c) || _forced(r, c, dr, dc)) {break;}
+    if (_scans(dr, dc)) {
+      if (dc != 0) {
+        if (_jump(r, c, 0, dc, &s) >= 0 || _jump(r, c, dr, 0, &s) >= 0) {break;}
+      }else{
+        if (_jump(r, c, 0, 1, &s) >= 0 || _jump(r, c, 0, -1, &s) >= 0) {break;}
+      }
+    }
+  }
+  *steps = k;
+  return _grid->ToInternal(r * _cols + c);
+};
+
+void JpsGrid2d::_try(long v, double dist_v, long r, long c, int dr, int dc) {
+  long steps = 0;
+  long u = _jump(r, c, dr, dc, &steps);
+  if (u < 0) {return;}
+  if (DEBUG_JPS){ std::cout << "[DEBUG] JpsGrid2d::_try, v = " << v << " dir = (" << dr << "," << dc << ") jump to u = " << u << " steps = " << steps << std::endl; }
+  _relax(v, u, dist_v + steps * ((dr != 0 && dc != 0) ? _cost_diag : _cost_straight));
+};
+
+void JpsGrid2d::_expand(long v, double dist_v) {
+  if (_mode != 0) {
+    // jump points are only defined towards a goal.
+    Dijkstra::_expand(v, dist_v);
+    return;
+  }
+  long r = _grid->_k2r(v);
+  long c = _grid->_k2c(v);
+  long p = _parent[v];
+  if (p == -1) {
+    // the start, all directions.
+    _try(v, dist_v, r, c, 0, -1);
+    _try(v, dist_v, r, c, 0, 1);
+    _try(v, dist_v, r, c, -1, 0);
+    _try(v, dist_v, r, c, 1, 0);
+    if (_kngh == 8) {
+      _try(v, dist_v, r, c, -1, -1);
+      _try(v, dist_v, r, c, -1, 1);
+      _try(v, dist_v, r, c, 1, -1);
+      _try(v, dist_v, r, c, 1, 1);
+    }
+    return;
+  }
+  // direction of the move that reached v, the parent is on a straight or diagonal line.
+  int dr = Sign(r - _grid->_k2r(p));
+  int dc = Sign(c - _grid->_k2c(p));
+  if (_kngh == 8) {
+    if (dr != 0 && dc != 0) {
+      _try(v, dist_v, r, c, dr, 0);
+      _try(v, dist_v, r, c, 0, dc);
+      _try(v, dist_v, r, c, dr, dc);
+      if (!_free(r, c-dc)) {_try(v, dist_v, r, c, dr, -dc);}
+      if (!_free(r-dr, c)) {_try(v, dist_v, r, c, -dr, dc);}
+    }else if (dr == 0) {
+      _try(v, dist_v, r, c, 0, dc);
+      if (!_free(r+1, c)) {_try(v, dist_v, r, c, 1, dc);}
+      if (!_free(r-1, c)) {_try(v, dist_v, r, c, -1, dc);}
+    }else{
+      _try(v, dist_v, r, c, dr, 0);
+      if (!_free(r, c+1)) {_try(v, dist_v, r, c, dr, 1);}
+      if (!_free(r, c-1)) {_try(v, dist_v, r, c, dr, -1);}
+    }
+    return;
+  }
+  if (dr == 0) {
+    _try(v, dist_v, r, c, 0, dc);
+    if (_free(r+1, c) && !_free(r+1, c-dc)) {_try(v, dist_v, r, c, 1, 0);}
+    if (_free(r-1, c) && !_free(r-1, c-dc)) {_try(v, dist_v, r, c, -1, 0);}
+  }else{
+    _try(v, dist_v, r, c, dr, 0);
+    _try(v, dist_v, r, c, 0, 1);
+    _try(v, dist_v, r, c, 0, -1);
+  }
+};
+
+std::vector<long> JpsGrid2d::GetPath(long v, bool do_reverse) {
+  std::vector<long> jumps = Dijkstra::GetPath(v, true);
+  if (jumps.size() < 2) {return jumps;}
+  std::vector<long> path;
+  path.push_back(jumps[0]);
+  for (size_t i = 1; i < jumps.size(); i++) {
+    long r = _grid->_k2r(jumps[i-1]);
+    long c = _grid->_k2c(jumps[i-1]);
+    long r1 = _grid->_k2r(jumps[i]);
+    long c1 = _grid->_k2c(jumps[i]);
+    int dr = Sign(r1 - r);
+    int dc = Sign(c1 - c);
+    while (r != r1 || c != c1) {
+      r += dr;
+      c += dc;
+      path.push_back(_grid->_rc2k(r, c));
+    }
+  }
+  if (!do_reverse) {
+    std::reverse(path.begin(), path.end());
+  }
+  return path;
+};
+
+////////////////////////////
+
+JpsPlusGrid2d::JpsPlusGrid2d() {
+  _class_name = "JpsPlusGrid2d";
+};
+
+JpsPlusGrid2d::~JpsPlusGrid2d() {
+
+};
+
+void JpsPlusGrid2d::_init_more() {
+  JpsGrid2d::_init_more();
+  if (_table_of != _graph || _table_version != _graph->ArcVersion() || _dist.size() != size_t(_rows * _cols) * 8) {
+    Preprocess();
+  }
+};
+
+void JpsPlusGrid2d::Preprocess() {
+  _bind_grid();
+  _dist.assign(size_t(_rows * _cols) * 8, 0);
+  _table_of = _graph;
+  _table_version = _graph->ArcVersion();
+  // straight moves first, the moves that scan read them. A cell is computed after the next cell in
+  // its direction, so each direction is one pass over the grid.
+  const int dirs[8][2] = {{0,-1},{0,1},{-1,0},{1,0},{-1,-1},{-1,1},{1,-1},{1,1}};
+  for (int i = 0; i < 8; i++) {
+    int dr = dirs[i][0];
+    int dc = dirs[i][1];
+    if (_kngh == 4 && dr != 0 && dc != 0) {continue;}
+    int d = _dir(dr, dc);
+    for (long ir = 0; ir < _rows; ir++) {
+      long r = (dr > 0) ? _rows - 1 - ir : ir;
+      for (long ic = 0; ic < _cols; ic++) {
+        long c = (dc > 0) ? _cols - 1 - ic : ic;
+        if (!_free(r, c)) {continue;}
+        long nr = r + dr;
+        long nc = c + dc;
+        int32_t out = 0;
+        if (_free(nr, nc)) {
+          long u = _grid->ToInternal(nr * _cols + nc);
+          bool stop = _forced(nr, nc, dr, dc);
+          if (!stop && _scans(dr, dc)) {
+            if (dc != 0) {
+              stop = _jd(u, _dir(0, dc)) > 0 || _jd(u, _dir(dr, 0)) > 0;
+            }else{
+              stop = _jd(u, _dir(0, 1)) > 0 || _jd(u, _dir(0, -1)) > 0;
+            }
+          }
+          int32_t next = _jd(u, d);
+          out = stop ? 1 : (next > 0 ? next + 1 : next - 1);
+        }
+        _dist[_grid->ToInternal(r * _cols + c) * 8 + d] = out;
+      }
+    }
+  }
+};
+
+long JpsPlusGrid2d::_steps_to_goal(long r, long c, int dr, int dc) const {
+  long k;
+  if (dr == 0) {
+    if (r != _vd_r || Sign(_vd_c - c) != dc) {return -1;}
+    k = std::abs(_vd_c - c);
+  }else{
+    if (c != _vd_c || Sign(_vd_r - r) != dr) {return -1;}
+    k = std::abs(_vd_r - r);
+  }
+  int32_t jd = _jd(_grid->ToInternal(r * _cols + c), _dir(dr, dc));
+  return (k <= std::abs(long(jd))) ? k : -1;
+};
+
+long JpsPlusGrid2d::_jump(long r, long c, int dr, int dc, long* steps) {
+  int32_t jd = _jd(_grid->ToInternal(r * _cols + c), _dir(dr, dc));
+  if (!_scans(dr, dc)) {
+    long k = _steps_to_goal(r, c, dr, dc);
+    if (k >= 0) {
+      *steps = k;
+      return _vg;
+    }
+  }else{
+    // the scans meet the goal at the first step where the run reaches the row (or column) of the goal.
+    long lim = std::abs(long(jd));
+    long at_row = (_vd_r - r) * dr;
+    long at_col = (dc != 0) ? (_vd_c - c) * dc : -1;
+    long cand[2] = {std::min(at_row, at_col), std::max(at_row, at_col)};
+    for (int j = 0; j < 2; j++) {
+      long i = cand[j];
+      if (i <= 0 || i > lim) {continue;}
+      long yr = r + i * dr;
+      long yc = c + i * dc;
+      bool found = false;
+      if (yr == _vd_r && yc == _vd_c) {
+        found = true;
+      }else if (i == at_row) {
+        int hc = Sign(_vd_c - yc);
+        found = (dc == 0 || hc == dc) && _steps_to_goal(yr, yc, 0, hc) >= 0;
+      }else{
+        found = _steps_to_goal(yr, yc, dr, 0) >= 0;
+      }
+      if (found) {
+        *steps = i;
+        return _grid->ToInternal(yr * _cols + yc);
+      }
+    }
+  }
+  if (jd <= 0) {return -1;}
+  *steps = jd;
+  return _grid->ToInternal((r + jd * dr) * _cols + (c + jd * dc));
+};
+
+} // end namespace raplab
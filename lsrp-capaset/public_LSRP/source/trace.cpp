@@ -0,0 +1,122 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+#include "trace.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+
+namespace raplab{
+
+namespace trace_detail {
+
+std::atomic<bool> enabled(false);
+
+namespace {
+// the registry is only locked when a thread records its first span and when dumping.
+std::mutex reg_mtx;
+std::vector< std::unique_ptr<TraceRing> > rings;
+size_t ring_capacity = (1 << 16);
+std::atomic<uint64_t> generation(0);
+std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+thread_local TraceRing* tls_ring = nullptr;
+thread_local uint64_t tls_generation = uint64_t(-1);
+}
+
+int64_t NowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - epoch).count();
+};
+
+void Record(const TraceEvent& e) {
+  uint64_t gen = generation.load(std::memory_order_acquire);
+  if (tls_ring == nullptr || tls_generation != gen) {
+    std::lock_guard<std::mutex> lock(reg_mtx);
+    rings.emplace_back(new TraceRing(ring_capacity, int(rings.size())));
+    tls_ring = rings.back().get();
+    tls_generation = gen;
+  }
+  tls_ring->Push(e);
+};
+
+} // end namespace trace_detail
+
+TraceRing::TraceRing(size_t capacity, int tid) : _head(0), _tid(tid) {
+  size_t n = 1;
+  while (n < capacity) {n <<= 1;}
+  _events.resize(n);
+  _mask = n - 1;
+};
+
+size_t TraceRing::Snapshot(std::vector<TraceEvent>* out) const {
+  size_t h = _head.load(std::memory_order_acquire);
+  size_t n = std::min(h, _events.size());
+  for (size_t i = h - n; i < h; i++) {
+    out->push_back(_events[i & _mask]);
+  }
+  return h - n;
+};
+
+void TraceEnable(size_t ring_capacity) {
+  std::lock_guard<std::mutex> lock(trace_detail::reg_mtx);
+  trace_detail::rings.clear();
+  trace_detail::ring_capacity = ring_capacity;
+  trace_detail::epoch = std::chrono::steady_clock::now();
+  trace_detail::generation.fetch_add(1, std::memory_order_release);
+  trace_detail::enabled.store(true, std::memory_order_relaxed);
+};
+
+void TraceDisable() {
+  trace_detail::enabled.store(false, std::memory_order_relaxed);
+};
+
+int TraceDumpChrome(const std::string& fname) {
+  std::FILE* f = std::fopen(fname.c_str(), "w");
+  if (!f) {
+    std::cerr << "[Error] file '" << fname << "' could not be opened" << std::endl;
+    return -1;
+  }
+  std::lock_guard<std::mutex> lock(trace_detail::reg_mtx);
+  std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  bool first = true;
+  size_t n_dropped = 0;
+  std::vector<TraceEvent> events;
+  for (auto& ring : trace_detail::rings) {
+    events.clear();
+    n_dropped += ring->Snapshot(&events);
+    std::fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}",
+      first ? "" : ",\n", ring->Tid(), ring->Tid());
+    first = false;
+    for (const auto& e : events) {
+      // chrome trace timestamps are in microseconds.
+      std::fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+        e.name, ring->Tid(), e.ts_ns / 1000.0, e.dur_ns / 1000.0);
+      if (e.arg_names[0] || e.arg_names[1]) {
+        std::fprintf(f, ",\"args\":{");
+        bool first_arg = true;
+        for (int i = 0; i < 2; i++) {
+          if (!e.arg_names[i]) {continue;}
+          std::fprintf(f, "%s\"%s\":%.17g", first_arg ? "" : ",", e.arg_names[i], e.args[i]);
+          first_arg = false;
+        }
+        std::fprintf(f, "}");
+      }
+      std::fprintf(f, "}");
+    }
+  }
+  std::fprintf(f, "\n]}\n");
+  std::fclose(f);
+  if (n_dropped > 0) {
+    std::cout << "[CAVEAT] TraceDumpChrome, " << n_dropped << " oldest spans were overwritten, "
+      << "increase the ring capacity of TraceEnable to keep them." << std::endl;
+  }
+  return 1;
+};
+
+} // end namespace raplab
@@ -1,4 +1,3 @@
-
 /*******************************************
  * Author: Zhongqiang Richard Ren. 
  * All Rights Reserved. 
@@ -8,59 +7,33 @@
 
 namespace raplab{
 
+UnionFind::UnionFind(long n) {
+  Reset(n);
+};
 
-/**
- * @brief Find operation in Union-find data structure. 
- *  Assume a is in dic. No safety check. You should do that outside.
- */
- /*
-template<typename DataType>
-DataType UFFind(std::unordered_map<DataType,DataType>* dic, DataType a) {
-  // if (dic->find(a) == dic->end()) {return -1;}
-  while ((*dic)[a] != a) {
-    (*dic)[a] = (*dic)[(*dic)[a]]; // path compression
-    a = (*dic)[a];
+void UnionFind::Reset(long n) {
+  _parent.resize(n);
+  for (long i = 0; i < n; i++) {
+    _parent[i] = i;
   }
-  return a;
+  _rank.assign(n, 0);
 };
-/**
- * @brief Union the sets that contains element a and b.
- *  Returned value int indicates the running status of this func.
- */
- /*
-template<typename DataType>
-int UFUnion(std::unordered_map<DataType,DataType>* dic, const DataType& a, const DataType& b) {
-  if (dic->find(a) == dic->end()) {return -1;}
-  if (dic->find(b) == dic->end()) {return -2;}
-  auto rooti = UFFind(dic,a);
-  auto rootj = UFFind(dic,b);
-  if (rooti == rootj){
+
+int UnionFind::Union(long a, long b) {
+  long rooti = Find(a);
+  long rootj = Find(b);
+  if (rooti == rootj) {
     return 0;
   }
-  else{
-    if (rooti > rootj){
-      (*dic)[rootj] = rooti;
-    }else{
-      (*dic)[rooti] = rootj;
-    }
-    return 1;
+  if (_rank[rooti] < _rank[rootj]) {
+    _parent[rooti] = rootj;
+  } else if (_rank[rooti] > _rank[rootj]) {
+    _parent[rootj] = rooti;
+  } else {
+    _parent[rootj] = rooti;
+    _rank[rooti]++;
   }
-};
-*/
-void CompileHelperUnionFind() {
-  std::unordered_map<int,int> a1;
-  UFFind(&a1,1);
-  UFUnion(&a1,1,2);
-  std::unordered_map<long,long> a2;
-  UFFind(&a2,1l);
-  UFUnion(&a2,1l,2l);
-  std::unordered_map<short,short> a3;
-  UFFind(&a3,short(1));
-  UFUnion(&a3,short(1),short(2));
-  std::unordered_map<std::string,std::string> a4;
-  UFFind(&a4,std::to_string(1));
-  UFUnion(&a4,std::to_string(1),std::to_string(2));
-  return;
+  return 1;
 };
 
 } // end namespace rzq
@@ -0,0 +1,170 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// WriteBinaryMap then BinaryMap::Open, and the rejection of truncated or corrupted maps and hop tables.
+
+#include "binary_map.hpp"
+#include "decision_log.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+std::vector<std::string> g_files;
+
+std::string ReadBytes(const std::string& fname) {
+    std::ifstream fin(fname, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+}
+
+std::string WriteBytes(const std::string& name, const std::string& bytes) {
+    std::string fname = "test_binary_map_" + name + ".lsrpmap";
+    std::ofstream fout(fname, std::ios::binary | std::ios::trunc);
+    fout << bytes;
+    g_files.push_back(fname);
+    return fname;
+}
+
+template <typename T>
+void Put(std::string* bytes, uint64_t off, T value) {
+    std::memcpy(&(*bytes)[off], &value, sizeof(T));
+}
+
+template <typename T>
+T Get(const std::string& bytes, uint64_t off) {
+    T value;
+    std::memcpy(&value, &bytes[off], sizeof(T));
+    return value;
+}
+
+bool Opens(const std::string& fname) {
+    raplab::BinaryMap map;
+    return map.Open(fname) == 1;
+}
+
+}
+
+int main() {
+    std::mt19937 rng(3);
+    const long rows = 23;
+    const long cols = 31;
+    const long n = rows * cols;
+    std::vector< std::vector<double> > occ(rows, std::vector<double>(cols, 0));
+    for (auto& row : occ) {
+        for (auto& x : row) {x = (rng() % 10 < 2) ? 1 : 0;}
+    }
+    raplab::Grid2d g;
+    g.SetVertexOrder(raplab::GridOrder::HILBERT);
+    g.SetOccuGridPtr(&occ);
+    std::vector<long> goals;
+    for (long v = 0; v < n; v += 17) {
+        if (!g.IsObstacle(v)) {goals.push_back(v);}
+    }
+    std::unordered_map<long, int> caps = {{goals[0], 3}};
+    std::string good = "test_binary_map_good.lsrpmap";
+    g_files.push_back(good);
+    Check(raplab::WriteBinaryMap(good, g, caps, goals) == 1, "WriteBinaryMap");
+
+    {
+        raplab::BinaryMap map;
+        Check(map.Open(good) == 1, "open a map");
+        Check(map.NumVertex() == n && map.NumHopTables() == goals.size(), "sizes of the map");
+        std::vector<uint32_t> ref(static_cast<size_t>(n));
+        for (long goal : goals) {
+            uint32_t max_hop = raplab::ComputeHopTable(g.GetTableView(), goal, ref.data());
+            raplab::HopTable t = map.GetHopTable(goal);
+            Check(t.hops != nullptr && t.max_hop == max_hop && std::equal(ref.begin(), ref.end(), t.hops),
+                  "hop table of goal " + std::to_string(goal));
+        }
+        Check(map.GetHopTable(goals[0] + 1).hops == nullptr, "no table of another goal");
+        raplab::Grid2d attached;
+        Check(raplab::AttachBinaryMap(map, &attached) == 1, "attach the map");
+        Check(attached.NumVertex() == g.NumVertex() && attached.GetVertexMaxCapacity(goals[0]) == 3, "attached grid");
+    }
+
+    std::string bytes = ReadBytes(good);
+    raplab::BinaryMapHeader h;
+    std::memcpy(&h, bytes.data(), sizeof(h));
+
+    // the header and the sections.
+    Check(!Opens("test_binary_map_missing.lsrpmap"), "missing file");
+    Check(!Opens(WriteBytes("not_a_map", "type octile\nheight 1\n")), "not a map");
+    Check(!Opens(WriteBytes("truncated", bytes.substr(0, bytes.size() - 64))), "truncated map");
+    Check(!Opens(WriteBytes("header_only", bytes.substr(0, sizeof(h)))), "header only");
+    std::string bad = bytes;
+    Put<uint32_t>(&bad, offsetof(raplab::BinaryMapHeader, version), 2);
+    Check(!Opens(WriteBytes("version", bad)), "old version");
+    bad = bytes;
+    Put<uint64_t>(&bad, offsetof(raplab::BinaryMapHeader, off_hops), h.off_hop_sums);
+    Check(!Opens(WriteBytes("overlap", bad)), "overlapping sections");
+    bad = bytes;
+    Put<raplab::vid_t>(&bad, h.off_targets + 2 * sizeof(raplab::vid_t), raplab::vid_t(n));
+    Check(!Opens(WriteBytes("target", bad)), "neighbor outside the grid");
+    bad = bytes;
+    Put<uint64_t>(&bad, h.off_bits, ~Get<uint64_t>(bytes, h.off_bits));
+    Check(!Opens(WriteBytes("obstacles", bad)), "content hash mismatch");
+
+    // the hop index.
+    const uint64_t entry = sizeof(raplab::HopTableEntry);
+    bad = bytes;
+    Put<uint32_t>(&bad, h.off_hop_index + entry + offsetof(raplab::HopTableEntry, max_hop), uint32_t(n));
+    Check(!Opens(WriteBytes("max_hop", bad)), "max_hop not below the vertex count");
+    bad = bytes;
+    Put<int64_t>(&bad, h.off_hop_index + entry + offsetof(raplab::HopTableEntry, goal), goals[2]);
+    Check(!Opens(WriteBytes("unsorted", bad)), "unsorted hop index");
+    bad = bytes;
+    Put<int64_t>(&bad, h.off_hop_index + offsetof(raplab::HopTableEntry, goal), -1);
+    Check(!Opens(WriteBytes("goal", bad)), "goal outside the grid");
+
+    // the tables: a flipped entry fails the checksum, an entry above max_hop with a matching checksum
+    // fails the range check. Only that table is dropped.
+    uint64_t table1 = h.off_hops + uint64_t(n) * sizeof(uint32_t);
+    long free_cell = (goals[1] + 1) % n;
+    bad = bytes;
+    Put<uint32_t>(&bad, table1 + free_cell * sizeof(uint32_t), Get<uint32_t>(bytes, table1 + free_cell * sizeof(uint32_t)) ^ 1);
+    std::string flipped = WriteBytes("flipped", bad);
+    bad = bytes;
+    uint32_t max_hop1 = Get<uint32_t>(bytes, h.off_hop_index + entry + offsetof(raplab::HopTableEntry, max_hop));
+    Put<uint32_t>(&bad, table1 + free_cell * sizeof(uint32_t), max_hop1 + 1);
+    Put<uint64_t>(&bad, h.off_hop_sums + sizeof(uint64_t), raplab::DigestBytes(&bad[table1], size_t(n) * sizeof(uint32_t)));
+    std::string above = WriteBytes("above", bad);
+    for (const std::string& fname : {flipped, above}) {
+        raplab::BinaryMap map;
+        Check(map.Open(fname) == 1, fname + ": the map opens");
+        Check(map.GetHopTable(goals[1]).hops == nullptr, fname + ": the corrupted table is not used");
+        Check(map.GetHopTable(goals[1]).hops == nullptr, fname + ": nor the second time");
+        Check(map.GetHopTable(goals[0]).hops != nullptr && map.GetHopTable(goals[2]).hops != nullptr,
+              fname + ": the other tables are");
+    }
+
+    for (const auto& f : g_files) {
+        std::remove(f.c_str());
+    }
+    if (g_n_fail > 0) {
+        std::cout << "test_binary_map: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_binary_map: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// DecisionLog record then verify, with and without a divergence, a failed write, and a planner solve
+// recorded and replayed.
+
+#include "decision_log.hpp"
+#include "mapfaa_lsrp.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+const std::string kLog = "test_decision_log.lsrplog";
+
+// what a DecisionLog reports after Close.
+struct Outcome
+{
+    bool diverged = false;
+    long record = -1;
+    size_t n_records = 0;
+    std::string report;
+};
+
+Outcome OutcomeOf(const raplab::DecisionLog& log) {
+    Outcome out;
+    out.diverged = log.Diverged();
+    out.record = log.DivergedRecord();
+    out.n_records = log.NumRecords();
+    out.report = log.Report();
+    return out;
+}
+
+// record i: a decision of agent i % 7 at vertex i, field is added to the vertex of record changed.
+void PutRecords(raplab::DecisionLog* log, size_t n, size_t changed = size_t(-1), long field = 0) {
+    for (size_t i = 0; i < n; i++) {
+        log->Begin(raplab::DLOG_DECISION);
+        log->PutU(i % 7);
+        log->PutS(long(i) + (i == changed ? field : 0));
+        log->PutU(1);
+        log->PutF(0.5 * double(i));
+        log->End();
+    }
+}
+
+// verify n records against kLog, one of them changed.
+Outcome Verify(size_t n, size_t changed = size_t(-1), long field = 0) {
+    raplab::DecisionLog log;
+    raplab::DecisionLogHeader header;
+    if (log.OpenVerify(kLog, &header) == 1) {
+        PutRecords(&log, n, changed, field);
+        log.Close();
+    }
+    return OutcomeOf(log);
+}
+
+// a solve of agents on a random grid, recorded or replayed from kLog.
+Outcome Solve(const std::vector<double>& duration, bool replay, double* soc) {
+    std::mt19937 rng(9);
+    std::vector< std::vector<double> > occ(16, std::vector<double>(16, 0));
+    for (auto& row : occ) {
+        for (auto& x : row) {x = (rng() % 10 < 2) ? 1 : 0;}
+    }
+    raplab::Grid2d g;
+    g.SetOccuGridPtr(&occ);
+    std::vector<long> free_cells;
+    for (long v = 0; v < 256; v++) {
+        if (!g.IsObstacle(v)) {free_cells.push_back(v);}
+    }
+    std::shuffle(free_cells.begin(), free_cells.end(), rng);
+    std::vector<long> starts(free_cells.begin(), free_cells.begin() + duration.size());
+    std::vector<long> goals(free_cells.begin() + duration.size(), free_cells.begin() + 2 * duration.size());
+    raplab::Lsrp planner;
+    planner.SetGraphPtr(&g);
+    planner.Setduration(duration);
+    planner.set_swap(true);
+    planner.set_seed(replay ? 1 : 7); // the replay takes the seed of the log
+    if (replay) {
+        planner.set_replay_log(kLog);
+    } else {
+        planner.set_decision_log(kLog);
+    }
+    planner.Solve(starts, goals, 60, 1.0);
+    *soc = planner.re_soc();
+    return OutcomeOf(planner.get_decision_log());
+}
+
+}
+
+int main() {
+    // enough records for several buffers of the writer thread.
+    const size_t n = 200000;
+    {
+        raplab::DecisionLog log;
+        raplab::DecisionLogHeader header;
+        header.n_agents = 7;
+        header.seed = 3;
+        Check(log.OpenRecord(kLog, header) == 1, "open a log to record");
+        PutRecords(&log, n);
+        Check(log.Close() == 1 && !log.WriteFailed() && log.NumRecords() == n, "record");
+    }
+    Outcome same = Verify(n);
+    Check(!same.diverged && same.record == -1 && same.n_records == n, "verify the same records");
+    Outcome changed = Verify(n, 123456, 1);
+    Check(changed.diverged && changed.record == 123456, "one record changed: " + changed.report);
+    Check(changed.report.find("fields of record tag") != std::string::npos, "reason of a changed record");
+    Outcome shorter = Verify(n - 10);
+    Check(shorter.record == long(n - 10) && shorter.report.find("replay ended") != std::string::npos,
+          "replay shorter than the log: " + shorter.report);
+    Outcome longer = Verify(n + 1);
+    Check(longer.record == long(n) && longer.report.find("log ended early") != std::string::npos,
+          "replay longer than the log: " + longer.report);
+
+    // writes to a full device fail when the buffers reach the file.
+    if (::access("/dev/full", W_OK) == 0) {
+        raplab::DecisionLog log;
+        if (log.OpenRecord("/dev/full", raplab::DecisionLogHeader()) == 1) {
+            PutRecords(&log, n);
+            Check(log.Close() == -1 && log.WriteFailed(), "write error reported by Close");
+            Check(log.Report().find("write error") != std::string::npos, "write error reported by Report");
+        }
+    }
+
+    // a solve, replayed with the same and with other durations.
+    std::vector<double> duration = {1, 0.5, 2, 1, 1.5, 0.75, 1, 1, 3, 1.25};
+    double soc = 0;
+    double replay_soc = 0;
+    Outcome recorded = Solve(duration, false, &soc);
+    Check(recorded.n_records > 0 && recorded.report.find("write error") == std::string::npos, "record a solve");
+    Outcome replayed = Solve(duration, true, &replay_soc);
+    Check(!replayed.diverged && replayed.n_records == recorded.n_records, "replay: " + replayed.report);
+    Check(replay_soc == soc, "replay finds the same plan");
+    duration[3] = 1.1;
+    Outcome other = Solve(duration, true, &replay_soc);
+    Check(other.diverged && other.record >= 0, "replay with other durations diverges");
+
+    std::remove(kLog.c_str());
+    if (g_n_fail > 0) {
+        std::cout << "test_decision_log: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_decision_log: ok" << std::endl;
+    return 0;
+}
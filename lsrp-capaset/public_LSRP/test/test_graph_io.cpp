@@ -0,0 +1,135 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// LoadSparseGraphDIMAC against graphs built by AddArc, and its errors on malformed input.
+
+#include "graph_io.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+// files written in the working directory, removed at the end.
+std::vector<std::string> g_files;
+
+std::string WriteFile(const std::string& name, const std::string& text) {
+    std::string fname = "test_graph_io_" + name + ".gr";
+    std::ofstream fout(fname, std::ios::binary);
+    fout << text;
+    g_files.push_back(fname);
+    return fname;
+}
+
+// a DIMACS file of the arcs with cost dimension d of costs, lines end with eol.
+std::string DimacsText(const std::vector<long>& sources, const std::vector<long>& targets,
+                       const std::vector<std::vector<double> >& costs, size_t d, const std::string& eol) {
+    std::ostringstream out;
+    out << "c test graph" << eol << "p sp " << sources.size() << " " << sources.size() << eol;
+    for (size_t a = 0; a < sources.size(); a++) {
+        out << "a " << sources[a] << " " << targets[a] << " " << costs[a][d] << eol;
+    }
+    return out.str();
+}
+
+// successors and costs of every vertex of g equal those of ref.
+void CheckSameArcs(raplab::SparseGraph& g, raplab::SparseGraph& ref, const std::string& name) {
+    Check(g.NumVertex() == ref.NumVertex(), name + ": NumVertex");
+    for (long v = 0; v < long(ref.NumVertex()); v++) {
+        std::vector<long> s = g.GetSuccs(v);
+        std::vector<long> s_ref = ref.GetSuccs(v);
+        std::sort(s_ref.begin(), s_ref.end());
+        Check(s == s_ref, name + ": succs of " + std::to_string(v));
+        for (long u : s_ref) {
+            Check(g.GetCost(v, u) == ref.GetCost(v, u), name + ": cost of " + std::to_string(v) + "->" + std::to_string(u));
+        }
+        Check(g.GetPreds(v).size() == ref.GetPreds(v).size(), name + ": preds of " + std::to_string(v));
+    }
+}
+
+}
+
+int main() {
+    // parallel arcs, the last one is kept as by AddArc. The files are large enough to be split into
+    // several chunks, the second one ends its lines with CRLF.
+    std::mt19937 rng(11);
+    const long n = 5000;
+    std::vector<long> sources;
+    std::vector<long> targets;
+    std::vector< std::vector<double> > costs;
+    raplab::SparseGraph ref;
+    for (int i = 0; i < 200000; i++) {
+        long u = long(rng() % n);
+        long v = long(rng() % 50);
+        std::vector<double> c = {double(rng() % 1000), double(rng() % 9) / 4.0};
+        ref.AddArc(u, v, c);
+        sources.push_back(u);
+        targets.push_back(v);
+        costs.push_back(c);
+    }
+    std::string f0 = WriteFile("cost0", DimacsText(sources, targets, costs, 0, "\n"));
+    std::string f1 = WriteFile("cost1", DimacsText(sources, targets, costs, 1, "\r\n"));
+    for (int n_threads : {1, 4}) {
+        raplab::SparseGraph g;
+        Check(raplab::LoadSparseGraphDIMAC({f0, f1}, &g, n_threads) == 1, "load two cost files");
+        Check(g.IsFrozen() && g.CostDim() == 2, "frozen with two costs");
+        CheckSameArcs(g, ref, std::to_string(n_threads) + " threads");
+    }
+
+    // a small file by hand: comment, problem line, CRLF, duplicate arc and no newline at the end.
+    std::string small = WriteFile("small", "c tiny\r\np sp 3 3\r\na 0 1 2.5\r\na 1 2 4\r\na 0 1 3");
+    raplab::SparseGraph g;
+    Check(raplab::LoadSparseGraphDIMAC({small}, &g) == 1, "load a small CRLF file");
+    Check(g.NumVertex() == 3 && g.NumArc() == 2, "small graph, duplicates merged");
+    Check(g.GetCost(0, 1) == raplab::CostVec({3.0}), "the last duplicate is kept");
+    Check(g.GetCost(1, 2) == raplab::CostVec({4.0}), "cost of a CRLF line");
+
+    // cost files that do not match the first one.
+    std::string fewer = WriteFile("fewer", "a 0 1 1\na 1 2 1\n");
+    std::string other = WriteFile("other", "a 0 1 1\na 2 1 1\na 0 1 1\n");
+    raplab::SparseGraph h;
+    Check(raplab::LoadSparseGraphDIMAC({small, fewer}, &h) == -1, "second file with fewer arcs");
+    Check(raplab::LoadSparseGraphDIMAC({small, other}, &h) == -1, "second file with another arc");
+    Check(raplab::LoadSparseGraphDIMAC({}, &h) == -1, "no cost file");
+    Check(raplab::LoadSparseGraphDIMAC({"test_graph_io_missing.gr"}, &h) == -1, "missing file");
+
+    // bad arc lines.
+    Check(raplab::LoadSparseGraphDIMAC({WriteFile("bad_cost", "a 0 1 1\na 1 2 x\n")}, &h) == -1, "cost is not a number");
+    Check(raplab::LoadSparseGraphDIMAC({WriteFile("bad_short", "a 0 1 1\na 1\n")}, &h) == -1, "missing target");
+    Check(raplab::LoadSparseGraphDIMAC({WriteFile("bad_id", "a 0 1 1\na -1 2 1\n")}, &h) == -1, "negative vertex id");
+    bool thrown = false;
+    try {
+        raplab::LoadSparseGraphDIMAC({WriteFile("negative", "a 0 1 -1\n")}, &h);
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    Check(thrown, "negative cost throws");
+
+    for (const auto& f : g_files) {
+        std::remove(f.c_str());
+    }
+    if (g_n_fail > 0) {
+        std::cout << "test_graph_io: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_graph_io: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// HeuristicStore Get, Flush then reopen, a corrupted table computed again, two stores flushing into the
+// same file, and tables read through their pin across a Flush.
+
+#include "heuristic_store.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+const std::string kStore = "test_heuristic_store.lsrphs";
+
+std::string ReadBytes(const std::string& fname) {
+    std::ifstream fin(fname, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+}
+
+void WriteBytes(const std::string& fname, const std::string& bytes) {
+    std::ofstream fout(fname, std::ios::binary | std::ios::trunc);
+    fout << bytes;
+}
+
+// t is the hop table of goal in view.
+bool SameTable(const raplab::GridTableView& view, long goal, const raplab::HopTable& t) {
+    std::vector<uint32_t> ref(size_t(view.rows * view.cols));
+    uint32_t max_hop = raplab::ComputeHopTable(view, goal, ref.data());
+    return t.hops != nullptr && t.max_hop == max_hop && std::equal(ref.begin(), ref.end(), t.hops);
+}
+
+}
+
+int main() {
+    std::mt19937 rng(13);
+    std::vector< std::vector<double> > occ(20, std::vector<double>(24, 0));
+    for (auto& row : occ) {
+        for (auto& x : row) {x = (rng() % 10 < 2) ? 1 : 0;}
+    }
+    raplab::Grid2d g;
+    g.SetOccuGridPtr(&occ);
+    const raplab::GridTableView& view = g.GetTableView();
+    std::vector<long> goals;
+    for (long v = 5; v < 480 && goals.size() < 6; v += 37) {
+        if (!g.IsObstacle(v)) {goals.push_back(v);}
+    }
+    std::remove(kStore.c_str());
+
+    // Get computes, Flush writes, a new store reads the tables back.
+    {
+        raplab::HeuristicStore store;
+        Check(store.Open(kStore, view) == 1, "open a new store");
+        for (long goal : goals) {
+            Check(SameTable(view, goal, store.Get(goal)), "computed table of goal " + std::to_string(goal));
+        }
+        Check(store.NumMisses() == goals.size() && store.NumHits() == 0, "misses of a new store");
+        Check(store.Flush() == 1, "flush");
+    }
+    {
+        raplab::HeuristicStore store;
+        Check(store.Open(kStore, view) == 1, "reopen");
+        Check(store.Missing(goals).empty(), "nothing missing after reopen");
+        for (long goal : goals) {
+            Check(SameTable(view, goal, store.Get(goal)), "stored table of goal " + std::to_string(goal));
+        }
+        Check(store.NumHits() == goals.size() && store.NumMisses() == 0, "hits after reopen");
+    }
+
+    // a flipped entry in the second table: that table is computed again and rewritten by the next Flush.
+    std::string bytes = ReadBytes(kStore);
+    raplab::HeuristicStoreHeader h;
+    std::memcpy(&h, bytes.data(), sizeof(h));
+    Check(h.n_tables == goals.size(), "tables in the file");
+    uint64_t second = h.off_hops + uint64_t(h.n_vertex) * sizeof(uint32_t) + 3 * sizeof(uint32_t);
+    bytes[second] ^= 1;
+    WriteBytes(kStore, bytes);
+    {
+        raplab::HeuristicStore store;
+        Check(store.Open(kStore, view) == 1, "open a store with a corrupted table");
+        for (long goal : goals) {
+            Check(SameTable(view, goal, store.Get(goal)), "table of goal " + std::to_string(goal) + " after corruption");
+        }
+        Check(store.NumMisses() == 1 && store.NumHits() == goals.size() - 1, "the corrupted table is a miss");
+    }
+    {
+        raplab::HeuristicStore store;
+        store.Open(kStore, view);
+        Check(store.Missing(goals).empty(), "the corrupted table is rewritten");
+    }
+
+    // two stores on the same file, each flushes its own new goal: both are kept.
+    long a = goals[0] + 1;
+    long b = goals[1] + 1;
+    while (g.IsObstacle(a)) {a++;}
+    while (g.IsObstacle(b) || b == a) {b++;}
+    {
+        raplab::HeuristicStore first;
+        raplab::HeuristicStore second_store;
+        first.Open(kStore, view);
+        second_store.Open(kStore, view);
+        first.Get(a);
+        second_store.Get(b);
+        Check(first.Flush() == 1 && second_store.Flush() == 1, "flush of two stores");
+    }
+    {
+        raplab::HeuristicStore store;
+        store.Open(kStore, view);
+        Check(SameTable(view, a, store.Find(a)) && SameTable(view, b, store.Find(b)), "both flushes are merged");
+        Check(store.Missing(goals).empty(), "the older tables are kept by the merge");
+    }
+
+    // pinned tables, one computed and one mapped, stay readable across a Flush that replaces the file.
+    {
+        raplab::HeuristicStore store;
+        store.Open(kStore, view);
+        long c = b + 1;
+        while (g.IsObstacle(c) || c == a) {c++;}
+        raplab::HeuristicStore::HopTablePin computed_pin;
+        raplab::HeuristicStore::HopTablePin mapped_pin;
+        raplab::HopTable computed = store.Get(c, &computed_pin);
+        raplab::HopTable mapped = store.Get(goals[2], &mapped_pin);
+        Check(computed.hops != nullptr && mapped.hops != nullptr, "pinned tables");
+        Check(store.Flush() == 1, "flush with pinned tables");
+        Check(SameTable(view, c, computed), "computed table through its pin after Flush");
+        Check(SameTable(view, goals[2], mapped), "mapped table through its pin after Flush");
+        store.Close();
+        Check(SameTable(view, c, computed) && SameTable(view, goals[2], mapped), "pinned tables after Close");
+    }
+
+    // the store of another grid is ignored.
+    std::vector< std::vector<double> > other_occ = occ;
+    other_occ[0][0] = 1 - other_occ[0][0];
+    raplab::Grid2d other;
+    other.SetOccuGridPtr(&other_occ);
+    {
+        raplab::HeuristicStore store;
+        Check(store.Open(kStore, other.GetTableView()) == 1, "open the store of another grid");
+        Check(store.Find(goals[0]).hops == nullptr, "no table of another grid");
+    }
+
+    std::remove(kStore.c_str());
+    std::remove((kStore + ".lock").c_str());
+    if (g_n_fail > 0) {
+        std::cout << "test_heuristic_store: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_heuristic_store: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// ComputeHopTables against one ComputeHopTable per goal: every free cell as a goal, sparse goals,
+// duplicated and out of range goals, on several workers.
+
+#include "binary_map.hpp"
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+void CheckTables(const raplab::Grid2d& g, const std::vector<long>& goals, int n_threads, const std::string& name) {
+    const raplab::GridTableView& view = g.GetTableView();
+    size_t n = size_t(view.rows * view.cols);
+    std::vector< std::vector<uint32_t> > tables(goals.size(), std::vector<uint32_t>(n, 7));
+    std::vector<uint32_t*> outs;
+    for (auto& t : tables) {outs.push_back(t.data());}
+    std::vector<uint32_t> max_hops(goals.size(), 7);
+    raplab::ComputeHopTables(view, goals.data(), goals.size(), outs.data(), max_hops.data(), n_threads);
+    std::vector<uint32_t> ref(n);
+    for (size_t i = 0; i < goals.size(); i++) {
+        uint32_t max_hop = raplab::ComputeHopTable(view, goals[i], ref.data());
+        if (max_hop != max_hops[i] || ref != tables[i]) {
+            Check(false, name + ": table of goal " + std::to_string(goals[i]));
+            return;
+        }
+    }
+}
+
+}
+
+int main() {
+    std::mt19937 rng(5);
+    for (int trial = 0; trial < 24; trial++) {
+        long rows = 3 + long(rng() % 40);
+        long cols = 3 + long(rng() % 40);
+        std::vector< std::vector<double> > occ(rows, std::vector<double>(cols, 0));
+        for (auto& row : occ) {
+            for (auto& x : row) {x = (rng() % 10 < 3) ? 1 : 0;}
+        }
+        raplab::Grid2d g;
+        g.SetKNeighbor((trial % 2) ? 8 : 4);
+        g.SetVertexOrder(raplab::GridOrder(trial % 3));
+        g.SetOccuGridPtr(&occ);
+        long n = rows * cols;
+        std::string name = "trial " + std::to_string(trial);
+
+        std::vector<long> all;
+        for (long v = 0; v < n; v++) {
+            if (!g.IsObstacle(v)) {all.push_back(v);}
+        }
+        CheckTables(g, all, 1 + trial % 3, name + " every free cell");
+
+        std::vector<long> sparse;
+        for (size_t i = 0; i < 1 + rng() % 100; i++) {
+            unsigned r = rng() % 20;
+            sparse.push_back(r == 0 ? -1 : (r == 1 ? n : long(rng() % n))); // obstacles are goals too
+        }
+        sparse.insert(sparse.end(), sparse.begin(), sparse.begin() + sparse.size() / 2);
+        CheckTables(g, sparse, 1 + trial % 3, name + " sparse goals");
+    }
+
+    if (g_n_fail > 0) {
+        std::cout << "test_hop_tables: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_hop_tables: ok" << std::endl;
+    return 0;
+}
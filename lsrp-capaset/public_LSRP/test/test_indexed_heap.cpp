@@ -0,0 +1,108 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// IndexedMinHeap against std::set< std::pair<double,long> >, the queue it replaces in the searches.
+
+#include "indexed_heap.hpp"
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+// the reference queue with the decrease-key of the searches: erase the old entry, insert the new one.
+struct SetQueue
+{
+    std::set< std::pair<double, long> > s;
+    std::vector<double> key;
+
+    explicit SetQueue(size_t n) : key(n, -1) {};
+    void Push(long v, double k) {
+        if (key[v] >= 0) {
+            if (!(std::make_pair(k, v) < std::make_pair(key[v], v))) {return;}
+            s.erase(std::make_pair(key[v], v));
+        }
+        key[v] = k;
+        s.insert(std::make_pair(k, v));
+    };
+    std::pair<double, long> Pop() {
+        std::pair<double, long> top = *s.begin();
+        s.erase(s.begin());
+        key[top.second] = -1;
+        return top;
+    };
+};
+
+}
+
+int main() {
+    std::mt19937 rng(11);
+    const long n = 500;
+    raplab::IndexedMinHeap heap;
+    heap.Reserve(n);
+    Check(heap.Empty() && heap.Size() == 0, "empty after Reserve");
+
+    // decrease-key, a larger key is ignored, and the pop order follows the set, ties broken by vertex id.
+    for (int round = 0; round < 3; round++) {
+        SetQueue ref(n);
+        for (int op = 0; op < 20000; op++) {
+            unsigned r = rng() % 10;
+            if (r < 6 || ref.s.empty()) {
+                long v = long(rng() % n);
+                double k = double(rng() % 50); // many equal keys
+                heap.Push(v, k);
+                ref.Push(v, k);
+            } else {
+                Check(heap.Top() == *ref.s.begin(), "Top");
+                Check(heap.Pop() == ref.Pop(), "Pop");
+            }
+            Check(heap.Size() == ref.s.size(), "Size");
+        }
+        for (long v = 0; v < n; v++) {
+            Check(heap.Contains(v) == (ref.key[v] >= 0), "Contains " + std::to_string(v));
+        }
+        if (round == 0) {
+            while (!ref.s.empty()) {
+                Check(heap.Pop() == ref.Pop(), "Pop until empty");
+            }
+            Check(heap.Empty(), "empty after the last Pop");
+        } else {
+            // Clear and reuse: nothing is left, and the positions of the cleared vertices are reset.
+            heap.Clear();
+            Check(heap.Empty(), "empty after Clear");
+            bool any = false;
+            for (long v = 0; v < n; v++) {any = any || heap.Contains(v);}
+            Check(!any, "no vertex after Clear");
+        }
+    }
+
+    heap.Push(7, 3.0);
+    heap.Push(7, 1.0);
+    heap.Push(7, 2.0);
+    heap.Push(3, 1.0);
+    Check(heap.Size() == 2, "a vertex is in the heap once");
+    Check(heap.Pop() == std::make_pair(1.0, 3L), "equal keys pop by vertex id");
+    Check(heap.Pop() == std::make_pair(1.0, 7L), "decreased key");
+    Check(heap.Empty(), "empty");
+
+    if (g_n_fail > 0) {
+        std::cout << "test_indexed_heap: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_indexed_heap: ok" << std::endl;
+    return 0;
+}
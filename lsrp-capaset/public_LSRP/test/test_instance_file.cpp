@@ -0,0 +1,150 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// WriteInstance then LoadInstance in both forms, and the rejection of malformed binary instances.
+
+#include "instance_file.hpp"
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+const std::string kDir = "test_instance_file_dir";
+
+std::string ReadBytes(const std::string& fname) {
+    std::ifstream fin(fname, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+}
+
+void WriteBytes(const std::string& fname, const std::string& bytes) {
+    std::ofstream fout(fname, std::ios::binary | std::ios::trunc);
+    fout << bytes;
+}
+
+// the agents and capacities of a and b are equal.
+bool SameAgents(const raplab::Instance& a, const raplab::Instance& b) {
+    return a.starts == b.starts && a.goals == b.goals && a.durations == b.durations &&
+           a.cap_vertices == b.cap_vertices && a.cap_values == b.cap_values;
+}
+
+// a copy of the binary instance fname where the uint64 field at offset of the header is set to value.
+std::string WithHeaderField(const std::string& fname, size_t offset, uint64_t value, const std::string& name) {
+    std::string bytes = ReadBytes(fname);
+    std::memcpy(&bytes[offset], &value, sizeof(value));
+    std::string out = kDir + "/" + name + ".lsrpi";
+    WriteBytes(out, bytes);
+    return out;
+}
+
+}
+
+int main() {
+    ::mkdir(kDir.c_str(), 0755);
+
+    // a 5x7 map with a wall, embedded.
+    raplab::Instance inst;
+    inst.rows = 5;
+    inst.cols = 7;
+    inst.map.Resize(5, 7);
+    for (long r = 0; r < 4; r++) {
+        inst.map.SetBlocked(r * 7 + 3);
+    }
+    inst.starts = {0, 8, 34};
+    inst.goals = {6, 13, 28};
+    inst.durations = {1.0, 0.3, 2.75};
+    inst.cap_vertices = {30, 31};
+    inst.cap_values = {2, 3};
+    for (bool text : {false, true}) {
+        std::string fname = kDir + (text ? "/embedded.txt" : "/embedded.lsrpi");
+        std::string form = text ? "text" : "binary";
+        Check(raplab::WriteInstance(fname, inst, text) == 1, form + ": write an embedded map");
+        Check(raplab::IsInstanceFile(fname), form + ": IsInstanceFile");
+        raplab::Instance back;
+        Check(raplab::LoadInstance(fname, &back) == 1, form + ": load an embedded map");
+        Check(back.HasEmbeddedMap() && back.rows == 5 && back.cols == 7 && back.map_path.empty(), form + ": map size");
+        Check(back.map.bits == inst.map.bits, form + ": map cells");
+        Check(SameAgents(back, inst), form + ": agents and capacities");
+    }
+
+    // a referenced map: a relative path is resolved against the directory of the instance, an absolute
+    // one is kept.
+    raplab::Instance ref = inst;
+    ref.map = raplab::OccupancyBitmap();
+    ref.map_path = "maps/tiny.map";
+    for (bool text : {false, true}) {
+        std::string fname = kDir + (text ? "/referenced.txt" : "/referenced.lsrpi");
+        std::string form = text ? "text" : "binary";
+        Check(raplab::WriteInstance(fname, ref, text) == 1, form + ": write a referenced map");
+        raplab::Instance back;
+        Check(raplab::LoadInstance(fname, &back) == 1, form + ": load a referenced map");
+        Check(!back.HasEmbeddedMap() && back.map_path == kDir + "/maps/tiny.map", form + ": relative map path");
+        Check(back.rows == 5 && back.cols == 7, form + ": size of the referenced map");
+        Check(SameAgents(back, inst), form + ": agents of a referenced map");
+    }
+    ref.map_path = "/data/maps/tiny.map";
+    Check(raplab::WriteInstance(kDir + "/absolute.lsrpi", ref) == 1, "write an absolute map path");
+    raplab::Instance abs_back;
+    Check(raplab::LoadInstance(kDir + "/absolute.lsrpi", &abs_back) == 1 && abs_back.map_path == ref.map_path,
+          "absolute map path");
+
+    // corrupted binary instances.
+    std::string good = kDir + "/embedded.lsrpi";
+    raplab::InstanceFileHeader h;
+    std::memcpy(&h, ReadBytes(good).data(), sizeof(h));
+    raplab::Instance bad;
+    Check(raplab::LoadInstance(WithHeaderField(good, offsetof(raplab::InstanceFileHeader, off_goals), 12, "off_goals"),
+                               &bad) == -1, "sections overlap");
+    Check(raplab::LoadInstance(WithHeaderField(good, offsetof(raplab::InstanceFileHeader, off_cap_values), 1 << 20,
+                               "off_cap_values"), &bad) == -1, "section past the end");
+    Check(raplab::LoadInstance(WithHeaderField(good, offsetof(raplab::InstanceFileHeader, off_durations),
+                               h.off_durations + 4, "off_durations"), &bad) == -1, "misaligned section");
+    Check(raplab::LoadInstance(WithHeaderField(good, offsetof(raplab::InstanceFileHeader, n_agents), uint64_t(1) << 40,
+                               "n_agents"), &bad) == -1, "too many agents");
+    std::string bytes = ReadBytes(good);
+    WriteBytes(kDir + "/truncated.lsrpi", bytes.substr(0, bytes.size() - 8));
+    Check(raplab::LoadInstance(kDir + "/truncated.lsrpi", &bad) == -1, "truncated file");
+
+    // WriteInstance checks the instance.
+    raplab::Instance wrong = inst;
+    wrong.durations.pop_back();
+    Check(raplab::WriteInstance(kDir + "/wrong.lsrpi", wrong) == -1, "arrays of different sizes");
+    wrong = inst;
+    wrong.goals[1] = 35;
+    Check(raplab::WriteInstance(kDir + "/wrong.lsrpi", wrong) == -1, "goal outside the map");
+    wrong = ref;
+    wrong.map_path.clear();
+    Check(raplab::WriteInstance(kDir + "/wrong.lsrpi", wrong) == -1, "no map");
+
+    for (const char* f : {"embedded.lsrpi", "embedded.txt", "referenced.lsrpi", "referenced.txt", "absolute.lsrpi",
+                          "off_goals.lsrpi", "off_cap_values.lsrpi", "off_durations.lsrpi", "n_agents.lsrpi",
+                          "truncated.lsrpi"}) {
+        std::remove((kDir + "/" + f).c_str());
+    }
+    ::rmdir(kDir.c_str());
+    if (g_n_fail > 0) {
+        std::cout << "test_instance_file: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_instance_file: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,127 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// JpsGrid2d and JpsPlusGrid2d against Dijkstra on random 4- and 8-connected grids with obstacles, in every
+// vertex order and with a cost scale factor. The searches are reused between the queries on a grid, and
+// JpsPlusGrid2d is reused after its grid changed.
+
+#include "search_jps.hpp"
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+}
+
+int main() {
+    std::mt19937 rng(7);
+    long n_solved[2] = {0, 0}; // 4- and 8-connected
+    long n_unreachable = 0;
+    for (int trial = 0; trial < 120; trial++) {
+        long rows = 5 + long(rng() % 40);
+        long cols = 5 + long(rng() % 40);
+        unsigned density = (rng() % 5) * 100; // per thousand, from an empty grid to 40% obstacles
+        std::vector< std::vector<double> > occ(rows, std::vector<double>(cols, 0));
+        for (auto& row : occ) {
+            for (auto& x : row) {x = (rng() % 1000 < density) ? 1 : 0;}
+        }
+        int k = (trial % 2) ? 8 : 4;
+        raplab::Grid2d g;
+        g.SetKNeighbor(k);
+        g.SetVertexOrder(raplab::GridOrder(trial % 3));
+        if (trial % 5 == 0) {g.SetCostScaleFactor(2.5);}
+        g.SetOccuGridPtr(&occ);
+        raplab::Dijkstra dijkstra;
+        raplab::JpsGrid2d jps;
+        raplab::JpsPlusGrid2d jps_plus;
+        dijkstra.SetGraphPtr(&g);
+        jps.SetGraphPtr(&g);
+        jps_plus.SetGraphPtr(&g);
+        raplab::Dijkstra* searches[2] = {&jps, &jps_plus};
+        const char* names[2] = {"JPS", "JPS+"};
+        for (int q = 0; q < 60; q++) {
+            long vs = long(rng() % (rows * cols));
+            long vg = long(rng() % (rows * cols));
+            if (g.IsObstacle(vs) || g.IsObstacle(vg)) {continue;}
+            dijkstra.PathFinding(vs, vg);
+            std::vector<double> ref = dijkstra.GetSolutionCost();
+            for (int w = 0; w < 2; w++) {
+                std::string name = std::string(names[w]) + " k" + std::to_string(k) + " trial " + std::to_string(trial) +
+                    " " + std::to_string(vs) + "->" + std::to_string(vg);
+                std::vector<long> path = searches[w]->PathFinding(vs, vg);
+                std::vector<double> cost = searches[w]->GetSolutionCost();
+                if (ref.empty()) {
+                    Check(cost.empty(), name + ": unreachable goal reached");
+                    n_unreachable++;
+                    continue;
+                }
+                if (cost.empty() || std::fabs(cost[0] - ref[0]) > 1e-6) {
+                    Check(false, name + ": cost differs from Dijkstra");
+                    continue;
+                }
+                // the full path, cell by cell, over arcs of the grid.
+                bool valid = !path.empty() && path.front() == vs && path.back() == vg;
+                double sum = 0;
+                for (size_t i = 1; valid && i < path.size(); i++) {
+                    valid = g.HasArc(path[i - 1], path[i]);
+                    if (valid) {sum += g.GetCost(path[i - 1], path[i])[0];}
+                }
+                Check(valid && std::fabs(sum - ref[0]) <= 1e-6, name + ": path");
+                n_solved[k == 8]++;
+            }
+        }
+    }
+    Check(n_solved[0] > 1000 && n_solved[1] > 1000 && n_unreachable > 0,
+          "queries cover both connectivities and unreachable goals");
+
+    // the jump table follows the grid: a wall, then 8 neighbors, then another vertex order.
+    {
+        std::vector< std::vector<double> > occ(12, std::vector<double>(12, 0));
+        raplab::Grid2d g;
+        g.SetKNeighbor(4);
+        g.SetOccuGridPtr(&occ);
+        raplab::Dijkstra dijkstra;
+        raplab::JpsPlusGrid2d jps_plus;
+        dijkstra.SetGraphPtr(&g);
+        jps_plus.SetGraphPtr(&g);
+        for (int step = 0; step < 4; step++) {
+            if (step == 1) {
+                for (long r = 0; r < 11; r++) {occ[r][6] = 1;}
+                g.SetOccuGridPtr(&occ);
+            } else if (step == 2) {
+                g.SetKNeighbor(8);
+            } else if (step == 3) {
+                g.SetVertexOrder(raplab::GridOrder(1));
+            }
+            dijkstra.PathFinding(0, 11);
+            std::vector<double> ref = dijkstra.GetSolutionCost();
+            jps_plus.PathFinding(0, 11);
+            std::vector<double> cost = jps_plus.GetSolutionCost();
+            Check(!ref.empty() && !cost.empty() && std::fabs(cost[0] - ref[0]) <= 1e-6,
+                  "JPS+ after grid change " + std::to_string(step));
+        }
+    }
+
+    if (g_n_fail > 0) {
+        std::cout << "test_jps: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_jps: ok, " << n_solved[0] << " 4-connected and " << n_solved[1] << " 8-connected paths, "
+              << n_unreachable << " unreachable goals" << std::endl;
+    return 0;
+}
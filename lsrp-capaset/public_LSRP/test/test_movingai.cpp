@@ -0,0 +1,225 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// ParseMap_MovingAI and ParseScenarios_MovingAI on LF and CRLF files, their errors on malformed input,
+// the scenario selection, and LoadMap_MovingAI and LoadScenarios against the getline readers they replaced.
+
+#include "graph_io.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+// files written in the working directory, removed at the end.
+std::vector<std::string> g_files;
+
+std::string WriteFile(const std::string& name, const std::string& text) {
+    std::string fname = "test_movingai_" + name;
+    std::ofstream fout(fname, std::ios::binary);
+    fout << text;
+    g_files.push_back(fname);
+    return fname;
+}
+
+std::string MapText(const std::vector<std::string>& rows, long height, long width, const std::string& eol) {
+    std::string out = "type octile" + eol + "height " + std::to_string(height) + eol + "width " +
+                      std::to_string(width) + eol + "map" + eol;
+    for (const auto& row : rows) {out += row + eol;}
+    return out;
+}
+
+// the .map reader before ParseMap_MovingAI: rows start at the first line with a map cell.
+std::vector< std::vector<double> > OldLoadMap(const std::string& fname) {
+    std::ifstream ifs(fname);
+    std::vector< std::vector<double> > grid;
+    std::string line;
+    bool read = false;
+    while (std::getline(ifs, line)) {
+        if (line.find_first_of(".@TG") != std::string::npos) {read = true;}
+        if (!read) {continue;}
+        std::vector<double> row;
+        for (char pixel : line) {row.push_back((pixel == '.' || pixel == 'G') ? 0 : 1);}
+        grid.push_back(row);
+    }
+    return grid;
+}
+
+// the .scen reader before ParseScenarios_MovingAI: the first n entries after the version line.
+void OldLoadScenarios(const std::string& fname, int n, std::vector<long>* starts, std::vector<long>* goals,
+                      std::tuple<int,int>* width_height) {
+    std::ifstream infile(fname);
+    std::string line;
+    std::getline(infile, line);
+    for (int count = 0; count < n && std::getline(infile, line); count++) {
+        std::istringstream iss(line);
+        int bucket, w, h, sx, sy, gx, gy;
+        std::string map;
+        double opt;
+        if (!(iss >> bucket >> map >> w >> h >> sx >> sy >> gx >> gy >> opt)) {break;}
+        starts->push_back(long(sy) * w + sx);
+        goals->push_back(long(gy) * w + gx);
+        if (count == 0) {*width_height = std::make_tuple(w, h);}
+    }
+}
+
+struct Entry
+{
+    int bucket;
+    long sx, sy, gx, gy;
+};
+
+std::string ScenText(const std::vector<Entry>& entries, long width, long height, const std::string& eol) {
+    std::ostringstream out;
+    out << "version 1" << eol;
+    for (const auto& e : entries) {
+        out << e.bucket << "\tmaps/test.map\t" << width << "\t" << height << "\t" << e.sx << "\t" << e.sy << "\t"
+            << e.gx << "\t" << e.gy << "\t" << 1.5 * e.bucket << eol;
+    }
+    return out.str();
+}
+
+}
+
+int main() {
+    std::mt19937 rng(17);
+    const long height = 9;
+    const long width = 13;
+    std::vector<std::string> rows;
+    for (long r = 0; r < height; r++) {
+        std::string row;
+        for (long c = 0; c < width; c++) {row += ".@TG"[rng() % 4];}
+        rows.push_back(row);
+    }
+
+    // the same map with LF and CRLF line ends.
+    raplab::OccupancyBitmap lf;
+    raplab::OccupancyBitmap crlf;
+    std::string lf_map = WriteFile("lf.map", MapText(rows, height, width, "\n"));
+    Check(raplab::ParseMap_MovingAI(lf_map, &lf) == 1, "LF map");
+    Check(raplab::ParseMap_MovingAI(WriteFile("crlf.map", MapText(rows, height, width, "\r\n")), &crlf) == 1, "CRLF map");
+    Check(lf.rows == height && lf.cols == width && crlf.rows == height && crlf.cols == width, "map size");
+    Check(lf.bits == crlf.bits, "LF and CRLF maps are equal");
+    bool cells_ok = true;
+    for (long k = 0; k < height * width; k++) {
+        char c = rows[k / width][k % width];
+        cells_ok = cells_ok && lf.IsBlocked(k) == (c != '.' && c != 'G');
+    }
+    Check(cells_ok, "'.' and 'G' are free, the other cells are obstacles");
+    std::vector< std::vector<double> > grid;
+    Check(raplab::LoadMap_MovingAI(lf_map, &grid) == 1 && grid == OldLoadMap(lf_map), "LoadMap_MovingAI as before");
+
+    // malformed maps.
+    raplab::OccupancyBitmap bad;
+    Check(raplab::ParseMap_MovingAI(WriteFile("missing_rows.map", MapText(std::vector<std::string>(rows.begin(), rows.end() - 2),
+          height, width, "\n")), &bad) == -1, "truncated map");
+    std::vector<std::string> short_row = rows;
+    short_row[3].pop_back();
+    Check(raplab::ParseMap_MovingAI(WriteFile("short_row.map", MapText(short_row, height, width, "\n")), &bad) == -1,
+          "row shorter than the width");
+    Check(raplab::ParseMap_MovingAI(WriteFile("wide.map", MapText(rows, height, width - 1, "\n")), &bad) == -1,
+          "width of the header below the rows");
+    Check(raplab::ParseMap_MovingAI(WriteFile("tall.map", MapText(rows, height - 1, width, "\n")), &bad) == -1,
+          "more rows than the header");
+    Check(raplab::ParseMap_MovingAI(WriteFile("no_header.map", "map\n" + rows[0] + "\n"), &bad) == -1, "no size");
+    Check(raplab::ParseMap_MovingAI("test_movingai_missing.map", &bad) == -1, "missing map");
+    Check(raplab::LoadMap_MovingAI("test_movingai_missing.map", &grid) == -1, "LoadMap_MovingAI of a missing map");
+
+    // scenarios: 3 buckets of 4 entries.
+    std::vector<Entry> entries;
+    for (int i = 0; i < 12; i++) {
+        entries.push_back({i / 4, long(rng() % width), long(rng() % height), long(rng() % width), long(rng() % height)});
+    }
+    std::string lf_scen = WriteFile("lf.scen", ScenText(entries, width, height, "\n"));
+    std::string crlf_scen = WriteFile("crlf.scen", ScenText(entries, width, height, "\r\n"));
+    for (const std::string& fname : {lf_scen, crlf_scen}) {
+        std::vector<long> starts, goals;
+        std::tuple<int,int> wh;
+        Check(raplab::ParseScenarios_MovingAI(fname, raplab::ScenarioSelection(), &starts, &goals, &wh) == 1, fname);
+        bool ids_ok = starts.size() == entries.size() && goals.size() == entries.size();
+        for (size_t i = 0; ids_ok && i < entries.size(); i++) {
+            ids_ok = starts[i] == entries[i].sy * width + entries[i].sx && goals[i] == entries[i].gy * width + entries[i].gx;
+        }
+        Check(ids_ok, fname + ": row-major ids");
+        Check(wh == std::make_tuple(int(width), int(height)), fname + ": map size");
+    }
+
+    // bucket range, then skip, then count.
+    raplab::ScenarioSelection sel;
+    sel.bucket_min = 1;
+    sel.bucket_max = 2;
+    sel.skip = 2;
+    sel.count = 3;
+    std::vector<long> starts, goals;
+    std::tuple<int,int> wh;
+    Check(raplab::ParseScenarios_MovingAI(crlf_scen, sel, &starts, &goals, &wh) == 1, "selection");
+    bool sel_ok = starts.size() == 3;
+    for (size_t i = 0; sel_ok && i < 3; i++) {
+        sel_ok = starts[i] == entries[6 + i].sy * width + entries[6 + i].sx;
+    }
+    Check(sel_ok, "entries 6 to 8: buckets 1 and 2, two skipped, three taken");
+    sel.count = 100;
+    starts.clear();
+    goals.clear();
+    Check(raplab::ParseScenarios_MovingAI(lf_scen, sel, &starts, &goals, &wh) == 1 && starts.size() == 6,
+          "count beyond the selection");
+    sel.width = width + 1;
+    sel.height = height;
+    Check(raplab::ParseScenarios_MovingAI(lf_scen, sel, &starts, &goals, &wh) == -1, "map size of the selection");
+
+    // LoadScenarios reads the first n entries, as before.
+    for (int n : {0, 5, 12, 20}) {
+        std::vector<long> s_new, g_new, s_old, g_old;
+        std::tuple<int,int> wh_new, wh_old;
+        Check(raplab::LoadScenarios(lf_scen, n, &s_new, &g_new, &wh_new) == 1, "LoadScenarios " + std::to_string(n));
+        OldLoadScenarios(lf_scen, n, &s_old, &g_old, &wh_old);
+        Check(s_new == s_old && g_new == g_old, "LoadScenarios " + std::to_string(n) + " as before");
+        Check(n == 0 || wh_new == wh_old, "LoadScenarios " + std::to_string(n) + " map size as before");
+    }
+
+    // malformed scenarios.
+    std::vector<Entry> outside = entries;
+    outside[5].gx = width;
+    Check(raplab::ParseScenarios_MovingAI(WriteFile("outside.scen", ScenText(outside, width, height, "\n")),
+          raplab::ScenarioSelection(), &starts, &goals, &wh) == -1, "goal outside the map");
+    outside = entries;
+    outside[2].sy = height;
+    Check(raplab::ParseScenarios_MovingAI(WriteFile("outside_y.scen", ScenText(outside, width, height, "\n")),
+          raplab::ScenarioSelection(), &starts, &goals, &wh) == -1, "start outside the map");
+    std::string mixed = ScenText(entries, width, height, "\n") + ScenText({entries[0]}, width + 1, height, "\n").substr(10);
+    Check(raplab::ParseScenarios_MovingAI(WriteFile("mixed.scen", mixed), raplab::ScenarioSelection(), &starts, &goals,
+          &wh) == -1, "entries of maps of two sizes");
+    Check(raplab::ParseScenarios_MovingAI(WriteFile("negative.scen", "version 1\n0\tm.map\t13\t9\t-1\t0\t1\t1\t2\n"),
+          raplab::ScenarioSelection(), &starts, &goals, &wh) == -1, "negative cell");
+    Check(raplab::ParseScenarios_MovingAI(WriteFile("no_version.scen", ScenText(entries, width, height, "\n").substr(10)),
+          raplab::ScenarioSelection(), &starts, &goals, &wh) == -1, "no version line");
+    Check(raplab::ParseScenarios_MovingAI("test_movingai_missing.scen", raplab::ScenarioSelection(), &starts, &goals,
+          &wh) == -1, "missing scenario");
+
+    for (const auto& f : g_files) {
+        std::remove(f.c_str());
+    }
+    if (g_n_fail > 0) {
+        std::cout << "test_movingai: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_movingai: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// WritePlan then PlanReader, the rounding of times to ticks, truncated files, and the errors of
+// PlanWriter::Close: agent count of the header and times that are not finite.
+
+#include "plan_file.hpp"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+// files written in the working directory, removed at the end.
+std::vector<std::string> g_files;
+
+std::string FileName(const std::string& name) {
+    std::string fname = "test_plan_file_" + name + ".lsrpplan";
+    g_files.push_back(fname);
+    return fname;
+}
+
+std::string ReadBytes(const std::string& fname) {
+    std::ifstream fin(fname, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+}
+
+void WriteBytes(const std::string& fname, const std::string& bytes) {
+    std::ofstream fout(fname, std::ios::binary | std::ios::trunc);
+    fout << bytes;
+}
+
+typedef std::vector< std::vector< std::tuple<long, long, double, double> > > Paths;
+
+}
+
+int main() {
+    // vertices going down and up, waits, times that are not multiples of a tick.
+    Paths paths = {
+        {std::make_tuple(5L, 6L, 0.0, 1.0), std::make_tuple(6L, 6L, 1.0, 2.5), std::make_tuple(6L, 1L, 2.5, 3.125)},
+        {std::make_tuple(100000L, 99999L, 0.0, 1.0 / 3), std::make_tuple(99999L, 0L, 1.0 / 3, 2.0 / 3)},
+        {},
+    };
+    std::vector<double> durations = {1.0, 0.5, 2.0};
+    raplab::PlanFileHeader header;
+    header.rows = 400;
+    header.cols = 250;
+    header.ticks_per_unit = 100;
+    header.runtime = 0.25;
+    header.soc = 4.125;
+    header.makespan = 3.125;
+    std::string good = FileName("good");
+    Check(raplab::WritePlan(good, header, durations, paths) == 1, "WritePlan");
+
+    raplab::PlanReader reader;
+    Check(reader.Open(good) == 1, "open a plan");
+    const raplab::PlanFileHeader& h = reader.Header();
+    Check(h.n_agents == 3 && h.rows == 400 && h.cols == 250 && h.ticks_per_unit == 100, "header sizes");
+    Check(h.runtime == 0.25 && h.soc == 4.125 && h.makespan == 3.125, "header results");
+    for (size_t i = 0; i < paths.size(); i++) {
+        double duration = 0;
+        std::vector<raplab::PlanSection> sections;
+        std::string name = "agent " + std::to_string(i);
+        Check(reader.NextAgent(&duration, &sections) == 1, name + ": read");
+        Check(duration == durations[i] && sections.size() == paths[i].size(), name + ": duration and size");
+        for (size_t k = 0; k < sections.size() && k < paths[i].size(); k++) {
+            const raplab::PlanSection& s = sections[k];
+            double start = std::get<2>(paths[i][k]);
+            double end = std::get<3>(paths[i][k]);
+            // times come back rounded to the nearest tick.
+            Check(s.from == std::get<0>(paths[i][k]) && s.to == std::get<1>(paths[i][k]), name + ": vertices");
+            Check(std::fabs(s.start - std::round(start * 100) / 100) < 1e-12 &&
+                  std::fabs(s.end - std::round(end * 100) / 100) < 1e-12, name + ": times rounded to ticks");
+        }
+    }
+    double duration = 0;
+    std::vector<raplab::PlanSection> sections;
+    Check(reader.NextAgent(&duration, &sections) == 0, "no agent after the last one");
+
+    // a plan cut in the middle of its first agent.
+    std::string bytes = ReadBytes(good);
+    std::string truncated = FileName("truncated");
+    WriteBytes(truncated, bytes.substr(0, sizeof(raplab::PlanFileHeader) + 14));
+    raplab::PlanReader cut;
+    Check(cut.Open(truncated) == 1, "open a truncated plan");
+    Check(cut.NextAgent(&duration, &sections) == -1, "truncated agent");
+    std::string header_only = FileName("header_only");
+    WriteBytes(header_only, bytes.substr(0, sizeof(raplab::PlanFileHeader) - 1));
+    Check(raplab::PlanReader().Open(header_only) == -1, "truncated header");
+    std::string other = FileName("other");
+    WriteBytes(other, std::string(sizeof(raplab::PlanFileHeader), 'x'));
+    Check(raplab::PlanReader().Open(other) == -1, "not a plan file");
+
+    // fewer agents than the header announces.
+    {
+        raplab::PlanWriter w;
+        raplab::PlanFileHeader three;
+        three.n_agents = 3;
+        Check(w.Open(FileName("fewer"), three) == 1, "open a writer");
+        w.BeginAgent(1, 1.0);
+        w.PutSection(0, 1, 0, 1);
+        w.BeginAgent(0, 1.0);
+        Check(w.Close() == -1, "agent count of the header");
+    }
+
+    // a time that is not finite is rejected, the file stays decodable.
+    for (double t : {std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN(), 1e300}) {
+        std::string fname = FileName("not_finite");
+        raplab::PlanWriter w;
+        raplab::PlanFileHeader one;
+        one.n_agents = 1;
+        w.Open(fname, one);
+        w.BeginAgent(2, 1.0);
+        w.PutSection(0, 1, 0, 1);
+        w.PutSection(1, 2, 1, t);
+        Check(w.Close() == -1, "time " + std::to_string(t) + " rejected");
+        raplab::PlanReader r;
+        Check(r.Open(fname) == 1 && r.NextAgent(&duration, &sections) == 1 && sections.size() == 2 &&
+              sections[1].start == 1 && sections[1].end == 1, "time " + std::to_string(t) + ": decodable");
+    }
+
+    for (const auto& f : g_files) {
+        std::remove(f.c_str());
+    }
+    if (g_n_fail > 0) {
+        std::cout << "test_plan_file: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_plan_file: ok" << std::endl;
+    return 0;
+}
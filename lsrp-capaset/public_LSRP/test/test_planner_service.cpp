@@ -0,0 +1,161 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// ServeStream over a socketpair: several requests, malformed frames and a shutdown, the plans matched
+// to the requests by id and compared with PlannerService::Solve.
+
+#include "planner_service.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+bool SendFrame(int fd, const std::string& payload) {
+    std::string frame(4, '\0');
+    for (int i = 0; i < 4; i++) {frame[i] = char((payload.size() >> (8 * i)) & 0xff);}
+    frame += payload;
+    return ::write(fd, frame.data(), frame.size()) == ssize_t(frame.size());
+}
+
+bool ReadFrame(int fd, std::string* payload) {
+    unsigned char len[4];
+    size_t got = 0;
+    while (got < 4) {
+        ssize_t k = ::read(fd, len + got, 4 - got);
+        if (k <= 0) {return false;}
+        got += size_t(k);
+    }
+    payload->assign(size_t(len[0]) | (size_t(len[1]) << 8) | (size_t(len[2]) << 16) | (size_t(len[3]) << 24), '\0');
+    for (got = 0; got < payload->size();) {
+        ssize_t k = ::read(fd, &(*payload)[got], payload->size() - got);
+        if (k <= 0) {return false;}
+        got += size_t(k);
+    }
+    return true;
+}
+
+}
+
+int main() {
+    // a 12x12 map with a wall in the middle, open at both ends.
+    const long rows = 12;
+    const long cols = 12;
+    std::vector<uint8_t> cells(rows * cols, 0);
+    for (long r = 2; r < 10; r++) {cells[r * cols + 6] = 1;}
+    raplab::PlannerService service;
+    Check(service.SetMap(cells.data(), rows, cols) == 1, "SetMap");
+
+    std::vector<raplab::SolveRequest> requests(3);
+    requests[0].starts = {0, 13};
+    requests[0].goals = {143, 11};
+    requests[0].durations = {1, 0.5};
+    requests[1].starts = {24, 60, 100};
+    requests[1].goals = {35, 71, 111};
+    requests[1].durations = {1, 2, 1.5};
+    requests[1].capacities = {{47, 2}};
+    requests[1].swap = true;
+    requests[2].starts = {5};
+    requests[2].goals = {30}; // an obstacle
+    requests[2].durations = {1};
+    for (size_t i = 0; i < requests.size(); i++) {requests[i].id = 11 + i;}
+
+    int fds[2];
+    Check(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0, "socketpair");
+    int served = 0;
+    std::thread server([&]() {served = raplab::ServeStream(&service, fds[1], fds[1], 2);});
+
+    for (const auto& req : requests) {
+        std::string payload;
+        raplab::EncodeSolveRequest(req, &payload);
+        Check(SendFrame(fds[0], payload), "send request " + std::to_string(req.id));
+    }
+    // a request cut after its id, then a request whose id cannot be read.
+    std::string truncated;
+    raplab::SolveRequest bad = requests[0];
+    bad.id = 99;
+    raplab::EncodeSolveRequest(bad, &truncated);
+    truncated.resize(truncated.size() - 5);
+    Check(SendFrame(fds[0], truncated), "send a truncated request");
+    Check(SendFrame(fds[0], std::string(1, char(raplab::SERVE_SOLVE))), "send a request without id");
+    Check(SendFrame(fds[0], std::string(1, char(raplab::SERVE_SHUTDOWN))), "send a shutdown");
+
+    // the responses come in completion order.
+    std::map<uint64_t, raplab::SolveResult> results;
+    std::vector<uint64_t> invalid_ids;
+    for (size_t i = 0; i < requests.size() + 2; i++) {
+        std::string payload;
+        raplab::SolveResult res;
+        if (!ReadFrame(fds[0], &payload) || !raplab::DecodeSolveResult(payload, &res)) {
+            Check(false, "response " + std::to_string(i));
+            break;
+        }
+        if (res.status == raplab::SOLVE_INVALID) {
+            invalid_ids.push_back(res.id);
+        } else {
+            results[res.id] = res;
+        }
+    }
+    server.join();
+    ::close(fds[0]);
+    ::close(fds[1]);
+    Check(served == 1, "ServeStream stops after the shutdown");
+
+    Check(invalid_ids.size() == 3, "three invalid requests");
+    Check(std::count(invalid_ids.begin(), invalid_ids.end(), 99) == 1, "the id of a truncated request is echoed");
+    Check(std::count(invalid_ids.begin(), invalid_ids.end(), 0) == 1, "id 0 when the id cannot be read");
+    Check(std::count(invalid_ids.begin(), invalid_ids.end(), 13) == 1, "a goal on an obstacle is invalid");
+    for (size_t k = 0; k < 2; k++) {
+        const raplab::SolveRequest& req = requests[k];
+        std::string name = "request " + std::to_string(req.id);
+        if (!results.count(req.id)) {
+            Check(false, name + ": no plan");
+            continue;
+        }
+        const raplab::SolveResult& res = results[req.id];
+        raplab::SolveResult direct = service.Solve(req);
+        Check(res.status == raplab::SOLVE_OK && direct.status == raplab::SOLVE_OK, name + ": status");
+        Check(res.paths.size() == req.starts.size() && res.durations == req.durations, name + ": agents");
+        Check(res.soc == direct.soc && res.makespan == direct.makespan, name + ": same plan as Solve");
+        for (size_t a = 0; a < res.paths.size() && a < req.starts.size(); a++) {
+            const auto& path = res.paths[a];
+            Check(!path.empty() && std::get<0>(path.front()) == req.starts[a] && std::get<1>(path.back()) == req.goals[a],
+                  name + ": path of agent " + std::to_string(a));
+        }
+    }
+
+    // a plan with a time that is not finite is sent as invalid.
+    raplab::SolveResult nan_plan = results.begin()->second;
+    std::get<3>(nan_plan.paths[0].back()) = std::nan("");
+    std::string payload;
+    raplab::EncodeSolveResult(nan_plan, &payload);
+    raplab::SolveResult decoded;
+    Check(raplab::DecodeSolveResult(payload, &decoded) && decoded.status == raplab::SOLVE_INVALID &&
+          decoded.id == nan_plan.id && decoded.paths.empty(), "a plan with a time that is not finite");
+
+    if (g_n_fail > 0) {
+        std::cout << "test_planner_service: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_planner_service: ok" << std::endl;
+    return 0;
+}
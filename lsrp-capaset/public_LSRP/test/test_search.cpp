@@ -0,0 +1,160 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// Dijkstra and AstarGrid2d against a plain std::set Dijkstra, on a grid with obstacles and on a sparse
+// graph with two cost dimensions. The searches are reused between queries, as in the planner.
+
+#include "search_astar.hpp"
+#include <iostream>
+#include <limits>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+const double kInf = std::numeric_limits<double>::infinity();
+
+// distances from vs over the successors of g in cost dimension cdim.
+std::vector<double> ReferenceDist(raplab::PlannerGraph& g, long vs, short cdim) {
+    std::vector<double> d(g.NumVertex(), kInf);
+    std::set< std::pair<double, long> > open;
+    d[vs] = 0;
+    open.insert(std::make_pair(0.0, vs));
+    while (!open.empty()) {
+        long v = open.begin()->second;
+        open.erase(open.begin());
+        for (long u : g.GetSuccs(v)) {
+            double du = d[v] + g.GetCost(v, u)[cdim];
+            if (du < d[u]) {
+                open.erase(std::make_pair(d[u], u));
+                d[u] = du;
+                open.insert(std::make_pair(du, u));
+            }
+        }
+    }
+    return d;
+}
+
+// the path of the last query goes from vs to vg over arcs of g, and its costs are the solution cost.
+void CheckPath(raplab::PlannerGraph& g, const std::vector<long>& path, const std::vector<double>& cost, long vs, long vg,
+               const std::string& name) {
+    if (path.empty() || path.front() != vs || path.back() != vg) {
+        Check(false, name + ": path endpoints");
+        return;
+    }
+    std::vector<double> sum(cost.size(), 0.0);
+    for (size_t i = 1; i < path.size(); i++) {
+        if (!g.HasArc(path[i - 1], path[i])) {
+            Check(false, name + ": path arc");
+            return;
+        }
+        std::vector<double> c = g.GetCost(path[i - 1], path[i]);
+        for (size_t d = 0; d < sum.size() && d < c.size(); d++) {sum[d] += c[d];}
+    }
+    Check(sum == cost, name + ": path cost");
+}
+
+}
+
+int main() {
+    std::mt19937 rng(3);
+
+    // 4-connected grid, a quarter of the cells are obstacles.
+    const long rows = 60;
+    const long cols = 70;
+    std::vector< std::vector<double> > occ(rows, std::vector<double>(cols, 0));
+    for (auto& row : occ) {
+        for (auto& x : row) {x = (rng() % 4 == 0) ? 1 : 0;}
+    }
+    raplab::Grid2d grid;
+    grid.SetOccuGridPtr(&occ);
+    raplab::Dijkstra dijkstra;
+    raplab::AstarGrid2d astar;
+    dijkstra.SetGraphPtr(&grid);
+    astar.SetGraphPtr(&grid);
+    int n_reached = 0;
+    int n_unreached = 0;
+    for (int q = 0; q < 200; q++) {
+        long vs = long(rng() % (rows * cols));
+        long vg = long(rng() % (rows * cols));
+        if (occ[vs / cols][vs % cols] || occ[vg / cols][vg % cols]) {continue;}
+        std::vector<double> ref = ReferenceDist(grid, vs, 0);
+        std::string name = "grid " + std::to_string(vs) + "->" + std::to_string(vg);
+        std::vector<long> p1 = dijkstra.PathFinding(vs, vg);
+        std::vector<double> c1 = dijkstra.GetSolutionCost();
+        std::vector<long> p2 = astar.PathFinding(vs, vg);
+        std::vector<double> c2 = astar.GetSolutionCost();
+        if (ref[vg] == kInf) {
+            Check(c1.empty() && c2.empty(), name + ": unreachable");
+            n_unreached++;
+            continue;
+        }
+        n_reached++;
+        Check(!c1.empty() && c1[0] == ref[vg], name + ": Dijkstra cost");
+        Check(!c2.empty() && c2[0] == ref[vg], name + ": A* cost");
+        CheckPath(grid, p1, c1, vs, vg, name + " Dijkstra");
+        CheckPath(grid, p2, c2, vs, vg, name + " A*");
+        if (q % 20 == 0) {
+            // the grid is undirected, so the backward distances to vs are the reference distances.
+            raplab::Dijkstra all;
+            all.SetGraphPtr(&grid);
+            all.ExhaustiveBackwards(vs);
+            bool same = true;
+            for (long v = 0; v < rows * cols; v++) {
+                if (!occ[v / cols][v % cols] && ref[v] != kInf) {same = same && all.GetDistValue(v) == ref[v];}
+            }
+            Check(same, name + ": ExhaustiveBackwards");
+        }
+    }
+    Check(n_reached > 50 && n_unreached > 0, "grid queries cover reachable and unreachable goals");
+
+    // sparse directed graph with two cost dimensions, searched in each.
+    raplab::SparseGraph sparse;
+    const long n = 300;
+    for (long v = 0; v < n; v++) {sparse.AddVertex(v);}
+    for (int i = 0; i < 1200; i++) {
+        long u = long(rng() % n);
+        long v = long(rng() % n);
+        if (u != v && !sparse.HasArc(u, v)) {
+            sparse.AddArc(u, v, {double(rng() % 10), double(rng() % 7)});
+        }
+    }
+    raplab::Dijkstra search;
+    search.SetGraphPtr(&sparse);
+    for (int q = 0; q < 200; q++) {
+        long vs = long(rng() % n);
+        long vg = long(rng() % n);
+        short cdim = short(q % 2);
+        std::vector<double> ref = ReferenceDist(sparse, vs, cdim);
+        std::string name = "sparse " + std::to_string(vs) + "->" + std::to_string(vg) + " dim " + std::to_string(cdim);
+        std::vector<long> p = search.PathFinding(vs, vg, kInf, cdim);
+        std::vector<double> c = search.GetSolutionCost();
+        if (ref[vg] == kInf) {
+            Check(c.empty(), name + ": unreachable");
+            continue;
+        }
+        Check(c.size() == 2 && c[cdim] == ref[vg], name + ": cost");
+        CheckPath(sparse, p, c, vs, vg, name);
+    }
+
+    if (g_n_fail > 0) {
+        std::cout << "test_search: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_search: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,113 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// The frozen forms of SparseGraph (Freeze, CreateFrozenFromArcs/Ids) against the adjacency lists built by AddArc.
+
+#include "graph.hpp"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+int g_n_fail = 0;
+
+void Check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "[FAIL] " << what << std::endl;
+        g_n_fail++;
+    }
+}
+
+// successors, predecessors and costs of every vertex of g equal those of ref.
+void CheckSameAdjacency(raplab::SparseGraph& g, raplab::SparseGraph& ref, const std::string& name) {
+    Check(g.NumVertex() == ref.NumVertex(), name + ": NumVertex");
+    Check(g.CostDim() == ref.CostDim(), name + ": CostDim");
+    for (long v = 0; v < long(ref.NumVertex()); v++) {
+        std::vector<long> s = g.GetSuccs(v);
+        std::vector<long> s_ref = ref.GetSuccs(v);
+        std::vector<long> p = g.GetPreds(v);
+        std::vector<long> p_ref = ref.GetPreds(v);
+        // AddArc keeps the insertion order, the frozen graph sorts by id.
+        std::sort(s_ref.begin(), s_ref.end());
+        std::sort(p_ref.begin(), p_ref.end());
+        Check(s == s_ref, name + ": succs of " + std::to_string(v));
+        Check(p == p_ref, name + ": preds of " + std::to_string(v));
+        Check(g.OutDegree(v) == ref.OutDegree(v), name + ": out degree of " + std::to_string(v));
+        for (long u : s_ref) {
+            Check(g.HasArc(v, u), name + ": HasArc");
+            Check(g.GetCost(v, u) == ref.GetCost(v, u), name + ": cost of " + std::to_string(v) + "->" + std::to_string(u));
+        }
+        raplab::ArcSpan arcs = g.GetSuccArcs(v);
+        for (size_t i = 0; i < arcs.size; i++) {
+            raplab::CostVec c = ref.GetCost(v, arcs.ids[i]);
+            for (size_t d = 0; d < c.size(); d++) {
+                Check(arcs.Cost(i, d) == c[d], name + ": arc span cost");
+            }
+        }
+    }
+    Check(!g.HasArc(-1, 0) && !g.HasArc(long(ref.NumVertex()), 0), name + ": HasArc outside the graph");
+    Check(g.GetCost(long(ref.NumVertex()) + 5, 0).empty(), name + ": GetCost outside the graph");
+}
+
+}
+
+int main() {
+    std::mt19937 rng(7);
+    const long n = 300;
+    std::vector<long> sources;
+    std::vector<long> targets;
+    std::vector<double> costs; // two costs per arc.
+    raplab::SparseGraph ref;
+    raplab::SparseGraph frozen;
+    for (int i = 0; i < 3000; i++) {
+        long u = long(rng() % n);
+        long v = long(rng() % 40); // many parallel arcs
+        std::vector<double> c = {double(rng() % 100), double(rng() % 7) / 4.0};
+        ref.AddArc(u, v, c);
+        frozen.AddArc(u, v, c);
+        sources.push_back(u);
+        targets.push_back(v);
+        costs.insert(costs.end(), c.begin(), c.end());
+    }
+    frozen.Freeze();
+    CheckSameAdjacency(frozen, ref, "Freeze");
+
+    raplab::SparseGraph merged;
+    merged.CreateFrozenFromArcs(sources, targets, costs, 2, true);
+    CheckSameAdjacency(merged, ref, "CreateFrozenFromArcs");
+
+    raplab::SparseGraph merged_ids;
+    merged_ids.CreateFrozenFromIds(std::vector<raplab::vid_t>(sources.begin(), sources.end()),
+                                   std::vector<raplab::vid_t>(targets.begin(), targets.end()), costs, 2, true);
+    CheckSameAdjacency(merged_ids, ref, "CreateFrozenFromIds");
+
+    raplab::SparseGraph multi;
+    multi.CreateFrozenFromArcs(sources, targets, costs, 2);
+    Check(multi.NumArc() == sources.size(), "CreateFrozenFromArcs keeps parallel arcs");
+
+    // a frozen graph is thawed by AddArc.
+    frozen.AddArc(n + 3, 0, {1.0, 2.0});
+    ref.AddArc(n + 3, 0, {1.0, 2.0});
+    CheckSameAdjacency(frozen, ref, "AddArc after Freeze");
+
+    raplab::SparseGraph empty;
+    empty.CreateFrozenFromArcs({}, {}, {}, 1);
+    Check(empty.NumVertex() == 0 && empty.NumArc() == 0, "no arcs, no vertex");
+    Check(!empty.HasArc(0, 0) && empty.GetSuccs(0).empty(), "queries on an empty graph");
+
+    raplab::SparseGraph empty_frozen;
+    empty_frozen.Freeze();
+    Check(empty_frozen.NumVertex() == 0 && !empty_frozen.HasArc(0, 0), "Freeze of an empty graph");
+
+    if (g_n_fail > 0) {
+        std::cout << "test_sparse_graph: " << g_n_fail << " checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "test_sparse_graph: ok" << std::endl;
+    return 0;
+}
@@ -0,0 +1,69 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// Pack the map, scenario, duration and capacity files of a run into one instance file, or convert an
+// instance file between the binary and the text form, see instance_file.hpp.
+
+#include "instance_file.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> inputs;
+    std::string outPath = "";
+    bool text = false;
+    bool embedMap = false;
+    raplab::ScenarioSelection sel;
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "-o" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (a == "--text") {
+            text = true;
+        } else if (a == "--embed-map") {
+            embedMap = true;
+        } else if (a == "--buckets" && i + 1 < argc) {
+            std::string b = argv[++i];
+            size_t sep = b.find(':');
+            sel.bucket_min = std::stoi(b.substr(0, sep));
+            sel.bucket_max = (sep == std::string::npos) ? sel.bucket_min : std::stoi(b.substr(sep + 1));
+        } else if (a == "--skip-agents" && i + 1 < argc) {
+            sel.skip = std::stol(argv[++i]);
+        } else if (a.compare(0, 2, "--") == 0) {
+            std::cerr << "Unknown argument: " << a << std::endl;
+            return -1;
+        } else {
+            inputs.push_back(a);
+        }
+    }
+    if (outPath.empty() || (inputs.size() != 1 && inputs.size() != 3 && inputs.size() != 4)) {
+        std::cerr << "Usage: " << argv[0] << " <map_path> <scen_path> <duration_path> [capacity_path] -o <output_path>"
+                  << " [--text] [--embed-map] [--buckets <min>:<max>] [--skip-agents <n>]" << std::endl
+                  << "       " << argv[0] << " <instance_path> -o <output_path> [--text]" << std::endl;
+        return -1;
+    }
+
+    raplab::Instance inst;
+    if (inputs.size() == 1) {
+        if (raplab::LoadInstance(inputs[0], &inst) != 1) {
+            return -1;
+        }
+    } else {
+        // the map path is written as given, a relative path must be relative to the output file.
+        std::string capacityPath = (inputs.size() == 4) ? inputs[3] : "";
+        if (raplab::AssembleInstance(inputs[0], inputs[1], inputs[2], capacityPath, sel, embedMap, &inst) != 1) {
+            return -1;
+        }
+    }
+    if (raplab::WriteInstance(outPath, inst, text) != 1) {
+        return -1;
+    }
+    std::cout << outPath << ": " << inst.NumAgents() << " agents, " << inst.cap_vertices.size() << " capacities, "
+              << (inst.HasEmbeddedMap() ? "embedded " + std::to_string(inst.rows) + "x" + std::to_string(inst.cols) + " map"
+                                        : "map " + inst.map_path) << std::endl;
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// Convert a MovingAI .map file into a precompiled binary map, see binary_map.hpp.
+
+#include "binary_map.hpp"
+#include "graph_io.hpp"
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <map_path> <output_path> [--kngh 4|8] [--capacity <capacity_path>]"
+                  << " [--hop-goals <scen_path> <n_agents>] [--vertex-order row|hilbert|bfs]" << std::endl;
+        return -1;
+    }
+    std::string mapPath = argv[1];
+    std::string outPath = argv[2];
+    int kngh = 4;
+    std::string capacityPath = "";
+    std::string scenPath = "";
+    int nAgents = 0;
+    raplab::GridOrder order = raplab::GridOrder::ROW_MAJOR;
+    for (int i = 3; i < argc; i++) {
+        std::string a = argv[i];
+        if (a == "--kngh" && i + 1 < argc) {
+            kngh = std::stoi(argv[++i]);
+        } else if (a == "--capacity" && i + 1 < argc) {
+            capacityPath = argv[++i];
+        } else if (a == "--hop-goals" && i + 2 < argc) {
+            scenPath = argv[++i];
+            nAgents = std::stoi(argv[++i]);
+        } else if (a == "--vertex-order" && i + 1 < argc) {
+            std::string o = argv[++i];
+            if (o == "hilbert") {
+                order = raplab::GridOrder::HILBERT;
+            } else if (o == "bfs") {
+                order = raplab::GridOrder::BFS;
+            } else if (o != "row") {
+                std::cerr << "Unknown vertex order: " << o << std::endl;
+                return -1;
+            }
+        } else {
+            std::cerr << "Unknown argument: " << a << std::endl;
+            return -1;
+        }
+    }
+
+    raplab::OccupancyBitmap occupancy;
+    if (raplab::ParseMap_MovingAI(mapPath, &occupancy) != 1) {
+        return -1;
+    }
+    raplab::Grid2d g;
+    if (!g.SetKNeighbor(kngh)) {
+        std::cerr << "Unsupported kngh: " << kngh << std::endl;
+        return -1;
+    }
+    g.SetVertexOrder(order);
+    g.SetOccuBitmapPtr(&occupancy);
+
+    // the files use row-major cell ids, the binary map vertex ids.
+    std::unordered_map<long, int> file_capacities;
+    if (!capacityPath.empty() && raplab::LoadNodeCapacities(capacityPath, &file_capacities) != 1) {
+        return -1;
+    }
+    std::unordered_map<long, int> node_capacities;
+    for (const auto& kv : file_capacities) {
+        node_capacities[g.HasVertex(kv.first) ? g.ToInternal(kv.first) : kv.first] = kv.second;
+    }
+    std::vector<long> starts;
+    std::vector<long> goals;
+    if (!scenPath.empty()) {
+        std::tuple<int, int> width_height;
+        raplab::ScenarioSelection sel;
+        sel.count = nAgents;
+        sel.width = occupancy.cols;
+        sel.height = occupancy.rows;
+        if (raplab::ParseScenarios_MovingAI(scenPath, sel, &starts, &goals, &width_height) != 1) {
+            return -1;
+        }
+        for (auto& v : goals) {
+            if (g.HasVertex(v)) {v = g.ToInternal(v);}
+        }
+    }
+    if (raplab::WriteBinaryMap(outPath, g, node_capacities, goals) != 1) {
+        return -1;
+    }
+    raplab::BinaryMap check;
+    if (check.Open(outPath) != 1) {
+        return -1;
+    }
+    std::cout << outPath << ": " << check.Header().rows << "x" << check.Header().cols
+              << ", " << check.Header().n_arcs << " arcs, " << check.NumHopTables() << " hop tables, "
+              << check.Header().file_size << " bytes" << std::endl;
+    return 0;
+}
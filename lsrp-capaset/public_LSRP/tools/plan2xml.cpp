@@ -0,0 +1,135 @@
+/*******************************************
+ * Author: Shuai Zhou.
+ * Organization: Raplab
+ * All Rights Reserved.
+ *******************************************/
+
+// Convert a binary plan written by lsrp into the XML file of the visualizer, see plan_file.hpp.
+
+#include "binary_map.hpp"
+#include "plan_file.hpp"
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// cell values of the XML grid: 0 free, 1 obstacle, 2 tree.
+int ReadMapCells(const std::string& map_path, long rows, long cols, std::vector<std::vector<int>>* grid) {
+    grid->assign(rows, std::vector<int>());
+    raplab::BinaryMap binMap;
+    if (raplab::BinaryMap::IsBinaryMap(map_path)) {
+        // a precompiled map only keeps the obstacle bitmap, trees are written as obstacles.
+        raplab::Grid2d g;
+        if (binMap.Open(map_path) != 1 || raplab::AttachBinaryMap(binMap, &g) != 1) {
+            return -1;
+        }
+        for (long i = 0; i < rows; ++i) {
+            for (long j = 0; j < cols; ++j) {
+                (*grid)[i].push_back(g.IsObstacle(g.ToInternal(i * cols + j)) ? 1 : 0);
+            }
+        }
+        return 1;
+    }
+    std::ifstream map_file(map_path);
+    if (!map_file.is_open()) {
+        std::cerr << "[Error] file '" << map_path << "' could not be opened" << std::endl;
+        return -1;
+    }
+    std::string line;
+    while (std::getline(map_file, line) && line.compare(0, 3, "map") != 0) {}
+    for (long i = 0; i < rows && std::getline(map_file, line); ++i) {
+        for (char c : line) {
+            if (c == '.') {
+                (*grid)[i].push_back(0);
+            } else if (c == '@') {
+                (*grid)[i].push_back(1);
+            } else if (c == 'T') {
+                (*grid)[i].push_back(2);
+            }
+        }
+    }
+    return 1;
+}
+
+// distinct colors without a search: an odd multiplier is a bijection of the 24 bit colors, white is
+// replaced by the color of the last index, which no agent uses.
+void AgentColor(uint32_t i, int rgb[3]) {
+    const uint32_t kMul = 0x9E3779u;
+    uint32_t c = (i * kMul) & 0xFFFFFFu;
+    if (c == 0xFFFFFFu) {c = (0xFFFFFFu * kMul) & 0xFFFFFFu;}
+    rgb[0] = int(c >> 16);
+    rgb[1] = int((c >> 8) & 0xFF);
+    rgb[2] = int(c & 0xFF);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <plan_path> <map_path> [xml_path]" << std::endl;
+        return -1;
+    }
+    std::string planPath = argv[1];
+    std::string mapPath = argv[2];
+    std::string xmlPath = (argc > 3) ? argv[3] : "result.xml";
+
+    raplab::PlanReader plan;
+    if (plan.Open(planPath) != 1) {
+        return -1;
+    }
+    const raplab::PlanFileHeader& h = plan.Header();
+    std::vector<std::vector<int>> grid;
+    if (ReadMapCells(mapPath, h.rows, h.cols, &grid) != 1) {
+        return -1;
+    }
+    for (long i = 0; i < h.rows; ++i) {
+        if (long(grid[i].size()) != h.cols) {
+            std::cerr << "[Error] plan2xml, the map is not " << h.rows << " x " << h.cols << " as in the plan" << std::endl;
+            return -1;
+        }
+    }
+    std::ofstream file(xmlPath);
+    if (!file.is_open()) {
+        std::cerr << "[Error] file '" << xmlPath << "' could not be opened" << std::endl;
+        return -1;
+    }
+
+    file << "<?xml version=\"1.0\" ?>\n";
+    file << "<root>\n";
+    file << "    <map>\n";
+    file << "        <grid width=\"" << h.cols << "\" height=\"" << h.rows << "\">\n";
+    for (const auto& row : grid) {
+        file << "            <row>";
+        for (int cell : row) {
+            file << cell << ' ';
+        }
+        file << "</row>\n";
+    }
+    file << "        </grid>\n";
+    file << "    </map>\n";
+
+    file << "    <log>\n";
+    file << "        <summary time=\"" << h.runtime << "\" flowtime=\"" << h.soc << "\" makespan=\"" << h.makespan << "\"/>\n";
+    double duration;
+    std::vector<raplab::PlanSection> sections;
+    int ret;
+    for (uint32_t i = 0; (ret = plan.NextAgent(&duration, &sections)) == 1; ++i) {
+        int rgb[3];
+        AgentColor(i, rgb);
+        file << "        <agent number=\"" << i << "\">\n";
+        file << "            <color RGB=\"(" << rgb[0] << ", " << rgb[1] << ", " << rgb[2] << ")\"/>\n";
+        file << "            <path duration=\"" << duration << "\">\n";
+        for (size_t j = 0; j < sections.size(); ++j) {
+            const auto& s = sections[j];
+            file << "                <section number=\"" << j << "\" start_i=\"" << s.from / h.cols << "\" start_j=\"" << s.from % h.cols
+                 << "\" goal_i=\"" << s.to / h.cols << "\" goal_j=\"" << s.to % h.cols << "\" duration=\"" << s.end - s.start << "\"/>\n";
+        }
+        file << "            </path>\n";
+        file << "        </agent>\n";
+    }
+    file << "    </log>\n";
+    file << "</root>\n";
+    if (ret < 0) {
+        std::cerr << "[Error] plan2xml, '" << planPath << "' is truncated" << std::endl;
+        return -1;
+    }
+    return 0;
+}